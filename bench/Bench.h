@@ -0,0 +1,189 @@
+/******************************************************************************
+*  Name: Bench.h
+*
+*  Purpose: Microbenchmark harness for the IPC and logging primitives,
+*           collects latency samples and reports percentiles as a table
+*           and as JSON
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "common/types.h"
+#include "lib/time/time.h"
+
+// each benchmark runs for a fixed amount of time and records one or more
+// results, a result is a set of parameters (what was measured), rates and
+// counts, and latency distributions in nanoseconds
+//
+// latencies are measured with time_util::mono_ns, which costs a few tens of
+// nanoseconds, so operations cheaper than that are reported as rates rather
+// than per operation latencies
+
+// Benchmark type and data declarations
+namespace BenchDecls {
+    /// the most samples kept for one latency distribution, past this samples
+    /// are kept at random so the distribution stays representative
+    static const size_t MAX_SAMPLES = 1 << 20;
+
+    /// @brief benchmark options
+    typedef struct {
+        time_util::timestamp_t duration;    // how long each benchmark runs
+        std::vector<int> cpus;              // CPUs to pin each side of a
+                                            // benchmark to, empty to not pin
+        std::vector<size_t> sizes;          // triple buffer payload sizes
+        std::vector<size_t> threads;        // semaphore contender counts
+    } options_t;
+
+    /// @brief a latency distribution in nanoseconds
+    typedef struct {
+        uint64_t count;                     // samples taken, including those
+                                            // not kept
+        uint64_t min;
+        double mean;
+        uint64_t p50;
+        uint64_t p90;
+        uint64_t p99;
+        uint64_t p999;
+        uint64_t max;
+    } summary_t;
+
+    /// @brief the result of one benchmark configuration
+    typedef struct {
+        std::string name;
+        std::vector<std::pair<std::string, int64_t>> params;
+        std::vector<std::pair<std::string, double>> metrics;
+        std::vector<std::pair<std::string, summary_t>> latencies;
+    } result_t;
+};
+
+/// @brief a set of latency samples
+class Samples {
+public:
+    /// @brief constructor
+    Samples();
+
+    /// @brief add a sample
+    /// @param ns   the latency in nanoseconds
+    void add(uint64_t ns) {
+        m_count++;
+        m_sum += ns;
+
+        if(ns < m_min) {
+            m_min = ns;
+        }
+
+        if(ns > m_max) {
+            m_max = ns;
+        }
+
+        if(m_samples.size() < BenchDecls::MAX_SAMPLES) {
+            m_samples.push_back(ns);
+        } else {
+            // reservoir sampling, every sample has the same chance of being kept
+            uint64_t i = random() % m_count;
+            if(i < BenchDecls::MAX_SAMPLES) {
+                m_samples[i] = ns;
+            }
+        }
+    }
+
+    /// @brief add every sample from another set, e.g. one per thread
+    /// @param other    the samples to add
+    void merge(const Samples& other);
+
+    /// @brief get the number of samples added
+    uint64_t count() { return m_count; }
+
+    /// @brief summarize the samples
+    /// NOTE: sorts the kept samples
+    /// @return the distribution, all zero if no samples were added
+    BenchDecls::summary_t summarize();
+
+private:
+    /// @brief get a random number for reservoir sampling (xorshift64)
+    uint64_t random() {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
+        return m_state;
+    }
+
+    std::vector<uint64_t> m_samples;
+    uint64_t m_count;
+    uint64_t m_sum;
+    uint64_t m_min;
+    uint64_t m_max;
+    uint64_t m_state;
+};
+
+/// @brief runs benchmarks and collects their results
+class Bench {
+public:
+    /// @brief constructor
+    /// @param opts     benchmark options
+    Bench(const BenchDecls::options_t& opts);
+
+    /// @brief get the benchmark options
+    const BenchDecls::options_t& options() { return m_opts; }
+
+    /// @brief start a new result
+    /// @param name     the name of the benchmark
+    /// @return the result to fill in
+    BenchDecls::result_t& result(const char* name);
+
+    /// @brief pin the calling thread to the CPU for one side of a benchmark
+    /// @param side     which side (e.g. 0 for the writer, 1 for the reader),
+    ///                 wraps around the CPU list
+    /// @return the CPU pinned to, or -1 if not pinning
+    int pin(size_t side);
+
+    /// @brief undo any pinning of the calling thread
+    void unpin();
+
+    /// @brief print the results as a table
+    /// @param out  the file to print to
+    void print(FILE* out);
+
+    /// @brief write the results as JSON
+    /// @param out  the file to write to
+    /// @return
+    RetType write_json(FILE* out);
+
+private:
+    BenchDecls::options_t m_opts;
+    std::vector<BenchDecls::result_t> m_results;
+
+    // affinity when the harness started
+    cpu_set_t m_affinity;
+};
+
+// benchmarks, each runs every configuration its options select
+
+/// @brief triple buffer throughput and staleness across threads and processes
+void bench_triple_buffer(Bench& bench);
+
+/// @brief Logger::log_vec latency with each transport
+void bench_logger(Bench& bench);
+
+/// @brief shared memory create, attach, first touch, and destroy cost
+void bench_shm(Bench& bench);
+
+/// @brief semaphore throughput and acquire latency with contending threads
+void bench_semaphore(Bench& bench);
+
+/// @brief BatchDecoder throughput with each instruction set
+void bench_decoder(Bench& bench);
+
+#endif
@@ -0,0 +1,270 @@
+/******************************************************************************
+*  Name: Bench.cpp
+*
+*  Purpose: Microbenchmark harness for the IPC and logging primitives,
+*           collects latency samples and reports percentiles as a table
+*           and as JSON
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include <algorithm>
+
+#include "bench/Bench.h"
+
+using namespace BenchDecls;
+
+/// @brief constructor
+Samples::Samples() : m_count(0), m_sum(0), m_min(UINT64_MAX), m_max(0),
+                     m_state(0x9E3779B97F4A7C15ULL) {
+    // nothing else to do
+}
+
+/// @brief get a percentile of sorted samples (nearest rank)
+/// @param sorted   the samples, sorted
+/// @param p        the percentile, 0 to 1
+/// @return the sample
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    size_t rank = (size_t)ceil(p * sorted.size());
+    if(rank > 0) {
+        rank--;
+    }
+
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+/// @brief add every sample from another set
+/// @param other    the samples to add
+void Samples::merge(const Samples& other) {
+    // the other set's kept samples stand in for the ones it didn't keep
+    uint64_t count = m_count + other.m_count;
+    uint64_t sum = m_sum + other.m_sum;
+
+    for(uint64_t ns : other.m_samples) {
+        add(ns);
+    }
+
+    m_count = count;
+    m_sum = sum;
+    m_min = std::min(m_min, other.m_min);
+    m_max = std::max(m_max, other.m_max);
+}
+
+/// @brief summarize the samples
+/// @return the distribution, all zero if no samples were added
+summary_t Samples::summarize() {
+    summary_t sum;
+    memset(&sum, 0, sizeof(sum));
+
+    if(0 == m_count) {
+        return sum;
+    }
+
+    std::sort(m_samples.begin(), m_samples.end());
+
+    sum.count = m_count;
+    sum.min = m_min;
+    sum.mean = (double)m_sum / m_count;
+    sum.p50 = percentile(m_samples, 0.5);
+    sum.p90 = percentile(m_samples, 0.9);
+    sum.p99 = percentile(m_samples, 0.99);
+    sum.p999 = percentile(m_samples, 0.999);
+    sum.max = m_max;
+
+    return sum;
+}
+
+/// @brief constructor
+/// @param opts     benchmark options
+Bench::Bench(const options_t& opts) : m_opts(opts) {
+    CPU_ZERO(&m_affinity);
+    if(-1 == sched_getaffinity(0, sizeof(m_affinity), &m_affinity)) {
+        perror("sched_getaffinity failed");
+    }
+}
+
+/// @brief start a new result
+/// @param name     the name of the benchmark
+/// @return the result to fill in
+result_t& Bench::result(const char* name) {
+    m_results.push_back(result_t());
+    m_results.back().name = name;
+
+    return m_results.back();
+}
+
+/// @brief pin the calling thread to the CPU for one side of a benchmark
+/// @param side     which side, wraps around the CPU list
+/// @return the CPU pinned to, or -1 if not pinning
+int Bench::pin(size_t side) {
+    if(m_opts.cpus.empty()) {
+        return -1;
+    }
+
+    int cpu = m_opts.cpus[side % m_opts.cpus.size()];
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    // pid 0 is the calling thread
+    if(-1 == sched_setaffinity(0, sizeof(set), &set)) {
+        perror("sched_setaffinity failed");
+        return -1;
+    }
+
+    return cpu;
+}
+
+/// @brief undo any pinning of the calling thread
+void Bench::unpin() {
+    if(m_opts.cpus.empty()) {
+        return;
+    }
+
+    if(-1 == sched_setaffinity(0, sizeof(m_affinity), &m_affinity)) {
+        perror("sched_setaffinity failed");
+    }
+}
+
+/// @brief print the results as a table
+/// @param out  the file to print to
+void Bench::print(FILE* out) {
+    for(result_t& res : m_results) {
+        fprintf(out, "%s", res.name.c_str());
+        for(auto& param : res.params) {
+            fprintf(out, " %s=%ld", param.first.c_str(), param.second);
+        }
+        fprintf(out, "\n");
+
+        for(auto& metric : res.metrics) {
+            fprintf(out, "    %-24s %.6g\n", metric.first.c_str(), metric.second);
+        }
+
+        for(auto& lat : res.latencies) {
+            const summary_t& s = lat.second;
+            fprintf(out, "    %-24s p50 %lu p90 %lu p99 %lu p99.9 %lu max %lu ns (%lu samples)\n",
+                    lat.first.c_str(), s.p50, s.p90, s.p99, s.p999, s.max, s.count);
+        }
+    }
+}
+
+/// @brief write a string as a JSON string
+/// @param out  the file to write to
+/// @param str  the string
+static void json_string(FILE* out, const char* str) {
+    fputc('"', out);
+
+    for(; *str; str++) {
+        if('"' == *str || '\\' == *str) {
+            fputc('\\', out);
+            fputc(*str, out);
+        } else if((unsigned char)*str < 0x20) {
+            fprintf(out, "\\u%04x", *str);
+        } else {
+            fputc(*str, out);
+        }
+    }
+
+    fputc('"', out);
+}
+
+/// @brief write a number as JSON, which has no infinities or NaNs
+/// @param out  the file to write to
+/// @param val  the number
+static void json_number(FILE* out, double val) {
+    if(isfinite(val)) {
+        fprintf(out, "%.6g", val);
+    } else {
+        fprintf(out, "null");
+    }
+}
+
+/// @brief write the results as JSON
+/// @param out  the file to write to
+/// @return
+RetType Bench::write_json(FILE* out) {
+    struct utsname host;
+    if(-1 == uname(&host)) {
+        memset(&host, 0, sizeof(host));
+    }
+
+    char date[time_util::TIME_STR_LEN];
+    time_util::format(time_util::now_ns(), date, sizeof(date));
+
+    // host and options first, so results from different machines and
+    // configurations can be told apart
+    fprintf(out, "{\n  \"date\": ");
+    json_string(out, date);
+    fprintf(out, ",\n  \"host\": {\"name\": ");
+    json_string(out, host.nodename);
+    fprintf(out, ", \"kernel\": ");
+    json_string(out, host.release);
+    fprintf(out, ", \"machine\": ");
+    json_string(out, host.machine);
+    fprintf(out, ", \"cpus\": %ld, \"tsc\": %s},\n", sysconf(_SC_NPROCESSORS_ONLN),
+            time_util::tsc_enabled() ? "true" : "false");
+
+    fprintf(out, "  \"options\": {\"duration_ns\": %lu, \"cpus\": [", m_opts.duration);
+    for(size_t i = 0; i < m_opts.cpus.size(); i++) {
+        fprintf(out, "%s%d", i ? ", " : "", m_opts.cpus[i]);
+    }
+    fprintf(out, "], \"sizes\": [");
+    for(size_t i = 0; i < m_opts.sizes.size(); i++) {
+        fprintf(out, "%s%lu", i ? ", " : "", m_opts.sizes[i]);
+    }
+    fprintf(out, "], \"threads\": [");
+    for(size_t i = 0; i < m_opts.threads.size(); i++) {
+        fprintf(out, "%s%lu", i ? ", " : "", m_opts.threads[i]);
+    }
+    fprintf(out, "]},\n  \"results\": [");
+
+    for(size_t i = 0; i < m_results.size(); i++) {
+        result_t& res = m_results[i];
+
+        fprintf(out, "%s\n    {\"name\": ", i ? "," : "");
+        json_string(out, res.name.c_str());
+
+        fprintf(out, ",\n     \"params\": {");
+        for(size_t j = 0; j < res.params.size(); j++) {
+            fprintf(out, "%s", j ? ", " : "");
+            json_string(out, res.params[j].first.c_str());
+            fprintf(out, ": %ld", res.params[j].second);
+        }
+
+        fprintf(out, "},\n     \"metrics\": {");
+        for(size_t j = 0; j < res.metrics.size(); j++) {
+            fprintf(out, "%s", j ? ", " : "");
+            json_string(out, res.metrics[j].first.c_str());
+            fprintf(out, ": ");
+            json_number(out, res.metrics[j].second);
+        }
+
+        fprintf(out, "},\n     \"latency_ns\": {");
+        for(size_t j = 0; j < res.latencies.size(); j++) {
+            const summary_t& s = res.latencies[j].second;
+
+            fprintf(out, "%s\n       ", j ? "," : "");
+            json_string(out, res.latencies[j].first.c_str());
+            fprintf(out, ": {\"count\": %lu, \"min\": %lu, \"mean\": ", s.count, s.min);
+            json_number(out, s.mean);
+            fprintf(out, ", \"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"p999\": %lu, \"max\": %lu}",
+                    s.p50, s.p90, s.p99, s.p999, s.max);
+        }
+
+        fprintf(out, "%s}}", res.latencies.empty() ? "" : "\n     ");
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+
+    if(ferror(out)) {
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
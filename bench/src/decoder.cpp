@@ -0,0 +1,184 @@
+/******************************************************************************
+*  Name: decoder.cpp
+*
+*  Purpose: BatchDecoder throughput with each instruction set, against
+*           decoding one field at a time
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <vector>
+
+#include "bench/Bench.h"
+#include "lib/telemetry/BatchDecoder.h"
+#include "lib/telemetry/Field.h"
+
+using namespace BenchDecls;
+using namespace TelemetryConfigDecls;
+using namespace BatchDecoderDecls;
+
+// every instruction set is timed decoding the same packet over and over, the
+// results are checked against field::raw and field::value by lib/telemetry/test
+//
+// "decoder.field" decodes one field at a time with field::raw and
+// field::value, which is what Extractor did before BatchDecoder, every other
+// result is compared to it
+
+/// number of measurements in the packet layout
+#define NUM_FIELDS 2000
+
+/// packets decoded between checks of the clock
+#define BATCH 64
+
+/// @brief xorshift64, the layout and packets are the same every run
+/// @param state    updated
+/// @return the next random number
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/// @brief build a packet layout with a mix of every kind of field, mostly
+///        ones that can be grouped
+/// @param packet   filled in
+/// @return the size of the packet in bytes
+static size_t make_layout(packet_info_t* packet) {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    packet->name = "bench";
+    packet->port = 0;
+
+    // leave room before the first field for 16 bit loads
+    size_t offset = 2;
+
+    for(size_t i = 0; i < NUM_FIELDS; i++) {
+        measurement_info_t meas;
+        meas.name = "m" + std::to_string(i);
+        meas.offset = offset;
+        meas.bit = 0;
+        meas.endian = (next_random(&state) & 1) ? BIG : LITTLE;
+        meas.type = UINT;
+        meas.scale = 1.0 + (double)(next_random(&state) % 1000) / 100.0;
+        meas.bias = (double)(next_random(&state) % 2001) - 1000.0;
+
+        uint64_t kind = next_random(&state) % 16;
+        if(kind < 4) {
+            meas.bits = 16;
+            meas.type = (kind & 1) ? INT : UINT;
+        } else if(kind < 10) {
+            meas.bits = 32;
+            meas.type = (type_t)(kind % 3);
+        } else if(kind < 13) {
+            meas.bits = 64;
+            meas.type = (type_t)(kind % 3);
+        } else if(kind < 15) {
+            meas.bits = 8;
+            meas.type = (kind & 1) ? INT : UINT;
+        } else {
+            // bit field, always big endian
+            meas.bit = next_random(&state) % 8;
+            meas.bits = 1 + next_random(&state) % 12;
+            meas.endian = BIG;
+        }
+
+        packet->measurements.push_back(meas);
+        offset += (meas.bit + meas.bits + 7) / 8;
+    }
+
+    return offset;
+}
+
+/// @brief time decoding one packet over and over
+/// @param bench    the harness
+/// @param decoder  the decoder to use, or NULL to decode one field at a time
+/// @param packet   the packet layout
+/// @param pkt      the packet
+/// @return packets decoded per second
+static double run(Bench& bench, BatchDecoder* decoder, const packet_info_t& packet,
+                  const std::vector<uint8_t>& pkt) {
+    std::vector<uint64_t> raw(NUM_FIELDS);
+    std::vector<double> value(NUM_FIELDS);
+
+    // keeps the decoding from being optimized out
+    volatile double sink = 0;
+
+    uint64_t packets = 0;
+    time_util::timestamp_t start = time_util::mono_ns();
+    time_util::timestamp_t deadline = start + bench.options().duration;
+    time_util::timestamp_t now = start;
+
+    while(now < deadline) {
+        for(size_t n = 0; n < BATCH; n++) {
+            if(NULL != decoder) {
+                decoder->decode(pkt.data(), raw.data(), value.data());
+            } else {
+                for(size_t i = 0; i < NUM_FIELDS; i++) {
+                    const measurement_info_t& meas = packet.measurements[i];
+                    raw[i] = field::raw(pkt.data(), meas);
+                    value[i] = field::value(raw[i], meas);
+                }
+            }
+
+            sink = sink + value[n % NUM_FIELDS];
+        }
+
+        packets += BATCH;
+        now = time_util::mono_ns();
+    }
+
+    double secs = (double)(now - start) / time_util::NS_PER_SEC;
+
+    return secs > 0 ? packets / secs : 0;
+}
+
+/// @brief record a result
+/// @param bench        the harness
+/// @param name         the name of the result
+/// @param size         the size of the packet in bytes
+/// @param rate         packets decoded per second
+/// @param baseline     packets decoded per second one field at a time
+static void record(Bench& bench, const char* name, size_t size, double rate,
+                   double baseline) {
+    result_t& res = bench.result(name);
+    res.params.push_back({"fields", NUM_FIELDS});
+    res.params.push_back({"bytes", size});
+
+    res.metrics.push_back({"packets_per_sec", rate});
+    res.metrics.push_back({"ns_per_field", rate > 0 ? time_util::NS_PER_SEC / (rate * NUM_FIELDS) : 0});
+    res.metrics.push_back({"speedup", baseline > 0 ? rate / baseline : 0});
+}
+
+/// @brief BatchDecoder throughput with each instruction set
+void bench_decoder(Bench& bench) {
+    packet_info_t packet;
+    size_t size = make_layout(&packet);
+
+    std::vector<uint8_t> pkt(size);
+    uint64_t state = 0xBF58476D1CE4E5B9ULL;
+    for(uint8_t& byte : pkt) {
+        byte = next_random(&state);
+    }
+
+    bench.pin(0);
+
+    double baseline = run(bench, NULL, packet, pkt);
+    record(bench, "decoder.field", size, baseline, baseline);
+
+    static const char* NAMES[AVX2 + 1] = {"decoder.scalar", "decoder.sse4", "decoder.avx2"};
+
+    for(int isa = SCALAR; isa <= AVX2; isa++) {
+        BatchDecoder decoder(packet, (isa_t)isa);
+        if(decoder.isa() != isa) {
+            printf("Skipping %s, not supported by this processor\n", isa_str[isa]);
+            continue;
+        }
+
+        double rate = run(bench, &decoder, packet, pkt);
+        record(bench, NAMES[isa], size, rate, baseline);
+    }
+
+    bench.unpin();
+}
@@ -0,0 +1,227 @@
+/******************************************************************************
+*  Name: logger.cpp
+*
+*  Purpose: Logger::log_vec latency with each transport
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <thread>
+#include <string>
+
+#include "bench/Bench.h"
+#include "lib/logging/Logger.h"
+#include "lib/logging/LogRing.h"
+
+using namespace BenchDecls;
+using namespace LoggerDecls;
+
+// a thread stands in for the logging daemon and drains every message, so
+// the latency includes the sender blocking (socket) or dropping (ring) when
+// the daemon falls behind
+
+/// logger address file, separate from the real loggers so a running logging
+/// daemon isn't disturbed
+#define LOG_FILE "bench_log_socket"
+
+/// how long the drain thread blocks for before checking if it should stop
+#define DRAIN_TIMEOUT_MS 10
+
+/// @brief total message sizes, including the header vector
+static const size_t MSG_SIZES[] = {64, 1024, Logger::MAX_LOG_SIZE};
+
+/// bytes in the first vector of each message, like a message logger header
+#define HEADER_SIZE 32
+
+/// @brief drain the socket until told to stop
+/// @param sd       the bound socket
+/// @param stop     set when done
+/// @param received filled with the number of messages received
+static void drain_socket(int sd, uint32_t* stop, uint64_t* received) {
+    uint8_t buff[Logger::MAX_LOG_SIZE];
+
+    while(!__atomic_load_n(stop, __ATOMIC_RELAXED)) {
+        if(recv(sd, buff, sizeof(buff), 0) >= 0) {
+            __atomic_add_fetch(received, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/// @brief drain the ring until told to stop
+/// @param ring     the created ring
+/// @param stop     set when done
+/// @param received filled with the number of messages received
+static void drain_ring(LogRing* ring, uint32_t* stop, uint64_t* received) {
+    while(!__atomic_load_n(stop, __ATOMIC_RELAXED)) {
+        uint32_t seq = ring->sequence();
+
+        size_t len;
+        if(NULL != ring->peek(&len)) {
+            ring->pop();
+            __atomic_add_fetch(received, 1, __ATOMIC_RELAXED);
+        } else {
+            ring->wait(seq, DRAIN_TIMEOUT_MS);
+        }
+    }
+}
+
+/// @brief log messages of each size for the duration of the benchmark
+/// @param bench        the harness
+/// @param logger       the logger
+/// @param transport    the transport the logger uses
+/// @param ring         the ring if using one, for the drop count
+/// @param received     incremented by the drain thread
+static void send_all(Bench& bench, Logger& logger, transport_t transport, LogRing* ring,
+                     uint64_t* received) {
+    static uint8_t payload[Logger::MAX_LOG_SIZE];
+    memset(payload, 'x', sizeof(payload));
+
+    for(size_t size : MSG_SIZES) {
+        Samples latency;
+        uint64_t failed = 0;
+        uint64_t dropped = (NULL != ring) ? ring->dropped() : 0;
+        uint64_t first = __atomic_load_n(received, __ATOMIC_RELAXED);
+
+        int cpu = bench.pin(0);
+
+        time_util::timestamp_t start = time_util::mono_ns();
+        time_util::timestamp_t deadline = start + bench.options().duration;
+        time_util::timestamp_t now = start;
+
+        // the header is a timestamp plus padding, only the size matters
+        uint8_t header[HEADER_SIZE];
+        memset(header, 0, sizeof(header));
+
+        struct iovec vec[2];
+        vec[0].iov_base = header;
+        vec[0].iov_len = HEADER_SIZE;
+        vec[1].iov_base = payload;
+        vec[1].iov_len = size - HEADER_SIZE;
+
+        while(now < deadline) {
+            memcpy(header, &now, sizeof(now));
+
+            time_util::timestamp_t before = time_util::mono_ns();
+            if(SUCCESS != logger.log_vec(vec, 2)) {
+                failed++;
+            }
+            now = time_util::mono_ns();
+
+            latency.add(now - before);
+        }
+
+        bench.unpin();
+
+        double secs = (double)(now - start) / time_util::NS_PER_SEC;
+
+        // let the drain thread catch up before counting what it received
+        usleep(DRAIN_TIMEOUT_MS * 1000);
+
+        result_t& res = bench.result(SOCKET == transport ? "logger.socket" : "logger.ring");
+        res.params.push_back({"size", size});
+        res.params.push_back({"cpu", cpu});
+
+        res.metrics.push_back({"messages_per_sec", secs > 0 ? latency.count() / secs : 0});
+        res.metrics.push_back({"failed", failed});
+        res.metrics.push_back({"received", __atomic_load_n(received, __ATOMIC_RELAXED) - first});
+        if(NULL != ring) {
+            res.metrics.push_back({"dropped", ring->dropped() - dropped});
+        }
+
+        res.latencies.push_back({"log_vec", latency.summarize()});
+    }
+}
+
+/// @brief benchmark logging over the socket
+/// @param bench    the harness
+static void run_socket(Bench& bench) {
+    std::string path = std::string(getenv("GSW_HOME")) + "/" + LOG_FILE;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if(path.length() >= sizeof(addr.sun_path)) {
+        printf("Logger socket path '%s' is too long\n", path.c_str());
+        return;
+    }
+    strcpy(addr.sun_path, path.c_str());
+
+    int sd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if(-1 == sd) {
+        perror("Failed to open socket");
+        return;
+    }
+
+    // wake up every so often to check if done
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = DRAIN_TIMEOUT_MS * 1000;
+    setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    unlink(path.c_str());
+    if(-1 == bind(sd, (struct sockaddr*)&addr, sizeof(addr))) {
+        perror("Failed to bind logger socket");
+        close(sd);
+        return;
+    }
+
+    uint32_t stop = 0;
+    uint64_t received = 0;
+
+    std::thread drain([&]() {
+        bench.pin(1);
+        drain_socket(sd, &stop, &received);
+    });
+
+    Logger logger(LOG_FILE, SOCKET);
+    send_all(bench, logger, SOCKET, NULL, &received);
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    drain.join();
+
+    close(sd);
+    unlink(path.c_str());
+}
+
+/// @brief benchmark logging through the ring
+/// @param bench    the harness
+static void run_ring(Bench& bench) {
+    LogRing ring(LOG_FILE);
+    if(SUCCESS != ring.create()) {
+        printf("Failed to create log ring\n");
+        return;
+    }
+
+    uint32_t stop = 0;
+    uint64_t received = 0;
+
+    std::thread drain([&]() {
+        bench.pin(1);
+        drain_ring(&ring, &stop, &received);
+    });
+
+    Logger logger(LOG_FILE, RING);
+    if(RING == logger.transport()) {
+        send_all(bench, logger, RING, &ring, &received);
+    } else {
+        printf("Logger didn't attach to the log ring\n");
+    }
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    drain.join();
+
+    ring.destroy();
+}
+
+/// @brief Logger::log_vec latency with each transport
+void bench_logger(Bench& bench) {
+    run_socket(bench);
+    run_ring(bench);
+}
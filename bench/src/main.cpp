@@ -0,0 +1,178 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Runs microbenchmarks of the IPC and logging primitives
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_bench [-d duration] [-c cpus] [-s sizes] [-n threads]
+*                     [-o file] [benchmark ...]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "bench/Bench.h"
+
+using namespace BenchDecls;
+
+/// the largest triple buffer payload, see triple_buffer.cpp
+#define MAX_SIZE (1 << 20)
+
+/// @brief a benchmark that can be selected by name
+typedef struct {
+    const char* name;
+    void (*run)(Bench& bench);
+} benchmark_t;
+
+/// @brief every benchmark, in the order they run
+static const benchmark_t BENCHMARKS[] = {
+    {"triple_buffer", bench_triple_buffer},
+    {"logger", bench_logger},
+    {"shm", bench_shm},
+    {"semaphore", bench_semaphore},
+    {"decoder", bench_decoder}
+};
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_bench [-d duration] [-c cpus] [-s sizes] [-n threads] [-o file] [benchmark ...]\n");
+    printf("    -d duration seconds to run each configuration for (default 1)\n");
+    printf("    -c cpus     comma separated CPUs to pin each side of a benchmark to (default none)\n");
+    printf("    -s sizes    comma separated triple buffer payload sizes in bytes (default 64,4096,65536)\n");
+    printf("    -n threads  comma separated semaphore contender counts (default 1,2,4)\n");
+    printf("    -o file     also write the results as JSON to this file\n");
+    printf("    benchmark   only run these, any of:");
+    for(const benchmark_t& bench : BENCHMARKS) {
+        printf(" %s", bench.name);
+    }
+    printf(" (default all)\n");
+    exit(FAILURE);
+}
+
+/// @brief parse a comma separated list of non-negative integers
+/// @param arg  the argument
+/// @param max  the largest allowed value
+/// @return the list
+std::vector<size_t> parse_list(const char* arg, size_t max) {
+    std::vector<size_t> list;
+
+    const char* curr = arg;
+    while('\0' != *curr) {
+        char* end;
+        unsigned long val = strtoul(curr, &end, 0);
+        if(end == curr || val > max || (',' != *end && '\0' != *end)) {
+            usage();
+        }
+
+        list.push_back(val);
+        curr = (',' == *end) ? end + 1 : end;
+    }
+
+    if(list.empty()) {
+        usage();
+    }
+
+    return list;
+}
+
+int main(int argc, char* argv[]) {
+    options_t opts;
+    opts.duration = time_util::NS_PER_SEC;
+    opts.sizes = {64, 4096, 65536};
+    opts.threads = {1, 2, 4};
+
+    const char* json = NULL;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "d:c:s:n:o:h"))) {
+        switch(opt) {
+            case 'd': {
+                char* end;
+                double seconds = strtod(optarg, &end);
+                if(end == optarg || '\0' != *end || seconds <= 0) {
+                    usage();
+                }
+                opts.duration = (time_util::timestamp_t)(seconds * time_util::NS_PER_SEC);
+                break;
+            }
+            case 'c':
+                for(size_t cpu : parse_list(optarg, CPU_SETSIZE - 1)) {
+                    opts.cpus.push_back((int)cpu);
+                }
+                break;
+            case 's':
+                opts.sizes = parse_list(optarg, MAX_SIZE);
+                break;
+            case 'n':
+                opts.threads = parse_list(optarg, 1024);
+                break;
+            case 'o':
+                json = optarg;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    // loggers and System V keys are relative to GSW_HOME
+    if(NULL == getenv("GSW_HOME")) {
+        printf("GSW_HOME environment variable not set, did you run '. setenv'?\n");
+        exit(FAILURE);
+    }
+
+    for(int i = optind; i < argc; i++) {
+        bool found = false;
+        for(const benchmark_t& bench : BENCHMARKS) {
+            found |= (0 == strcmp(argv[i], bench.name));
+        }
+
+        if(!found) {
+            printf("Unknown benchmark '%s'\n", argv[i]);
+            usage();
+        }
+    }
+
+    Bench bench(opts);
+
+    for(const benchmark_t& benchmark : BENCHMARKS) {
+        bool selected = (optind == argc);
+        for(int i = optind; i < argc; i++) {
+            selected |= (0 == strcmp(argv[i], benchmark.name));
+        }
+
+        if(selected) {
+            printf("Running %s...\n", benchmark.name);
+            fflush(stdout);
+
+            benchmark.run(bench);
+        }
+    }
+
+    printf("\n");
+    bench.print(stdout);
+
+    if(NULL != json) {
+        FILE* out = fopen(json, "w");
+        if(NULL == out) {
+            printf("Failed to open '%s'\n", json);
+            exit(FAILURE);
+        }
+
+        RetType ret = bench.write_json(out);
+        if(0 != fclose(out) || SUCCESS != ret) {
+            printf("Failed to write '%s'\n", json);
+            exit(FAILURE);
+        }
+
+        printf("\nWrote results to '%s'\n", json);
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,185 @@
+/******************************************************************************
+*  Name: semaphore.cpp
+*
+*  Purpose: Semaphore throughput and acquire latency with contending threads
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <unistd.h>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "bench/Bench.h"
+#include "lib/sync/Semaphore.h"
+#include "lib/sync/Futex.h"
+
+using namespace BenchDecls;
+
+// contention: every thread takes a semaphore with one resource as a lock,
+// bumps a shared counter, and gives it back, as fast as it can
+//
+// handoff: two threads pass a token back and forth through a pair of
+// semaphores, so every acquire has to wait for the other thread, the round
+// trip is two wake ups
+
+/// @brief shared between the contending threads
+typedef struct {
+    alignas(64) Semaphore sem{1};
+    alignas(64) uint32_t start;
+    uint32_t stop;
+    alignas(64) uint64_t counter;       // protected by 'sem'
+} contention_t;
+
+/// @brief per thread results
+typedef struct {
+    Samples acquire;
+    uint64_t ops;
+} thread_stats_t;
+
+/// @brief take and give back the semaphore until told to stop
+/// @param shared   the shared state
+/// @param stats    filled with results
+static void contend(contention_t* shared, thread_stats_t* stats) {
+    while(!__atomic_load_n(&shared->start, __ATOMIC_ACQUIRE)) {
+        futex::cpu_relax();
+    }
+
+    while(!__atomic_load_n(&shared->stop, __ATOMIC_RELAXED)) {
+        time_util::timestamp_t before = time_util::mono_ns();
+        shared->sem.acquire();
+        stats->acquire.add(time_util::mono_ns() - before);
+
+        shared->counter++;
+        stats->ops++;
+
+        shared->sem.release();
+    }
+}
+
+/// @brief run the contention benchmark
+/// @param bench    the harness
+/// @param threads  number of contending threads
+static void run_contention(Bench& bench, size_t threads) {
+    contention_t* shared = new contention_t;
+    shared->start = 0;
+    shared->stop = 0;
+    shared->counter = 0;
+
+    std::vector<thread_stats_t> stats(threads);
+    std::vector<std::thread> workers;
+
+    for(size_t i = 0; i < threads; i++) {
+        stats[i].ops = 0;
+        workers.emplace_back([&bench, shared, &stats, i]() {
+            bench.pin(i);
+            contend(shared, &stats[i]);
+        });
+    }
+
+    time_util::timestamp_t start = time_util::mono_ns();
+    __atomic_store_n(&shared->start, 1, __ATOMIC_RELEASE);
+
+    usleep(bench.options().duration / 1000);
+
+    __atomic_store_n(&shared->stop, 1, __ATOMIC_RELAXED);
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+
+    double secs = (double)(time_util::mono_ns() - start) / time_util::NS_PER_SEC;
+
+    Samples acquire;
+    uint64_t least = UINT64_MAX;
+    uint64_t most = 0;
+    for(thread_stats_t& stat : stats) {
+        acquire.merge(stat.acquire);
+        least = std::min(least, stat.ops);
+        most = std::max(most, stat.ops);
+    }
+
+    result_t& res = bench.result("semaphore.contention");
+    res.params.push_back({"threads", threads});
+
+    res.metrics.push_back({"acquires_per_sec", secs > 0 ? shared->counter / secs : 0});
+    res.metrics.push_back({"contended_ratio", shared->counter ?
+                                              (double)shared->sem.contention() / shared->counter : 0});
+    // 1 if every thread got the semaphore as often as the others
+    res.metrics.push_back({"fairness", most ? (double)least / most : 0});
+
+    res.latencies.push_back({"acquire", acquire.summarize()});
+
+    delete shared;
+}
+
+/// @brief run the handoff benchmark
+/// @param bench    the harness
+static void run_handoff(Bench& bench) {
+    Semaphore* ping = new Semaphore(0);
+    Semaphore* pong = new Semaphore(0);
+    uint32_t stop = 0;
+    int echo_cpu = -1;
+
+    // echoes every ping until told to stop
+    std::thread echo([&]() {
+        echo_cpu = bench.pin(1);
+
+        while(true) {
+            ping->acquire();
+            if(__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+                break;
+            }
+
+            pong->release();
+        }
+    });
+
+    int cpu = bench.pin(0);
+
+    Samples round_trip;
+    time_util::timestamp_t start = time_util::mono_ns();
+    time_util::timestamp_t deadline = start + bench.options().duration;
+    time_util::timestamp_t now = start;
+
+    while(now < deadline) {
+        ping->release();
+        pong->acquire();
+
+        time_util::timestamp_t before = now;
+        now = time_util::mono_ns();
+        round_trip.add(now - before);
+    }
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    ping->release();
+    echo.join();
+
+    bench.unpin();
+
+    double secs = (double)(now - start) / time_util::NS_PER_SEC;
+
+    result_t& res = bench.result("semaphore.handoff");
+    res.params.push_back({"cpu", cpu});
+    res.params.push_back({"echo_cpu", echo_cpu});
+
+    res.metrics.push_back({"round_trips_per_sec", secs > 0 ? round_trip.count() / secs : 0});
+    res.metrics.push_back({"contended_ratio", round_trip.count() ?
+                                              (double)(ping->contention() + pong->contention()) /
+                                              (2 * round_trip.count()) : 0});
+
+    res.latencies.push_back({"round_trip", round_trip.summarize()});
+
+    delete ping;
+    delete pong;
+}
+
+/// @brief semaphore throughput and acquire latency with contending threads
+void bench_semaphore(Bench& bench) {
+    for(size_t threads : bench.options().threads) {
+        run_contention(bench, threads);
+    }
+
+    run_handoff(bench);
+}
@@ -0,0 +1,191 @@
+/******************************************************************************
+*  Name: shm.cpp
+*
+*  Purpose: Shared memory create, attach, first touch, and destroy cost
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <unistd.h>
+
+#include "bench/Bench.h"
+#include "lib/shm/Shm.h"
+#include "lib/shm/PosixShm.h"
+
+using namespace BenchDecls;
+
+// every iteration goes through the whole life of a block, the first touch
+// faults in every page, which is where most of the cost of a large block is
+// unless it's prefaulted when attaching
+
+/// ID the System V key is generated with
+#define SHM_ID 0xB2
+
+/// name of the POSIX block
+#define POSIX_NAME "/gsw_bench"
+
+/// most iterations of each configuration, small blocks would otherwise take
+/// millions of samples
+#define MAX_ITERATIONS 10000
+
+/// @brief block sizes
+static const size_t SHM_SIZES[] = {4096, 1 << 20, 64 << 20};
+
+/// @brief latencies of each step
+typedef struct {
+    Samples create;
+    Samples attach;
+    Samples touch;
+    Samples detach;
+    Samples reattach;
+    Samples destroy;
+    uint64_t failed;
+} steps_t;
+
+/// @brief time one step
+/// @param samples  added to
+/// @param ret      set to FAILURE if the step fails
+#define TIME_STEP(samples, step, ret)                               \
+    do {                                                            \
+        time_util::timestamp_t before = time_util::mono_ns();       \
+        if(SUCCESS != (step)) {                                     \
+            ret = FAILURE;                                          \
+        }                                                           \
+        (samples).add(time_util::mono_ns() - before);               \
+    } while(0)
+
+/// @brief go through the life of a block once
+/// @param shm      the block
+/// @param steps    filled with latencies
+/// @return
+template <typename SHM>
+static RetType lifecycle(SHM& shm, steps_t* steps) {
+    RetType ret = SUCCESS;
+
+    TIME_STEP(steps->create, shm.create(), ret);
+    if(SUCCESS != ret) {
+        return ret;
+    }
+
+    TIME_STEP(steps->attach, shm.attach(), ret);
+    if(SUCCESS != ret) {
+        return ret;
+    }
+
+    // write one byte in every page
+    size_t page = sysconf(_SC_PAGESIZE);
+    time_util::timestamp_t before = time_util::mono_ns();
+    for(size_t i = 0; i < shm.size; i += page) {
+        ((volatile uint8_t*)shm.data)[i] = 1;
+    }
+    steps->touch.add(time_util::mono_ns() - before);
+
+    TIME_STEP(steps->detach, shm.detach(), ret);
+
+    // attaching to a block that's already populated, like every process but
+    // the creator does
+    TIME_STEP(steps->reattach, shm.attach(), ret);
+
+    // System V blocks have to be attached to be destroyed, destroying detaches
+    TIME_STEP(steps->destroy, shm.destroy(), ret);
+
+    return ret;
+}
+
+/// @brief record the results of a configuration
+/// @param bench    the harness
+/// @param name     the benchmark name
+/// @param size     the block size
+/// @param prefault whether the block was prefaulted, -1 if not supported
+/// @param steps    the latencies
+/// @param elapsed  how long the benchmark ran for
+static void record(Bench& bench, const char* name, size_t size, int prefault, steps_t* steps,
+                   time_util::timestamp_t elapsed) {
+    result_t& res = bench.result(name);
+    res.params.push_back({"size", size});
+    if(prefault >= 0) {
+        res.params.push_back({"prefault", prefault});
+    }
+
+    double secs = (double)elapsed / time_util::NS_PER_SEC;
+    res.metrics.push_back({"lifecycles_per_sec", secs > 0 ? steps->create.count() / secs : 0});
+    res.metrics.push_back({"failed", steps->failed});
+
+    res.latencies.push_back({"create", steps->create.summarize()});
+    res.latencies.push_back({"attach", steps->attach.summarize()});
+    res.latencies.push_back({"touch", steps->touch.summarize()});
+    res.latencies.push_back({"detach", steps->detach.summarize()});
+    res.latencies.push_back({"reattach", steps->reattach.summarize()});
+    res.latencies.push_back({"destroy", steps->destroy.summarize()});
+}
+
+/// @brief benchmark System V blocks
+/// @param bench    the harness
+/// @param size     the block size
+static void run_sysv(Bench& bench, size_t size) {
+    steps_t steps;
+    steps.failed = 0;
+
+    Shm shm(getenv("GSW_HOME"), SHM_ID, size);
+
+    // remove a block left by a previous run
+    if(SUCCESS == shm.attach()) {
+        shm.destroy();
+    }
+
+    time_util::timestamp_t start = time_util::mono_ns();
+    time_util::timestamp_t deadline = start + bench.options().duration;
+    time_util::timestamp_t now = start;
+
+    for(int i = 0; i < MAX_ITERATIONS && now < deadline; i++) {
+        if(SUCCESS != lifecycle(shm, &steps)) {
+            steps.failed++;
+            break;
+        }
+
+        now = time_util::mono_ns();
+    }
+
+    record(bench, "shm.sysv", size, -1, &steps, now - start);
+}
+
+/// @brief benchmark POSIX blocks
+/// @param bench    the harness
+/// @param size     the block size
+/// @param prefault whether to prefault when attaching
+static void run_posix(Bench& bench, size_t size, bool prefault) {
+    steps_t steps;
+    steps.failed = 0;
+
+    uint32_t flags = PosixShmDecls::REPLACE;
+    if(prefault) {
+        flags |= PosixShmDecls::PREFAULT;
+    }
+
+    PosixShm shm(POSIX_NAME, size, flags);
+
+    time_util::timestamp_t start = time_util::mono_ns();
+    time_util::timestamp_t deadline = start + bench.options().duration;
+    time_util::timestamp_t now = start;
+
+    for(int i = 0; i < MAX_ITERATIONS && now < deadline; i++) {
+        if(SUCCESS != lifecycle(shm, &steps)) {
+            steps.failed++;
+            break;
+        }
+
+        now = time_util::mono_ns();
+    }
+
+    record(bench, "shm.posix", size, prefault, &steps, now - start);
+}
+
+/// @brief shared memory create, attach, first touch, and destroy cost
+void bench_shm(Bench& bench) {
+    for(size_t size : SHM_SIZES) {
+        run_sysv(bench, size);
+        run_posix(bench, size, false);
+        run_posix(bench, size, true);
+    }
+}
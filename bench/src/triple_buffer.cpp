@@ -0,0 +1,329 @@
+/******************************************************************************
+*  Name: triple_buffer.cpp
+*
+*  Purpose: Triple buffer throughput and staleness across threads and
+*           across processes
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "bench/Bench.h"
+#include "lib/triple_buffer/LocalTripleBuffer.h"
+#include "lib/triple_buffer/ShmTripleBuffer.h"
+#include "lib/shm/Shm.h"
+#include "lib/sync/Futex.h"
+
+using namespace BenchDecls;
+
+// the writer fills 'size' bytes of the payload and stamps it with a sequence
+// number and the monotonic time right before flushing it, the reader copies
+// 'size' bytes out of every new buffer it gets
+//
+// staleness is how old the newest write is when the reader gets it, and
+// writes the reader never sees are counted as skipped
+
+/// the largest payload
+#define MAX_PAYLOAD (1 << 20)
+
+/// ID the shared memory key is generated with
+#define SHM_ID 0xB1
+
+/// time between writes in the wake up benchmark, the reader is always asleep
+/// when a write is made
+#define WAKEUP_PERIOD_NS 100000
+
+/// how long the reader blocks for before checking if the benchmark is over
+#define READ_TIMEOUT_MS 100
+
+/// @brief a buffer in the triple buffer
+typedef struct {
+    uint64_t seq;                           // write number, starting at 1
+    time_util::timestamp_t published;       // monotonic time it was flushed
+    uint8_t data[MAX_PAYLOAD];
+} payload_t;
+
+/// @brief shared between the writer and reader
+typedef struct {
+    uint32_t stop;                          // set by the reader when done
+    uint32_t unused;
+    uint64_t writes;                        // set by the writer when done
+    time_util::timestamp_t elapsed;         // how long the writer ran for
+} control_t;
+
+/// offset of the triple buffer in the shared memory block, after the control
+/// block on its own cache line
+static const size_t BUFF_OFFSET = 64;
+static_assert(sizeof(control_t) <= BUFF_OFFSET, "control block too large");
+
+/// @brief how a benchmark is run
+typedef enum {
+    THREADS,        // writer thread, spinning reader
+    PROCESSES,      // writer process, spinning reader
+    WAKEUP          // paced writer process, blocking reader
+} run_mode_t;
+
+/// @brief the names of each mode
+static const char* MODE_NAMES[] = {
+    "triple_buffer.threads",
+    "triple_buffer.processes",
+    "triple_buffer.wakeup"
+};
+
+/// @brief sleep until a monotonic time
+/// @param mono     the time to wake up at
+static void sleep_until(time_util::timestamp_t mono) {
+    struct timespec ts;
+    ts.tv_sec = mono / time_util::NS_PER_SEC;
+    ts.tv_nsec = mono % time_util::NS_PER_SEC;
+
+    while(EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) {}
+}
+
+/// @brief write until the reader says to stop
+/// @param buff     the triple buffer
+/// @param ctl      the control block
+/// @param size     bytes to write each time
+/// @param period   time between writes, 0 to write as fast as possible
+template <typename BUFF>
+static void write_loop(BUFF* buff, control_t* ctl, size_t size, time_util::timestamp_t period) {
+    time_util::timestamp_t start = time_util::mono_ns();
+    time_util::timestamp_t next = start;
+    uint64_t seq = 0;
+
+    payload_t* w = buff->write();
+    while(!__atomic_load_n(&ctl->stop, __ATOMIC_RELAXED)) {
+        if(period) {
+            next += period;
+            sleep_until(next);
+        }
+
+        memset(w->data, (int)seq, size);
+        w->seq = ++seq;
+        w->published = time_util::mono_ns();
+
+        w = buff->write();
+    }
+
+    ctl->writes = seq;
+    __atomic_store_n(&ctl->elapsed, time_util::mono_ns() - start, __ATOMIC_RELEASE);
+}
+
+/// @brief block reading a shared memory triple buffer
+static payload_t* read_blocking(ShmTripleBuffer<payload_t>* buff, int timeout_ms) {
+    return buff->read_blocking(timeout_ms);
+}
+
+/// @brief local triple buffers can't block
+static payload_t* read_blocking(LocalTripleBuffer<payload_t>* buff, int) {
+    return buff->read();
+}
+
+/// @brief reader results
+typedef struct {
+    uint64_t reads;         // new buffers read
+    uint64_t skipped;       // writes never read
+    uint64_t empty;         // reads with no new write
+    uint64_t timeouts;      // blocking reads that timed out
+    time_util::timestamp_t elapsed;
+} read_stats_t;
+
+/// @brief read for the duration of a benchmark
+/// @param buff         the triple buffer
+/// @param size         bytes to copy out each time
+/// @param duration     how long to read for
+/// @param blocking     whether to sleep waiting for writes
+/// @param staleness    filled with staleness samples
+/// @param stats        filled with counts
+template <typename BUFF>
+static void read_loop(BUFF* buff, size_t size, time_util::timestamp_t duration, bool blocking,
+                      Samples* staleness, read_stats_t* stats) {
+    std::vector<uint8_t> copy(size);
+    memset(stats, 0, sizeof(*stats));
+
+    uint64_t last = 0;
+    time_util::timestamp_t start = time_util::mono_ns();
+    time_util::timestamp_t deadline = start + duration;
+    time_util::timestamp_t now = start;
+
+    while(now < deadline) {
+        payload_t* r;
+        if(blocking) {
+            r = read_blocking(buff, READ_TIMEOUT_MS);
+        } else {
+            r = buff->read();
+        }
+
+        now = time_util::mono_ns();
+
+        if(NULL == r) {
+            if(blocking) {
+                stats->timeouts++;
+            } else {
+                stats->empty++;
+                futex::cpu_relax();
+            }
+
+            continue;
+        }
+
+        if(0 == r->seq) {
+            // the buffer the writer's first call to 'write' flushed, it
+            // never filled it in
+            continue;
+        }
+
+        time_util::timestamp_t published = r->published;
+        staleness->add(now > published ? now - published : 0);
+
+        if(r->seq > last + 1) {
+            stats->skipped += r->seq - last - 1;
+        }
+        last = r->seq;
+
+        memcpy(copy.data(), r->data, size);
+        stats->reads++;
+    }
+
+    stats->elapsed = now - start;
+}
+
+/// @brief create a System V shared memory block, replacing a leftover one
+/// @param shm  the block
+/// @return
+static RetType create_shm(Shm& shm) {
+    if(SUCCESS == shm.create()) {
+        return SUCCESS;
+    }
+
+    // a previous run died without removing it
+    if(SUCCESS != shm.attach() || SUCCESS != shm.destroy()) {
+        return FAILURE;
+    }
+
+    return shm.create();
+}
+
+/// @brief run one configuration
+/// @param bench    the harness
+/// @param mode     how to run
+/// @param size     bytes written and read each time
+static void run(Bench& bench, run_mode_t mode, size_t size) {
+    time_util::timestamp_t duration = bench.options().duration;
+
+    Samples staleness;
+    read_stats_t stats;
+
+    // writer results
+    control_t done;
+    memset(&done, 0, sizeof(done));
+
+    int writer_cpu = -1;
+    int reader_cpu = -1;
+
+    if(THREADS == mode) {
+        // zeroed like a new shared memory block, the constructor doesn't
+        // touch the buffers, so the first flushed buffer has sequence number 0
+        void* mem = calloc(1, sizeof(LocalTripleBuffer<payload_t>));
+        if(NULL == mem) {
+            printf("Failed to allocate triple buffer\n");
+            return;
+        }
+        LocalTripleBuffer<payload_t>* buff = new (mem) LocalTripleBuffer<payload_t>();
+        std::thread writer([&]() {
+            writer_cpu = bench.pin(0);
+            write_loop(buff, &done, size, 0);
+        });
+
+        reader_cpu = bench.pin(1);
+        read_loop(buff, size, duration, false, &staleness, &stats);
+
+        __atomic_store_n(&done.stop, 1, __ATOMIC_RELAXED);
+        writer.join();
+        bench.unpin();
+
+        buff->~LocalTripleBuffer<payload_t>();
+        free(mem);
+    } else {
+        Shm shm(getenv("GSW_HOME"), SHM_ID, BUFF_OFFSET + ShmTripleBuffer<payload_t>::SHM_SIZE);
+        if(SUCCESS != create_shm(shm) || SUCCESS != shm.attach()) {
+            printf("Failed to create shared memory for %s\n", MODE_NAMES[mode]);
+            return;
+        }
+
+        control_t* ctl = (control_t*)shm.data;
+        memset(ctl, 0, sizeof(*ctl));
+
+        ShmTripleBuffer<payload_t> reader(shm.data + BUFF_OFFSET, true);
+        time_util::timestamp_t period = (WAKEUP == mode) ? WAKEUP_PERIOD_NS : 0;
+
+        // attached blocks are inherited
+        pid_t pid = fork();
+        if(-1 == pid) {
+            perror("fork failed");
+            shm.destroy();
+            return;
+        }
+
+        if(0 == pid) {
+            bench.pin(0);
+
+            ShmTripleBuffer<payload_t> writer(shm.data + BUFF_OFFSET, false);
+            write_loop(&writer, ctl, size, period);
+
+            _exit(0);
+        }
+
+        writer_cpu = bench.options().cpus.empty() ? -1 : bench.options().cpus[0];
+        reader_cpu = bench.pin(1);
+        read_loop(&reader, size, duration, WAKEUP == mode, &staleness, &stats);
+
+        __atomic_store_n(&ctl->stop, 1, __ATOMIC_RELAXED);
+        waitpid(pid, NULL, 0);
+        bench.unpin();
+
+        // copy out the writer results before the block goes away
+        done = *ctl;
+
+        shm.destroy();
+    }
+
+    double writer_secs = (double)done.elapsed / time_util::NS_PER_SEC;
+    double reader_secs = (double)stats.elapsed / time_util::NS_PER_SEC;
+
+    result_t& res = bench.result(MODE_NAMES[mode]);
+    res.params.push_back({"size", size});
+    res.params.push_back({"writer_cpu", writer_cpu});
+    res.params.push_back({"reader_cpu", reader_cpu});
+
+    res.metrics.push_back({"writes_per_sec", writer_secs > 0 ? done.writes / writer_secs : 0});
+    res.metrics.push_back({"reads_per_sec", reader_secs > 0 ? stats.reads / reader_secs : 0});
+    res.metrics.push_back({"write_bytes_per_sec", writer_secs > 0 ? done.writes * size / writer_secs : 0});
+    res.metrics.push_back({"skipped_ratio", done.writes ? (double)stats.skipped / done.writes : 0});
+
+    if(WAKEUP == mode) {
+        res.metrics.push_back({"timeouts", stats.timeouts});
+    } else {
+        res.metrics.push_back({"empty_reads", stats.empty});
+    }
+
+    res.latencies.push_back({"staleness", staleness.summarize()});
+}
+
+/// @brief triple buffer throughput and staleness across threads and processes
+void bench_triple_buffer(Bench& bench) {
+    for(size_t size : bench.options().sizes) {
+        run(bench, THREADS, size);
+        run(bench, PROCESSES, size);
+        run(bench, WAKEUP, size);
+    }
+}
@@ -0,0 +1,553 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: The broker daemon, fans out the measurements extracted by a decom
+*           process to subscribed applications
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_broker -p packet [-c config]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <set>
+
+#include "lib/shm/PosixShm.h"
+#include "lib/sync/Mutex.h"
+#include "lib/telemetry/TelemetryConfig.h"
+#include "lib/telemetry/TelemetryShm.h"
+#include "lib/telemetry/Subscriber.h"
+#include "lib/triple_buffer/ShmTripleBuffer.h"
+#include "lib/stats/Stats.h"
+#include "lib/stats/Trace.h"
+
+using namespace TelemetryShmDecls;
+using namespace SubscriberDecls;
+
+/// how long the fan-out loop sleeps when nothing is due, in milliseconds
+#define IDLE_TIMEOUT_MS 100
+
+/// how often the control loop checks for exited applications, in milliseconds
+#define REAP_TIMEOUT_MS 1000
+
+/// the largest subscription ID, limits the subscriptions of a single application
+#define MAX_ID 255
+
+
+/// @brief a subscription of one application to one measurement
+typedef struct {
+    pid_t pid;              // application process ID
+    uint32_t id;            // subscription ID, unique per application
+    size_t meas;            // index of the measurement in the packet
+    int32_t priority;       // higher priority subscriptions are updated first
+    double interval;        // minimum milliseconds between updates, 0 for no limit
+    double next_due;        // earliest time of the next update (monotonic milliseconds)
+    uint64_t last_seq;      // sequence number of the last value delivered
+    uint64_t delivered;     // number of values delivered
+    PosixShm* shm;
+    ShmTripleBuffer<measurement_t>* buff;
+    measurement_t* curr;    // buffer the next value is written into
+} subscription_t;
+
+volatile sig_atomic_t should_exit = 0;
+
+// subscriptions, sorted by descending priority
+// the lock is only held briefly by the control thread to add or remove entries
+std::vector<subscription_t*> subs;
+Mutex subs_lock;
+
+// time to publish to a subscriber, only recorded by the fan out thread
+Histogram* publish_hist = NULL;
+
+// broker configuration
+const TelemetryConfigDecls::packet_info_t* packet;
+
+
+/// @brief signal handler that sets 'should_exit'
+void sig_exit(int) {
+    should_exit = 1;
+}
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_broker -p packet [-c config]\n");
+    printf("    -p packet   name of the packet in the configuration to broker\n");
+    printf("    -c config   telemetry configuration file (default $GSW_HOME/%s)\n",
+           TelemetryConfigDecls::DEFAULT_FILE);
+    exit(FAILURE);
+}
+
+/// @brief get the monotonic time
+/// @return the time in milliseconds
+double mono_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((double)ts.tv_sec * 1000) + ((double)ts.tv_nsec / 1000000);
+}
+
+/// @brief get the name of a subscription's shared memory block
+/// @param pid  the application process ID
+/// @param id   the subscription ID
+/// @return the name of the block
+std::string shm_name(pid_t pid, uint32_t id) {
+    return SHM_PREFIX + packet->name + "_" + std::to_string(pid) + "_" + std::to_string(id);
+}
+
+/// @brief free a subscription's shared memory and the subscription itself
+/// @param sub  the subscription, must already be removed from 'subs'
+void free_subscription(subscription_t* sub) {
+    delete sub->buff;
+    sub->shm->destroy();
+    delete sub->shm;
+
+    printf("Removed subscription %u of process %d, delivered %lu updates\n",
+           sub->id, sub->pid, sub->delivered);
+
+    delete sub;
+}
+
+/// @brief handle a subscribe request
+/// @param req  the request
+/// @param resp filled with the response
+void subscribe(request_t* req, response_t* resp) {
+    req->measurement[MAX_NAME - 1] = '\0';
+
+    size_t meas;
+    for(meas = 0; meas < packet->measurements.size(); meas++) {
+        if(packet->measurements[meas].name == req->measurement) {
+            break;
+        }
+    }
+
+    if(meas == packet->measurements.size()) {
+        printf("Process %d subscribed to unknown measurement '%s'\n", req->pid, req->measurement);
+        return;
+    }
+
+    // find an unused ID for this application
+    // the control thread is the only one that modifies 'subs', no need to lock
+    std::set<uint32_t> used;
+    for(subscription_t* s : subs) {
+        if(s->pid == req->pid) {
+            used.insert(s->id);
+        }
+    }
+
+    uint32_t id;
+    for(id = 1; id <= MAX_ID; id++) {
+        if(used.find(id) == used.end()) {
+            break;
+        }
+    }
+
+    if(id > MAX_ID) {
+        printf("Process %d has too many subscriptions\n", req->pid);
+        return;
+    }
+
+    subscription_t* sub = new subscription_t;
+    sub->pid = req->pid;
+    sub->id = id;
+    sub->meas = meas;
+    sub->priority = req->priority;
+    sub->interval = (req->rate > 0) ? (1000 / req->rate) : 0;
+    sub->next_due = 0;
+    sub->last_seq = 0;
+    sub->delivered = 0;
+
+    std::string name = shm_name(req->pid, id);
+    if(name.length() >= MAX_SHM_NAME) {
+        printf("Shared memory name too long\n");
+        delete sub;
+        return;
+    }
+
+    // a block with the same name can only be left over from a broker that
+    // didn't exit cleanly, so replace it
+    sub->shm = new PosixShm(name.c_str(), ShmTripleBuffer<measurement_t>::SHM_SIZE,
+                            SubscriberDecls::SHM_FLAGS | PosixShmDecls::REPLACE);
+    if(SUCCESS != sub->shm->create() || SUCCESS != sub->shm->attach()) {
+        printf("Failed to create shared memory for process %d\n", req->pid);
+        delete sub->shm;
+        delete sub;
+        return;
+    }
+
+    sub->buff = new ShmTripleBuffer<measurement_t>(sub->shm->data, true);
+    sub->curr = sub->buff->write();
+
+    // every write after this is from the fan out thread
+    sub->buff->instrument(publish_hist, NULL);
+
+    // insert after every subscription with the same or higher priority
+    subs_lock.lock();
+    std::vector<subscription_t*>::iterator it = subs.begin();
+    while(it != subs.end() && (*it)->priority >= sub->priority) {
+        it++;
+    }
+    subs.insert(it, sub);
+    subs_lock.unlock();
+
+    printf("Process %d subscribed to '%s' (rate %.1f Hz, priority %d) with ID %u\n",
+           req->pid, req->measurement, req->rate, req->priority, id);
+
+    resp->status = SUCCESS;
+    resp->id = id;
+    strcpy(resp->shm_name, name.c_str());
+    resp->port = packet->port;
+}
+
+/// @brief handle an unsubscribe request
+/// @param req  the request
+/// @param resp filled with the response
+void unsubscribe(request_t* req, response_t* resp) {
+    subscription_t* sub = NULL;
+
+    subs_lock.lock();
+    for(std::vector<subscription_t*>::iterator it = subs.begin(); it != subs.end(); it++) {
+        if((*it)->pid == req->pid && (*it)->id == req->id) {
+            sub = *it;
+            subs.erase(it);
+            break;
+        }
+    }
+    subs_lock.unlock();
+
+    if(NULL == sub) {
+        return;
+    }
+
+    free_subscription(sub);
+    resp->status = SUCCESS;
+}
+
+/// @brief remove the subscriptions of every application that has exited
+void reap() {
+    std::vector<subscription_t*> dead;
+
+    subs_lock.lock();
+    std::vector<subscription_t*>::iterator it = subs.begin();
+    while(it != subs.end()) {
+        if(-1 == kill((*it)->pid, 0) && ESRCH == errno) {
+            dead.push_back(*it);
+            it = subs.erase(it);
+        } else {
+            it++;
+        }
+    }
+    subs_lock.unlock();
+
+    for(subscription_t* sub : dead) {
+        free_subscription(sub);
+    }
+}
+
+/// @brief handle subscription requests from applications
+/// @param arg  the bound control socket descriptor
+void* control(void* arg) {
+    int sd = *(int*)arg;
+
+    double last_reap = mono_ms();
+    while(!should_exit) {
+        request_t req;
+        struct sockaddr_un from;
+        socklen_t from_len = sizeof(from);
+
+        ssize_t len = recvfrom(sd, &req, sizeof(req), 0, (struct sockaddr*)&from, &from_len);
+
+        if(mono_ms() - last_reap >= REAP_TIMEOUT_MS) {
+            reap();
+            last_reap = mono_ms();
+        }
+
+        if(len != sizeof(req)) {
+            // timed out, interrupted, or a bad request
+            continue;
+        }
+
+        response_t resp;
+        memset(&resp, 0, sizeof(resp));
+        resp.status = FAILURE;
+
+        if(SUBSCRIBE == req.type) {
+            subscribe(&req, &resp);
+        } else if(UNSUBSCRIBE == req.type) {
+            unsubscribe(&req, &resp);
+        }
+
+        if(-1 == sendto(sd, &resp, sizeof(resp), 0, (struct sockaddr*)&from, from_len)) {
+            perror("Failed to respond to application");
+        }
+    }
+
+    return NULL;
+}
+
+/// @brief wait for decom to create the telemetry shared memory and attach to it
+/// @param tshm     the telemetry shared memory
+/// @return false if told to exit while waiting
+bool wait_for_decom(TelemetryShm& tshm) {
+    printf("Waiting for decom of packet '%s'\n", packet->name.c_str());
+
+    while(SUCCESS != tshm.attach()) {
+        if(should_exit) {
+            return false;
+        }
+
+        sleep(1);
+    }
+
+    return true;
+}
+
+/// @brief wait for measurement updates from decom and deliver them to subscribers
+/// @param tshm     the attached telemetry shared memory
+void fan_out(TelemetryShm& tshm) {
+    size_t num_meas = tshm.count;
+    std::vector<measurement_t> latest(num_meas);
+    memset(latest.data(), 0, num_meas * sizeof(measurement_t));
+
+    Event* update = tshm.update();
+
+#ifdef GSW_TRACE
+    // newest packet traced through each stage, every measurement of a packet
+    // is read and published but the packet is only traced once
+    uint64_t read_seq = 0;
+    uint64_t publish_seq = 0;
+#endif
+
+    // time reading measurements that were updated
+    Histogram* read_hist = Stats::shared()->histogram("gsw_broker.read");
+    for(size_t i = 0; i < num_meas; i++) {
+        tshm.buffer(i)->instrument(NULL, read_hist);
+    }
+
+    while(!should_exit) {
+        // cache the sequence number first so no update is missed while we work
+        uint32_t seq = update->sequence();
+
+        for(size_t i = 0; i < num_meas; i++) {
+            measurement_t* val = tshm.buffer(i)->read();
+            if(NULL != val) {
+                latest[i] = *val;
+
+#ifdef GSW_TRACE
+                if(val->seq > read_seq) {
+                    read_seq = val->seq;
+                    TRACE_PACKET(TraceDecls::BROKER_READ, packet->port, read_seq);
+                }
+#endif
+            }
+        }
+
+        // subscriptions are in priority order, so a high priority application
+        // always gets its update before lower priority ones
+        // each update is a fixed size copy into a triple buffer that never
+        // blocks, so a slow application can't hold up anyone else
+        double now = mono_ms();
+        double next_due = now + IDLE_TIMEOUT_MS;
+
+        subs_lock.lock();
+        for(subscription_t* sub : subs) {
+            measurement_t* val = &latest[sub->meas];
+            if(val->seq == sub->last_seq || 0 == val->seq) {
+                // nothing new, or the empty buffer a new decom starts with
+                continue;
+            }
+
+            if(now < sub->next_due) {
+                // rate limited, deliver the latest value once the interval is up
+                if(sub->next_due < next_due) {
+                    next_due = sub->next_due;
+                }
+                continue;
+            }
+
+            *sub->curr = *val;
+            sub->curr = sub->buff->write();
+
+#ifdef GSW_TRACE
+            if(val->seq > publish_seq) {
+                publish_seq = val->seq;
+                TRACE_PACKET(TraceDecls::BROKER_PUBLISH, packet->port, publish_seq);
+            }
+#endif
+
+            sub->last_seq = val->seq;
+            sub->next_due = now + sub->interval;
+            sub->delivered++;
+        }
+        subs_lock.unlock();
+
+        int timeout = (int)(next_due - now) + 1;
+        if(SUCCESS == update->wait(seq, timeout) || !tshm.replaced()) {
+            continue;
+        }
+
+        // a restarted decom replaces the block rather than reusing it, so
+        // nothing will be written to this one again
+        printf("Decom of packet '%s' restarted or exited\n", packet->name.c_str());
+
+        tshm.detach();
+        if(!wait_for_decom(tshm)) {
+            return;
+        }
+
+        update = tshm.update();
+        for(size_t i = 0; i < num_meas; i++) {
+            tshm.buffer(i)->instrument(NULL, read_hist);
+        }
+
+#ifdef GSW_TRACE
+        // the new decom numbers packets from the start again
+        read_seq = 0;
+        publish_seq = 0;
+#endif
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* packet_name = NULL;
+    const char* config_file = NULL;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "p:c:h"))) {
+        switch(opt) {
+            case 'p':
+                packet_name = optarg;
+                break;
+            case 'c':
+                config_file = optarg;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if(NULL == packet_name) {
+        usage();
+    }
+
+    char* gsw_home = getenv("GSW_HOME");
+    if(NULL == gsw_home) {
+        printf("GSW_HOME environment variable not set, did you run '. setenv'?\n");
+        exit(FAILURE);
+    }
+
+    std::string default_config = gsw_home;
+    default_config += "/";
+    default_config += TelemetryConfigDecls::DEFAULT_FILE;
+    if(NULL == config_file) {
+        config_file = default_config.c_str();
+    }
+
+    TelemetryConfig config;
+    if(SUCCESS != config.parse(config_file)) {
+        printf("Failed to parse telemetry configuration '%s'\n", config_file);
+        exit(FAILURE);
+    }
+
+    int packet_index = config.find(packet_name);
+    if(-1 == packet_index) {
+        printf("No packet named '%s' in telemetry configuration\n", packet_name);
+        exit(FAILURE);
+    }
+    packet = &config.packets[packet_index];
+
+    // setup signal handlers without SA_RESTART so blocking calls return
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sig_exit;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGQUIT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // wait for decom to create the telemetry shared memory
+    TelemetryShm tshm(packet_name, packet->measurements.size());
+    if(!wait_for_decom(tshm)) {
+        exit(SUCCESS);
+    }
+
+    // open the control socket applications subscribe through
+    int sd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if(-1 == sd) {
+        perror("Failed to open broker control socket");
+        exit(FAILURE);
+    }
+
+    std::string addr_file = gsw_home;
+    addr_file += "/";
+    addr_file += ADDRESS_PREFIX;
+    addr_file += packet_name;
+
+    struct sockaddr_un addr;
+    addr.sun_family = AF_UNIX;
+    if(addr_file.length() >= sizeof(addr.sun_path)) {
+        printf("Filename '%s' used for UNIX address is too long\n", addr_file.c_str());
+        exit(FAILURE);
+    }
+    strcpy(addr.sun_path, addr_file.c_str());
+
+    // remove a socket left behind by a previous broker
+    unlink(addr_file.c_str());
+
+    if(-1 == bind(sd, (struct sockaddr*)&addr, sizeof(addr))) {
+        perror("Failed to bind broker control socket");
+        exit(FAILURE);
+    }
+
+    // time out periodically to check for exited applications
+    struct timeval tv;
+    tv.tv_sec = REAP_TIMEOUT_MS / 1000;
+    tv.tv_usec = (REAP_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // registered from this thread since it runs the fan out
+    publish_hist = Stats::shared()->histogram("gsw_broker.publish");
+
+    pthread_t control_thread;
+    if(0 != pthread_create(&control_thread, NULL, control, &sd)) {
+        printf("Failed to start control thread\n");
+        exit(FAILURE);
+    }
+
+    printf("Broker started for packet '%s' with %lu measurements\n",
+           packet_name, packet->measurements.size());
+
+    fan_out(tshm);
+
+    pthread_join(control_thread, NULL);
+    close(sd);
+    unlink(addr_file.c_str());
+
+    // clean up all remaining subscriptions
+    while(subs.size()) {
+        subscription_t* sub = subs.back();
+        subs.pop_back();
+        free_subscription(sub);
+    }
+
+    // not attached if told to exit while waiting for a restarted decom
+    if(NULL != tshm.update()) {
+        tshm.detach();
+    }
+
+    printf("Broker exiting\n");
+    exit(SUCCESS);
+}
@@ -0,0 +1,411 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: The decommutation daemon, receives packets from a data source,
+*           logs them, and extracts measurements into shared memory
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_decom -p packet [-c config] [-b batch] [-i]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+#include "lib/time/time.h"
+#include "lib/logging/PacketLogger.h"
+#include "lib/logging/MessageLogger.h"
+#include "lib/logging/PacketPool.h"
+#include "lib/telemetry/TelemetryConfig.h"
+#include "lib/telemetry/TelemetryShm.h"
+#include "lib/telemetry/Extractor.h"
+#include "lib/stats/Stats.h"
+#include "lib/stats/Trace.h"
+
+using namespace TelemetryShmDecls;
+
+/// largest UDP payload we can receive
+#define MAX_PACKET_SIZE 65507
+
+static_assert(MAX_PACKET_SIZE <= PacketPoolDecls::MAX_PACKET, "packet pool slots too small");
+
+/// socket receive buffer size to request, large enough to absorb bursts
+#define RECV_BUFFER_SIZE (8 * 1024 * 1024)
+
+/// packets held while the packet logging socket is full, in bytes
+#define PACKET_SPILL_SIZE (16 * 1024 * 1024)
+
+/// how often to retry sending spilled messages when no packets arrive
+#define DRAIN_INTERVAL_MS 10
+
+/// how long to keep sending spilled messages when exiting before they're dropped
+#define EXIT_DRAIN_MS 1000
+
+/// extraction kernels generated at build time by gsw_schemac (src/kernels.gen.cpp)
+extern const ExtractorDecls::kernel_entry_t generated_kernels[];
+
+
+volatile sig_atomic_t should_exit = 0;
+
+/// @brief signal handler that sets 'should_exit'
+///        installed without SA_RESTART so a blocked 'recvmmsg' returns EINTR
+void sig_exit(int) {
+    should_exit = 1;
+}
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_decom -p packet [-c config] [-b batch] [-i]\n");
+    printf("    -p packet   name of the packet in the configuration to decom\n");
+    printf("    -c config   telemetry configuration file (default $GSW_HOME/%s)\n",
+           TelemetryConfigDecls::DEFAULT_FILE);
+    printf("    -b batch    max packets received per system call (default %lu)\n",
+           PacketLoggerDecls::MAX_BATCH);
+    printf("    -i          interpret the configuration instead of using generated kernels\n");
+    exit(FAILURE);
+}
+
+/// @brief get the kernel receive timestamp of a message
+/// @param hdr  the received message header
+/// @return the timestamp in nanoseconds since the epoch
+time_util::timestamp_t recv_timestamp(struct msghdr* hdr) {
+    for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg != NULL; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if(SOL_SOCKET == cmsg->cmsg_level && SCM_TIMESTAMPNS == cmsg->cmsg_type) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+
+            return ((time_util::timestamp_t)ts.tv_sec * time_util::NS_PER_SEC) + ts.tv_nsec;
+        }
+    }
+
+    // kernel didn't give us a timestamp, take our own
+    return time_util::now_ns();
+}
+
+/// @brief point a receive buffer at a free packet pool slot
+/// @param pool     the packet pool
+/// @param i        index of the buffer in the batch
+/// @param slot     filled with the slot index, or -1 if no slot was free
+/// @param vec      the receive buffer
+/// @param arena    buffers to fall back to if no slot is free
+void take_slot(PacketPool& pool, size_t i, int32_t* slot, struct iovec* vec, uint8_t* arena) {
+    *slot = pool.alloc();
+
+    if(-1 == *slot) {
+        vec->iov_base = arena + (i * MAX_PACKET_SIZE);
+    } else {
+        vec->iov_base = pool.slot(*slot) + PacketPoolDecls::DATA_OFFSET;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* packet_name = NULL;
+    const char* config_file = NULL;
+    size_t batch = PacketLoggerDecls::MAX_BATCH;
+    bool interpret = false;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "p:c:b:ih"))) {
+        switch(opt) {
+            case 'p':
+                packet_name = optarg;
+                break;
+            case 'c':
+                config_file = optarg;
+                break;
+            case 'b':
+                batch = strtoul(optarg, NULL, 0);
+                if(batch < 1 || batch > PacketLoggerDecls::MAX_BATCH) {
+                    printf("batch size must be between 1 and %lu\n", PacketLoggerDecls::MAX_BATCH);
+                    exit(FAILURE);
+                }
+                break;
+            case 'i':
+                interpret = true;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if(NULL == packet_name) {
+        usage();
+    }
+
+    char* gsw_home = getenv("GSW_HOME");
+    if(NULL == gsw_home) {
+        printf("GSW_HOME environment variable not set, did you run '. setenv'?\n");
+        exit(FAILURE);
+    }
+
+    std::string default_config = gsw_home;
+    default_config += "/";
+    default_config += TelemetryConfigDecls::DEFAULT_FILE;
+    if(NULL == config_file) {
+        config_file = default_config.c_str();
+    }
+
+    TelemetryConfig config;
+    if(SUCCESS != config.parse(config_file)) {
+        printf("Failed to parse telemetry configuration '%s'\n", config_file);
+        exit(FAILURE);
+    }
+
+    int packet_index = config.find(packet_name);
+    if(-1 == packet_index) {
+        printf("No packet named '%s' in telemetry configuration\n", packet_name);
+        exit(FAILURE);
+    }
+
+    const TelemetryConfigDecls::packet_info_t& packet = config.packets[packet_index];
+    size_t num_meas = packet.measurements.size();
+
+    // open the UDP socket to receive packets on
+    int sd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(-1 == sd) {
+        perror("Failed to open UDP socket");
+        exit(FAILURE);
+    }
+
+    // ask the kernel to timestamp packets as they arrive
+    int enable = 1;
+    if(-1 == setsockopt(sd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable))) {
+        perror("Failed to enable receive timestamps, falling back to user space timestamps");
+    }
+
+    int rcvbuf = RECV_BUFFER_SIZE;
+    if(-1 == setsockopt(sd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf))) {
+        perror("Failed to set socket receive buffer size");
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(packet.port);
+
+    if(-1 == bind(sd, (struct sockaddr*)&addr, sizeof(addr))) {
+        perror("Failed to bind UDP socket, is another decom running for this packet?");
+        exit(FAILURE);
+    }
+
+    // create shared memory for the extracted measurements
+    // this replaces any block left by a decom that crashed, which is safe now
+    // that we hold the port
+    TelemetryShm shm(packet_name, num_meas);
+    if(SUCCESS != shm.create()) {
+        printf("Failed to create telemetry shared memory for '%s'\n", packet_name);
+        close(sd);
+        exit(FAILURE);
+    }
+    printf("Telemetry shared memory backed by %lu byte pages\n", shm.page_size());
+
+    // setup signal handlers without SA_RESTART
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sig_exit;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGQUIT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // receive straight into slots of a shared packet pool, so the logging
+    // daemon can write the packets out without them being copied
+    PacketPool pool(packet_name);
+    if(SUCCESS != pool.create()) {
+        printf("Failed to create packet pool, packets will be copied to the logger\n");
+    }
+
+    // preallocate everything for receiving a batch of packets
+    // each packet in the batch gets its own buffer and control message space
+    // so the packets can be logged straight out of the receive buffers
+    // the arena is only used when no pool slot is free
+    uint8_t* arena = (uint8_t*)malloc(batch * MAX_PACKET_SIZE);
+    if(NULL == arena) {
+        MessageLogger logger("main");
+        logger.log(MessageLoggerDecls::CRIT, "failed to allocate %lu byte receive arena",
+                   batch * MAX_PACKET_SIZE);
+        perror("Failed to allocate receive arena");
+        pool.destroy();
+        shm.destroy();
+        close(sd);
+        exit(FAILURE);
+    }
+    std::vector<struct mmsghdr> msgs(batch);
+    std::vector<struct iovec> vecs(batch);
+    std::vector<int32_t> slots(batch);
+    size_t ctrl_size = CMSG_SPACE(sizeof(struct timespec));
+    std::vector<uint8_t> ctrl(batch * ctrl_size);
+
+    for(size_t i = 0; i < batch; i++) {
+        take_slot(pool, i, &slots[i], &vecs[i], arena);
+        vecs[i].iov_len = MAX_PACKET_SIZE;
+
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &vecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // grab the first buffer to write to for each measurement
+    std::vector<measurement_t*> meas(num_meas);
+    for(size_t i = 0; i < num_meas; i++) {
+        meas[i] = shm.buffer(i)->write();
+    }
+
+    // time publishing measurements, every buffer is written from this thread
+    Histogram* publish_hist = Stats::shared()->histogram("gsw_decom.publish");
+    for(size_t i = 0; i < num_meas; i++) {
+        shm.buffer(i)->instrument(publish_hist, NULL);
+    }
+
+    Extractor extractor(packet);
+    if(!interpret) {
+        if(SUCCESS == extractor.use_kernel(generated_kernels)) {
+            printf("Using generated extraction kernel\n");
+        } else {
+            printf("No generated kernel matches the configuration of '%s', interpreting it\n", packet_name);
+            interpret = true;
+        }
+    }
+
+    if(interpret) {
+        printf("Decoding with %s instructions\n", BatchDecoderDecls::isa_str[extractor.decoder().isa()]);
+    }
+
+    // never stall receiving because the logging daemon fell behind, the
+    // spills absorb short stalls and anything beyond them is counted
+    bool nonblocking = (SUCCESS == Logger::set_nonblocking(PacketLoggerDecls::ADDRESS_FILE,
+                                                           PACKET_SPILL_SIZE));
+    for(int i = 0; i < MessageLoggerDecls::NUM_MESSAGE_T; i++) {
+        nonblocking &= (SUCCESS == Logger::set_nonblocking(MessageLoggerDecls::LANE_FILE[i]));
+    }
+
+    if(!nonblocking) {
+        printf("Failed to open logging sockets, logging may block\n");
+    }
+
+    PacketLogger plogger;
+    if(NULL != pool.slot(0)) {
+        plogger.use_pool(&pool);
+    }
+
+    uint64_t seq = 0;
+    uint64_t num_short = 0;
+    uint64_t num_trunc = 0;
+    uint64_t num_copied = 0;
+
+    printf("Decom started for packet '%s' on port %u with %lu measurements\n",
+           packet_name, packet.port, num_meas);
+
+    while(!should_exit) {
+        // the control message length is overwritten by the kernel on every receive
+        for(size_t i = 0; i < batch; i++) {
+            msgs[i].msg_hdr.msg_control = &ctrl[i * ctrl_size];
+            msgs[i].msg_hdr.msg_controllen = ctrl_size;
+        }
+
+        // spilled messages are only sent when something is logged, so keep
+        // sending them while no packets arrive
+        if(Logger::spilling()) {
+            struct pollfd pfd;
+            pfd.fd = sd;
+            pfd.events = POLLIN;
+
+            if(poll(&pfd, 1, DRAIN_INTERVAL_MS) <= 0) {
+                Logger::drain();
+                continue;
+            }
+        }
+
+        // block for the first packet, then take whatever else is queued
+        int n = recvmmsg(sd, msgs.data(), batch, MSG_WAITFORONE, NULL);
+        if(-1 == n) {
+            if(EINTR != errno) {
+                perror("recvmmsg failed");
+            }
+
+            continue;
+        }
+
+        for(int i = 0; i < n; i++) {
+            uint8_t* buff = (uint8_t*)vecs[i].iov_base;
+            size_t len = msgs[i].msg_len;
+            time_util::timestamp_t timestamp = recv_timestamp(&msgs[i].msg_hdr);
+
+            if(msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                num_trunc++;
+            }
+
+            seq++;
+            TRACE_PACKET_AT(TraceDecls::RECEIVE, packet.port, seq, time_util::real_to_mono(timestamp));
+
+            if(-1 != slots[i]) {
+                plogger.queue_slot(slots[i], len, packet.port, timestamp, seq);
+            } else {
+                plogger.queue_packet(buff, len, packet.port, timestamp, seq);
+                num_copied++;
+            }
+
+            if(SUCCESS != extractor.extract(buff, len, meas.data())) {
+                num_short++;
+                continue;
+            }
+
+            for(size_t j = 0; j < num_meas; j++) {
+                meas[j]->timestamp = (double)timestamp / time_util::NS_PER_MS;
+                meas[j]->seq = seq;
+
+                // publish the value and get the next buffer to write to
+                meas[j] = shm.buffer(j)->write();
+            }
+
+            TRACE_PACKET(TraceDecls::PUBLISH, packet.port, seq);
+        }
+
+        // log the whole batch at once and let the broker know there's new data
+        plogger.flush();
+        shm.update()->signal();
+
+        // done with the slots we received into, the logger holds them until
+        // they're written
+        for(int i = 0; i < n; i++) {
+            if(-1 != slots[i]) {
+                pool.release(slots[i], PacketPoolDecls::CREATOR);
+            }
+
+            take_slot(pool, i, &slots[i], &vecs[i], arena);
+        }
+    }
+
+    // send whatever the logging daemon has room for, the rest is counted as
+    // not logged
+    plogger.flush();
+    if(SUCCESS != Logger::drain(EXIT_DRAIN_MS, true)) {
+        printf("Logging daemon fell behind, dropped messages it had no room for\n");
+    }
+
+    printf("Decom exiting, received %lu packets (%lu too short, %lu truncated, %lu copied to the logger, "
+           "%lu not logged)\n", seq, num_short, num_trunc, num_copied, plogger.dropped());
+
+    close(sd);
+    free(arena);
+    pool.destroy();
+
+    if(SUCCESS != shm.destroy()) {
+        printf("Failed to destroy telemetry shared memory\n");
+        exit(FAILURE);
+    }
+
+    exit(SUCCESS);
+}
@@ -5,7 +5,7 @@
 *
 *  Author: Will Merges
 *
-*  Usage: ./logd [--messages] [--packets rate] [--help]
+*  Usage: ./gsw_logd [-s none|periodic|group] [-i sync_ms] [-b] [-q]
 *
 ******************************************************************************/
 
@@ -15,13 +15,35 @@
 #include <unistd.h>
 #include <sys/select.h>
 #include <signal.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <pthread.h>
+#include <map>
+#include <unordered_map>
 
 #include "lib/time/time.h"
 #include "lib/logging/MessageLogger.h"
+#include "lib/logging/MessageLog.h"
 #include "lib/logging/PacketLogger.h"
-
-#define MAX_LINES_PER_FILE 512  // limit text files to 512 lines
-#define MAX_FILE_SIZE (1 << 31) // limit binary files to 2^32 bytes
+#include "lib/logging/PacketLog.h"
+#include "lib/logging/LogRing.h"
+#include "lib/logging/PacketPool.h"
+#include "lib/logging/LogWriter.h"
+#include "lib/sync/Mutex.h"
+#include "lib/stats/Stats.h"
+#include "lib/stats/Trace.h"
+
+#define MAX_PACKET_FILE_SIZE (1ULL << 32) // limit packet files to 2^32 bytes
+#define RING_TIMEOUT_MS 100     // how often ring threads check for exit
+#define RECV_BATCH 64           // most datagrams received per system call
+#define FILL_BUCKETS 7          // batch fill histogram buckets, powers of 2 up to RECV_BATCH
+#define SHED_START_MS 250       // shed INFO messages once one is this old when logged
+#define SHED_STOP_MS 50         // stop shedding once one is this young again
+#define SHED_HOLD_MS 1000       // but shed for at least this long once started
 
 
 // ANSI control escape codes for settings colors
@@ -43,6 +65,445 @@ const char* message_color[MessageLoggerDecls::NUM_MESSAGE_T] = \
 
 bool should_exit = false;
 
+/// @brief arguments of a thread draining a log ring
+typedef struct {
+    LogRing* ring;
+    void (*write)(const uint8_t* buff, size_t len);     // writes a record
+    void (*report)(uint64_t dropped);                   // reports dropped records
+} drain_t;
+
+/// @brief drain a log ring until 'should_exit' is set
+/// @param arg  the drain_t describing the ring
+void* drain_ring(void* arg) {
+    drain_t* drain = (drain_t*)arg;
+
+    uint64_t reported = 0;
+    while(1) {
+        // cache the sequence number first so no record is missed while we work
+        uint32_t seq = drain->ring->sequence();
+
+        size_t len;
+        const uint8_t* rec;
+        while(NULL != (rec = drain->ring->peek(&len))) {
+            drain->write(rec, len);
+            drain->ring->pop();
+        }
+
+        uint64_t dropped = drain->ring->dropped();
+        if(dropped != reported) {
+            drain->report(dropped - reported);
+            reported = dropped;
+        }
+
+        if(should_exit) {
+            break;
+        }
+
+        drain->ring->wait(seq, RING_TIMEOUT_MS);
+    }
+
+    return NULL;
+}
+
+/// @brief datagrams received from a logging socket with one system call
+typedef struct {
+    size_t max_len;                     // largest datagram accepted
+    uint8_t* arena;                     // RECV_BATCH buffers of 'max_len' bytes
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec vecs[RECV_BATCH];
+
+    uint64_t batches;                   // system calls that received something
+    uint64_t datagrams;                 // datagrams received
+    uint64_t fill[FILL_BUCKETS];        // batches by size, bucket i holds
+                                        // sizes [2^i, 2^(i+1))
+    uint64_t backlog;                   // datagrams received since the
+                                        // queue was last emptied
+    uint64_t peak_backlog;              // deepest the queue has been
+} recv_batch_t;
+
+/// @brief stats of one kind of log, published for gsw_stat
+/// NOTE: the lock of the log must be held to record into any but 'batch',
+///       which only the socket receiver records into
+typedef struct {
+    Histogram* batch;                   // datagrams received per system call
+    Histogram* write;                   // time to add a record to the log
+    Histogram* age;                     // time from the record's timestamp
+                                        // to it being logged
+    Counter* dropped;                   // records dropped from the ring
+    Counter* failed;                    // records that were invalid or
+                                        // couldn't be written
+} log_stats_t;
+
+/// @brief register the stats of a log
+/// @param stats    the stats to fill in
+/// @param name     what's logged (e.g. "messages")
+void init_stats(log_stats_t* stats, const char* name) {
+    Stats* shared = Stats::shared();
+    std::string prefix = std::string("gsw_logd.") + name;
+
+    stats->batch = shared->histogram((prefix + ".batch").c_str(), StatsDecls::COUNT);
+    stats->write = shared->histogram((prefix + ".write").c_str());
+    stats->age = shared->histogram((prefix + ".age").c_str());
+    stats->dropped = shared->counter((prefix + ".dropped").c_str());
+    stats->failed = shared->counter((prefix + ".failed").c_str());
+}
+
+/// @brief record the age of a record
+/// @param stats        the stats of the log
+/// @param timestamp    the timestamp of the record
+void record_age(log_stats_t* stats, time_util::timestamp_t timestamp) {
+    time_util::timestamp_t now = time_util::now_ns();
+
+    // the sender's clock may be ahead if it's from another machine
+    stats->age->record(now > timestamp ? now - timestamp : 0);
+}
+
+/// @brief allocate the buffers of a batch and point a message at each
+/// @param batch    the batch to setup
+/// @param max_len  largest datagram to accept, anything longer is truncated
+void init_batch(recv_batch_t* batch, size_t max_len) {
+    memset(batch, 0, sizeof(*batch));
+
+    batch->max_len = max_len;
+    batch->arena = (uint8_t*)malloc(RECV_BATCH * max_len);
+    if(NULL == batch->arena) {
+        printf("Failed to allocate receive buffers\n");
+        exit(FAILURE);
+    }
+
+    for(size_t i = 0; i < RECV_BATCH; i++) {
+        batch->vecs[i].iov_base = batch->arena + (i * max_len);
+        batch->vecs[i].iov_len = max_len;
+
+        batch->msgs[i].msg_hdr.msg_iov = &batch->vecs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+/// @brief ask for a larger receive buffer on a logging socket
+/// @param sd   the socket
+void set_recv_buffer(int sd) {
+    // the default still works, so carry on if it can't be set
+    int rcvbuf = LoggerDecls::SOCKET_BUFFER_SIZE;
+    if(-1 == setsockopt(sd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf))) {
+        perror("Failed to set logging socket receive buffer size");
+    }
+}
+
+/// @brief block for a datagram and take whatever else is queued behind it
+/// @param sd       the socket to receive from
+/// @param batch    the batch to receive into
+/// @param stats    the stats of the log
+/// @return the number of datagrams received or -1 on error
+int recv_batch(int sd, recv_batch_t* batch, log_stats_t* stats) {
+    int n = recvmmsg(sd, batch->msgs, RECV_BATCH, MSG_WAITFORONE, NULL);
+    if(n <= 0) {
+        return n;
+    }
+
+    stats->batch->record(n);
+
+    batch->batches++;
+    batch->datagrams += n;
+
+    int bucket = 0;
+    while((1 << (bucket + 1)) <= n && bucket < FILL_BUCKETS - 1) {
+        bucket++;
+    }
+    batch->fill[bucket]++;
+
+    // a full batch means more is waiting, so the queue was at least as deep
+    // as everything received since a batch last came up short
+    // NOTE: UNIX datagrams are charged to the sender, so the kernel can't tell
+    //       us how much is queued on the receiving end
+    batch->backlog += n;
+    if(batch->backlog > batch->peak_backlog) {
+        batch->peak_backlog = batch->backlog;
+    }
+
+    if(RECV_BATCH != n) {
+        batch->backlog = 0;
+    }
+
+    return n;
+}
+
+/// @brief print the counters of a batch
+/// @param name     what was received (e.g. "messages")
+/// @param batch    the batch
+void report_batch(const char* name, recv_batch_t* batch) {
+    double avg = batch->batches ? (double)batch->datagrams / batch->batches : 0;
+
+    printf("Received %lu %s in %lu batches, %.1f per batch, at most %lu queued\n",
+           batch->datagrams, name, batch->batches, avg, batch->peak_backlog);
+
+    std::string hist = "Batch sizes:";
+    for(int i = 0; i < FILL_BUCKETS; i++) {
+        hist += " " + std::to_string(1 << i) + "+:" + std::to_string(batch->fill[i]);
+    }
+    printf("%s\n", hist.c_str());
+}
+
+// message log file state, shared by the socket receiver and the ring drain thread
+Mutex msg_lock;
+std::string msg_dir;
+FILE* msg_file = NULL;
+size_t msg_index = 0;
+size_t msg_size = 0;
+bool msg_echo = true;
+
+// ids of the sources seen in the current message log file
+std::unordered_map<std::string, uint16_t> msg_sources;
+
+log_stats_t msg_stats;
+
+// INFO messages are shed while the log is falling behind, see shed_message
+bool msg_shedding = false;
+uint64_t msg_shed = 0;                  // messages shed since shedding started
+time_util::timestamp_t msg_shed_start;  // when shedding started (mono_ns)
+Counter* msg_shed_stat = NULL;          // every message shed
+Counter* msg_shedding_stat = NULL;      // 1 while shedding
+
+/// @brief write to the message log file, exits on failure
+/// @param data     the data to write
+/// @param len      the length of data in bytes
+void write_message_file(const void* data, size_t len) {
+    if(fwrite(data, 1, len, msg_file) != len) {
+        perror("Failed to write to message log file");
+        exit(FAILURE);
+    }
+
+    msg_size += len;
+}
+
+/// @brief open the next message log file
+void open_message_file() {
+    if(NULL != msg_file) {
+        fclose(msg_file);
+    }
+
+    std::string filename = msg_dir;
+    filename += "/messages-";
+    filename += std::to_string(msg_index);
+    filename += MessageLogDecls::SUFFIX;
+    msg_index++;
+
+    msg_file = fopen(filename.c_str(), "w");
+    if(NULL == msg_file) {
+        perror("Failed to open new log file");
+        exit(FAILURE);
+    }
+
+    // records are flushed a batch at a time, so buffer at least a batch
+    setvbuf(msg_file, NULL, _IOFBF, RECV_BATCH * (Logger::MAX_LOG_SIZE + sizeof(MessageLogDecls::record_t)));
+
+    msg_size = 0;
+    msg_sources.clear();
+
+    MessageLogDecls::file_header_t header;
+    header.magic = MessageLogDecls::MAGIC;
+    header.version = MessageLogDecls::VERSION;
+    header.unused = 0;
+    write_message_file(&header, sizeof(header));
+}
+
+/// @brief get the id of a source, defining it in the current file if needed
+/// @param name     the source name
+/// @param len      the length of the name
+/// @return the id, or MessageLogDecls::NO_SOURCE if the file has no ids left
+uint16_t message_source(const char* name, size_t len) {
+    std::string key(name, len);
+
+    std::unordered_map<std::string, uint16_t>::iterator it = msg_sources.find(key);
+    if(it != msg_sources.end()) {
+        return it->second;
+    }
+
+    if(msg_sources.size() >= MessageLogDecls::MAX_SOURCE) {
+        return MessageLogDecls::NO_SOURCE;
+    }
+
+    uint16_t id = msg_sources.size() + 1;
+    msg_sources[key] = id;
+
+    MessageLogDecls::record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = MessageLogDecls::SOURCE;
+    rec.source = id;
+    rec.len = len;
+    write_message_file(&rec, sizeof(rec));
+    write_message_file(name, len);
+
+    return id;
+}
+
+void append_message(const uint8_t* buff, size_t len);
+
+/// @brief write a message from the logging daemon itself to the log without
+///        flushing the log file
+/// @param type     the type of message
+/// @param msg      the message, without the "(gsw_logd) " prefix
+/// NOTE: msg_lock must be held
+void append_notice(MessageLoggerDecls::message_t type, const std::string& msg) {
+    std::string text = "(gsw_logd) " + msg;
+
+    uint8_t buff[sizeof(MessageLoggerDecls::info_t) + 128];
+    size_t len = text.length();
+    if(len > sizeof(buff) - sizeof(MessageLoggerDecls::info_t)) {
+        len = sizeof(buff) - sizeof(MessageLoggerDecls::info_t);
+    }
+
+    MessageLoggerDecls::info_t info;
+    info.timestamp = time_util::now_ns();
+    info.type = type;
+    memcpy(buff, &info, sizeof(info));
+    memcpy(buff + sizeof(info), text.c_str(), len);
+
+    append_message(buff, sizeof(info) + len);
+}
+
+/// @brief check if a message should be shed because the log is falling
+///        behind, only INFO messages are ever shed
+/// @param info     the information logged with the message
+/// @return true if the message should be dropped
+/// NOTE: msg_lock must be held
+bool shed_message(const MessageLoggerDecls::info_t& info) {
+    if(MessageLoggerDecls::INFO != info.type) {
+        return false;
+    }
+
+    // how long the message waited, the sender is on this machine
+    time_util::timestamp_t now = time_util::now_ns();
+    time_util::timestamp_t age = (now > info.timestamp) ? now - info.timestamp : 0;
+
+    if(!msg_shedding && age >= SHED_START_MS * time_util::NS_PER_MS) {
+        msg_shedding = true;
+        msg_shed = 0;
+        msg_shed_start = time_util::mono_ns();
+        msg_shedding_stat->set(1);
+
+        append_notice(MessageLoggerDecls::WARN, "shedding INFO messages, " +
+                      std::to_string(age / time_util::NS_PER_MS) + " ms behind");
+    } else if(msg_shedding && age < SHED_STOP_MS * time_util::NS_PER_MS &&
+              time_util::mono_ns() - msg_shed_start >= SHED_HOLD_MS * time_util::NS_PER_MS) {
+        // held long enough that a backlog behind a shallow socket queue
+        // doesn't start and stop shedding over and over
+        msg_shedding = false;
+        msg_shedding_stat->set(0);
+
+        append_notice(MessageLoggerDecls::WARN, "stopped shedding INFO messages, shed " +
+                      std::to_string(msg_shed));
+    }
+
+    if(msg_shedding) {
+        msg_shed++;
+        msg_shed_stat->add();
+        return true;
+    }
+
+    return false;
+}
+
+/// @brief write a system message to the log without flushing the log file,
+///        and echo it to standard output if 'msg_echo' is set
+/// @param buff     the message, starting with a MessageLoggerDecls::info_t
+/// @param len      the length of the message in bytes
+/// NOTE: msg_lock must be held
+void append_message(const uint8_t* buff, size_t len) {
+    if(len < sizeof(MessageLoggerDecls::info_t)) {
+        printf("Invalid system message of %lu bytes\n", len);
+        msg_stats.failed->add();
+        return;
+    }
+
+    time_util::timestamp_t start = time_util::mono_ns();
+
+    MessageLoggerDecls::info_t info;
+    memcpy(&info, buff, sizeof(info));
+    if(info.type >= MessageLoggerDecls::NUM_MESSAGE_T) {
+        info.type = MessageLoggerDecls::NUM_MESSAGE_T;
+    }
+
+    if(shed_message(info)) {
+        return;
+    }
+
+    // the message isn't NULL terminated
+    const char* msg = (const char*)buff + sizeof(info);
+    size_t msg_len = len - sizeof(info);
+
+    // leave room for a source definition too, a new file starts without any
+    if(msg_size + (2 * sizeof(MessageLogDecls::record_t)) + MessageLogDecls::MAX_SOURCE_NAME + msg_len >
+       MessageLogDecls::MAX_FILE_SIZE) {
+        open_message_file();
+    }
+
+    MessageLogDecls::record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.type = MessageLogDecls::MESSAGE;
+    rec.severity = info.type;
+    rec.timestamp = info.timestamp;
+
+    // split "(source) message" into its source and message
+    const char* text = msg;
+    size_t text_len = msg_len;
+    if(msg_len > 0 && '(' == msg[0]) {
+        size_t max = msg_len;
+        if(max > MessageLogDecls::MAX_SOURCE_NAME + 1) {
+            max = MessageLogDecls::MAX_SOURCE_NAME + 1;
+        }
+
+        const char* end = (const char*)memchr(msg, ')', max);
+        if(NULL != end && (size_t)(end - msg) + 1 < msg_len && ' ' == end[1]) {
+            rec.source = message_source(msg + 1, end - msg - 1);
+
+            if(MessageLogDecls::NO_SOURCE != rec.source) {
+                text = end + 2;
+                text_len = msg_len - (text - msg);
+            }
+        }
+    }
+
+    rec.len = text_len;
+    write_message_file(&rec, sizeof(rec));
+    write_message_file(text, text_len);
+
+    if(msg_echo) {
+        const char* color = (info.type < MessageLoggerDecls::NUM_MESSAGE_T) ?
+                            message_color[info.type] : ANSI_WHITE_BOLD;
+        char timestamp[time_util::TIME_STR_LEN];
+        time_util::format(info.timestamp, timestamp, sizeof(timestamp), 3);
+
+        printf("%s [%s%s%s] %s%.*s%s\n", timestamp,
+                                         color, MessageLoggerDecls::message_str[info.type], ANSI_RESET,
+                                         ANSI_WHITE_BOLD, (int)msg_len, msg, ANSI_RESET);
+    }
+
+    msg_stats.write->record(time_util::mono_ns() - start);
+    record_age(&msg_stats, info.timestamp);
+}
+
+/// @brief write a system message to the log and echo it to standard output
+/// @param buff     the message, starting with a MessageLoggerDecls::info_t
+/// @param len      the length of the message in bytes
+void write_message(const uint8_t* buff, size_t len) {
+    msg_lock.lock();
+    append_message(buff, len);
+    fflush(msg_file);
+    msg_lock.unlock();
+}
+
+/// @brief log a warning that system messages were dropped from the ring
+/// @param dropped  the number of messages dropped since the last report
+void report_messages(uint64_t dropped) {
+    msg_lock.lock();
+    msg_stats.dropped->add(dropped);
+    append_notice(MessageLoggerDecls::WARN, "dropped " + std::to_string(dropped) +
+                  " messages, message log ring full");
+    fflush(msg_file);
+    msg_lock.unlock();
+}
+
 /// @brief signal handler for the message logger that sets 'should_exit' to true
 ///        and sends a dummy message from a logger
 ///
@@ -51,34 +512,32 @@ bool should_exit = false;
 void sig_msg(int) {
     should_exit = true;
 
-    MessageLogger logger{""};
-    logger.log_message("");
+    Logger logger(MessageLoggerDecls::ADDRESS_FILE, LoggerDecls::SOCKET);
+    uint8_t dummy = 0;
+    logger.log(&dummy, sizeof(dummy));
 }
 
-/// @brief log system messages
-/// @param dir  the directory to place message logs
-void log_messages(const char* dir) {
-    // setup signal handler to set the 'should_exit' flag
-    // NOTE: this will only fail if signum is invalid
-    signal(SIGINT, sig_msg);
-    signal(SIGQUIT, sig_msg);
-    signal(SIGTERM, sig_msg);
-
-    // open the UNIX socket that system messages are sent to
-    int sd = socket(AF_UNIX, SOCK_DGRAM, 0);
+/// @brief open and bind the socket of a message lane
+/// @param file     the address file of the lane, relative to GSW_HOME
+/// @return the socket, exits on failure
+int open_lane(const char* file) {
+    // non-blocking, the lanes are polled together
+    int sd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0);
 
     if(-1 == sd) {
         perror("Failed to open message logging socket");
         exit(FAILURE);
     }
 
+    set_recv_buffer(sd);
+
     struct sockaddr_un addr;
     addr.sun_family = AF_UNIX;
 
     // NOTE: we're guaranteed getenv returns non-NULL because we checked in main
     std::string addr_file = getenv("GSW_HOME");
     addr_file += "/";
-    addr_file += MessageLoggerDecls::ADDRESS_FILE;
+    addr_file += file;
     const char* addr_str = addr_file.c_str();
 
     size_t len = 0;
@@ -103,80 +562,326 @@ void log_messages(const char* dir) {
         exit(FAILURE);
     }
 
-    size_t file_index = 0;
-    while(!should_exit) {
-        std::string filename = dir;
-        filename += "/messages-";
-        filename += std::to_string(file_index);
-        filename += ".csv";
-
-        FILE* f = fopen(filename.c_str(), "w");
-        if(NULL == f) {
-            perror("Failed to open new log file");
-            exit(FAILURE);
-        }
+    return sd;
+}
 
-        // write the row header
-        std::string header = "time,type,message\n";
+/// @brief write a batch of system messages to the log and flush it once
+/// @param batch    the batch
+/// @param n        the number of messages received into the batch
+void write_messages(recv_batch_t* batch, int n) {
+    msg_lock.lock();
+
+    for(int i = 0; i < n; i++) {
+        size_t len = batch->msgs[i].msg_len;
+
+        if(len < sizeof(MessageLoggerDecls::info_t)) {
+            // it's possible we were unblocked by the dummy message sent
+            // from within the signal handler
+            if(!should_exit) {
+                printf("Invalid amount of data read from message logging socket, read %lu bytes\n", len);
+                msg_stats.failed->add();
+            }
 
-        if(fwrite(header.c_str(), sizeof(char), header.length(), f) != header.length()) {
-            printf("Failed to write row header to message log file\n");
-            exit(FAILURE);
+            continue;
         }
 
-        size_t lines = 1;
-        uint8_t buff[Logger::MAX_LOG_SIZE + sizeof(MessageLoggerDecls::info_t)];
-        while(lines < MAX_LINES_PER_FILE && !should_exit) {
-            ssize_t len = recv(sd, buff, Logger::MAX_LOG_SIZE + sizeof(MessageLoggerDecls::info_t), 0);
+        append_message((uint8_t*)batch->vecs[i].iov_base, len);
+    }
 
-            // it's possible we were unblocked by the dummy message sent from
-            // within the signal handler
-            if(should_exit) {
-                break;
-            }
+    fflush(msg_file);
+    msg_lock.unlock();
+}
 
-            if(len < (ssize_t)sizeof(MessageLoggerDecls::info_t)) {
-                // no data received, try again
-                printf("Invalid amount of data read from message logging socket, read %li bytes\n", len);
-                continue;
-            }
+/// @brief log system messages
+/// @param dir  the directory to place message logs
+void log_messages(const char* dir) {
+    // setup signal handler to set the 'should_exit' flag
+    // NOTE: this will only fail if signum is invalid
+    signal(SIGINT, sig_msg);
+    signal(SIGQUIT, sig_msg);
+    signal(SIGTERM, sig_msg);
 
-            MessageLoggerDecls::info_t* info = (MessageLoggerDecls::info_t*)buff;
-            std::string timestamp = time_util::to_string(info->timestamp, true);
-            std::string type = MessageLoggerDecls::message_str[info->type];
+    // open the UNIX socket of each lane, indexed by message type
+    struct pollfd lanes[MessageLoggerDecls::NUM_MESSAGE_T];
+    recv_batch_t batches[MessageLoggerDecls::NUM_MESSAGE_T];
+    for(int i = 0; i < MessageLoggerDecls::NUM_MESSAGE_T; i++) {
+        lanes[i].fd = open_lane(MessageLoggerDecls::LANE_FILE[i]);
+        lanes[i].events = POLLIN;
 
-            const char* msg;
-            if(len == sizeof(MessageLoggerDecls::info_t)) {
-                // no message
-                msg = "";
-            } else {
-                msg = (char*)(&(buff[sizeof(MessageLoggerDecls::info_t)]));
+        init_batch(&batches[i], Logger::MAX_LOG_SIZE + sizeof(MessageLoggerDecls::info_t));
+    }
+
+    msg_dir = dir;
+    open_message_file();
+
+    // registered before any thread that records them starts
+    init_stats(&msg_stats, "messages");
+    msg_shed_stat = Stats::shared()->counter("gsw_logd.messages.shed");
+    msg_shedding_stat = Stats::shared()->gauge("gsw_logd.messages.shedding");
+
+    // loggers using the ring transport write here instead of the socket
+    LogRing ring(MessageLoggerDecls::ADDRESS_FILE);
+    if(SUCCESS != ring.create()) {
+        printf("Failed to create message log ring\n");
+        exit(FAILURE);
+    }
+
+    drain_t drain = {&ring, write_message, report_messages};
+    pthread_t drain_thread;
+    if(0 != pthread_create(&drain_thread, NULL, drain_ring, &drain)) {
+        printf("Failed to start message log ring thread\n");
+        exit(FAILURE);
+    }
+
+    while(!should_exit) {
+        if(-1 == poll(lanes, MessageLoggerDecls::NUM_MESSAGE_T, -1)) {
+            if(EINTR != errno) {
+                perror("Failed to poll message logging sockets");
             }
 
-            std::string csv_line = timestamp + "," + type + "," + msg + "\n";
+            continue;
+        }
+
+        // take a batch from the most severe lane with messages, and start
+        // over from CRIT after every batch, so a less severe lane never holds
+        // up a more severe one
+        int lane = MessageLoggerDecls::CRIT;
+        while(lane >= 0 && !should_exit) {
+            int n = recv_batch(lanes[lane].fd, &batches[lane], &msg_stats);
+            if(n <= 0) {
+                if(-1 == n && EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno) {
+                    perror("Failed to receive from message logging socket");
+                }
 
-            if(fwrite(csv_line.c_str(), sizeof(char), csv_line.length(), f) != csv_line.length()) {
-                printf("Failed to write message to log file\n");
+                lane--;
                 continue;
             }
-            fflush(f);
-
-            // echo to standard output
-            const char* color = message_color[info->type];
-            printf("%s [%s%s%s] %s%s%s\n", timestamp.c_str(),
-                                           color, type.c_str(), ANSI_RESET,
-                                           ANSI_WHITE_BOLD, msg, ANSI_RESET);
-            lines++;
+
+            write_messages(&batches[lane], n);
+            lane = MessageLoggerDecls::CRIT;
         }
+    }
 
-        fclose(f);
-        file_index++;
+    pthread_join(drain_thread, NULL);
+    ring.destroy();
+
+    for(int i = 0; i < MessageLoggerDecls::NUM_MESSAGE_T; i++) {
+        std::string name = std::string(MessageLoggerDecls::message_str[i]) + " messages";
+        report_batch(name.c_str(), &batches[i]);
+
+        free(batches[i].arena);
+        close(lanes[i].fd);
     }
 
-    close(sd);
+    if(msg_shed_stat->get()) {
+        printf("Shed %lu INFO messages while falling behind\n", msg_shed_stat->get());
+    }
+
+    fclose(msg_file);
     exit(SUCCESS);
 }
 
+// packet log state, shared by the socket receiver and the ring drain threads
+Mutex pkt_lock;
+LogWriter* pkt_writer = NULL;
+size_t pkt_print_rate = 1;
+size_t pkt_count = 0;
+size_t pkt_total = 0;
+uint64_t pkt_failed = 0;
+log_stats_t pkt_stats;
+
+// packet log index state
+std::string pkt_dir;
+int pkt_index_fd = -1;
+size_t pkt_index_file = (size_t)-1;     // file the index is for
+PacketLogDecls::index_entry_t pkt_last_entry;
+
+/// @brief add a record to the index if it's been long enough since the last
+///        entry, starting a new index if the record is in a new file
+/// @param timestamp    the timestamp of the record
+/// @param pos          where the record was written
+/// NOTE: pkt_lock must be held
+void index_packet(time_util::timestamp_t timestamp, const LogWriterDecls::position_t* pos) {
+    bool first = false;
+
+    if(pos->file != pkt_index_file) {
+        if(-1 != pkt_index_fd) {
+            close(pkt_index_fd);
+        }
+
+        pkt_index_file = pos->file;
+
+        std::string path = pkt_dir + "/" + PacketLogDecls::PREFIX +
+                           std::to_string(pos->file) + PacketLogDecls::INDEX_SUFFIX;
+        pkt_index_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if(-1 == pkt_index_fd) {
+            perror("Failed to open packet log index");
+            return;
+        }
+
+        PacketLogDecls::index_header_t header;
+        memset(&header, 0, sizeof(header));
+        header.magic = PacketLogDecls::INDEX_MAGIC;
+        header.version = PacketLogDecls::VERSION;
+
+        if(sizeof(header) != write(pkt_index_fd, &header, sizeof(header))) {
+            perror("Failed to write packet log index");
+        }
+
+        first = true;
+    }
+
+    if(-1 == pkt_index_fd) {
+        return;
+    }
+
+    // entries stay in timestamp order, a record older than the last entry
+    // (e.g. from a process with an earlier receive time) is covered by it
+    if(!first && (timestamp < pkt_last_entry.timestamp ||
+                  (timestamp - pkt_last_entry.timestamp < PacketLogDecls::INDEX_INTERVAL &&
+                   pos->offset - pkt_last_entry.offset < PacketLogDecls::INDEX_BYTES))) {
+        return;
+    }
+
+    pkt_last_entry.timestamp = timestamp;
+    pkt_last_entry.offset = pos->offset;
+
+    if(sizeof(pkt_last_entry) != write(pkt_index_fd, &pkt_last_entry, sizeof(pkt_last_entry))) {
+        perror("Failed to write packet log index");
+    }
+}
+
+/// @brief write a packet to the log
+/// @param buff     the packet, starting with a PacketLoggerDecls::info_t
+/// @param len      the length of the packet in bytes
+/// NOTE: pkt_lock must be held
+void append_packet(const uint8_t* buff, size_t len) {
+    static const uint8_t padding[PacketLogDecls::RECORD_ALIGN] = {0};
+
+    if(len < sizeof(PacketLoggerDecls::info_t)) {
+        printf("Invalid packet of %lu bytes\n", len);
+        pkt_stats.failed->add();
+        return;
+    }
+
+    time_util::timestamp_t start = time_util::mono_ns();
+
+    PacketLoggerDecls::info_t info;
+    memcpy(&info, buff, sizeof(info));
+
+    PacketLogDecls::record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.sync = PacketLogDecls::SYNC;
+    rec.timestamp = info.timestamp;
+    rec.len = len - sizeof(info);
+    rec.port = info.port;
+
+    const uint8_t* data = buff + sizeof(info);
+    rec.crc = PacketLogDecls::record_crc(&rec, data);
+
+    struct iovec iov[3];
+    iov[0].iov_base = &rec;
+    iov[0].iov_len = sizeof(rec);
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = rec.len;
+    iov[2].iov_base = (void*)padding;
+    iov[2].iov_len = PacketLogDecls::record_size(rec.len) - sizeof(rec) - rec.len;
+
+    // only copies the packet into a buffer, the writer thread does the I/O
+    LogWriterDecls::position_t pos;
+    if(SUCCESS != pkt_writer->write(iov, 3, &pos)) {
+        pkt_failed++;
+        pkt_stats.failed->add();
+    } else {
+        index_packet(rec.timestamp, &pos);
+        TRACE_PACKET(TraceDecls::LOGD_WRITE, info.port, info.seq);
+    }
+
+    pkt_stats.write->record(time_util::mono_ns() - start);
+    record_age(&pkt_stats, info.timestamp);
+
+    pkt_count++;
+    if(pkt_count >= pkt_print_rate) {
+        pkt_total += pkt_count;
+        pkt_count = 0;
+        printf("%sReceived %lu packets%s\n", ANSI_MAGENTA_BOLD,
+                                            pkt_total,
+                                            ANSI_RESET);
+    }
+}
+
+/// @brief write a packet to the log
+/// @param buff     the packet, starting with a PacketLoggerDecls::info_t
+/// @param len      the length of the packet in bytes
+void write_packet(const uint8_t* buff, size_t len) {
+    pkt_lock.lock();
+    append_packet(buff, len);
+    pkt_lock.unlock();
+}
+
+// packet pools descriptors have been received for, only used by the pool
+// drain thread
+std::map<std::string, PacketPool*> pools;
+
+/// @brief write a packet held in a packet pool to the log and release its slot
+/// @param buff     the PacketPoolDecls::descriptor_t of the slot
+/// @param len      the length of the descriptor in bytes
+void write_descriptor(const uint8_t* buff, size_t len) {
+    if(len != sizeof(PacketPoolDecls::descriptor_t)) {
+        printf("Invalid packet descriptor of %lu bytes\n", len);
+        return;
+    }
+
+    PacketPoolDecls::descriptor_t desc;
+    memcpy(&desc, buff, sizeof(desc));
+    desc.pool[PacketPoolDecls::MAX_NAME - 1] = '\0';
+
+    PacketPool*& pool = pools[desc.pool];
+    if(NULL != pool && pool->owner() != desc.owner) {
+        // the pool was recreated (e.g. decom restarted), drop the old one
+        pool->detach();
+        delete pool;
+        pool = NULL;
+    }
+
+    if(NULL == pool) {
+        pool = new PacketPool(desc.pool);
+        if(SUCCESS != pool->attach() || pool->owner() != desc.owner) {
+            // the pool is already gone
+            printf("Failed to attach to packet pool '%s'\n", desc.pool);
+            pool->detach();
+            delete pool;
+            pool = NULL;
+            return;
+        }
+    }
+
+    uint8_t* slot = pool->slot(desc.slot);
+    if(NULL == slot) {
+        printf("Invalid slot %u in packet pool '%s'\n", desc.slot, desc.pool);
+        return;
+    }
+
+    if(desc.len <= PacketPoolDecls::SLOT_SIZE) {
+        write_packet(slot, desc.len);
+    } else {
+        printf("Invalid length %u of slot in packet pool '%s'\n", desc.len, desc.pool);
+    }
+
+    pool->release(desc.slot, PacketPoolDecls::LOGGER);
+}
+
+/// @brief report that packets were dropped from the ring
+/// @param dropped  the number of packets dropped since the last report
+void report_packets(uint64_t dropped) {
+    pkt_lock.lock();
+    pkt_stats.dropped->add(dropped);
+    printf("%sDropped %lu packets, packet log ring full%s\n", ANSI_YELLOW_BOLD,
+                                                            dropped,
+                                                            ANSI_RESET);
+    pkt_lock.unlock();
+}
+
 /// @brief signal handler for the packet logger that sets 'should_exit' to true
 ///        and sends a dummy packet from a logger
 ///
@@ -185,16 +890,18 @@ void log_messages(const char* dir) {
 void sig_pkt(int) {
     should_exit = true;
 
-    PacketLogger logger{};
-    logger.log_packet(NULL, 0, 8000);
+    Logger logger(PacketLoggerDecls::ADDRESS_FILE, LoggerDecls::SOCKET);
+    uint8_t dummy = 0;
+    logger.log(&dummy, sizeof(dummy));
 }
 
 /// @brief log packets
 /// @param dir          the directory to place packet logs
 /// @param print_rate   print a message every 'print_rate' packets logged
+/// @param config       packet log writer configuration
 // TODO check sizes are correct according to configuration?
 //      maybe also configure whether to log short packets
-void log_packets(const char* dir, size_t print_rate) {
+void log_packets(const char* dir, size_t print_rate, LogWriterDecls::config_t config) {
     // setup signal handler to set the 'should_exit' flag
     // NOTE: this will only fail if signum is invalid
     signal(SIGINT, sig_pkt);
@@ -209,6 +916,8 @@ void log_packets(const char* dir, size_t print_rate) {
         exit(FAILURE);
     }
 
+    set_recv_buffer(sd);
+
     struct sockaddr_un addr;
     addr.sun_family = AF_UNIX;
 
@@ -240,66 +949,148 @@ void log_packets(const char* dir, size_t print_rate) {
         exit(FAILURE);
     }
 
-    size_t file_index = 0;
-    while(!should_exit) {
-        std::string filename = dir;
-        filename += "/packets-";
-        filename += std::to_string(file_index);
-        filename += ".bin";
-
-        FILE* f = fopen(filename.c_str(), "w");
-        if(NULL == f) {
-            perror("Failed to open new log file");
-            exit(FAILURE);
-        }
+    pkt_print_rate = print_rate;
 
-        uint32_t written = 0;
-        size_t packets = 0;
-        size_t total_packets = 0;
-        uint8_t buff[Logger::MAX_LOG_SIZE + sizeof(PacketLoggerDecls::info_t)];
+    // registered before any thread that records them starts
+    init_stats(&pkt_stats, "packets");
 
-        while(written < (uint32_t)MAX_FILE_SIZE && !should_exit) {
-            ssize_t len = recv(sd, buff, Logger::MAX_LOG_SIZE + sizeof(PacketLoggerDecls::info_t), 0);
+    pkt_dir = dir;
 
-            // it's possible we were unblocked by the dummy message sent from
-            // within the signal handler
-            if(should_exit) {
-                break;
+    PacketLogDecls::file_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.magic = PacketLogDecls::MAGIC;
+    header.version = PacketLogDecls::VERSION;
+    header.record_size = sizeof(PacketLogDecls::record_t);
+
+    LogWriter writer(dir, PacketLogDecls::PREFIX, PacketLogDecls::SUFFIX, config);
+    if(SUCCESS != writer.set_header((const uint8_t*)&header, sizeof(header)) ||
+       SUCCESS != writer.open()) {
+        perror("Failed to open new log file");
+        exit(FAILURE);
+    }
+    pkt_writer = &writer;
+
+    printf("Writing packet logs with %s I/O, %s sync\n", writer.direct() ? "direct" : "buffered",
+           LogWriterDecls::sync_str[config.sync]);
+
+    // loggers using the ring transport write here instead of the socket
+    LogRing ring(PacketLoggerDecls::ADDRESS_FILE);
+    if(SUCCESS != ring.create()) {
+        printf("Failed to create packet log ring\n");
+        exit(FAILURE);
+    }
+
+    drain_t drain = {&ring, write_packet, report_packets};
+    pthread_t drain_thread;
+    if(0 != pthread_create(&drain_thread, NULL, drain_ring, &drain)) {
+        printf("Failed to start packet log ring thread\n");
+        exit(FAILURE);
+    }
+
+    // processes receiving into a packet pool send descriptors of the slots here
+    LogRing pool_ring(PacketLoggerDecls::POOL_RING);
+    if(SUCCESS != pool_ring.create()) {
+        printf("Failed to create packet pool descriptor ring\n");
+        exit(FAILURE);
+    }
+
+    drain_t pool_drain = {&pool_ring, write_descriptor, report_packets};
+    pthread_t pool_thread;
+    if(0 != pthread_create(&pool_thread, NULL, drain_ring, &pool_drain)) {
+        printf("Failed to start packet pool thread\n");
+        exit(FAILURE);
+    }
+
+    recv_batch_t batch;
+    init_batch(&batch, Logger::MAX_LOG_SIZE + sizeof(PacketLoggerDecls::info_t));
+
+    while(!should_exit) {
+        int n = recv_batch(sd, &batch, &pkt_stats);
+        if(-1 == n) {
+            if(EINTR != errno) {
+                perror("Failed to receive from packet logging socket");
             }
 
-            if(len < (ssize_t)sizeof(PacketLoggerDecls::info_t)) {
-                // no data received, try again
-                printf("Invalid amount of data read from packet logging socket, read %li bytes\n", len);
+            continue;
+        }
+
+        // take the lock once for the whole batch
+        pkt_lock.lock();
+        for(int i = 0; i < n; i++) {
+            size_t len = batch.msgs[i].msg_len;
+
+            if(len < sizeof(PacketLoggerDecls::info_t)) {
+                // it's possible we were unblocked by the dummy packet sent
+                // from within the signal handler
+                if(!should_exit) {
+                    printf("Invalid amount of data read from packet logging socket, read %lu bytes\n", len);
+                    pkt_stats.failed->add();
+                }
+
                 continue;
             }
 
-            // write everything out
-            if((ssize_t)fwrite(buff, sizeof(uint8_t), len, f) != len) {
-                printf("Failed to write message message to log file\n");
-            }
-            fflush(f);
-
-            packets++;
-            if(packets >= print_rate) {
-                total_packets += packets;
-                packets = 0;
-                printf("%sReceived %lu packets%s\n", ANSI_MAGENTA_BOLD,
-                                                    total_packets,
-                                                    ANSI_RESET);
-            }
+            append_packet((uint8_t*)batch.vecs[i].iov_base, len);
+        }
+        pkt_lock.unlock();
+    }
+
+    pthread_join(drain_thread, NULL);
+    ring.destroy();
 
-            written += len;
+    pthread_join(pool_thread, NULL);
+    pool_ring.destroy();
+
+    for(std::pair<const std::string, PacketPool*>& p : pools) {
+        if(NULL != p.second) {
+            p.second->detach();
+            delete p.second;
         }
+    }
+
+    if(SUCCESS != writer.close()) {
+        printf("Failed to write out packet log\n");
+    }
+
+    if(-1 != pkt_index_fd) {
+        close(pkt_index_fd);
+    }
 
-        fclose(f);
-        file_index++;
+    if(pkt_failed) {
+        printf("Failed to write %lu packets to the log\n", pkt_failed);
     }
 
+    report_batch("packets", &batch);
+    free(batch.arena);
+
     close(sd);
     exit(0);
 }
 
 
+/// @brief output every complete line read from a pipe, buffering the rest
+/// @param buff     data read from the pipe without a newline yet
+/// @param data     data just read from the pipe
+/// @param len      the length of data
+void dump_lines(std::string& buff, const char* data, size_t len) {
+    const char* end = data + len;
+
+    while(data < end) {
+        const char* nl = (const char*)memchr(data, '\n', end - data);
+        if(NULL == nl) {
+            // buffer the partial line
+            buff.append(data, end - data);
+            break;
+        }
+
+        buff.append(data, nl - data);
+        printf("%s\n", buff.c_str());
+        buff = "";
+
+        data = nl + 1;
+    }
+}
+
 /// @brief buffer the output of two file descriptors and output them to stdout
 ///        when a full line is buffered. The file descriptors should be pipes
 ///        that are connected to the output of the message logging process and
@@ -320,6 +1111,10 @@ void pipe_output(int msg, int pkt) {
         nfds = pkt + 1;
     }
 
+    // read as much as is available at once, the sub processes block when
+    // their pipe fills up so reading a byte at a time throttles them
+    char chunk[4096];
+
     uint8_t cont = 0;
     while(1) {
         FD_ZERO(&set);
@@ -352,22 +1147,14 @@ void pipe_output(int msg, int pkt) {
 
         if(FD_ISSET(msg, &set)) {
             // data on msg
-            char chr;
-            ssize_t len = read(msg, &chr, 1);
+            ssize_t len = read(msg, chunk, sizeof(chunk));
             if(0 == len) {
                 // EOF, write end of pipe closed (by sub process exit)
                 printf("detected exit of message logger process\n");
                 close(msg);
                 msg = -1;
-            } else if(1 == len){
-                if('\n' == chr) {
-                    // dump the buffer
-                    printf("%s\n", msg_buff.c_str());
-                    msg_buff = "";
-                } else {
-                    // buffer the character
-                    msg_buff += chr;
-                }
+            } else if(len > 0) {
+                dump_lines(msg_buff, chunk, len);
             } else {
                 if(errno == EINTR) {
                     // signal
@@ -380,21 +1167,13 @@ void pipe_output(int msg, int pkt) {
 
         if(FD_ISSET(pkt, &set)) {
             // data on pkt
-            char chr;
-            ssize_t len = read(pkt, &chr, 1);
+            ssize_t len = read(pkt, chunk, sizeof(chunk));
             if(0 == len) {
                 printf("detected exit of packet logger process\n");
                 close(pkt);
                 pkt = -1;
-            } else if(1 == len){
-                if('\n' == chr) {
-                    // dump the buffer
-                    printf("%s\n", pkt_buff.c_str());
-                    pkt_buff = "";
-                } else {
-                    // buffer the character
-                    pkt_buff += chr;
-                }
+            } else if(len > 0) {
+                dump_lines(pkt_buff, chunk, len);
             } else {
                 if(errno == EINTR) {
                     // signal
@@ -412,8 +1191,54 @@ void sig_ignore(int) {
     return;
 }
 
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_logd [-s none|periodic|group] [-i sync_ms] [-b] [-q]\n");
+    printf("    -s sync     packet log durability policy (default %s)\n",
+           LogWriterDecls::sync_str[LogWriterDecls::DEFAULT_CONFIG.sync]);
+    printf("    -i sync_ms  sync interval for the periodic policy (default %d)\n",
+           LogWriterDecls::DEFAULT_CONFIG.sync_ms);
+    printf("    -b          write packet logs with buffered instead of direct I/O\n");
+    printf("    -q          don't echo system messages, read them with gsw_logcat instead\n");
+    exit(FAILURE);
+}
+
 // TODO handle signals and graciously exit
-int main() {
+int main(int argc, char* argv[]) {
+    LogWriterDecls::config_t config = LogWriterDecls::DEFAULT_CONFIG;
+    config.file_size = MAX_PACKET_FILE_SIZE;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "s:i:bqh"))) {
+        switch(opt) {
+            case 's':
+                if(0 == strcmp(optarg, "none")) {
+                    config.sync = LogWriterDecls::NONE;
+                } else if(0 == strcmp(optarg, "periodic")) {
+                    config.sync = LogWriterDecls::PERIODIC;
+                } else if(0 == strcmp(optarg, "group")) {
+                    config.sync = LogWriterDecls::GROUP;
+                } else {
+                    usage();
+                }
+                break;
+            case 'i':
+                config.sync_ms = atoi(optarg);
+                if(config.sync_ms <= 0) {
+                    usage();
+                }
+                break;
+            case 'b':
+                config.direct = false;
+                break;
+            case 'q':
+                msg_echo = false;
+                break;
+            default:
+                usage();
+        }
+    }
+
     const char* curr_time = time_util::to_string(time_util::now());
 
     char* gsw_home = getenv("GSW_HOME");
@@ -530,7 +1355,7 @@ int main() {
         close(pkt_pipes[0]);
 
         // TODO have packet reporting rate passed in as a parameter
-        log_packets(packets_path.c_str(), 1);
+        log_packets(packets_path.c_str(), 1, config);
 
         // should never get here
         printf("Packet logger process returned unexpectedly!\n");
@@ -0,0 +1,38 @@
+/******************************************************************************
+*  Name: Crc.h
+*
+*  Purpose: CRC32C (Castagnoli) checksums
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// uses the SSE4.2 crc32 instruction when the processor has it, otherwise a
+// lookup table
+
+namespace crc {
+    /// @brief compute the CRC32C of data
+    /// @param data     the data
+    /// @param len      the length of the data in bytes
+    /// @param crc      the CRC of the data before this, to checksum data in
+    ///                 pieces
+    /// @return the CRC
+    uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+
+    /// @brief compute the CRC32C of data with the lookup table, even if the
+    ///        processor has the crc32 instruction, gives the same result as
+    ///        'crc32c'
+    /// @param data     the data
+    /// @param len      the length of the data in bytes
+    /// @param crc      the CRC of the data before this
+    /// @return the CRC
+    uint32_t crc32c_table(const void* data, size_t len, uint32_t crc = 0);
+};
+
+#endif
@@ -0,0 +1,160 @@
+/******************************************************************************
+*  Name: LogLevels.h
+*
+*  Purpose: Table of system message log levels in shared memory, one per
+*           logger tag, that can be changed while processes are running
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef LOG_LEVELS_H
+#define LOG_LEVELS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "common/types.h"
+#include "lib/sync/Mutex.h"
+
+// every message logger registers its "class::func" tag in the table when it's
+// constructed and keeps a pointer to the level of its entry, so checking if a
+// message should be sent is a single relaxed load
+//
+// a message is sent if its type is at least the level of its tag, setting a
+// level of MessageLoggerDecls::NUM_MESSAGE_T turns a tag off
+//
+// levels can also be set for a whole class with a tag of just "class", which
+// applies to every "class::func" entry of the class, including ones
+// registered later, and "*" sets the level of every entry and the default
+//
+// the table is created by the first process to use it and never removed,
+// if it can't be created every message is sent
+//
+// entries are never removed either, a tag stays in the table after every
+// process using it exits, so the table only ever holds the first MAX_TAGS
+// tags seen since it was created, later tags get the default level
+//
+// the lock is only held while adding entries or setting levels, a process
+// waiting on it for more than LOCK_WAIT_MS takes it over if the process
+// holding it died, otherwise it gives up, and a new logger sends everything
+
+// Log level type and data declarations
+namespace LogLevelDecls {
+    /// @brief the name of the shared memory block
+    static const char* const SHM_NAME = "/gsw_log_levels";
+
+    /// the number of entries in the table
+    static const size_t MAX_TAGS = 512;
+
+    /// the longest tag, including the NULL terminator
+    static const size_t MAX_TAG = 64;
+
+    /// the tag that sets every level
+    static const char* const ALL_TAGS = "*";
+
+    /// written once the table is initialized
+    static const uint32_t MAGIC = 0x474C5632;
+
+    /// how long to wait for the table lock before checking its holder
+    static const int LOCK_WAIT_MS = 100;
+
+    /// @brief an entry in the table
+    typedef struct {
+        char tag[MAX_TAG];
+        uint32_t level;
+        uint32_t unused;
+    } entry_t;
+
+    /// @brief the shared memory block
+    typedef struct {
+        uint32_t magic;
+        uint32_t default_level;     // level of tags with no class entry
+        uint32_t count;             // number of entries in use
+        Mutex lock;                 // held while adding entries
+        pid_t owner;                // process holding the lock, or 0
+        entry_t entries[MAX_TAGS];
+    } table_t;
+};
+
+class LogLevels {
+public:
+    /// @brief constructor
+    LogLevels();
+
+    /// @brief destructor
+    virtual ~LogLevels();
+
+    /// @brief attach to the table, creating it if it doesn't exist
+    /// @return
+    RetType attach();
+
+    /// @brief detach from the table
+    /// @return
+    RetType detach();
+
+    /// @brief get the level of a logger, registering its tag
+    /// @param class_name   the name of the class the logger is in
+    /// @param func_name    the name of the function the logger is in
+    /// @return the level word to load, never NULL
+    uint32_t* level(const char* class_name, const char* func_name);
+
+    /// @brief check if a level word returned by 'level' will always be the
+    ///        tag's level, rather than a fallback because the table couldn't
+    ///        be locked or attached to
+    /// @param level    the level word
+    /// @return true if the level word is in the table
+    bool registered(const uint32_t* level);
+
+    /// @brief set the level of a tag
+    /// @param tag      "class::func", "class", or ALL_TAGS
+    /// @param level    the level
+    /// @return FAILURE if not attached or the table is full
+    RetType set(const char* tag, uint32_t level);
+
+    /// @brief get the number of entries in the table, 0 if not attached
+    size_t count();
+
+    /// @brief get an entry in the table
+    /// @param index    the entry index
+    /// @return the entry or NULL if out of range
+    const LogLevelDecls::entry_t* entry(size_t index);
+
+    /// @brief get the level of tags with no class entry
+    uint32_t default_level();
+
+    /// @brief get the table shared by every logger in the process
+    /// @return the table, attached if possible
+    static LogLevels* shared();
+
+private:
+    /// @brief lock the table, taking the lock over if its holder died
+    /// @return FAILURE if the lock is held by a live process for longer
+    ///         than LOCK_WAIT_MS
+    RetType lock();
+
+    /// @brief unlock the table
+    void unlock();
+
+    /// @brief find an entry
+    /// NOTE: entries are only ever added, so it's safe to search without the
+    ///       lock as long as the count is loaded first
+    /// @param tag  the tag
+    /// @return the entry or NULL if there isn't one
+    LogLevelDecls::entry_t* find(const char* tag);
+
+    /// @brief add an entry
+    /// NOTE: the table lock must be held
+    /// @param tag      the tag
+    /// @param level    the initial level
+    /// @return the entry or NULL if the table is full
+    LogLevelDecls::entry_t* add(const char* tag, uint32_t level);
+
+    LogLevelDecls::table_t* m_table;
+
+    // level used when the table isn't available, sends everything
+    uint32_t m_fallback;
+};
+
+#endif
@@ -0,0 +1,202 @@
+/******************************************************************************
+*  Name: LogRing.h
+*
+*  Purpose: Multi-producer single-consumer ring of log records in shared
+*           memory, written by loggers and drained by the logging daemon
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+#include <string>
+
+#include "common/types.h"
+#include "lib/sync/Event.h"
+
+// the ring is a fixed number of fixed size slots, each with a sequence number
+// that says who owns it (Vyukov's bounded queue)
+//  - a slot with sequence number 'pos' is free for the producer that claims
+//    ticket 'pos' by incrementing the head
+//  - the producer copies its record in and sets the sequence number to 'pos + 1'
+//  - the consumer reads the record and sets it to 'pos + slots', freeing it
+//    for the producer that claims the same slot on the next lap
+//
+// producers never block and never make a system call (unless the consumer is
+// asleep), they give up and count the record as dropped if the ring is full or
+// they lose the race for the head MAX_RETRIES times in a row
+//
+// a producer that claims a slot and doesn't publish it within STALL_MS is
+// skipped so it can't stall the ring, and its record is counted as dropped
+//  - the slot is marked ABANDONED instead of free, so no producer claims it
+//    while the slow producer may still be copying into it
+//  - the slow producer sees the mark when it tries to publish and frees the
+//    slot for the next lap itself
+//  - if it never does because it died, the consumer frees the slot once it's
+//    been abandoned for RECLAIM_MS, producers see the ring full until then
+//
+// NOTE: uses its own mapping instead of PosixShm since PosixShm reports errors
+//       with a MessageLogger, which may be logging through this ring
+
+// Log ring type and data declarations
+namespace LogRingDecls {
+    /// @brief the name prefix of ring shared memory blocks, followed by the
+    ///        logger address file
+    static const char* const NAME_PREFIX = "/gsw_log_";
+
+    /// size of a slot, enough for the largest log message and its header
+    static const size_t SLOT_SIZE = 4224;
+
+    /// the default number of slots in a ring, must be a power of 2
+    static const size_t DEFAULT_SLOTS = 1024;
+
+    /// the number of times a producer tries to claim a slot before giving up
+    static const uint32_t MAX_RETRIES = 16;
+
+    /// how long a claimed slot can go unpublished before the consumer assumes
+    /// the producer died and skips it, in milliseconds
+    static const uint32_t STALL_MS = 100;
+
+    /// how long a skipped slot stays abandoned before the consumer assumes
+    /// the producer died and frees it, in milliseconds
+    static const uint32_t RECLAIM_MS = 10000;
+
+    /// set in the sequence number of an abandoned slot, along with the
+    /// ticket of the producer that claimed it
+    static const uint64_t ABANDONED = 1ULL << 63;
+
+    /// written last when the ring is created, so producers never attach to a
+    /// partially initialized ring
+    static const uint32_t MAGIC = 0x474c5247;
+
+    /// @brief a slot holding one record
+    typedef struct {
+        uint64_t seq;       // sequence number, see above
+        uint32_t len;       // length of the record in bytes
+        uint32_t unused;
+        uint8_t data[SLOT_SIZE - 16];
+    } slot_t;
+
+    /// largest record that fits in a slot
+    static const size_t MAX_RECORD = sizeof(((slot_t*)0)->data);
+
+    /// @brief header placed at the start of the shared memory block
+    // NOTE: producer and consumer indices are on separate cache lines
+    typedef struct {
+        uint32_t magic;
+        uint32_t closed;                // set when the consumer destroys the ring
+        uint64_t slots;                 // number of slots
+        Event update;                   // signaled when a record is published
+        alignas(64) uint64_t head;      // next ticket for producers to claim
+        alignas(64) uint64_t tail;      // next ticket the consumer reads
+        alignas(64) uint64_t dropped;   // records dropped (full, contended, or stalled)
+        uint64_t oversize;              // records too large for a slot
+    } header_t;
+
+    /// offset of the first slot from the start of the block
+    static const size_t HEADER_SIZE = 256;
+
+    static_assert(sizeof(header_t) <= HEADER_SIZE, "log ring header too large");
+};
+
+class LogRing {
+public:
+    /// @brief constructor
+    /// @param filename     the logger address file the ring is for
+    LogRing(const char* filename);
+
+    /// @brief destructor
+    virtual ~LogRing();
+
+    /// @brief create and attach to the ring, replacing any existing ring
+    ///        should only be called by the consumer
+    /// @param slots    the number of slots, must be a power of 2
+    /// @return
+    RetType create(size_t slots = LogRingDecls::DEFAULT_SLOTS);
+
+    /// @brief attach to a ring created by the consumer
+    /// @return
+    RetType attach();
+
+    /// @brief detach from the ring
+    /// @return
+    RetType detach();
+
+    /// @brief close and remove the ring, producers still attached see it closed
+    ///        should only be called by the consumer
+    /// @return
+    RetType destroy();
+
+    /// @brief write a record to the ring, never blocks
+    /// @param vec      list of vectors making up the record
+    /// @param len      number of vectors in vec
+    /// @param count    false to leave counting a rejected record as dropped
+    ///                 up to the caller, e.g. if it has somewhere else to send it
+    /// @return FAILURE if the record was dropped
+    RetType write(const struct iovec* vec, size_t len, bool count = true);
+
+    /// @brief get the oldest record in the ring without removing it
+    ///        should only be called by the consumer
+    /// @param len  filled with the length of the record
+    /// @return the record or NULL if there is none
+    const uint8_t* peek(size_t* len);
+
+    /// @brief remove the record returned by 'peek'
+    void pop();
+
+    /// @brief wait for a record to be published
+    /// @param seq          the update sequence number read before the ring
+    ///                     was last found empty
+    /// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+    ///                     block forever
+    /// @return SUCCESS if a record may be available, FAILURE on timeout
+    RetType wait(uint32_t seq, int timeout_ms = -1);
+
+    /// @brief get the update event sequence number
+    uint32_t sequence();
+
+    /// @brief check if the consumer has closed the ring
+    /// @return true if closed or not attached
+    bool closed();
+
+    /// @brief get the number of records dropped
+    uint64_t dropped();
+
+    /// @brief get the number of records waiting to be consumed
+    uint64_t depth();
+
+private:
+    /// @brief get the slot for a ticket
+    LogRingDecls::slot_t* slot(uint64_t pos) {
+        return (LogRingDecls::slot_t*)(m_data + LogRingDecls::HEADER_SIZE) + (pos & m_mask);
+    }
+
+    /// @brief check if the slot at the tail has been stuck for long enough,
+    ///        starting the clock the first time it's found stuck
+    /// @param limit_ms     how long is long enough in milliseconds
+    /// @return true if stuck for at least 'limit_ms'
+    bool stalled(uint64_t limit_ms);
+
+    /// @brief map the ring
+    /// @param fd   the open shared memory block
+    /// @return
+    RetType map(int fd);
+
+    std::string m_name;
+
+    uint8_t* m_data;
+    LogRingDecls::header_t* m_hdr;
+    size_t m_size;
+    uint64_t m_mask;
+
+    // consumer state
+    uint64_t m_tail;
+    uint64_t m_stall;
+};
+
+#endif
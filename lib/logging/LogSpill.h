@@ -0,0 +1,85 @@
+/******************************************************************************
+*  Name: LogSpill.h
+*
+*  Purpose: Bounded FIFO of log messages held in private memory while the
+*           logging daemon's socket is full
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef LOG_SPILL_H
+#define LOG_SPILL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+
+#include "common/types.h"
+
+// messages are copied into one preallocated buffer back to back, each after
+// a length, so spilling never allocates
+//
+// a message that doesn't fit before the end of the buffer is placed at the
+// start instead, with a marker saying the rest of the end is unused
+//
+// NOTE: not thread safe, the caller locks around it
+
+// Log spill type and data declarations
+namespace LogSpillDecls {
+    /// @brief header placed before each message
+    typedef struct {
+        uint32_t len;       // length of the message in bytes, or WRAP
+        uint32_t unused;
+    } header_t;
+
+    /// length marking the rest of the buffer as unused
+    static const uint32_t WRAP = 0xFFFFFFFF;
+
+    /// messages start on a multiple of this
+    static const size_t ALIGN = sizeof(header_t);
+};
+
+class LogSpill {
+public:
+    /// @brief constructor
+    /// @param size     the size of the buffer in bytes, rounded up to a
+    ///                 multiple of LogSpillDecls::ALIGN
+    LogSpill(size_t size);
+
+    /// @brief destructor
+    virtual ~LogSpill();
+
+    /// @brief copy a message to the back of the spill
+    /// @param vec  list of vectors making up the message
+    /// @param len  number of vectors in vec
+    /// @return FAILURE if there isn't room for the message
+    RetType push(const struct iovec* vec, size_t len);
+
+    /// @brief get the oldest message without removing it
+    /// @param len  filled with the length of the message
+    /// @return the message or NULL if the spill is empty
+    const uint8_t* peek(size_t* len);
+
+    /// @brief remove the message returned by 'peek'
+    void pop();
+
+    /// @brief check if the spill has no messages
+    bool empty();
+
+    /// @brief get the number of messages in the spill
+    size_t count();
+
+private:
+    uint8_t* m_buff;
+    size_t m_size;
+
+    // bytes ever written and read, the offset into the buffer is these
+    // modulo the size
+    uint64_t m_head;
+    uint64_t m_tail;
+
+    size_t m_count;
+};
+
+#endif
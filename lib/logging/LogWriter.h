@@ -0,0 +1,199 @@
+/******************************************************************************
+*  Name: LogWriter.h
+*
+*  Purpose: Writes a stream of log records to a series of files through large
+*           aligned buffers handed off to a writer thread
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <string>
+
+#include "common/types.h"
+#include "lib/sync/Mutex.h"
+#include "lib/sync/CondVar.h"
+
+// records are copied into one of two buffers, when a buffer fills (or has
+// been sitting for 'flush_ms') it's handed to the writer thread and records go
+// into the other one, so a record is only ever a memcpy for the caller
+//
+// files are opened with O_DIRECT when the file system supports it, which
+// needs every write to be a whole number of aligned blocks, so a partially
+// filled buffer is written padded out to a block and its last partial block is
+// carried over to the start of the next buffer and written again
+// files are preallocated and truncated to the length of their records on close
+//
+// records are never split across files, a file is rotated before a record
+// that would take it past 'file_size', every file starts with the header set
+// by 'set_header' (if any)
+
+// Log writer type and data declarations
+namespace LogWriterDecls {
+    /// @brief durability policy
+    typedef enum {
+        NONE = 0,       // leave it to the kernel
+        PERIODIC,       // sync at most every 'sync_ms' milliseconds
+        GROUP           // sync after every buffer is written, so every record
+                        // in the buffer is committed together
+    } sync_t;
+
+    /// maps durability policies to strings
+    extern const char* sync_str[];
+
+    /// size of each of the two buffers
+    static const size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+    /// alignment of buffers, file offsets, and write lengths for direct I/O
+    static const size_t ALIGNMENT = 4096;
+
+    /// @brief writer configuration
+    typedef struct {
+        size_t file_size;   // maximum size of a file in bytes
+        sync_t sync;        // durability policy
+        int sync_ms;        // sync interval for PERIODIC
+        int flush_ms;       // longest a record waits in a buffer before it's written
+        bool direct;        // try to open files with O_DIRECT
+    } config_t;
+
+    /// @brief where a record was written
+    typedef struct {
+        size_t file;        // index of the file
+        uint64_t offset;    // offset of the record in the file
+    } position_t;
+
+    /// the default configuration
+    static const config_t DEFAULT_CONFIG = {
+        (size_t)1 << 30,    // file_size
+        PERIODIC,           // sync
+        1000,               // sync_ms
+        100,                // flush_ms
+        true                // direct
+    };
+};
+
+class LogWriter {
+public:
+    /// @brief constructor
+    /// @param dir      the directory to write files to
+    /// @param prefix   files are named '<prefix><index><suffix>'
+    /// @param suffix
+    /// @param config   writer configuration
+    LogWriter(const char* dir, const char* prefix, const char* suffix,
+              LogWriterDecls::config_t config = LogWriterDecls::DEFAULT_CONFIG);
+
+    /// @brief destructor, closes the writer if open
+    virtual ~LogWriter();
+
+    /// @brief set the header written at the start of every file
+    /// NOTE: must be called before 'open'
+    /// @param header   the header
+    /// @param len      the length of the header in bytes
+    /// @return FAILURE if the header doesn't fit in a buffer
+    RetType set_header(const uint8_t* header, size_t len);
+
+    /// @brief open the first file and start the writer thread
+    /// @return
+    RetType open();
+
+    /// @brief write a record
+    /// @param data     the record
+    /// @param len      the length of the record in bytes
+    /// @return FAILURE if the record is larger than a file or a write failed
+    RetType write(const uint8_t* data, size_t len);
+
+    /// @brief write a record gathered from several buffers
+    /// @param iov      the buffers
+    /// @param iovcnt   the number of buffers
+    /// @param pos      filled with where the record was written, or NULL
+    /// @return FAILURE if the record is larger than a file or a write failed
+    RetType write(const struct iovec* iov, int iovcnt, LogWriterDecls::position_t* pos = NULL);
+
+    /// @brief hand everything written so far to the writer thread
+    /// @return
+    RetType flush();
+
+    /// @brief write everything out, stop the writer thread, and close the file
+    /// @return
+    RetType close();
+
+    /// @brief get the total number of bytes written
+    uint64_t written();
+
+    /// @brief check if files are being written with direct I/O
+    /// @return true if the current file was opened with O_DIRECT
+    bool direct() { return m_direct; }
+
+private:
+    /// @brief writer thread entry point
+    static void* writer_thread(void* arg);
+
+    /// @brief write buffers handed off until closed
+    void run();
+
+    /// @brief copy data into the current buffer, handing off full buffers
+    /// NOTE: m_lock must be held
+    /// @param data     the data
+    /// @param len      the length of the data in bytes
+    void copy(const uint8_t* data, size_t len);
+
+    /// @brief hand the current buffer to the writer thread
+    /// NOTE: m_lock must be held
+    void submit();
+
+    /// @brief wait for the writer thread to finish the buffer handed to it
+    /// NOTE: m_lock must be held
+    void wait_idle();
+
+    /// @brief open the next file
+    /// NOTE: m_lock must be held and the writer thread idle
+    /// @return
+    RetType open_file();
+
+    /// @brief write out the current buffer and close the file
+    /// NOTE: m_lock must be held
+    /// @return
+    RetType close_file();
+
+    std::string m_dir;
+    std::string m_prefix;
+    std::string m_suffix;
+    LogWriterDecls::config_t m_config;
+    std::string m_header;
+
+    int m_fd;
+    bool m_direct;
+    size_t m_index;
+
+    uint8_t* m_buffs[2];
+
+    // buffer being filled
+    int m_curr;
+    size_t m_fill;          // bytes in the current buffer
+    uint64_t m_buffOffset;  // file offset of the start of the current buffer
+    uint64_t m_fileSize;    // bytes of records in the current file
+    uint64_t m_total;       // bytes of records in every file
+    bool m_dirty;           // records were written since the last hand off
+
+    // buffer handed to the writer thread, -1 if none
+    int m_pending;
+    size_t m_pendingLen;
+    uint64_t m_pendingOffset;
+    RetType m_status;       // result of the last write
+
+    bool m_running;
+    bool m_stop;
+    pthread_t m_thread;
+
+    Mutex m_lock;
+    CondVar m_cond;
+};
+
+#endif
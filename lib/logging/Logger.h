@@ -15,8 +15,13 @@
 #include <stdint.h>
 #include <sys/un.h>
 #include <sys/uio.h>
+#include <string>
 
 #include "common/types.h"
+#include "lib/logging/LogRing.h"
+#include "lib/sync/Mutex.h"
+
+class LogSpill;
 
 
 // a logger opens a UNIX socket based on a filename for the logging type
@@ -24,16 +29,82 @@
 // logging messages are sent as packets over a UNIX socket, the logging daemon
 // should listen on the other side and log the message to disk (if running)
 
+// every logger in a process sending to the same address shares one socket,
+// opened the first time a logger for the address is constructed and never
+// closed, so a logger is just a handle and cheap to construct and destroy
+
+// sending to the socket blocks while the daemon's queue is full, an endpoint
+// can be made non-blocking instead (see Logger::set_nonblocking), messages
+// that don't fit are then held in a bounded spill and sent ahead of the next
+// message once there's room, or dropped if the spill is full too
+//
+// nothing is sent from the spill unless a logger sends or the owner of the
+// process calls Logger::drain, so a process that may stop logging for a while
+// should drain while Logger::spilling, and drain with 'discard' set before
+// exiting so whatever can't be sent is counted as dropped
+//
+// every message that couldn't be sent (including when the daemon isn't
+// running) is counted in the "Logger.<filename>.dropped" stat, and every
+// spilled message in "Logger.<filename>.spilled"
+
+// alternatively messages can be written to a shared memory ring the logging
+// daemon drains (see LogRing.h), which never blocks and costs no system calls
+// but drops messages if the daemon falls behind
+
+// Logger type and data declarations
+namespace LoggerDecls {
+    /// @brief how messages get to the logging daemon
+    typedef enum {
+        SOCKET = 0,     // UNIX datagram socket, blocks if the daemon falls
+                        // behind unless made non-blocking
+        RING            // shared memory ring, falls back to the socket if the
+                        // daemon hasn't created the ring
+    } transport_t;
+
+    /// @brief environment variable selecting the default transport,
+    ///        "ring" for RING, anything else for SOCKET
+    static const char* const TRANSPORT_ENV = "GSW_LOG_TRANSPORT";
+
+    /// @brief socket send buffer size requested by loggers and receive buffer
+    ///        size requested by the logging daemon, the kernel caps these at
+    ///        net.core.wmem_max and net.core.rmem_max
+    // NOTE: the daemon's queue is also limited to net.unix.max_dgram_qlen
+    //       datagrams, regardless of the buffer sizes
+    static const int SOCKET_BUFFER_SIZE = 4 * 1024 * 1024;
+
+    /// @brief default size of the spill of a non-blocking endpoint in bytes
+    static const size_t DEFAULT_SPILL_SIZE = 1024 * 1024;
+
+    /// @brief a socket and the address it sends to, shared by every logger in
+    ///        the process with the same filename
+    typedef struct {
+        std::string filename;
+        int sd;
+        struct sockaddr_un addr;
+        bool nonblocking;       // send with MSG_DONTWAIT
+        bool spilling;          // the spill has messages, read without the lock
+        LogSpill* spill;        // messages waiting for room in the socket,
+                                // NULL if they're dropped instead
+        uint64_t dropped;       // messages that couldn't be sent
+        Mutex lock;             // protects the spill
+    } endpoint_t;
+};
+
 class Logger {
 public:
     /// the maximum number of bytes that can be sent in a log message
     /// NOTE: cannot exceed the UNIX domain socket MTU
     static const size_t MAX_LOG_SIZE = 4096;
 
-    /// @brief constructor
+    /// @brief constructor, uses the transport selected by TRANSPORT_ENV
     /// @param filename     a unique filename bound to logging messages
     Logger(const char* filename);
 
+    /// @brief constructor
+    /// @param filename     a unique filename bound to logging messages
+    /// @param transport    how to send messages to the logging daemon
+    Logger(const char* filename, LoggerDecls::transport_t transport);
+
     /// @brief destructor
     virtual ~Logger();
 
@@ -52,21 +123,77 @@ public:
     /// @param vec  list of vectors
     /// @param len  number of vectors in vec
     /// @return
+    /// NOTE: the time taken is recorded in the "Logger::log_vec" stat
     RetType log_vec(struct iovec* vec, size_t len);
 
+    /// @brief log a batch of messages with one system call
+    /// @param msgs     list of messages, only the I/O vectors need to be set
+    /// @param len      number of messages in msgs
+    /// @return
+    RetType log_batch(struct mmsghdr* msgs, size_t len);
+
+    /// @brief get the transport messages are sent with
+    /// @return RING if messages are written to a ring, otherwise SOCKET
+    LoggerDecls::transport_t transport();
+
+    /// @brief get the number of messages every logger in the process with the
+    ///        same filename couldn't send over the socket
+    /// @return the count, 0 if not using the socket
+    uint64_t dropped();
+
+    /// @brief never block sending over the socket with every logger in the
+    ///        process using a filename, messages are held in a spill while
+    ///        the socket is full and dropped if the spill is full too
+    /// @param filename     the logger address file
+    /// @param spill_size   size of the spill in bytes, 0 to drop messages as
+    ///                     soon as the socket is full, the spill is kept if
+    ///                     this was already called for 'filename'
+    /// @return FAILURE if the socket couldn't be opened
+    static RetType set_nonblocking(const char* filename,
+                                   size_t spill_size = LoggerDecls::DEFAULT_SPILL_SIZE);
+
+    /// @brief send messages spilled by every logger in the process
+    /// @param timeout_ms   how long to keep trying while the sockets are full,
+    ///                     0 to only send what fits now
+    /// @param discard      drop whatever is still spilled after 'timeout_ms',
+    ///                     counting it as dropped
+    /// @return FAILURE if messages are still spilled or were discarded
+    static RetType drain(int timeout_ms = 0, bool discard = false);
+
+    /// @brief check if any logger in the process has spilled messages
+    /// @return true if there are messages to drain
+    static bool spilling();
+
 
 private:
+    /// @brief send a message to the ring or socket
+    /// @param vec  list of vectors
+    /// @param len  number of vectors in vec
+    /// @return
+    RetType send_vec(struct iovec* vec, size_t len);
+
+    /// @brief write a message to the ring, reattaching if the daemon restarted
+    /// @param vec  list of vectors
+    /// @param len  number of vectors in vec
+    /// @return
+    RetType write_ring(const struct iovec* vec, size_t len);
+
     // filename corresponding to logging messages of this type
     const char* m_filename;
 
-    // socket descriptor
-    int m_sd;
-
-    // address to send logging messages to
-    struct sockaddr_un m_addr;
+    // shared socket and address to send logging messages to, NULL if the
+    // socket couldn't be opened
+    LoggerDecls::endpoint_t* m_endpoint;
 
     // message header to send messages to
     struct msghdr m_msg;
+
+    // requested transport
+    LoggerDecls::transport_t m_transport;
+
+    // ring shared by every logger in the process with the same filename,
+    // NULL if using the socket
+    LogRing* m_ring;
 };
 
 #endif
@@ -0,0 +1,77 @@
+/******************************************************************************
+*  Name: MessageLog.h
+*
+*  Purpose: Binary format of system message log files
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef MESSAGE_LOG_H
+#define MESSAGE_LOG_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// the logging daemon writes system messages exactly as they're received,
+// nothing is formatted until the log is read (e.g. with gsw_logcat)
+//
+// a message log file is a file_header_t followed by records, each record is a
+// record_t followed by 'len' bytes of payload
+//
+// messages are sent as "(class::func) message", the part in parentheses is
+// the source of the message, each source is given an id the first time it
+// shows up in a file by a SOURCE record with the source name as the payload,
+// MESSAGE records refer to it by id and only carry the rest of the message
+// ids start over in every file, so every file can be read on its own
+//
+// files are rotated by size, a record is never split across files
+
+// Message log type and data declarations
+namespace MessageLogDecls {
+    /// the start of every message log file
+    static const uint32_t MAGIC = 0x474D5347;
+
+    /// format version, increment on any change to this file
+    static const uint16_t VERSION = 1;
+
+    /// the file name extension of message logs
+    static const char* const SUFFIX = ".bin";
+
+    /// the most bytes in a file before the daemon rotates to a new one
+    static const size_t MAX_FILE_SIZE = 64 * 1024 * 1024;
+
+    /// id of messages with no source, or more sources than fit in a file
+    /// the message is logged with its source still in it
+    static const uint16_t NO_SOURCE = 0;
+
+    /// the largest source id
+    static const uint16_t MAX_SOURCE = 0xFFFF;
+
+    /// the longest source name, anything longer isn't treated as a source
+    static const size_t MAX_SOURCE_NAME = 256;
+
+    /// @brief kinds of records
+    typedef enum {
+        MESSAGE = 0,    // a system message
+        SOURCE          // defines a source id
+    } record_type_t;
+
+    /// @brief written at the start of every file
+    typedef struct {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t unused;
+    } file_header_t;
+
+    /// @brief written before the payload of every record
+    typedef struct {
+        uint8_t type;           // record_type_t
+        uint8_t severity;       // MessageLoggerDecls::message_t, MESSAGE only
+        uint16_t source;        // source id
+        uint32_t len;           // bytes of payload following the record
+        uint64_t timestamp;     // nanoseconds since the epoch, MESSAGE only
+    } record_t;
+};
+
+#endif
@@ -15,6 +15,24 @@
 #include <sys/uio.h>
 
 #include "lib/logging/Logger.h"
+#include "lib/logging/LogLevels.h"
+#include "lib/time/time.h"
+
+// messages of a type below GSW_LOG_MIN_LEVEL are compiled out of GSW_LOG,
+// log and log_message, e.g. build with CXXFLAGS=-DGSW_LOG_MIN_LEVEL=1 to drop
+// INFO messages
+#ifndef GSW_LOG_MIN_LEVEL
+#define GSW_LOG_MIN_LEVEL 0
+#endif
+
+/// @brief log a formatted message with a MessageLogger, the arguments are
+///        only evaluated if the level of the logger's tag lets it through
+#define GSW_LOG(logger, type, ...) \
+    do { \
+        if((int)(type) >= GSW_LOG_MIN_LEVEL && (logger).enabled(type)) { \
+            (logger).log((type), __VA_ARGS__); \
+        } \
+    } while(0)
 
 
 // Message Logger type and data declarations
@@ -32,41 +50,145 @@ namespace MessageLoggerDecls {
 
     /// @brief data prepended to log messages
     typedef struct {
-        double timestamp;
+        time_util::timestamp_t timestamp;  // nanoseconds since the epoch
         message_t type;
     } info_t;
 
-    /// @brief the file path to use for addressing (relative to GSW_HOME)
-    static const char* ADDRESS_FILE = "message_log_socket";
+    /// @brief the file path to use for addressing (relative to GSW_HOME),
+    ///        also the lane INFO messages are sent to
+    static const char* const ADDRESS_FILE = "message_log_socket";
+
+    /// @brief the file paths of the lanes messages of each type are sent to
+    ///        (relative to GSW_HOME)
+    static const char* const LANE_FILE[NUM_MESSAGE_T] = {
+        "message_log_socket",
+        "message_warn_log_socket",
+        "message_crit_log_socket"
+    };
+
+    /// @brief the longest "(class::func) " prefix, longer names are cut short
+    static const size_t MAX_PREFIX = 128;
 };
 
+// messages are sent as the info_t, the "(class::func) " prefix built when the
+// logger is constructed, and the message, each from where it already is so
+// logging a message never allocates memory
+//
+// messages below the level of the logger's tag (see LogLevels.h) are dropped
+// before they're formatted
+//
+// each thread remembers the level and prefix of the last loggers it
+// constructed by the address of their names, so constructing a logger at the
+// same call site again doesn't search the level table or format the prefix
+//
+// each type of message has its own lane to the logging daemon, which empties
+// the CRIT lane before taking from WARN and WARN before INFO, and sheds INFO
+// messages when it falls behind, so a flood of INFO never delays a CRIT
+//
+// the logger itself is the INFO lane, WARN and CRIT are sent through loggers
+// shared by every MessageLogger in the thread, opened the first time the
+// thread sends one, so constructing a MessageLogger costs one endpoint lookup
+//
+// only INFO messages use the ring transport, the ring is one queue so WARN
+// and CRIT always take their own socket, so with GSW_LOG_TRANSPORT=ring a
+// process's messages are split between the ring and two sockets
+// NOTE: the daemon drains the ring on its own thread alongside the sockets,
+//       so INFO messages from the ring aren't held behind WARN and CRIT and
+//       messages from different lanes may be logged out of order, the
+//       timestamps still say which came first
+
 
 class MessageLogger : public Logger {
 public:
     /// @brief constructor
     /// @param class_name  the name of the class the logger is in
     /// @param func_name   the name of the function the logger is in
-    MessageLogger(std::string class_name, std::string func_name);
+    MessageLogger(const char* class_name, const char* func_name);
 
     /// @brief constructor
     /// @param func_name    the name of the function the logger is in
-    MessageLogger(std::string func_name);
+    MessageLogger(const char* func_name);
 
     /// @brief log a message
     /// @param msg   the message to log
     /// @param type  the type of message to log
     /// @return
-    RetType log_message(std::string msg,
-             MessageLoggerDecls::message_t type = MessageLoggerDecls::INFO);
+    /// NOTE: inlined into the caller, so a constant 'type' below
+    ///       GSW_LOG_MIN_LEVEL compiles the call out
+    __attribute__((always_inline))
+    RetType log_message(const std::string& msg,
+             MessageLoggerDecls::message_t type = MessageLoggerDecls::INFO) {
+        if(!wanted(type)) {
+            return SUCCESS;
+        }
+
+        return send(msg.c_str(), msg.size(), type);
+    }
+
+    /// @brief log a formatted message, rendered on the stack
+    /// @param type  the type of message to log
+    /// @param fmt   printf style format, checked against the arguments at
+    ///              compile time
+    /// @return
+    /// NOTE: messages longer than Logger::MAX_LOG_SIZE are truncated
+    /// NOTE: inlined into the caller like log_message, only the formatting
+    ///       is out of line
+    __attribute__((always_inline, format(printf, 3, 4)))
+    RetType log(MessageLoggerDecls::message_t type, const char* fmt, ...) {
+        if(!wanted(type)) {
+            return SUCCESS;
+        }
+
+        return log_format(type, fmt, __builtin_va_arg_pack());
+    }
+
+    // don't hide the raw Logger::log
+    using Logger::log;
+
+    /// @brief check if messages of a type are sent
+    /// @param type  the type of message
+    /// @return true if messages of 'type' are at least the level of this
+    ///         logger's tag
+    bool enabled(MessageLoggerDecls::message_t type) {
+        return (uint32_t)type >= __atomic_load_n(m_level, __ATOMIC_RELAXED);
+    }
 
 private:
-    std::string m_className;
-    std::string m_funcName;
+    /// @brief check if a message is sent, against both GSW_LOG_MIN_LEVEL in
+    ///        the caller's build and the level of this logger's tag
+    /// @param type  the type of message
+    __attribute__((always_inline))
+    bool wanted(MessageLoggerDecls::message_t type) {
+        return (int)type >= GSW_LOG_MIN_LEVEL && enabled(type);
+    }
+
+    /// @brief format a message on the stack and send it
+    /// @param type  the type of message to log
+    /// @param fmt   printf style format
+    /// @return
+    RetType log_format(MessageLoggerDecls::message_t type, const char* fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+
+    /// @brief build the "(class::func) " prefix and find the level of the tag
+    /// @param class_name  the name of the class the logger is in
+    /// @param func_name   the name of the function the logger is in
+    void init_prefix(const char* class_name, const char* func_name);
+
+    /// @brief send a message with the prefix
+    /// @param msg   the message, not including the prefix
+    /// @param len   the length of msg in bytes
+    /// @param type  the type of message
+    /// @return
+    RetType send(const char* msg, size_t len, MessageLoggerDecls::message_t type);
+
+    char m_prefix[MessageLoggerDecls::MAX_PREFIX];
+    size_t m_prefixLen;
 
-    struct timeval m_time;
+    // level of this logger's tag in the shared level table
+    uint32_t* m_level;
 
     MessageLoggerDecls::info_t m_info;
-    struct iovec m_vecs[2];
+    struct iovec m_vecs[3];
 };
 
 #endif
@@ -0,0 +1,112 @@
+/******************************************************************************
+*  Name: PacketLog.h
+*
+*  Purpose: Binary format of packet log files and their indexes
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef PACKET_LOG_H
+#define PACKET_LOG_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lib/time/time.h"
+
+// a packet log file is a file_header_t followed by records, each record is a
+// record_t followed by 'len' bytes of packet, padded with zeros to a multiple
+// of RECORD_ALIGN bytes so every record_t is aligned
+//
+// every record starts with SYNC and a CRC32C of the rest of the record_t and
+// the packet (not the padding), so a reader that hits a torn or corrupt record
+// can find the next good one by scanning aligned words for SYNC and checking
+// the CRC
+//
+// each packet log file 'packets-N.bin' has an index 'packets-N.idx', an
+// index_header_t followed by index_entry_t's giving the offset of records in
+// the file, in increasing timestamp order, every INDEX_INTERVAL nanoseconds
+// (or INDEX_BYTES bytes) of log, so a time range can be found without reading
+// the whole log
+// records are in the order they were received, which may not be exactly in
+// timestamp order, so an entry only says no record after it is older than it
+
+// Packet log type and data declarations
+namespace PacketLogDecls {
+    /// the start of every packet log file
+    static const uint32_t MAGIC = 0x47504B54;
+
+    /// the start of every packet log index file
+    static const uint32_t INDEX_MAGIC = 0x47504958;
+
+    /// format version, increment on any change to this file
+    static const uint16_t VERSION = 1;
+
+    /// the start of every record (the CCSDS attached sync marker)
+    static const uint32_t SYNC = 0x1ACFFC1D;
+
+    /// packet log file name prefix, files are '<PREFIX><index><SUFFIX>'
+    static const char* const PREFIX = "packets-";
+
+    /// the file name extension of packet logs
+    static const char* const SUFFIX = ".bin";
+
+    /// the file name extension of packet log indexes
+    static const char* const INDEX_SUFFIX = ".idx";
+
+    /// records start at multiples of this many bytes
+    static const size_t RECORD_ALIGN = 8;
+
+    /// the longest time between index entries
+    static const time_util::timestamp_t INDEX_INTERVAL = 100 * time_util::NS_PER_MS;
+
+    /// the most bytes of log between index entries
+    static const uint64_t INDEX_BYTES = 1024 * 1024;
+
+    /// @brief written at the start of every file
+    typedef struct {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t record_size;   // sizeof(record_t)
+        uint64_t unused;
+    } file_header_t;
+
+    /// @brief written before every packet
+    typedef struct {
+        uint32_t sync;                      // SYNC
+        uint32_t crc;                       // CRC32C of the rest of the record
+        time_util::timestamp_t timestamp;   // nanoseconds since the epoch
+        uint32_t len;                       // bytes of packet
+        uint16_t port;                      // destination UDP port
+        uint16_t unused;
+    } record_t;
+
+    /// @brief written at the start of every index file
+    typedef struct {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t unused;
+    } index_header_t;
+
+    /// @brief an index entry
+    typedef struct {
+        time_util::timestamp_t timestamp;   // timestamp of the record
+        uint64_t offset;                    // offset of the record in the file
+    } index_entry_t;
+
+    /// @brief get the bytes a record takes up in a file
+    /// @param len  the length of the packet
+    /// @return the length of the record including padding
+    inline size_t record_size(size_t len) {
+        return (sizeof(record_t) + len + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+    }
+
+    /// @brief compute the CRC of a record
+    /// @param rec      the record, only the fields after 'crc' are used
+    /// @param packet   the packet
+    /// @return the CRC to store in 'rec->crc'
+    uint32_t record_crc(const record_t* rec, const uint8_t* packet);
+};
+
+#endif
@@ -0,0 +1,118 @@
+/******************************************************************************
+*  Name: PacketLogReader.h
+*
+*  Purpose: Reads the packet logs in a directory in order, using their indexes
+*           to seek by time
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef PACKET_LOG_READER_H
+#define PACKET_LOG_READER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "lib/logging/PacketLog.h"
+
+// files are memory mapped as they're reached and stay mapped until the reader
+// is closed, so packets returned by 'next' point straight into the log and
+// stay valid until then
+//
+// corrupt records are skipped, the reader scans forward for the next record
+// with a good CRC
+
+// Packet log reader type and data declarations
+namespace PacketLogReaderDecls {
+    /// @brief a packet read from the log
+    typedef struct {
+        const PacketLogDecls::record_t* rec;
+        const uint8_t* data;    // 'rec->len' bytes
+        size_t file;            // index of the file it's in
+        uint64_t offset;        // offset of the record in the file
+    } packet_t;
+
+    /// @brief a packet log file
+    typedef struct {
+        std::string path;
+        uint64_t size;
+        std::vector<PacketLogDecls::index_entry_t> index;
+    } file_t;
+};
+
+class PacketLogReader {
+public:
+    /// @brief constructor
+    PacketLogReader();
+
+    /// @brief destructor
+    virtual ~PacketLogReader();
+
+    /// @brief open the packet logs in a directory
+    /// @param dir  the directory
+    /// @return FAILURE if there are no packet logs or one isn't a packet log
+    RetType open(const char* dir);
+
+    /// @brief close the logs
+    void close();
+
+    /// @brief get the packet log files, in order
+    const std::vector<PacketLogReaderDecls::file_t>& files() { return m_files; }
+
+    /// @brief move to the first record that could be at or after a time
+    ///        records before it may also be read, they're in receive order
+    /// @param timestamp    nanoseconds since the epoch
+    /// @return
+    RetType seek(time_util::timestamp_t timestamp);
+
+    /// @brief move to a record
+    /// @param file     the file index
+    /// @param offset   the offset of the record in the file
+    /// @return FAILURE if the file doesn't exist
+    RetType seek(size_t file, uint64_t offset);
+
+    /// @brief read the next record
+    /// @param pkt  filled with the packet
+    /// @return FAILURE if there are no more records
+    RetType next(PacketLogReaderDecls::packet_t* pkt);
+
+    /// @brief get the number of bytes skipped because they were corrupt
+    uint64_t corrupt() { return m_corrupt; }
+
+    /// @brief get the number of times the reader had to find the next record
+    uint64_t resyncs() { return m_resyncs; }
+
+private:
+    /// @brief load the index of a file
+    /// @param file     the file
+    /// @param path     the index file path
+    void load_index(PacketLogReaderDecls::file_t* file, const std::string& path);
+
+    /// @brief map a file, if it isn't already
+    /// @param index    the file index
+    /// @return
+    RetType map(size_t index);
+
+    /// @brief unmap every file
+    void unmap();
+
+    std::vector<PacketLogReaderDecls::file_t> m_files;
+
+    size_t m_file;          // index of the current file
+    uint64_t m_offset;      // offset of the next record in the current file
+    uint8_t* m_map;         // the current file, or NULL if not mapped
+    uint64_t m_mapSize;
+
+    // every mapped file, indexed by file index, NULL if not mapped
+    std::vector<uint8_t*> m_maps;
+    std::vector<uint64_t> m_mapSizes;
+
+    uint64_t m_corrupt;
+    uint64_t m_resyncs;
+};
+
+#endif
@@ -16,18 +16,30 @@
 #include <sys/uio.h>
 
 #include "lib/logging/Logger.h"
+#include "lib/logging/LogRing.h"
+#include "lib/time/time.h"
+
+class PacketPool;
 
 // Packet Logger type and data declarations
 namespace PacketLoggerDecls {
     /// @brief the file path to use for addressing (relative to GSW_HOME)
-    static const char* ADDRESS_FILE = "packet_log_socket";
+    static const char* const ADDRESS_FILE = "packet_log_socket";
 
     /// @brief information logged with a packet
     typedef struct {
         uint16_t port;      // destination UDP port in system endianness
-        size_t len;         // length of the packet in bytes
-        double timestamp;   // UNIX timestamp (seconds since the epoch)
+        uint32_t len;       // length of the packet in bytes
+        time_util::timestamp_t timestamp;   // nanoseconds since the epoch
+        uint64_t seq;       // sequence number the packet is traced by, 0 if
+                            // it isn't, see lib/stats/Trace.h
     } info_t;
+
+    /// @brief the maximum number of packets queued before they are logged
+    static const size_t MAX_BATCH = 64;
+
+    /// @brief name of the ring packet pool descriptors are sent through
+    static const char* const POOL_RING = "packet_pool";
 };
 
 class PacketLogger : public Logger {
@@ -35,17 +47,76 @@ public:
     /// @brief constructor
     PacketLogger();
 
+    /// @brief destructor
+    virtual ~PacketLogger();
+
     /// @brief log a packet
     /// @param buff     a buffer containing the packet data
     /// @param len      the length of buff in bytes
     /// @param port     the UDP destination port of the packet, in system
     ///                 endianness
+    /// @param seq      the sequence number to trace the packet by, 0 to not
+    ///                 trace it
+    /// @return
+    RetType log_packet(uint8_t* buff, size_t len, uint16_t port, uint64_t seq = 0);
+
+    /// @brief queue a packet to be logged with the next batch
+    /// @param buff         a buffer containing the packet data, must remain
+    ///                     valid until the batch is flushed
+    /// @param len          the length of buff in bytes
+    /// @param port         the UDP destination port of the packet, in system
+    ///                     endianness
+    /// @param timestamp    the time the packet was received (same units as
+    ///                     time_util::now_ns)
+    /// @param seq          the sequence number to trace the packet by, 0 to
+    ///                     not trace it
+    /// @return
+    /// NOTE: automatically flushes when MAX_BATCH packets are queued
+    RetType queue_packet(uint8_t* buff, size_t len, uint16_t port, time_util::timestamp_t timestamp,
+                         uint64_t seq = 0);
+
+    /// @brief log all queued packets with one system call
     /// @return
-    RetType log_packet(uint8_t* buff, size_t len, uint16_t port);
+    RetType flush();
+
+    /// @brief log packets received into a pool by sending the logging daemon
+    ///        the slot instead of a copy of the packet
+    /// @param pool     the attached pool, must outlive the logger
+    /// @return
+    RetType use_pool(PacketPool* pool);
+
+    /// @brief log a packet held in a pool slot
+    /// @param index        the slot index, the caller must hold it until the
+    ///                     next flush in case the packet has to be copied
+    /// @param len          the length of the packet in bytes, the packet
+    ///                     starts PacketPoolDecls::DATA_OFFSET into the slot
+    /// @param port         the UDP destination port of the packet, in system
+    ///                     endianness
+    /// @param timestamp    the time the packet was received (same units as
+    ///                     time_util::now_ns)
+    /// @param seq          the sequence number to trace the packet by, 0 to
+    ///                     not trace it
+    /// @return
+    /// NOTE: falls back to 'queue_packet' if the logging daemon isn't draining
+    ///       pool descriptors or can't keep up with them
+    RetType queue_slot(uint32_t index, size_t len, uint16_t port, time_util::timestamp_t timestamp,
+                       uint64_t seq = 0);
 
 private:
     PacketLoggerDecls::info_t m_info;
     struct iovec m_vecs[2];
+
+    // queued packets
+    PacketLoggerDecls::info_t m_batchInfo[PacketLoggerDecls::MAX_BATCH];
+    struct iovec m_batchVecs[PacketLoggerDecls::MAX_BATCH][2];
+    struct mmsghdr m_batchMsgs[PacketLoggerDecls::MAX_BATCH];
+    size_t m_batchLen;
+
+    // pool packets are received into, NULL if not using one
+    PacketPool* m_pool;
+
+    // ring descriptors of pool slots are sent to the logging daemon through
+    LogRing m_poolRing;
 };
 
 #endif
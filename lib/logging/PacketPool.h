@@ -0,0 +1,170 @@
+/******************************************************************************
+*  Name: PacketPool.h
+*
+*  Purpose: Pool of packet buffers in shared memory, packets are received
+*           straight into a slot and only the slot index is sent to the
+*           logging daemon, which writes the slot out and releases it
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef PACKET_POOL_H
+#define PACKET_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+#include "common/types.h"
+#include "lib/logging/PacketLogger.h"
+
+// the pool is created by the process receiving packets (e.g. decom), the
+// logging daemon attaches to it the first time it gets a descriptor for it
+//
+// the shared memory block is layed out as follows
+// | header_t | reference words (one per slot) | slot 0 | ... | slot N-1 |
+//
+// each slot holds a PacketLoggerDecls::info_t followed by the packet, exactly
+// what gets written to the packet log, so the daemon writes a slot in one go
+//
+// a slot's reference word has a bit for each holder, it's free when no bits
+// are set and only the creator allocates slots, so a slot can't be reused
+// until both the creator and the logger are done with it
+// holding a bit per holder (instead of a plain count) lets the creator take
+// back every slot a logging daemon was holding if it dies
+
+// Packet pool type and data declarations
+namespace PacketPoolDecls {
+    /// @brief the name prefix of pool shared memory blocks, followed by the
+    ///        name of the pool (e.g. the packet name)
+    static const char* const NAME_PREFIX = "/gsw_pool_";
+
+    /// size of a slot, enough for the largest UDP payload and its packet info
+    static const size_t SLOT_SIZE = 65536;
+
+    /// offset of the packet from the start of a slot
+    static const size_t DATA_OFFSET = sizeof(PacketLoggerDecls::info_t);
+
+    /// the largest packet that fits in a slot
+    static const size_t MAX_PACKET = SLOT_SIZE - DATA_OFFSET;
+
+    /// the default number of slots in a pool
+    static const size_t DEFAULT_SLOTS = 256;
+
+    /// maximum length of a pool name, including the NULL terminator
+    static const size_t MAX_NAME = 48;
+
+    /// offset of the first slot from the start of the block, slots are page
+    /// aligned so they can be written with direct I/O
+    static const size_t PAGE_SIZE = 4096;
+
+    /// written last when the pool is created
+    static const uint32_t MAGIC = 0x47505053;
+
+    /// @brief holders of a slot
+    typedef enum {
+        CREATOR = 0x1,      // the process receiving into the pool
+        LOGGER = 0x2        // the logging daemon
+    } holder_t;
+
+    /// @brief header placed at the start of the shared memory block
+    typedef struct {
+        uint32_t magic;
+        uint32_t slots;     // number of slots
+        uint64_t owner;     // identifies this instance of the pool, a pool
+                            // recreated with the same name gets a new one
+    } header_t;
+
+    /// @brief sent to the logging daemon to log a slot
+    typedef struct {
+        char pool[MAX_NAME];    // name of the pool
+        uint64_t owner;         // instance of the pool
+        uint32_t slot;          // slot index
+        uint32_t len;           // bytes to log, starting from the start of the slot
+    } descriptor_t;
+};
+
+class PacketPool {
+public:
+    /// @brief constructor
+    /// @param name     the name of the pool
+    PacketPool(const char* name);
+
+    /// @brief destructor
+    virtual ~PacketPool();
+
+    /// @brief create and attach to the pool, replacing any existing pool
+    /// @param slots    the number of slots
+    /// @return
+    RetType create(size_t slots = PacketPoolDecls::DEFAULT_SLOTS);
+
+    /// @brief attach to a pool created by another process
+    /// @return
+    RetType attach();
+
+    /// @brief detach from the pool
+    /// @return
+    RetType detach();
+
+    /// @brief remove the pool, processes still attached keep their mapping
+    /// @return
+    RetType destroy();
+
+    /// @brief allocate a free slot, held by CREATOR
+    ///        should only be called by the creator
+    /// @return the slot index or -1 if every slot is in use
+    int32_t alloc();
+
+    /// @brief add a holder to a slot
+    /// @param index    the slot index
+    /// @param who      the holder
+    void hold(uint32_t index, PacketPoolDecls::holder_t who);
+
+    /// @brief remove a holder from a slot, freeing it if it was the last
+    /// @param index    the slot index
+    /// @param who      the holder
+    void release(uint32_t index, PacketPoolDecls::holder_t who);
+
+    /// @brief remove a holder from every slot
+    /// @param who      the holder
+    void release_all(PacketPoolDecls::holder_t who);
+
+    /// @brief get a slot
+    /// @param index    the slot index
+    /// @return the start of the slot or NULL if not attached / out of range
+    uint8_t* slot(uint32_t index);
+
+    /// @brief get the number of slots in use
+    size_t in_use();
+
+    /// @brief get the number of slots in the pool, 0 if not attached
+    size_t slots();
+
+    /// @brief get the instance of the pool, 0 if not attached
+    uint64_t owner();
+
+    /// @brief get the name of the pool
+    const char* name() { return m_name.c_str(); }
+
+private:
+    /// @brief map the pool
+    /// @param fd   the open shared memory block
+    /// @return
+    RetType map(int fd);
+
+    std::string m_name;
+    std::string m_shmName;
+
+    uint8_t* m_data;
+    size_t m_size;
+
+    PacketPoolDecls::header_t* m_hdr;
+    uint32_t* m_refs;
+    uint8_t* m_slots;
+
+    // where the next allocation starts looking
+    uint32_t m_next;
+};
+
+#endif
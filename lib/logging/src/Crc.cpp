@@ -0,0 +1,112 @@
+/******************************************************************************
+*  Name: Crc.cpp
+*
+*  Purpose: CRC32C (Castagnoli) checksums
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "lib/logging/Crc.h"
+
+/// the reflected CRC32C polynomial
+static const uint32_t POLY = 0x82F63B78;
+
+/// @brief lookup table for a byte at a time
+typedef struct {
+    uint32_t table[256];
+} crc_table_t;
+
+/// @brief build the lookup table
+/// @return the table
+static crc_table_t make_table() {
+    crc_table_t t;
+
+    for(uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for(int j = 0; j < 8; j++) {
+            c = (c & 1) ? (c >> 1) ^ POLY : c >> 1;
+        }
+
+        t.table[i] = c;
+    }
+
+    return t;
+}
+
+/// @brief compute the CRC a byte at a time
+/// @param data     the data
+/// @param len      the length of the data in bytes
+/// @param crc      the inverted CRC so far
+/// @return the inverted CRC
+static uint32_t crc_table(const uint8_t* data, size_t len, uint32_t crc) {
+    static const crc_table_t t = make_table();
+
+    for(size_t i = 0; i < len; i++) {
+        crc = t.table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+#if defined(__x86_64__)
+/// @brief compute the CRC with the crc32 instruction
+/// @param data     the data
+/// @param len      the length of the data in bytes
+/// @param crc      the inverted CRC so far
+/// @return the inverted CRC
+__attribute__((target("sse4.2")))
+static uint32_t crc_sse42(const uint8_t* data, size_t len, uint32_t crc) {
+    uint64_t c = crc;
+
+    while(len >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+
+        data += 8;
+        len -= 8;
+    }
+
+    crc = (uint32_t)c;
+    while(len--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+
+    return crc;
+}
+#endif
+
+/// @brief compute the CRC32C of data
+/// @param data     the data
+/// @param len      the length of the data in bytes
+/// @param crc      the CRC of the data before this
+/// @return the CRC
+uint32_t crc::crc32c(const void* data, size_t len, uint32_t crc) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+#if defined(__x86_64__)
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+
+    if(sse42) {
+        return ~crc_sse42(bytes, len, ~crc);
+    }
+#endif
+
+    return ~crc_table(bytes, len, ~crc);
+}
+
+/// @brief compute the CRC32C of data with the lookup table
+/// @param data     the data
+/// @param len      the length of the data in bytes
+/// @param crc      the CRC of the data before this
+/// @return the CRC
+uint32_t crc::crc32c_table(const void* data, size_t len, uint32_t crc) {
+    return ~crc_table((const uint8_t*)data, len, ~crc);
+}
@@ -0,0 +1,337 @@
+/******************************************************************************
+*  Name: LogLevels.cpp
+*
+*  Purpose: Table of system message log levels in shared memory, one per
+*           logger tag, that can be changed while processes are running
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lib/logging/LogLevels.h"
+
+using namespace LogLevelDecls;
+
+// NOTE: errors aren't logged here, the table is part of the logging path
+
+/// value of the magic word while the creator initializes the table
+static const uint32_t INITIALIZING = 1;
+
+/// how long to wait for another process to initialize the table
+static const int INIT_WAIT_MS = 1000;
+
+/// @brief constructor
+LogLevels::LogLevels() : m_table(NULL), m_fallback(0) {
+    // nothing else to do
+}
+
+/// @brief destructor
+LogLevels::~LogLevels() {
+    detach();
+}
+
+/// @brief attach to the table, creating it if it doesn't exist
+/// @return
+RetType LogLevels::attach() {
+    if(NULL != m_table) {
+        return SUCCESS;
+    }
+
+    int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
+    if(-1 == fd) {
+        return FAILURE;
+    }
+
+    // let every process change levels, regardless of umask
+    fchmod(fd, 0666);
+
+    // only ever grows the block, so racing creators all end up the same size
+    struct stat sb;
+    if(-1 == fstat(fd, &sb) ||
+       ((size_t)sb.st_size < sizeof(table_t) && -1 == ftruncate(fd, sizeof(table_t)))) {
+        close(fd);
+        return FAILURE;
+    }
+
+    void* addr = mmap(NULL, sizeof(table_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(MAP_FAILED == addr) {
+        return FAILURE;
+    }
+
+    table_t* table = (table_t*)addr;
+
+    // the first process to get here initializes the table
+    uint32_t expected = 0;
+    if(__atomic_compare_exchange_n(&table->magic, &expected, INITIALIZING, false,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        new (&table->lock) Mutex;
+        table->owner = 0;
+        table->default_level = 0;
+        table->count = 0;
+
+        __atomic_store_n(&table->magic, MAGIC, __ATOMIC_RELEASE);
+    } else {
+        for(int i = 0; MAGIC != __atomic_load_n(&table->magic, __ATOMIC_ACQUIRE); i++) {
+            if(i >= INIT_WAIT_MS) {
+                // the creator died part way through or it's not a table
+                munmap(addr, sizeof(table_t));
+                return FAILURE;
+            }
+
+            usleep(1000);
+        }
+    }
+
+    m_table = table;
+
+    return SUCCESS;
+}
+
+/// @brief detach from the table
+/// @return
+RetType LogLevels::detach() {
+    if(NULL == m_table) {
+        return SUCCESS;
+    }
+
+    if(-1 == munmap(m_table, sizeof(table_t))) {
+        return FAILURE;
+    }
+
+    m_table = NULL;
+
+    return SUCCESS;
+}
+
+/// @brief lock the table, taking the lock over if its holder died
+/// @return FAILURE if the lock is held by a live process for longer than
+///         LOCK_WAIT_MS
+RetType LogLevels::lock() {
+    if(SUCCESS == m_table->lock.lock(LOCK_WAIT_MS)) {
+        __atomic_store_n(&m_table->owner, getpid(), __ATOMIC_RELAXED);
+        return SUCCESS;
+    }
+
+    // nothing is held for long, so the holder has probably died, entries are
+    // published last so whatever it left part way through is never seen
+    pid_t owner = __atomic_load_n(&m_table->owner, __ATOMIC_RELAXED);
+    if(0 == owner || 0 == kill(owner, 0) || ESRCH != errno) {
+        return FAILURE;
+    }
+
+    // only one waiter takes over, the mutex stays locked and is now ours
+    if(!__atomic_compare_exchange_n(&m_table->owner, &owner, getpid(), false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/// @brief unlock the table
+void LogLevels::unlock() {
+    __atomic_store_n(&m_table->owner, 0, __ATOMIC_RELAXED);
+    m_table->lock.unlock();
+}
+
+/// @brief find an entry
+/// @param tag  the tag
+/// @return the entry or NULL if there isn't one
+entry_t* LogLevels::find(const char* tag) {
+    uint32_t count = __atomic_load_n(&m_table->count, __ATOMIC_ACQUIRE);
+
+    for(uint32_t i = 0; i < count; i++) {
+        if(0 == strncmp(m_table->entries[i].tag, tag, MAX_TAG)) {
+            return &m_table->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/// @brief add an entry
+/// @param tag      the tag
+/// @param level    the initial level
+/// @return the entry or NULL if the table is full
+entry_t* LogLevels::add(const char* tag, uint32_t level) {
+    uint32_t count = m_table->count;
+    if(count >= MAX_TAGS) {
+        return NULL;
+    }
+
+    entry_t* entry = &m_table->entries[count];
+    strncpy(entry->tag, tag, MAX_TAG - 1);
+    entry->tag[MAX_TAG - 1] = '\0';
+    entry->level = level;
+
+    // readers search without the lock, publish the entry last
+    __atomic_store_n(&m_table->count, count + 1, __ATOMIC_RELEASE);
+
+    return entry;
+}
+
+/// @brief get the level of a logger, registering its tag
+/// @param class_name   the name of the class the logger is in
+/// @param func_name    the name of the function the logger is in
+/// @return the level word to load, never NULL
+uint32_t* LogLevels::level(const char* class_name, const char* func_name) {
+    if(NULL == m_table) {
+        return &m_fallback;
+    }
+
+    char tag[MAX_TAG];
+    snprintf(tag, sizeof(tag), "%s::%s", class_name, func_name);
+
+    entry_t* entry = find(tag);
+    if(NULL != entry) {
+        return &entry->level;
+    }
+
+    if(SUCCESS != lock()) {
+        // can't register, send everything rather than wait
+        return &m_fallback;
+    }
+
+    // may have been added while we weren't holding the lock
+    entry = find(tag);
+    if(NULL == entry) {
+        entry_t* class_entry = find(class_name);
+        uint32_t level = (NULL != class_entry) ? class_entry->level : m_table->default_level;
+
+        entry = add(tag, level);
+    }
+
+    unlock();
+
+    // table full, fall back to the default level
+    return (NULL != entry) ? &entry->level : &m_table->default_level;
+}
+
+/// @brief check if a level word returned by 'level' will always be the
+///        tag's level, rather than a fallback because the table couldn't
+///        be locked or attached to
+/// @param level    the level word
+/// @return true if the level word is in the table
+bool LogLevels::registered(const uint32_t* level) {
+    if(NULL == m_table) {
+        return false;
+    }
+
+    // a tag that didn't fit in the full table always gets the default level
+    return (level == &m_table->default_level) ||
+           ((const uint8_t*)level >= (const uint8_t*)m_table->entries &&
+            (const uint8_t*)level < (const uint8_t*)(m_table->entries + MAX_TAGS));
+}
+
+/// @brief set the level of a tag
+/// @param tag      "class::func", "class", or ALL_TAGS
+/// @param level    the level
+/// @return FAILURE if not attached or the table is full
+RetType LogLevels::set(const char* tag, uint32_t level) {
+    if(NULL == m_table) {
+        return FAILURE;
+    }
+
+    if(SUCCESS != lock()) {
+        return FAILURE;
+    }
+
+    RetType ret = SUCCESS;
+
+    if(0 == strcmp(tag, ALL_TAGS)) {
+        __atomic_store_n(&m_table->default_level, level, __ATOMIC_RELAXED);
+
+        for(uint32_t i = 0; i < m_table->count; i++) {
+            __atomic_store_n(&m_table->entries[i].level, level, __ATOMIC_RELAXED);
+        }
+    } else {
+        entry_t* entry = find(tag);
+        if(NULL == entry) {
+            entry = add(tag, level);
+        }
+
+        if(NULL == entry) {
+            ret = FAILURE;
+        } else {
+            __atomic_store_n(&entry->level, level, __ATOMIC_RELAXED);
+        }
+
+        if(NULL == strstr(tag, "::")) {
+            // a class, set every function in it too
+            size_t len = strlen(tag);
+            for(uint32_t i = 0; i < m_table->count; i++) {
+                const char* other = m_table->entries[i].tag;
+                if(0 == strncmp(other, tag, len) && 0 == strncmp(other + len, "::", 2)) {
+                    __atomic_store_n(&m_table->entries[i].level, level, __ATOMIC_RELAXED);
+                }
+            }
+        }
+    }
+
+    unlock();
+
+    return ret;
+}
+
+/// @brief get the number of entries in the table, 0 if not attached
+size_t LogLevels::count() {
+    if(NULL == m_table) {
+        return 0;
+    }
+
+    return __atomic_load_n(&m_table->count, __ATOMIC_ACQUIRE);
+}
+
+/// @brief get an entry in the table
+/// @param index    the entry index
+/// @return the entry or NULL if out of range
+const entry_t* LogLevels::entry(size_t index) {
+    if(index >= count()) {
+        return NULL;
+    }
+
+    return &m_table->entries[index];
+}
+
+/// @brief get the level of tags with no class entry
+uint32_t LogLevels::default_level() {
+    if(NULL == m_table) {
+        return m_fallback;
+    }
+
+    return __atomic_load_n(&m_table->default_level, __ATOMIC_RELAXED);
+}
+
+/// @brief get the table shared by every logger in the process
+/// @return the table, attached if possible
+LogLevels* LogLevels::shared() {
+    // function local so loggers work during static initialization, never
+    // destroyed since loggers in other static objects may still point into it
+    static LogLevels* levels = NULL;
+    static Mutex lock;
+
+    lock.lock();
+
+    if(NULL == levels) {
+        levels = new LogLevels();
+
+        // don't care if this fails, every message is sent
+        levels->attach();
+    }
+
+    lock.unlock();
+
+    return levels;
+}
@@ -0,0 +1,401 @@
+/******************************************************************************
+*  Name: LogRing.cpp
+*
+*  Purpose: Multi-producer single-consumer ring of log records in shared
+*           memory, written by loggers and drained by the logging daemon
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lib/logging/LogRing.h"
+
+using namespace LogRingDecls;
+
+// NOTE: errors aren't logged here, the ring is part of the logging path
+
+/// @brief get the monotonic time
+/// @return the time in milliseconds
+static uint64_t mono_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/// @brief constructor
+/// @param filename     the logger address file the ring is for
+LogRing::LogRing(const char* filename) : m_data(NULL), m_hdr(NULL), m_size(0),
+                                         m_mask(0), m_tail(0), m_stall(0) {
+    m_name = NAME_PREFIX;
+    m_name += filename;
+}
+
+/// @brief destructor
+LogRing::~LogRing() {
+    // don't detach or destroy, leave that up to the user
+}
+
+/// @brief map the ring
+/// @param fd   the open shared memory block
+/// @return
+RetType LogRing::map(int fd) {
+    void* addr = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+
+    if(MAP_FAILED == addr) {
+        return FAILURE;
+    }
+
+    m_data = (uint8_t*)addr;
+    m_hdr = (header_t*)m_data;
+
+    return SUCCESS;
+}
+
+/// @brief create and attach to the ring, replacing any existing ring
+/// @param slots    the number of slots, must be a power of 2
+/// @return
+RetType LogRing::create(size_t slots) {
+    if(NULL != m_data || 0 == slots || (slots & (slots - 1))) {
+        return FAILURE;
+    }
+
+    // producers attached to an old ring see it closed and attach to this one
+    LogRing old(m_name.c_str() + strlen(NAME_PREFIX));
+    if(SUCCESS == old.attach()) {
+        old.destroy();
+    } else {
+        shm_unlink(m_name.c_str());
+    }
+
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if(-1 == fd) {
+        return FAILURE;
+    }
+
+    // let other users log, regardless of umask
+    fchmod(fd, 0666);
+
+    m_size = HEADER_SIZE + (slots * sizeof(slot_t));
+    if(-1 == ftruncate(fd, m_size)) {
+        close(fd);
+        shm_unlink(m_name.c_str());
+        return FAILURE;
+    }
+
+    if(SUCCESS != map(fd)) {
+        shm_unlink(m_name.c_str());
+        return FAILURE;
+    }
+
+    m_hdr->closed = 0;
+    m_hdr->slots = slots;
+    new (&m_hdr->update) Event();
+    m_hdr->head = 0;
+    m_hdr->tail = 0;
+    m_hdr->dropped = 0;
+    m_hdr->oversize = 0;
+
+    m_mask = slots - 1;
+    for(size_t i = 0; i < slots; i++) {
+        slot(i)->seq = i;
+    }
+
+    m_tail = 0;
+    m_stall = 0;
+
+    __atomic_store_n(&m_hdr->magic, MAGIC, __ATOMIC_RELEASE);
+
+    return SUCCESS;
+}
+
+/// @brief attach to a ring created by the consumer
+/// @return
+RetType LogRing::attach() {
+    if(NULL != m_data) {
+        return SUCCESS;
+    }
+
+    int fd = shm_open(m_name.c_str(), O_RDWR, 0666);
+    if(-1 == fd) {
+        return FAILURE;
+    }
+
+    struct stat sb;
+    if(-1 == fstat(fd, &sb) || (size_t)sb.st_size < HEADER_SIZE) {
+        close(fd);
+        return FAILURE;
+    }
+
+    m_size = sb.st_size;
+    if(SUCCESS != map(fd)) {
+        return FAILURE;
+    }
+
+    uint64_t slots = m_hdr->slots;
+    if(MAGIC != __atomic_load_n(&m_hdr->magic, __ATOMIC_ACQUIRE) ||
+       m_size != HEADER_SIZE + (slots * sizeof(slot_t))) {
+        detach();
+        return FAILURE;
+    }
+
+    m_mask = slots - 1;
+
+    return SUCCESS;
+}
+
+/// @brief detach from the ring
+/// @return
+RetType LogRing::detach() {
+    if(NULL == m_data) {
+        return SUCCESS;
+    }
+
+    if(-1 == munmap(m_data, m_size)) {
+        return FAILURE;
+    }
+
+    m_data = NULL;
+    m_hdr = NULL;
+
+    return SUCCESS;
+}
+
+/// @brief close and remove the ring, producers still attached see it closed
+/// @return
+RetType LogRing::destroy() {
+    if(NULL != m_hdr) {
+        __atomic_store_n(&m_hdr->closed, 1, __ATOMIC_RELEASE);
+    }
+
+    shm_unlink(m_name.c_str());
+
+    return detach();
+}
+
+/// @brief write a record to the ring, never blocks
+/// @param vec      list of vectors making up the record
+/// @param len      number of vectors in vec
+/// @param count    false to leave counting a rejected record as dropped up
+///                 to the caller, e.g. if it has somewhere else to send it
+/// @return FAILURE if the record was dropped
+RetType LogRing::write(const struct iovec* vec, size_t len, bool count) {
+    if(NULL == m_hdr) {
+        return FAILURE;
+    }
+
+    size_t total = 0;
+    for(size_t i = 0; i < len; i++) {
+        total += vec[i].iov_len;
+    }
+
+    if(total > MAX_RECORD) {
+        __atomic_add_fetch(&m_hdr->oversize, 1, __ATOMIC_RELAXED);
+        if(count) {
+            __atomic_add_fetch(&m_hdr->dropped, 1, __ATOMIC_RELAXED);
+        }
+        return FAILURE;
+    }
+
+    // claim a slot
+    uint64_t pos = __atomic_load_n(&m_hdr->head, __ATOMIC_RELAXED);
+    slot_t* s = NULL;
+    for(uint32_t i = 0; i < MAX_RETRIES; i++) {
+        slot_t* curr = slot(pos);
+        int64_t diff = (int64_t)(__atomic_load_n(&curr->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if(0 == diff) {
+            // slot is free, race the other producers for it
+            // on failure 'pos' is updated to the current head
+            if(__atomic_compare_exchange_n(&m_hdr->head, &pos, pos + 1, false,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                s = curr;
+                break;
+            }
+        } else if(diff < 0) {
+            // the consumer hasn't freed the slot yet or it was abandoned,
+            // ring is full
+            break;
+        } else {
+            // another producer claimed it, try the next one
+            pos = __atomic_load_n(&m_hdr->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    if(NULL == s) {
+        if(count) {
+            __atomic_add_fetch(&m_hdr->dropped, 1, __ATOMIC_RELAXED);
+        }
+        return FAILURE;
+    }
+
+    uint8_t* data = s->data;
+    for(size_t i = 0; i < len; i++) {
+        memcpy(data, vec[i].iov_base, vec[i].iov_len);
+        data += vec[i].iov_len;
+    }
+    s->len = total;
+
+    // publish, unless the consumer gave up on us and skipped the slot
+    uint64_t expected = pos;
+    if(!__atomic_compare_exchange_n(&s->seq, &expected, pos + 1, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        // no one else could claim the slot while we were copying into it,
+        // now we're done free it for the next lap, unless the consumer
+        // already reclaimed it thinking we died
+        expected = pos | ABANDONED;
+        __atomic_compare_exchange_n(&s->seq, &expected, pos + m_hdr->slots, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+        return FAILURE;
+    }
+
+    m_hdr->update.signal();
+
+    return SUCCESS;
+}
+
+/// @brief check if the slot at the tail has been stuck for long enough,
+///        starting the clock the first time it's found stuck
+/// @param limit_ms     how long is long enough in milliseconds
+/// @return true if stuck for at least 'limit_ms'
+bool LogRing::stalled(uint64_t limit_ms) {
+    uint64_t now = mono_ms();
+    if(0 == m_stall) {
+        m_stall = now;
+        return false;
+    }
+
+    return (now - m_stall >= limit_ms);
+}
+
+/// @brief get the oldest record in the ring without removing it
+/// @param len  filled with the length of the record
+/// @return the record or NULL if there is none
+const uint8_t* LogRing::peek(size_t* len) {
+    if(NULL == m_hdr) {
+        return NULL;
+    }
+
+    while(1) {
+        slot_t* s = slot(m_tail);
+        uint64_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+
+        if(seq == m_tail + 1) {
+            m_stall = 0;
+            *len = s->len;
+            return s->data;
+        }
+
+        if(seq & ABANDONED) {
+            // skipped a lap ago and the producer still hasn't freed it, a
+            // slow producer would have by now so it probably died
+            if(!stalled(RECLAIM_MS)) {
+                return NULL;
+            }
+
+            __atomic_compare_exchange_n(&s->seq, &seq, m_tail, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+
+            // either reclaimed or the producer just freed it, look again
+            m_stall = 0;
+            continue;
+        }
+
+        if(__atomic_load_n(&m_hdr->head, __ATOMIC_RELAXED) == m_tail) {
+            // empty
+            return NULL;
+        }
+
+        // claimed but not published yet, if it stays that way the producer
+        // is stuck or died mid-write and would stall the ring
+        if(!stalled(STALL_MS)) {
+            return NULL;
+        }
+
+        // skip it, but leave it abandoned so no one else claims it while the
+        // producer may still be writing
+        uint64_t expected = m_tail;
+        if(__atomic_compare_exchange_n(&s->seq, &expected, m_tail | ABANDONED, false,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            __atomic_add_fetch(&m_hdr->dropped, 1, __ATOMIC_RELAXED);
+            m_tail++;
+            __atomic_store_n(&m_hdr->tail, m_tail, __ATOMIC_RELAXED);
+        }
+
+        // either skipped or it was just published, look again
+        m_stall = 0;
+    }
+}
+
+/// @brief remove the record returned by 'peek'
+void LogRing::pop() {
+    __atomic_store_n(&slot(m_tail)->seq, m_tail + m_hdr->slots, __ATOMIC_RELEASE);
+    m_tail++;
+    __atomic_store_n(&m_hdr->tail, m_tail, __ATOMIC_RELAXED);
+}
+
+/// @brief wait for a record to be published
+/// @param seq          the update sequence number read before the ring
+///                     was last found empty
+/// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+///                     block forever
+/// @return SUCCESS if a record may be available, FAILURE on timeout
+RetType LogRing::wait(uint32_t seq, int timeout_ms) {
+    if(NULL == m_hdr) {
+        return FAILURE;
+    }
+
+    // don't sleep through a stalled or abandoned slot
+    if(0 != m_stall && (timeout_ms < 0 || timeout_ms > (int)STALL_MS)) {
+        timeout_ms = STALL_MS;
+    }
+
+    return m_hdr->update.wait(seq, timeout_ms);
+}
+
+/// @brief get the update event sequence number
+uint32_t LogRing::sequence() {
+    if(NULL == m_hdr) {
+        return 0;
+    }
+
+    return m_hdr->update.sequence();
+}
+
+/// @brief check if the consumer has closed the ring
+/// @return true if closed or not attached
+bool LogRing::closed() {
+    if(NULL == m_hdr) {
+        return true;
+    }
+
+    return __atomic_load_n(&m_hdr->closed, __ATOMIC_ACQUIRE);
+}
+
+/// @brief get the number of records dropped
+uint64_t LogRing::dropped() {
+    if(NULL == m_hdr) {
+        return 0;
+    }
+
+    return __atomic_load_n(&m_hdr->dropped, __ATOMIC_RELAXED);
+}
+
+/// @brief get the number of records waiting to be consumed
+uint64_t LogRing::depth() {
+    if(NULL == m_hdr) {
+        return 0;
+    }
+
+    return __atomic_load_n(&m_hdr->head, __ATOMIC_RELAXED) -
+           __atomic_load_n(&m_hdr->tail, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,137 @@
+/******************************************************************************
+*  Name: LogSpill.cpp
+*
+*  Purpose: Bounded FIFO of log messages held in private memory while the
+*           logging daemon's socket is full
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+
+#include "lib/logging/LogSpill.h"
+
+using namespace LogSpillDecls;
+
+// NOTE: errors aren't logged here, the spill is part of the logging path
+
+/// @brief round a length up to a multiple of ALIGN
+static size_t align(size_t len) {
+    return (len + ALIGN - 1) & ~(ALIGN - 1);
+}
+
+/// @brief constructor
+/// @param size     the size of the buffer in bytes, rounded up to a multiple
+///                 of LogSpillDecls::ALIGN
+LogSpill::LogSpill(size_t size) : m_head(0), m_tail(0), m_count(0) {
+    m_size = align(size);
+    m_buff = (uint8_t*)malloc(m_size);
+
+    if(NULL == m_buff) {
+        // every push fails
+        m_size = 0;
+    }
+}
+
+/// @brief destructor
+LogSpill::~LogSpill() {
+    free(m_buff);
+}
+
+/// @brief copy a message to the back of the spill
+/// @param vec  list of vectors making up the message
+/// @param len  number of vectors in vec
+/// @return FAILURE if there isn't room for the message
+RetType LogSpill::push(const struct iovec* vec, size_t len) {
+    size_t total = 0;
+    for(size_t i = 0; i < len; i++) {
+        total += vec[i].iov_len;
+    }
+
+    if(total >= WRAP || 0 == m_size) {
+        return FAILURE;
+    }
+
+    if(0 == m_count) {
+        // start over at the front, so the whole buffer is contiguous
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    size_t need = sizeof(header_t) + align(total);
+    size_t pos = m_head % m_size;
+
+    // a message never wraps around the end of the buffer
+    size_t skip = 0;
+    if(pos + need > m_size) {
+        skip = m_size - pos;
+    }
+
+    if(skip + need > m_size - (m_head - m_tail)) {
+        return FAILURE;
+    }
+
+    if(skip) {
+        ((header_t*)(m_buff + pos))->len = WRAP;
+        m_head += skip;
+        pos = 0;
+    }
+
+    header_t* hdr = (header_t*)(m_buff + pos);
+    hdr->len = total;
+
+    uint8_t* data = m_buff + pos + sizeof(header_t);
+    for(size_t i = 0; i < len; i++) {
+        memcpy(data, vec[i].iov_base, vec[i].iov_len);
+        data += vec[i].iov_len;
+    }
+
+    m_head += need;
+    m_count++;
+
+    return SUCCESS;
+}
+
+/// @brief get the oldest message without removing it
+/// @param len  filled with the length of the message
+/// @return the message or NULL if the spill is empty
+const uint8_t* LogSpill::peek(size_t* len) {
+    if(0 == m_count) {
+        return NULL;
+    }
+
+    size_t pos = m_tail % m_size;
+    header_t* hdr = (header_t*)(m_buff + pos);
+
+    if(WRAP == hdr->len) {
+        m_tail += m_size - pos;
+        pos = 0;
+        hdr = (header_t*)m_buff;
+    }
+
+    *len = hdr->len;
+
+    return m_buff + pos + sizeof(header_t);
+}
+
+/// @brief remove the message returned by 'peek'
+void LogSpill::pop() {
+    size_t len;
+    if(NULL == peek(&len)) {
+        return;
+    }
+
+    m_tail += sizeof(header_t) + align(len);
+    m_count--;
+}
+
+/// @brief check if the spill has no messages
+bool LogSpill::empty() {
+    return (0 == m_count);
+}
+
+/// @brief get the number of messages in the spill
+size_t LogSpill::count() {
+    return m_count;
+}
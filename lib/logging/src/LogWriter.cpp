@@ -0,0 +1,449 @@
+/******************************************************************************
+*  Name: LogWriter.cpp
+*
+*  Purpose: Writes a stream of log records to a series of files through large
+*           aligned buffers handed off to a writer thread
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "lib/logging/LogWriter.h"
+
+using namespace LogWriterDecls;
+
+/// maps durability policies to strings
+const char* LogWriterDecls::sync_str[] = {"none", "periodic", "group"};
+
+/// @brief get the monotonic time
+/// @return the time in milliseconds
+static uint64_t mono_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+/// @brief constructor
+/// @param dir      the directory to write files to
+/// @param prefix   files are named '<prefix><index><suffix>'
+/// @param suffix
+/// @param config   writer configuration
+LogWriter::LogWriter(const char* dir, const char* prefix, const char* suffix,
+                     config_t config) : m_dir(dir), m_prefix(prefix), m_suffix(suffix),
+                                        m_config(config), m_fd(-1), m_direct(false),
+                                        m_index(0), m_curr(0), m_fill(0),
+                                        m_buffOffset(0), m_fileSize(0), m_total(0),
+                                        m_dirty(false), m_pending(-1), m_pendingLen(0),
+                                        m_pendingOffset(0), m_status(SUCCESS),
+                                        m_running(false), m_stop(false) {
+    m_buffs[0] = NULL;
+    m_buffs[1] = NULL;
+}
+
+/// @brief destructor, closes the writer if open
+LogWriter::~LogWriter() {
+    close();
+}
+
+/// @brief set the header written at the start of every file
+/// NOTE: must be called before 'open'
+/// @param header   the header
+/// @param len      the length of the header in bytes
+/// @return FAILURE if the header doesn't fit in a buffer
+RetType LogWriter::set_header(const uint8_t* header, size_t len) {
+    if(m_running || len > BUFFER_SIZE || len > m_config.file_size) {
+        return FAILURE;
+    }
+
+    m_header.assign((const char*)header, len);
+
+    return SUCCESS;
+}
+
+/// @brief open the first file and start the writer thread
+/// @return
+RetType LogWriter::open() {
+    if(m_running) {
+        return SUCCESS;
+    }
+
+    for(int i = 0; i < 2; i++) {
+        if(0 != posix_memalign((void**)&m_buffs[i], ALIGNMENT, BUFFER_SIZE)) {
+            m_buffs[i] = NULL;
+            return FAILURE;
+        }
+    }
+
+    m_lock.lock();
+    RetType ret = open_file();
+    m_lock.unlock();
+
+    if(SUCCESS != ret) {
+        return FAILURE;
+    }
+
+    m_stop = false;
+    if(0 != pthread_create(&m_thread, NULL, writer_thread, this)) {
+        ::close(m_fd);
+        m_fd = -1;
+        return FAILURE;
+    }
+
+    m_running = true;
+
+    return SUCCESS;
+}
+
+/// @brief write a record
+/// @param data     the record
+/// @param len      the length of the record in bytes
+/// @return FAILURE if the record is larger than a file or a write failed
+RetType LogWriter::write(const uint8_t* data, size_t len) {
+    struct iovec iov;
+    iov.iov_base = (void*)data;
+    iov.iov_len = len;
+
+    return write(&iov, 1);
+}
+
+/// @brief write a record gathered from several buffers
+/// @param iov      the buffers
+/// @param iovcnt   the number of buffers
+/// @param pos      filled with where the record was written, or NULL
+/// @return FAILURE if the record is larger than a file or a write failed
+RetType LogWriter::write(const struct iovec* iov, int iovcnt, position_t* pos) {
+    size_t len = 0;
+    for(int i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+
+    if(len + m_header.size() > m_config.file_size) {
+        return FAILURE;
+    }
+
+    m_lock.lock();
+
+    if(-1 == m_fd) {
+        m_lock.unlock();
+        return FAILURE;
+    }
+
+    if(m_fileSize + len > m_config.file_size) {
+        close_file();
+        if(SUCCESS != open_file()) {
+            m_lock.unlock();
+            return FAILURE;
+        }
+    }
+
+    if(NULL != pos) {
+        pos->file = m_index - 1;
+        pos->offset = m_fileSize;
+    }
+
+    m_fileSize += len;
+    m_total += len;
+    m_dirty = true;
+
+    for(int i = 0; i < iovcnt; i++) {
+        copy((const uint8_t*)iov[i].iov_base, iov[i].iov_len);
+    }
+
+    RetType ret = m_status;
+
+    m_lock.unlock();
+
+    return ret;
+}
+
+/// @brief copy data into the current buffer, handing off full buffers
+/// NOTE: m_lock must be held
+/// @param data     the data
+/// @param len      the length of the data in bytes
+void LogWriter::copy(const uint8_t* data, size_t len) {
+    while(len) {
+        size_t n = BUFFER_SIZE - m_fill;
+        if(n > len) {
+            n = len;
+        }
+
+        memcpy(m_buffs[m_curr] + m_fill, data, n);
+        m_fill += n;
+        data += n;
+        len -= n;
+
+        if(BUFFER_SIZE == m_fill) {
+            submit();
+        }
+    }
+}
+
+/// @brief hand everything written so far to the writer thread
+/// @return
+RetType LogWriter::flush() {
+    m_lock.lock();
+    submit();
+    RetType ret = m_status;
+    m_lock.unlock();
+
+    return ret;
+}
+
+/// @brief write everything out, stop the writer thread, and close the file
+/// @return
+RetType LogWriter::close() {
+    if(!m_running) {
+        return SUCCESS;
+    }
+
+    m_lock.lock();
+    RetType ret = close_file();
+    m_stop = true;
+    m_cond.broadcast();
+    m_lock.unlock();
+
+    pthread_join(m_thread, NULL);
+    m_running = false;
+
+    free(m_buffs[0]);
+    free(m_buffs[1]);
+    m_buffs[0] = NULL;
+    m_buffs[1] = NULL;
+
+    return ret;
+}
+
+/// @brief get the total number of bytes written
+uint64_t LogWriter::written() {
+    m_lock.lock();
+    uint64_t total = m_total;
+    m_lock.unlock();
+
+    return total;
+}
+
+/// @brief writer thread entry point
+void* LogWriter::writer_thread(void* arg) {
+    ((LogWriter*)arg)->run();
+
+    return NULL;
+}
+
+/// @brief write buffers handed off until closed
+void LogWriter::run() {
+    uint64_t last_sync = mono_ms();
+    bool unsynced = false;
+
+    m_lock.lock();
+    while(1) {
+        while(-1 == m_pending && !m_stop) {
+            if(SUCCESS == m_cond.wait(m_lock, m_config.flush_ms)) {
+                continue;
+            }
+
+            // timed out, don't let records sit in a buffer forever
+            if(m_dirty) {
+                submit();
+            } else if(PERIODIC == m_config.sync && unsynced &&
+                      mono_ms() - last_sync >= (uint64_t)m_config.sync_ms) {
+                // idle, sync what was written last without holding the lock
+                // so writers don't block behind a slow disk, the duplicate
+                // keeps the file open if it's rotated meanwhile (close_file
+                // syncs it then anyway)
+                int fd = dup(m_fd);
+                m_lock.unlock();
+
+                if(-1 != fd) {
+                    fdatasync(fd);
+                    ::close(fd);
+                }
+
+                last_sync = mono_ms();
+                unsynced = false;
+
+                m_lock.lock();
+            }
+        }
+
+        if(-1 == m_pending) {
+            // stopped
+            break;
+        }
+
+        int fd = m_fd;
+        uint8_t* buff = m_buffs[m_pending];
+        size_t len = m_pendingLen;
+        uint64_t offset = m_pendingOffset;
+
+        m_lock.unlock();
+
+        RetType status = SUCCESS;
+        while(len) {
+            ssize_t n = pwrite(fd, buff, len, offset);
+            if(-1 == n) {
+                if(EINTR == errno) {
+                    continue;
+                }
+
+                status = FAILURE;
+                break;
+            }
+
+            buff += n;
+            len -= n;
+            offset += n;
+        }
+
+        if(GROUP == m_config.sync) {
+            fdatasync(fd);
+        } else if(PERIODIC == m_config.sync) {
+            unsynced = true;
+
+            uint64_t now = mono_ms();
+            if(now - last_sync >= (uint64_t)m_config.sync_ms) {
+                fdatasync(fd);
+                last_sync = now;
+                unsynced = false;
+            }
+        }
+
+        m_lock.lock();
+        m_status = status;
+        m_pending = -1;
+        m_cond.broadcast();
+    }
+    m_lock.unlock();
+}
+
+/// @brief hand the current buffer to the writer thread
+/// NOTE: m_lock must be held
+void LogWriter::submit() {
+    if(!m_dirty) {
+        return;
+    }
+
+    wait_idle();
+
+    uint8_t* buff = m_buffs[m_curr];
+    int next = m_curr ^ 1;
+
+    if(m_direct) {
+        // write whole blocks, padding out the last one, and carry the partial
+        // block over so it's written again once the rest of it is filled in
+        size_t whole = m_fill - (m_fill % ALIGNMENT);
+        size_t tail = m_fill - whole;
+
+        m_pendingLen = whole;
+        if(tail) {
+            memset(buff + m_fill, 0, ALIGNMENT - tail);
+            m_pendingLen += ALIGNMENT;
+            memcpy(m_buffs[next], buff + whole, tail);
+        }
+
+        m_pendingOffset = m_buffOffset;
+        m_buffOffset += whole;
+        m_fill = tail;
+    } else {
+        m_pendingLen = m_fill;
+        m_pendingOffset = m_buffOffset;
+        m_buffOffset += m_fill;
+        m_fill = 0;
+    }
+
+    m_pending = m_curr;
+    m_curr = next;
+    m_dirty = false;
+
+    m_cond.broadcast();
+}
+
+/// @brief wait for the writer thread to finish the buffer handed to it
+/// NOTE: m_lock must be held
+void LogWriter::wait_idle() {
+    while(-1 != m_pending) {
+        m_cond.wait(m_lock);
+    }
+}
+
+/// @brief open the next file
+/// NOTE: m_lock must be held and the writer thread idle
+/// @return
+RetType LogWriter::open_file() {
+    std::string filename = m_dir;
+    filename += "/";
+    filename += m_prefix;
+    filename += std::to_string(m_index);
+    filename += m_suffix;
+    m_index++;
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+    m_direct = false;
+    m_fd = -1;
+    if(m_config.direct) {
+        m_fd = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+        m_direct = (-1 != m_fd);
+    }
+
+    if(-1 == m_fd) {
+        // file system doesn't support direct I/O (e.g. tmpfs)
+        m_fd = ::open(filename.c_str(), flags, 0644);
+    }
+
+    if(-1 == m_fd) {
+        return FAILURE;
+    }
+
+    // reserve space up front so the file system doesn't have to find more on
+    // every write, the file keeps its size so readers only see real records
+    // NOTE: not supported by every file system, doesn't matter if it fails
+    fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, m_config.file_size);
+
+    m_fill = 0;
+    m_buffOffset = 0;
+    m_fileSize = 0;
+    m_dirty = false;
+
+    if(!m_header.empty()) {
+        copy((const uint8_t*)m_header.data(), m_header.size());
+        m_fileSize = m_header.size();
+        m_dirty = true;
+    }
+
+    return SUCCESS;
+}
+
+/// @brief write out the current buffer and close the file
+/// NOTE: m_lock must be held
+/// @return
+RetType LogWriter::close_file() {
+    if(-1 == m_fd) {
+        return SUCCESS;
+    }
+
+    submit();
+    wait_idle();
+
+    RetType ret = m_status;
+
+    if(NONE != m_config.sync) {
+        fdatasync(m_fd);
+    }
+
+    // drop the padding after the last record and any unused preallocation
+    if(-1 == ftruncate(m_fd, m_fileSize)) {
+        ret = FAILURE;
+    }
+
+    ::close(m_fd);
+    m_fd = -1;
+
+    return ret;
+}
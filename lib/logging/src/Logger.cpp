@@ -9,71 +9,407 @@
 
 #include <sys/un.h>
 #include <unistd.h>
+#include <string.h>
+#include <errno.h>
 #include <string>
+#include <map>
+#include <vector>
 
 #include "lib/logging/Logger.h"
+#include "lib/logging/LogSpill.h"
+#include "lib/sync/Mutex.h"
+#include "lib/stats/Stats.h"
+#include "lib/time/time.h"
 
-/// @brief constructor
-/// @param filename     a unique filename bound to logging messages
-Logger::Logger(const char* filename) : m_filename(filename), m_sd(-1) {
-    // attempt to initialize
-    // don't error if it fails
-    init(filename);
-};
+using namespace LoggerDecls;
 
-/// @brief destructor
-Logger::~Logger() {
-    if(-1 != m_sd) {
-        close(m_sd);
+/// @brief read the transport selected by the environment
+/// @return the transport
+static transport_t read_env_transport() {
+    const char* env = getenv(TRANSPORT_ENV);
+    if(NULL != env && 0 == strcmp(env, "ring")) {
+        return RING;
     }
+
+    return SOCKET;
 }
 
-/// @brief initialize the logger
-/// @param filename     a unique filename bound to logging messages
-/// @return
-RetType Logger::init(const char* filename) {
+/// @brief get the transport selected by the environment
+/// @return the transport
+static transport_t env_transport() {
+    // only read the environment once
+    static const transport_t transport = read_env_transport();
+
+    return transport;
+}
+
+/// @brief open a socket to send to the logging daemon
+/// @param filename     the logger address file
+/// @return the endpoint or NULL on failure
+static endpoint_t* open_endpoint(const char* filename) {
     char* gsw_home = getenv("GSW_HOME");
     if(NULL == gsw_home) {
-        return FAILURE;
+        return NULL;
     }
 
     std::string file = gsw_home;
     file += "/";
     file += filename;
-    const char* addr_str = file.c_str();
 
-    // open the UNIX socket
-    m_sd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    endpoint_t* endpoint = new endpoint_t;
+    endpoint->filename = filename;
+    endpoint->nonblocking = false;
+    endpoint->spilling = false;
+    endpoint->spill = NULL;
+    endpoint->dropped = 0;
 
-    if(-1 == m_sd) {
-        return FAILURE;
+    // set the address to send logging messages too
+    endpoint->addr.sun_family = AF_UNIX;
+
+    if(file.length() >= sizeof(endpoint->addr.sun_path)) {
+        // filename was too long!
+        delete endpoint;
+        return NULL;
     }
 
-    // set the address to send logging messages too
-    m_addr.sun_family = AF_UNIX;
+    strcpy(endpoint->addr.sun_path, file.c_str());
 
-    size_t len = 0;
-    while(len < (sizeof(m_addr.sun_path) / sizeof(char))) {
-        m_addr.sun_path[len] = addr_str[len];
+    // open the UNIX socket, not inherited by programs we exec
+    endpoint->sd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if(-1 == endpoint->sd) {
+        delete endpoint;
+        return NULL;
+    }
+
+    // room for more messages in flight before blocking, don't care if this
+    // fails, the default still works
+    int sndbuf = SOCKET_BUFFER_SIZE;
+    setsockopt(endpoint->sd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    return endpoint;
+}
 
-        if('\0' == addr_str[len]) {
+/// @brief every endpoint opened by the process
+typedef struct {
+    std::vector<endpoint_t*> list;
+    Mutex lock;
+} endpoints_t;
+
+/// @brief get every endpoint opened by the process
+/// @return the endpoints
+static endpoints_t* all_endpoints() {
+    // function local so loggers work during static initialization, never
+    // destroyed so the spills can be drained while the process exits
+    static endpoints_t* endpoints = new endpoints_t;
+
+    return endpoints;
+}
+
+/// @brief get the socket for a filename, shared by every logger in the
+///        process so constructing a logger doesn't open a new one every time
+/// @param filename     the logger address file
+/// @return the endpoint or NULL if the socket couldn't be opened
+static endpoint_t* shared_endpoint(const char* filename) {
+    // there's only one endpoint per kind of logger, so a search is fastest
+    // and doesn't allocate
+    endpoints_t* endpoints = all_endpoints();
+
+    endpoints->lock.lock();
+
+    endpoint_t* ret = NULL;
+    for(endpoint_t* endpoint : endpoints->list) {
+        if(endpoint->filename == filename) {
+            ret = endpoint;
             break;
         }
+    }
 
-        len++;
+    if(NULL == ret) {
+        // failures aren't remembered, try again next time
+        ret = open_endpoint(filename);
+        if(NULL != ret) {
+            endpoints->list.push_back(ret);
+        }
     }
 
-    if(len >= (sizeof(m_addr.sun_path) / sizeof(char))) {
-        // filename was too long!
-        close(m_sd);
-        m_sd = -1;
+    endpoints->lock.unlock();
+
+    return ret;
+}
+
+/// @brief get the ring for a filename, shared by every logger in the process
+///        so constructing a logger doesn't map a new ring every time
+/// @param filename     the logger address file
+/// @return the attached ring or NULL if the logging daemon hasn't created it
+// NOTE: when the daemon restarts the old ring stays mapped since other loggers
+//       may still be holding it, they reattach the next time they write
+static LogRing* shared_ring(const char* filename) {
+    // function local so loggers work during static initialization
+    static std::map<std::string, LogRing*> rings;
+    static Mutex lock;
+
+    lock.lock();
+
+    LogRing*& ring = rings[filename];
+    if(NULL == ring || ring->closed()) {
+        LogRing* fresh = new LogRing(filename);
+        if(SUCCESS == fresh->attach()) {
+            ring = fresh;
+        } else {
+            delete fresh;
+        }
+    }
+
+    LogRing* ret = (NULL != ring && !ring->closed()) ? ring : NULL;
 
+    lock.unlock();
+
+    return ret;
+}
+
+/// @brief get the histogram of log_vec times for the calling thread
+/// @return the histogram
+static Histogram* log_vec_hist() {
+    static thread_local Histogram* hist = NULL;
+    static thread_local uint32_t forks = 0;
+
+    // a child of a fork can't record into its parent's histogram
+    uint32_t curr = Stats::forks();
+    if(NULL == hist || forks != curr) {
+        hist = Stats::shared()->histogram("Logger::log_vec");
+        forks = curr;
+    }
+
+    return hist;
+}
+
+/// @brief counters of an endpoint for one thread
+typedef struct {
+    endpoint_t* endpoint;
+    Counter* dropped;
+    Counter* spilled;
+} counters_t;
+
+/// @brief get the counters of an endpoint for the calling thread
+/// @param endpoint     the endpoint
+/// @return the counters
+static counters_t* endpoint_counters(endpoint_t* endpoint) {
+    // only a couple of endpoints per process, so a search is fastest
+    static thread_local std::vector<counters_t> counters;
+    static thread_local uint32_t forks = 0;
+
+    // a child of a fork can't add to its parent's counters
+    uint32_t curr = Stats::forks();
+    if(forks != curr) {
+        counters.clear();
+        forks = curr;
+    }
+
+    for(counters_t& c : counters) {
+        if(c.endpoint == endpoint) {
+            return &c;
+        }
+    }
+
+    std::string prefix = "Logger." + endpoint->filename;
+
+    counters_t c;
+    c.endpoint = endpoint;
+    c.dropped = Stats::shared()->counter((prefix + ".dropped").c_str());
+    c.spilled = Stats::shared()->counter((prefix + ".spilled").c_str());
+    counters.push_back(c);
+
+    return &counters.back();
+}
+
+/// @brief count messages that couldn't be sent
+/// @param endpoint     the endpoint they were sent to
+/// @param count        the number of messages
+static void count_dropped(endpoint_t* endpoint, uint64_t count) {
+    __atomic_add_fetch(&endpoint->dropped, count, __ATOMIC_RELAXED);
+    endpoint_counters(endpoint)->dropped->add(count);
+}
+
+/// @brief hold a message until the socket has room, dropping it if the spill
+///        is full
+/// @param endpoint     the endpoint, its lock must be held
+/// @param vec          list of vectors making up the message
+/// @param len          number of vectors in vec
+/// @return FAILURE if the message was dropped
+static RetType spill_message(endpoint_t* endpoint, const struct iovec* vec, size_t len) {
+    if(NULL == endpoint->spill || SUCCESS != endpoint->spill->push(vec, len)) {
+        count_dropped(endpoint, 1);
+        return FAILURE;
+    }
+
+    endpoint_counters(endpoint)->spilled->add();
+    __atomic_store_n(&endpoint->spilling, true, __ATOMIC_RELEASE);
+
+    return SUCCESS;
+}
+
+/// @brief hold messages until the socket has room
+/// @param endpoint     the endpoint
+/// @param msgs         list of messages
+/// @param len          number of messages in msgs
+/// @return FAILURE if any message was dropped
+static RetType spill_batch(endpoint_t* endpoint, struct mmsghdr* msgs, size_t len) {
+    RetType ret = SUCCESS;
+
+    endpoint->lock.lock();
+
+    for(size_t i = 0; i < len; i++) {
+        if(SUCCESS != spill_message(endpoint, msgs[i].msg_hdr.msg_iov, msgs[i].msg_hdr.msg_iovlen)) {
+            ret = FAILURE;
+        }
+    }
+
+    endpoint->lock.unlock();
+
+    return ret;
+}
+
+/// @brief send spilled messages until the socket is full again
+/// @param endpoint     the endpoint, its lock must be held
+/// @return true if every spilled message was sent (or dropped)
+static bool drain_spill(endpoint_t* endpoint) {
+    const uint8_t* msg;
+    size_t len;
+
+    while(NULL != (msg = endpoint->spill->peek(&len))) {
+        if(-1 == sendto(endpoint->sd, msg, len, MSG_DONTWAIT,
+                        (struct sockaddr*)&endpoint->addr, sizeof(endpoint->addr))) {
+            if(EAGAIN == errno || EWOULDBLOCK == errno) {
+                // still full
+                return false;
+            }
+
+            // daemon isn't running
+            count_dropped(endpoint, 1);
+        }
+
+        endpoint->spill->pop();
+    }
+
+    __atomic_store_n(&endpoint->spilling, false, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/// @brief check if the spill of an endpoint still has messages after trying
+///        to send them, newer messages have to be spilled behind them
+/// @param endpoint     the endpoint
+/// @return true if messages are still spilled
+static bool still_spilling(endpoint_t* endpoint) {
+    if(!__atomic_load_n(&endpoint->spilling, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    endpoint->lock.lock();
+    bool ret = !drain_spill(endpoint);
+    endpoint->lock.unlock();
+
+    return ret;
+}
+
+/// @brief drop every spilled message of an endpoint, counting them as dropped
+/// @param endpoint     the endpoint
+static void discard_spill(endpoint_t* endpoint) {
+    if(!__atomic_load_n(&endpoint->spilling, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    endpoint->lock.lock();
+
+    count_dropped(endpoint, endpoint->spill->count());
+    while(!endpoint->spill->empty()) {
+        endpoint->spill->pop();
+    }
+
+    __atomic_store_n(&endpoint->spilling, false, __ATOMIC_RELEASE);
+
+    endpoint->lock.unlock();
+}
+
+/// @brief send a message without blocking, spilling it if the socket is full
+/// @param endpoint     the endpoint
+/// @param msg          the message, addressed to the endpoint
+/// @return FAILURE if the message was dropped
+static RetType send_nonblocking(endpoint_t* endpoint, struct msghdr* msg) {
+    // keep messages in order, anything spilled is sent first
+    if(still_spilling(endpoint)) {
+        endpoint->lock.lock();
+        RetType ret = spill_message(endpoint, msg->msg_iov, msg->msg_iovlen);
+        endpoint->lock.unlock();
+
+        return ret;
+    }
+
+    if(-1 != sendmsg(endpoint->sd, msg, MSG_DONTWAIT)) {
+        return SUCCESS;
+    }
+
+    if(EAGAIN != errno && EWOULDBLOCK != errno) {
+        // daemon isn't running
+        count_dropped(endpoint, 1);
+        return FAILURE;
+    }
+
+    endpoint->lock.lock();
+    RetType ret = spill_message(endpoint, msg->msg_iov, msg->msg_iovlen);
+    endpoint->lock.unlock();
+
+    return ret;
+}
+
+/// @brief constructor, uses the transport selected by TRANSPORT_ENV
+/// @param filename     a unique filename bound to logging messages
+Logger::Logger(const char* filename) : m_filename(filename), m_endpoint(NULL),
+                                       m_transport(env_transport()),
+                                       m_ring(NULL) {
+    // attempt to initialize
+    // don't error if it fails
+    init(filename);
+};
+
+/// @brief constructor
+/// @param filename     a unique filename bound to logging messages
+/// @param transport    how to send messages to the logging daemon
+Logger::Logger(const char* filename, transport_t transport) :
+                                       m_filename(filename), m_endpoint(NULL),
+                                       m_transport(transport),
+                                       m_ring(NULL) {
+    // attempt to initialize
+    // don't error if it fails
+    init(filename);
+};
+
+/// @brief destructor
+Logger::~Logger() {
+    // the socket and ring are shared, leave them open
+}
+
+/// @brief initialize the logger
+/// @param filename     a unique filename bound to logging messages
+/// @return
+RetType Logger::init(const char* filename) {
+    if(RING == m_transport) {
+        m_ring = shared_ring(filename);
+        if(NULL != m_ring) {
+            return SUCCESS;
+        }
+
+        // fall back to the socket
+    }
+
+    m_endpoint = shared_endpoint(filename);
+    if(NULL == m_endpoint) {
         return FAILURE;
     }
 
     // set the address field of the message header (for vectored I/O)
-    m_msg.msg_name = (void*)&m_addr;
-    m_msg.msg_namelen = sizeof(m_addr);
+    m_msg.msg_name = (void*)&m_endpoint->addr;
+    m_msg.msg_namelen = sizeof(m_endpoint->addr);
 
     // zero unused fields of message header
     m_msg.msg_control = NULL;
@@ -89,14 +425,34 @@ RetType Logger::init(const char* filename) {
 /// @return
 /// NOTE: init must be run and return SUCCESS before log will succeed!
 RetType Logger::log(uint8_t* data, size_t len) {
-    if(-1 == m_sd) {
+    if(NULL != m_ring) {
+        struct iovec vec;
+        vec.iov_base = data;
+        vec.iov_len = len;
+
+        return write_ring(&vec, 1);
+    }
+
+    if(NULL == m_endpoint) {
         // no socket!
         // init was never run successfully
         return FAILURE;
     }
 
-    if(-1 == sendto(m_sd, data, len, 0,
-                    (struct sockaddr*)&m_addr, sizeof(m_addr))) {
+    if(__atomic_load_n(&m_endpoint->nonblocking, __ATOMIC_ACQUIRE)) {
+        struct iovec vec;
+        vec.iov_base = data;
+        vec.iov_len = len;
+
+        m_msg.msg_iov = &vec;
+        m_msg.msg_iovlen = 1;
+
+        return send_nonblocking(m_endpoint, &m_msg);
+    }
+
+    if(-1 == sendto(m_endpoint->sd, data, len, 0,
+                    (struct sockaddr*)&m_endpoint->addr, sizeof(m_endpoint->addr))) {
+        count_dropped(m_endpoint, 1);
         return FAILURE;
     }
 
@@ -108,7 +464,25 @@ RetType Logger::log(uint8_t* data, size_t len) {
 /// @param len  number of vectors in vec
 /// @return
 RetType Logger::log_vec(struct iovec* vec, size_t len) {
-    if(-1 == m_sd) {
+    Histogram* hist = log_vec_hist();
+
+    time_util::timestamp_t start = time_util::mono_ns();
+    RetType ret = send_vec(vec, len);
+    hist->record(time_util::mono_ns() - start);
+
+    return ret;
+}
+
+/// @brief send a message to the ring or socket
+/// @param vec  list of vectors
+/// @param len  number of vectors in vec
+/// @return
+RetType Logger::send_vec(struct iovec* vec, size_t len) {
+    if(NULL != m_ring) {
+        return write_ring(vec, len);
+    }
+
+    if(NULL == m_endpoint) {
         // no socket!
         // init was never run successfully
         return FAILURE;
@@ -117,9 +491,196 @@ RetType Logger::log_vec(struct iovec* vec, size_t len) {
     m_msg.msg_iov = vec;
     m_msg.msg_iovlen = len;
 
-    if(-1 == sendmsg(m_sd, &m_msg, 0)) {
+    if(__atomic_load_n(&m_endpoint->nonblocking, __ATOMIC_ACQUIRE)) {
+        return send_nonblocking(m_endpoint, &m_msg);
+    }
+
+    if(-1 == sendmsg(m_endpoint->sd, &m_msg, 0)) {
+        count_dropped(m_endpoint, 1);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/// @brief log a batch of messages with one system call
+/// @param msgs     list of messages, only the I/O vectors need to be set
+/// @param len      number of messages in msgs
+/// @return
+RetType Logger::log_batch(struct mmsghdr* msgs, size_t len) {
+    if(NULL != m_ring) {
+        RetType ret = SUCCESS;
+        for(size_t i = 0; i < len; i++) {
+            if(SUCCESS != write_ring(msgs[i].msg_hdr.msg_iov, msgs[i].msg_hdr.msg_iovlen)) {
+                ret = FAILURE;
+            }
+        }
+
+        return ret;
+    }
+
+    if(NULL == m_endpoint) {
+        // no socket!
+        // init was never run successfully
+        return FAILURE;
+    }
+
+    for(size_t i = 0; i < len; i++) {
+        msgs[i].msg_hdr.msg_name = (void*)&m_endpoint->addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(m_endpoint->addr);
+        msgs[i].msg_hdr.msg_control = NULL;
+        msgs[i].msg_hdr.msg_controllen = 0;
+        msgs[i].msg_hdr.msg_flags = 0;
+    }
+
+    bool nonblocking = __atomic_load_n(&m_endpoint->nonblocking, __ATOMIC_ACQUIRE);
+    if(nonblocking && still_spilling(m_endpoint)) {
+        // keep messages in order, behind anything spilled
+        return spill_batch(m_endpoint, msgs, len);
+    }
+
+    RetType ret = SUCCESS;
+    size_t sent = 0;
+    while(sent < len) {
+        int n = sendmmsg(m_endpoint->sd, &msgs[sent], len - sent, nonblocking ? MSG_DONTWAIT : 0);
+        if(-1 == n) {
+            if(nonblocking && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                // the socket is full, hold the rest until it has room
+                if(SUCCESS != spill_batch(m_endpoint, &msgs[sent], len - sent)) {
+                    ret = FAILURE;
+                }
+
+                break;
+            }
+
+            // the first remaining message failed, skip it and keep going
+            count_dropped(m_endpoint, 1);
+            ret = FAILURE;
+            n = 1;
+        }
+
+        sent += n;
+    }
+
+    return ret;
+}
+
+/// @brief get the transport messages are sent with
+/// @return RING if messages are written to a ring, otherwise SOCKET
+transport_t Logger::transport() {
+    return (NULL != m_ring) ? RING : SOCKET;
+}
+
+/// @brief get the number of messages every logger in the process with the
+///        same filename couldn't send over the socket
+/// @return the count, 0 if not using the socket
+uint64_t Logger::dropped() {
+    if(NULL == m_endpoint) {
+        return 0;
+    }
+
+    return __atomic_load_n(&m_endpoint->dropped, __ATOMIC_RELAXED);
+}
+
+/// @brief never block sending over the socket with every logger in the
+///        process using a filename, messages are held in a spill while the
+///        socket is full and dropped if the spill is full too
+/// @param filename     the logger address file
+/// @param spill_size   size of the spill in bytes, 0 to drop messages as soon
+///                     as the socket is full, the spill is kept if this was
+///                     already called for 'filename'
+/// @return FAILURE if the socket couldn't be opened
+RetType Logger::set_nonblocking(const char* filename, size_t spill_size) {
+    endpoint_t* endpoint = shared_endpoint(filename);
+    if(NULL == endpoint) {
         return FAILURE;
     }
 
+    endpoint->lock.lock();
+
+    // loggers may be holding the spill, never replace it
+    if(NULL == endpoint->spill && 0 != spill_size) {
+        endpoint->spill = new LogSpill(spill_size);
+    }
+
+    __atomic_store_n(&endpoint->nonblocking, true, __ATOMIC_RELEASE);
+
+    endpoint->lock.unlock();
+
     return SUCCESS;
 }
+
+/// @brief send messages spilled by every logger in the process
+/// @param timeout_ms   how long to keep trying while the sockets are full, 0
+///                     to only send what fits now
+/// @param discard      drop whatever is still spilled after 'timeout_ms',
+///                     counting it as dropped
+/// @return FAILURE if messages are still spilled or were discarded
+RetType Logger::drain(int timeout_ms, bool discard) {
+    endpoints_t* endpoints = all_endpoints();
+    time_util::timestamp_t deadline = time_util::mono_ns() +
+                                      (time_util::timestamp_t)timeout_ms * time_util::NS_PER_MS;
+
+    endpoints->lock.lock();
+
+    bool spilled = false;
+    while(true) {
+        spilled = false;
+        for(endpoint_t* endpoint : endpoints->list) {
+            spilled |= still_spilling(endpoint);
+        }
+
+        if(!spilled || time_util::mono_ns() >= deadline) {
+            break;
+        }
+
+        // a datagram socket is always writable, so there's nothing to wait on
+        // for the daemon to make room
+        usleep(1000);
+    }
+
+    if(spilled && discard) {
+        for(endpoint_t* endpoint : endpoints->list) {
+            discard_spill(endpoint);
+        }
+    }
+
+    endpoints->lock.unlock();
+
+    return spilled ? FAILURE : SUCCESS;
+}
+
+/// @brief check if any logger in the process has spilled messages
+/// @return true if there are messages to drain
+bool Logger::spilling() {
+    endpoints_t* endpoints = all_endpoints();
+
+    endpoints->lock.lock();
+
+    bool ret = false;
+    for(endpoint_t* endpoint : endpoints->list) {
+        ret |= __atomic_load_n(&endpoint->spilling, __ATOMIC_ACQUIRE);
+    }
+
+    endpoints->lock.unlock();
+
+    return ret;
+}
+
+/// @brief write a message to the ring, reattaching if the daemon restarted
+/// @param vec  list of vectors
+/// @param len  number of vectors in vec
+/// @return
+RetType Logger::write_ring(const struct iovec* vec, size_t len) {
+    if(m_ring->closed()) {
+        LogRing* ring = shared_ring(m_filename);
+        if(NULL == ring) {
+            // daemon isn't running
+            return FAILURE;
+        }
+
+        m_ring = ring;
+    }
+
+    return m_ring->write(vec, len);
+}
@@ -7,6 +7,11 @@
 *
 ******************************************************************************/
 
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+
 #include "lib/logging/MessageLogger.h"
 #include "lib/time/time.h"
 
@@ -19,42 +24,176 @@ const char* MessageLoggerDecls::message_str[MessageLoggerDecls::NUM_MESSAGE_T +
     "UNKN"      // unknown message type
 };
 
+/// @brief get the logger for the WARN or CRIT lane for the calling thread
+/// @param type     WARN or CRIT
+/// @return the logger
+static Logger* lane(MessageLoggerDecls::message_t type) {
+    // a logger isn't thread safe, so each thread has its own, constructed the
+    // first time the thread sends a message of that type so a MessageLogger
+    // only has to find one endpoint when it's constructed
+    if(MessageLoggerDecls::CRIT == type) {
+        static thread_local Logger crit(MessageLoggerDecls::LANE_FILE[MessageLoggerDecls::CRIT],
+                                        LoggerDecls::SOCKET);
+        return &crit;
+    }
+
+    static thread_local Logger warn(MessageLoggerDecls::LANE_FILE[MessageLoggerDecls::WARN],
+                                    LoggerDecls::SOCKET);
+    return &warn;
+}
+
+/// @brief a tag looked up by a thread, see 'cached_tag'
+typedef struct {
+    const char* class_name;     // the names the logger was constructed with,
+    const char* func_name;      // only the addresses are compared
+    uint32_t* level;
+    size_t prefix_len;
+    char prefix[MessageLoggerDecls::MAX_PREFIX];
+} tag_cache_t;
+
+/// number of tags each thread remembers, must be a power of 2
+static const size_t TAG_CACHE_SIZE = 32;
+
+/// @brief get the entry of the calling thread's tag cache for a logger's names
+/// @param class_name  the name of the class the logger is in
+/// @param func_name   the name of the function the logger is in
+/// @return the entry, which may hold a different tag
+static tag_cache_t* cached_tag(const char* class_name, const char* func_name) {
+    // loggers are constructed over and over at the same few call sites, with
+    // the same string literals, so a thread looks each one up in the level
+    // table and formats its prefix once, then finds it by address
+    static thread_local tag_cache_t cache[TAG_CACHE_SIZE];
+
+    uintptr_t hash = ((uintptr_t)class_name * 31) ^ (uintptr_t)func_name;
+    hash ^= hash >> 7;
+
+    return &cache[hash & (TAG_CACHE_SIZE - 1)];
+}
+
+/// @brief check if a prefix is "(class::func) " for a logger's names
+/// @param prefix       the prefix
+/// @param len          the length of the prefix
+/// @param class_name   the name of the class the logger is in
+/// @param func_name    the name of the function the logger is in
+/// @return true if it is, always false for a prefix that was cut short
+static bool is_prefix(const char* prefix, size_t len, const char* class_name,
+                      const char* func_name) {
+    const char* parts[] = {"(", class_name, "::", func_name, ") "};
+
+    const char* end = prefix + len;
+    for(const char* part : parts) {
+        for(; '\0' != *part; part++) {
+            if(prefix == end || *prefix++ != *part) {
+                return false;
+            }
+        }
+    }
+
+    return prefix == end;
+}
+
 /// @brief constructor
 /// @param class_name  the name of the class the logger is in
 /// @param func_name   the name of the function the logger is in
-MessageLogger::MessageLogger(std::string class_name,
-                std::string func_name) : Logger(MessageLoggerDecls::ADDRESS_FILE),
-                                         m_className(class_name),
-                                         m_funcName(func_name) {
-    // preset the first vector for vectored I/O to be the information struct
-    m_vecs[0].iov_base = (void*)&m_info;
-    m_vecs[0].iov_len = sizeof(m_info);
+MessageLogger::MessageLogger(const char* class_name,
+                const char* func_name) : Logger(MessageLoggerDecls::ADDRESS_FILE) {
+    init_prefix(class_name, func_name);
 };
 
 /// @brief constructor
 /// @param func_name    the name of the function the logger is in
-MessageLogger::MessageLogger(std::string func_name)
-                                       : Logger(MessageLoggerDecls::ADDRESS_FILE),
-                                         m_className(""),
-                                         m_funcName(func_name) {
-    // preset the first vector for vectored I/O to be the information struct
+MessageLogger::MessageLogger(const char* func_name)
+                                       : Logger(MessageLoggerDecls::ADDRESS_FILE) {
+    init_prefix("", func_name);
+};
+
+/// @brief build the "(class::func) " prefix and find the level of the tag
+/// @param class_name  the name of the class the logger is in
+/// @param func_name   the name of the function the logger is in
+void MessageLogger::init_prefix(const char* class_name, const char* func_name) {
+    // the names are checked against the cached prefix too, in case they're
+    // not literals and the addresses were reused for different names
+    tag_cache_t* cached = cached_tag(class_name, func_name);
+    if(cached->class_name == class_name && cached->func_name == func_name &&
+       is_prefix(cached->prefix, cached->prefix_len, class_name, func_name)) {
+        m_level = cached->level;
+        m_prefixLen = cached->prefix_len;
+        memcpy(m_prefix, cached->prefix, m_prefixLen);
+    } else {
+        m_level = LogLevels::shared()->level(class_name, func_name);
+
+        int len = snprintf(m_prefix, sizeof(m_prefix), "(%s::%s) ", class_name, func_name);
+
+        m_prefixLen = len;
+        if(len < 0) {
+            m_prefixLen = 0;
+        } else if((size_t)len >= sizeof(m_prefix)) {
+            // cut short, but keep it a prefix the logging daemon recognizes
+            m_prefixLen = sizeof(m_prefix) - 1;
+            m_prefix[m_prefixLen - 2] = ')';
+            m_prefix[m_prefixLen - 1] = ' ';
+        }
+
+        // a fallback level would stop the tag's level from ever being set
+        if(LogLevels::shared()->registered(m_level)) {
+            cached->class_name = class_name;
+            cached->func_name = func_name;
+            cached->level = m_level;
+            cached->prefix_len = m_prefixLen;
+            memcpy(cached->prefix, m_prefix, m_prefixLen);
+        }
+    }
+
+    // preset the first vector for vectored I/O to be the information struct,
+    // followed by the prefix
     m_vecs[0].iov_base = (void*)&m_info;
     m_vecs[0].iov_len = sizeof(m_info);
-};
+    m_vecs[1].iov_base = (void*)m_prefix;
+    m_vecs[1].iov_len = m_prefixLen;
+}
 
-/// @brief log a message
-/// @param msg   the message to log
-/// @param type  the type of message to log
+/// @brief send a message with the prefix
+/// @param msg   the message, not including the prefix
+/// @param len   the length of msg in bytes
+/// @param type  the type of message
 /// @return
-RetType MessageLogger::log_message(std::string msg, MessageLoggerDecls::message_t type) {
-    m_info.timestamp = time_util::now();
+RetType MessageLogger::send(const char* msg, size_t len, MessageLoggerDecls::message_t type) {
+    m_info.timestamp = time_util::now_ns();
     m_info.type = type;
 
-    std::string output = "(" + m_className + "::" + m_funcName + ") ";
-    output += msg;
+    m_vecs[2].iov_base = (void*)msg;
+    m_vecs[2].iov_len = len;
+
+    switch(type) {
+        case MessageLoggerDecls::CRIT:
+        case MessageLoggerDecls::WARN:
+            return lane(type)->log_vec(m_vecs, 3);
+        default:
+            return log_vec(m_vecs, 3);
+    }
+}
+
+/// @brief format a message on the stack and send it
+/// @param type  the type of message to log
+/// @param fmt   printf style format
+/// @return
+RetType MessageLogger::log_format(MessageLoggerDecls::message_t type, const char* fmt, ...) {
+    char buff[Logger::MAX_LOG_SIZE];
+    size_t max = Logger::MAX_LOG_SIZE - m_prefixLen;
+
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buff, max, fmt, args);
+    va_end(args);
+
+    if(len < 0) {
+        return FAILURE;
+    }
 
-    m_vecs[1].iov_base = (void*)(output.c_str());
-    m_vecs[1].iov_len = output.size();
+    if((size_t)len >= max) {
+        // truncated
+        len = max - 1;
+    }
 
-    return log_vec(m_vecs, 2);
+    return send(buff, len, type);
 }
@@ -0,0 +1,26 @@
+/******************************************************************************
+*  Name: PacketLog.cpp
+*
+*  Purpose: Binary format of packet log files and their indexes
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <stddef.h>
+
+#include "lib/logging/PacketLog.h"
+#include "lib/logging/Crc.h"
+
+using namespace PacketLogDecls;
+
+/// @brief compute the CRC of a record
+/// @param rec      the record, only the fields after 'crc' are used
+/// @param packet   the packet
+/// @return the CRC to store in 'rec->crc'
+uint32_t PacketLogDecls::record_crc(const record_t* rec, const uint8_t* packet) {
+    static const size_t start = offsetof(record_t, timestamp);
+
+    uint32_t crc = crc::crc32c((const uint8_t*)rec + start, sizeof(record_t) - start);
+    return crc::crc32c(packet, rec->len, crc);
+}
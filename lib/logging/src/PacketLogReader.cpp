@@ -0,0 +1,290 @@
+/******************************************************************************
+*  Name: PacketLogReader.cpp
+*
+*  Purpose: Reads the packet logs in a directory in order, using their indexes
+*           to seek by time
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "lib/logging/PacketLogReader.h"
+
+using namespace PacketLogDecls;
+using namespace PacketLogReaderDecls;
+
+/// @brief constructor
+PacketLogReader::PacketLogReader() : m_file(0), m_offset(0), m_map(NULL), m_mapSize(0),
+                                     m_corrupt(0), m_resyncs(0) {
+    // nothing else to do
+}
+
+/// @brief destructor
+PacketLogReader::~PacketLogReader() {
+    close();
+}
+
+/// @brief open the packet logs in a directory
+/// @param dir  the directory
+/// @return FAILURE if there are no packet logs or one isn't a packet log
+RetType PacketLogReader::open(const char* dir) {
+    close();
+
+    for(size_t i = 0; ; i++) {
+        std::string base = std::string(dir) + "/" + PREFIX + std::to_string(i);
+
+        file_t file;
+        file.path = base + SUFFIX;
+
+        int fd = ::open(file.path.c_str(), O_RDONLY);
+        if(-1 == fd) {
+            break;
+        }
+
+        struct stat sb;
+        file_header_t header;
+        bool valid = (0 == fstat(fd, &sb)) &&
+                     (sizeof(header) == pread(fd, &header, sizeof(header), 0)) &&
+                     MAGIC == header.magic && VERSION == header.version &&
+                     sizeof(record_t) == header.record_size;
+
+        if(!valid) {
+            ::close(fd);
+            close();
+            return FAILURE;
+        }
+
+        file.size = sb.st_size;
+
+        load_index(&file, base + INDEX_SUFFIX);
+
+        if(file.index.empty()) {
+            // no index (e.g. the daemon died before writing it), use the
+            // first record if it's good, otherwise the file is always read
+            // from the start
+            record_t rec;
+            index_entry_t entry = {0, sizeof(file_header_t)};
+
+            if(sizeof(rec) == pread(fd, &rec, sizeof(rec), sizeof(file_header_t)) &&
+               SYNC == rec.sync) {
+                entry.timestamp = rec.timestamp;
+            }
+
+            file.index.push_back(entry);
+        }
+
+        ::close(fd);
+
+        m_files.push_back(file);
+    }
+
+    if(m_files.empty()) {
+        return FAILURE;
+    }
+
+    m_maps.resize(m_files.size(), NULL);
+    m_mapSizes.resize(m_files.size(), 0);
+
+    return seek(0, sizeof(file_header_t));
+}
+
+/// @brief close the logs
+void PacketLogReader::close() {
+    unmap();
+    m_files.clear();
+    m_file = 0;
+    m_offset = 0;
+}
+
+/// @brief load the index of a file
+/// @param file     the file
+/// @param path     the index file path
+void PacketLogReader::load_index(file_t* file, const std::string& path) {
+    FILE* f = fopen(path.c_str(), "r");
+    if(NULL == f) {
+        return;
+    }
+
+    index_header_t header;
+    if(1 != fread(&header, sizeof(header), 1, f) ||
+       INDEX_MAGIC != header.magic || VERSION != header.version) {
+        fclose(f);
+        return;
+    }
+
+    index_entry_t entry;
+    while(1 == fread(&entry, sizeof(entry), 1, f)) {
+        // a torn last entry is just left off
+        if(entry.offset >= file->size ||
+           (!file->index.empty() && entry.timestamp < file->index.back().timestamp)) {
+            break;
+        }
+
+        file->index.push_back(entry);
+    }
+
+    fclose(f);
+}
+
+/// @brief move to the first record that could be at or after a time
+/// @param timestamp    nanoseconds since the epoch
+/// @return
+RetType PacketLogReader::seek(time_util::timestamp_t timestamp) {
+    // the last file that starts at or before the time
+    size_t i = m_files.size() - 1;
+    while(i > 0 && m_files[i].index[0].timestamp > timestamp) {
+        i--;
+    }
+
+    const std::vector<index_entry_t>& index = m_files[i].index;
+
+    // the last entry at or before the time
+    std::vector<index_entry_t>::const_iterator it =
+        std::upper_bound(index.begin(), index.end(), timestamp,
+                         [](time_util::timestamp_t t, const index_entry_t& e) {
+                             return t < e.timestamp;
+                         });
+
+    uint64_t offset = (it == index.begin()) ? sizeof(file_header_t) : (it - 1)->offset;
+
+    return seek(i, offset);
+}
+
+/// @brief move to a record
+/// @param file     the file index
+/// @param offset   the offset of the record in the file
+/// @return FAILURE if the file doesn't exist
+RetType PacketLogReader::seek(size_t file, uint64_t offset) {
+    if(file >= m_files.size()) {
+        return FAILURE;
+    }
+
+    if(offset < sizeof(file_header_t)) {
+        offset = sizeof(file_header_t);
+    }
+
+    if(file != m_file) {
+        // mapped on the next read
+        m_map = NULL;
+    }
+
+    m_file = file;
+    m_offset = offset;
+
+    return SUCCESS;
+}
+
+/// @brief map a file, if it isn't already
+/// @param index    the file index
+/// @return
+RetType PacketLogReader::map(size_t index) {
+    if(NULL != m_maps[index]) {
+        m_map = m_maps[index];
+        m_mapSize = m_mapSizes[index];
+        return SUCCESS;
+    }
+
+    int fd = ::open(m_files[index].path.c_str(), O_RDONLY);
+    if(-1 == fd) {
+        return FAILURE;
+    }
+
+    struct stat sb;
+    if(-1 == fstat(fd, &sb) || 0 == sb.st_size) {
+        ::close(fd);
+        return FAILURE;
+    }
+
+    void* addr = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if(MAP_FAILED == addr) {
+        return FAILURE;
+    }
+
+    madvise(addr, sb.st_size, MADV_SEQUENTIAL);
+
+    m_maps[index] = (uint8_t*)addr;
+    m_mapSizes[index] = sb.st_size;
+
+    m_map = m_maps[index];
+    m_mapSize = m_mapSizes[index];
+
+    return SUCCESS;
+}
+
+/// @brief unmap every file
+void PacketLogReader::unmap() {
+    for(size_t i = 0; i < m_maps.size(); i++) {
+        if(NULL != m_maps[i]) {
+            munmap(m_maps[i], m_mapSizes[i]);
+        }
+    }
+
+    m_maps.clear();
+    m_mapSizes.clear();
+    m_map = NULL;
+    m_mapSize = 0;
+}
+
+/// @brief read the next record
+/// @param pkt  filled with the packet
+/// @return FAILURE if there are no more records
+RetType PacketLogReader::next(packet_t* pkt) {
+    bool resyncing = false;
+
+    while(m_file < m_files.size()) {
+        if(NULL == m_map && SUCCESS != map(m_file)) {
+            // can't read this file, move on
+            m_map = NULL;
+            m_file++;
+            m_offset = sizeof(file_header_t);
+            continue;
+        }
+
+        if(m_offset + sizeof(record_t) > m_mapSize) {
+            // end of the file, anything left is a torn record
+            if(m_offset < m_mapSize) {
+                m_corrupt += m_mapSize - m_offset;
+            }
+
+            m_map = NULL;
+            m_file++;
+            m_offset = sizeof(file_header_t);
+            continue;
+        }
+
+        const record_t* rec = (const record_t*)(m_map + m_offset);
+        const uint8_t* data = m_map + m_offset + sizeof(record_t);
+
+        if(SYNC == rec->sync && rec->len <= m_mapSize - m_offset - sizeof(record_t) &&
+           rec->crc == record_crc(rec, data)) {
+            pkt->rec = rec;
+            pkt->data = data;
+            pkt->file = m_file;
+            pkt->offset = m_offset;
+
+            m_offset += record_size(rec->len);
+
+            return SUCCESS;
+        }
+
+        // not a good record, records are aligned so try the next aligned word
+        if(!resyncing) {
+            resyncing = true;
+            m_resyncs++;
+        }
+
+        m_offset += RECORD_ALIGN;
+        m_corrupt += RECORD_ALIGN;
+    }
+
+    return FAILURE;
+}
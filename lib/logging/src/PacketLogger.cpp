@@ -7,29 +7,180 @@
 *
 ******************************************************************************/
 
+#include <string.h>
+
 #include "lib/logging/PacketLogger.h"
+#include "lib/logging/PacketPool.h"
 #include "lib/time/time.h"
+#include "lib/stats/Trace.h"
 
 /// @brief constructor
-PacketLogger::PacketLogger() : Logger(PacketLoggerDecls::ADDRESS_FILE) {
+PacketLogger::PacketLogger() : Logger(PacketLoggerDecls::ADDRESS_FILE),
+                               m_batchLen(0), m_pool(NULL),
+                               m_poolRing(PacketLoggerDecls::POOL_RING) {
     // always send a timestamp before the packet data
     m_vecs[0].iov_base = (void*)&m_info;
     m_vecs[0].iov_len = sizeof(m_info);
+
+    // same for every queued packet
+    for(size_t i = 0; i < PacketLoggerDecls::MAX_BATCH; i++) {
+        m_batchVecs[i][0].iov_base = (void*)&m_batchInfo[i];
+        m_batchVecs[i][0].iov_len = sizeof(m_batchInfo[i]);
+
+        m_batchMsgs[i].msg_hdr.msg_iov = m_batchVecs[i];
+        m_batchMsgs[i].msg_hdr.msg_iovlen = 2;
+    }
 };
 
+/// @brief destructor
+PacketLogger::~PacketLogger() {
+    m_poolRing.detach();
+}
+
 /// @brief log a packet
 /// @param buff     a buffer containing the packet data
 /// @param len      the length of buff in bytes
 /// @param port     the UDP destination port of the packet, in system
 ///                 endianness
+/// @param seq      the sequence number to trace the packet by, 0 to not
+///                 trace it
 /// @return
-RetType PacketLogger::log_packet(uint8_t* buff, size_t len, uint16_t port) {
-    m_info.timestamp = time_util::now();
+RetType PacketLogger::log_packet(uint8_t* buff, size_t len, uint16_t port, uint64_t seq) {
+    TRACE_PACKET(TraceDecls::LOG, port, seq);
+
+    m_info.timestamp = time_util::now_ns();
     m_info.port = port;
     m_info.len = len;
+    m_info.seq = seq;
 
     m_vecs[1].iov_base = (void*)buff;
     m_vecs[1].iov_len = len;
 
     return log_vec(m_vecs, 2);
 }
+
+/// @brief queue a packet to be logged with the next batch
+/// @param buff         a buffer containing the packet data, must remain
+///                     valid until the batch is flushed
+/// @param len          the length of buff in bytes
+/// @param port         the UDP destination port of the packet, in system
+///                     endianness
+/// @param timestamp    the time the packet was received (same units as
+///                     time_util::now_ns)
+/// @param seq          the sequence number to trace the packet by, 0 to
+///                     not trace it
+/// @return
+/// NOTE: automatically flushes when MAX_BATCH packets are queued
+RetType PacketLogger::queue_packet(uint8_t* buff, size_t len, uint16_t port,
+                                   time_util::timestamp_t timestamp, uint64_t seq) {
+    TRACE_PACKET(TraceDecls::LOG, port, seq);
+
+    m_batchInfo[m_batchLen].timestamp = timestamp;
+    m_batchInfo[m_batchLen].port = port;
+    m_batchInfo[m_batchLen].len = len;
+    m_batchInfo[m_batchLen].seq = seq;
+
+    m_batchVecs[m_batchLen][1].iov_base = (void*)buff;
+    m_batchVecs[m_batchLen][1].iov_len = len;
+
+    m_batchLen++;
+    if(m_batchLen >= PacketLoggerDecls::MAX_BATCH) {
+        return flush();
+    }
+
+    return SUCCESS;
+}
+
+/// @brief log all queued packets with one system call
+/// @return
+RetType PacketLogger::flush() {
+    if(NULL != m_pool && m_poolRing.closed()) {
+        // the logging daemon exited or restarted, it won't release the slots
+        // it was holding so take them back and look for a new one
+        m_poolRing.detach();
+        m_poolRing.attach();
+        m_pool->release_all(PacketPoolDecls::LOGGER);
+    }
+
+    if(0 == m_batchLen) {
+        return SUCCESS;
+    }
+
+    RetType ret = log_batch(m_batchMsgs, m_batchLen);
+    m_batchLen = 0;
+
+    return ret;
+}
+
+/// @brief log packets received into a pool by sending the logging daemon
+///        the slot instead of a copy of the packet
+/// @param pool     the attached pool, must outlive the logger
+/// @return
+RetType PacketLogger::use_pool(PacketPool* pool) {
+    if(NULL == pool->slot(0) || strlen(pool->name()) >= PacketPoolDecls::MAX_NAME) {
+        return FAILURE;
+    }
+
+    m_pool = pool;
+
+    // don't care if this fails, the logging daemon may not be running yet
+    m_poolRing.attach();
+
+    return SUCCESS;
+}
+
+/// @brief log a packet held in a pool slot
+/// @param index        the slot index, the caller must hold it until the
+///                     next flush in case the packet has to be copied
+/// @param len          the length of the packet in bytes, the packet
+///                     starts PacketPoolDecls::DATA_OFFSET into the slot
+/// @param port         the UDP destination port of the packet, in system
+///                     endianness
+/// @param timestamp    the time the packet was received (same units as
+///                     time_util::now_ns)
+/// @param seq          the sequence number to trace the packet by, 0 to
+///                     not trace it
+/// @return
+RetType PacketLogger::queue_slot(uint32_t index, size_t len, uint16_t port,
+                                 time_util::timestamp_t timestamp, uint64_t seq) {
+    uint8_t* slot = m_pool->slot(index);
+    if(NULL == slot || len > PacketPoolDecls::MAX_PACKET) {
+        return FAILURE;
+    }
+
+    // the slot holds exactly what's sent to the logging daemon
+    PacketLoggerDecls::info_t* info = (PacketLoggerDecls::info_t*)slot;
+    info->timestamp = timestamp;
+    info->port = port;
+    info->len = len;
+    info->seq = seq;
+
+    if(m_poolRing.closed()) {
+        // logging daemon isn't draining descriptors, copy the packet instead
+        return queue_packet(slot + PacketPoolDecls::DATA_OFFSET, len, port, timestamp, seq);
+    }
+
+    PacketPoolDecls::descriptor_t desc;
+    memset(desc.pool, 0, sizeof(desc.pool));
+    strcpy(desc.pool, m_pool->name());
+    desc.owner = m_pool->owner();
+    desc.slot = index;
+    desc.len = PacketPoolDecls::DATA_OFFSET + len;
+
+    struct iovec vec;
+    vec.iov_base = (void*)&desc;
+    vec.iov_len = sizeof(desc);
+
+    // the logger has to hold the slot before it can see the descriptor
+    m_pool->hold(index, PacketPoolDecls::LOGGER);
+    if(SUCCESS != m_poolRing.write(&vec, 1, false)) {
+        // ring is full, copy the packet instead, it's only counted as
+        // dropped if that fails too
+        m_pool->release(index, PacketPoolDecls::LOGGER);
+        return queue_packet(slot + PacketPoolDecls::DATA_OFFSET, len, port, timestamp, seq);
+    }
+
+    TRACE_PACKET(TraceDecls::LOG, port, seq);
+
+    return SUCCESS;
+}
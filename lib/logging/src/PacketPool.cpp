@@ -0,0 +1,277 @@
+/******************************************************************************
+*  Name: PacketPool.cpp
+*
+*  Purpose: Pool of packet buffers in shared memory, packets are received
+*           straight into a slot and only the slot index is sent to the
+*           logging daemon, which writes the slot out and releases it
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lib/logging/PacketPool.h"
+
+using namespace PacketPoolDecls;
+
+// NOTE: like LogRing this maps its own shared memory instead of using PosixShm,
+//       so the logging library doesn't depend on the shared memory library
+
+/// @brief get the offset of the first slot in a pool
+/// @param slots    the number of slots
+/// @return the offset in bytes
+static size_t slots_offset(size_t slots) {
+    size_t end = sizeof(header_t) + (slots * sizeof(uint32_t));
+    return ((end + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+}
+
+/// @brief constructor
+/// @param name     the name of the pool
+PacketPool::PacketPool(const char* name) : m_name(name), m_data(NULL), m_size(0),
+                                           m_hdr(NULL), m_refs(NULL), m_slots(NULL),
+                                           m_next(0) {
+    m_shmName = NAME_PREFIX;
+    m_shmName += name;
+}
+
+/// @brief destructor
+PacketPool::~PacketPool() {
+    // don't detach or destroy, leave that up to the user
+}
+
+/// @brief map the pool
+/// @param fd   the open shared memory block
+/// @return
+RetType PacketPool::map(int fd) {
+    void* addr = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(MAP_FAILED == addr) {
+        return FAILURE;
+    }
+
+    m_data = (uint8_t*)addr;
+    m_hdr = (header_t*)m_data;
+    m_refs = (uint32_t*)(m_data + sizeof(header_t));
+
+    return SUCCESS;
+}
+
+/// @brief create and attach to the pool, replacing any existing pool
+/// @param slots    the number of slots
+/// @return
+RetType PacketPool::create(size_t slots) {
+    if(NULL != m_data || 0 == slots || m_name.length() >= MAX_NAME) {
+        return FAILURE;
+    }
+
+    // don't check for error since it may not exist
+    shm_unlink(m_shmName.c_str());
+
+    int fd = shm_open(m_shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    if(-1 == fd) {
+        return FAILURE;
+    }
+
+    // let the logging daemon attach, regardless of umask
+    fchmod(fd, 0666);
+
+    m_size = slots_offset(slots) + (slots * SLOT_SIZE);
+    if(-1 == ftruncate(fd, m_size)) {
+        close(fd);
+        shm_unlink(m_shmName.c_str());
+        return FAILURE;
+    }
+
+    if(SUCCESS != map(fd)) {
+        shm_unlink(m_shmName.c_str());
+        return FAILURE;
+    }
+
+    // the pid tells apart pools with the same name while the creator is
+    // alive, the time tells apart a pool recreated by a recycled pid
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    m_hdr->slots = slots;
+    m_hdr->owner = ((uint64_t)getpid() << 32) ^ (uint64_t)ts.tv_nsec ^ ((uint64_t)ts.tv_sec << 20);
+    memset(m_refs, 0, slots * sizeof(uint32_t));
+    m_slots = m_data + slots_offset(slots);
+    m_next = 0;
+
+    __atomic_store_n(&m_hdr->magic, MAGIC, __ATOMIC_RELEASE);
+
+    return SUCCESS;
+}
+
+/// @brief attach to a pool created by another process
+/// @return
+RetType PacketPool::attach() {
+    if(NULL != m_data) {
+        return SUCCESS;
+    }
+
+    int fd = shm_open(m_shmName.c_str(), O_RDWR, 0666);
+    if(-1 == fd) {
+        return FAILURE;
+    }
+
+    struct stat sb;
+    if(-1 == fstat(fd, &sb) || (size_t)sb.st_size < sizeof(header_t)) {
+        close(fd);
+        return FAILURE;
+    }
+
+    m_size = sb.st_size;
+    if(SUCCESS != map(fd)) {
+        return FAILURE;
+    }
+
+    size_t slots = m_hdr->slots;
+    if(MAGIC != __atomic_load_n(&m_hdr->magic, __ATOMIC_ACQUIRE) ||
+       m_size != slots_offset(slots) + (slots * SLOT_SIZE)) {
+        detach();
+        return FAILURE;
+    }
+
+    m_slots = m_data + slots_offset(slots);
+
+    return SUCCESS;
+}
+
+/// @brief detach from the pool
+/// @return
+RetType PacketPool::detach() {
+    if(NULL == m_data) {
+        return SUCCESS;
+    }
+
+    if(-1 == munmap(m_data, m_size)) {
+        return FAILURE;
+    }
+
+    m_data = NULL;
+    m_hdr = NULL;
+    m_refs = NULL;
+    m_slots = NULL;
+
+    return SUCCESS;
+}
+
+/// @brief remove the pool, processes still attached keep their mapping
+/// @return
+RetType PacketPool::destroy() {
+    shm_unlink(m_shmName.c_str());
+
+    return detach();
+}
+
+/// @brief allocate a free slot, held by CREATOR
+/// @return the slot index or -1 if every slot is in use
+int32_t PacketPool::alloc() {
+    if(NULL == m_hdr) {
+        return -1;
+    }
+
+    // slots are released roughly in the order they're allocated, so the slot
+    // after the last one allocated is almost always free
+    uint32_t slots = m_hdr->slots;
+    for(uint32_t i = 0; i < slots; i++) {
+        uint32_t index = m_next;
+        m_next = (m_next + 1 == slots) ? 0 : m_next + 1;
+
+        uint32_t expected = 0;
+        if(__atomic_compare_exchange_n(&m_refs[index], &expected, (uint32_t)CREATOR, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+/// @brief add a holder to a slot
+/// @param index    the slot index
+/// @param who      the holder
+void PacketPool::hold(uint32_t index, holder_t who) {
+    if(NULL == m_hdr || index >= m_hdr->slots) {
+        return;
+    }
+
+    __atomic_or_fetch(&m_refs[index], (uint32_t)who, __ATOMIC_RELAXED);
+}
+
+/// @brief remove a holder from a slot, freeing it if it was the last
+/// @param index    the slot index
+/// @param who      the holder
+void PacketPool::release(uint32_t index, holder_t who) {
+    if(NULL == m_hdr || index >= m_hdr->slots) {
+        return;
+    }
+
+    // release so our reads of the slot finish before it can be reallocated
+    __atomic_and_fetch(&m_refs[index], ~(uint32_t)who, __ATOMIC_RELEASE);
+}
+
+/// @brief remove a holder from every slot
+/// @param who      the holder
+void PacketPool::release_all(holder_t who) {
+    if(NULL == m_hdr) {
+        return;
+    }
+
+    for(uint32_t i = 0; i < m_hdr->slots; i++) {
+        __atomic_and_fetch(&m_refs[i], ~(uint32_t)who, __ATOMIC_RELEASE);
+    }
+}
+
+/// @brief get a slot
+/// @param index    the slot index
+/// @return the start of the slot or NULL if not attached / out of range
+uint8_t* PacketPool::slot(uint32_t index) {
+    if(NULL == m_hdr || index >= m_hdr->slots) {
+        return NULL;
+    }
+
+    return m_slots + ((size_t)index * SLOT_SIZE);
+}
+
+/// @brief get the number of slots in use
+size_t PacketPool::in_use() {
+    if(NULL == m_hdr) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for(uint32_t i = 0; i < m_hdr->slots; i++) {
+        if(__atomic_load_n(&m_refs[i], __ATOMIC_RELAXED)) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/// @brief get the number of slots in the pool, 0 if not attached
+size_t PacketPool::slots() {
+    if(NULL == m_hdr) {
+        return 0;
+    }
+
+    return m_hdr->slots;
+}
+
+/// @brief get the instance of the pool, 0 if not attached
+uint64_t PacketPool::owner() {
+    if(NULL == m_hdr) {
+        return 0;
+    }
+
+    return m_hdr->owner;
+}
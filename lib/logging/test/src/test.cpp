@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <string>
+#include <vector>
+
+#include "lib/logging/LogRing.h"
+#include "lib/logging/Crc.h"
+#include "lib/logging/PacketLog.h"
+#include "lib/logging/PacketLogReader.h"
+
+// log ring: a producer is stalled part way through copying its record by
+// pointing the second half of the record at a page it can't read, the fault
+// handler holds the producer until the test lets it go
+//
+// packet logs: small logs are written in the packet log format in a temporary
+// directory, then damaged and read back
+
+static uint8_t* locked_page = NULL;
+static size_t page_size = 0;
+static int stalled = 0;
+static int release = 0;
+
+static int failures = 0;
+
+static void check(bool cond, const char* msg) {
+    if(!cond) {
+        printf("failed logging unit test, %s :(\n", msg);
+        failures++;
+    }
+}
+
+static void hold_producer(int, siginfo_t* info, void*) {
+    uint8_t* addr = (uint8_t*)info->si_addr;
+    if(addr < locked_page || addr >= locked_page + page_size) {
+        // a real crash
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    __atomic_store_n(&stalled, 1, __ATOMIC_RELEASE);
+    while(!__atomic_load_n(&release, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+
+    // the copy picks up where it faulted
+    mprotect(locked_page, page_size, PROT_READ);
+}
+
+static void* stalled_write(void* arg) {
+    LogRing* ring = (LogRing*)arg;
+
+    static uint8_t head[64];
+    memset(head, 'A', sizeof(head));
+
+    struct iovec vecs[2];
+    vecs[0].iov_base = head;
+    vecs[0].iov_len = sizeof(head);
+    vecs[1].iov_base = locked_page;
+    vecs[1].iov_len = 256;
+
+    // skipped by the consumer, so never published
+    check(FAILURE == ring->write(vecs, 2), "stalled record was published");
+
+    return NULL;
+}
+
+static RetType write_fill(LogRing* ring, uint8_t fill, size_t len) {
+    uint8_t buff[512];
+    memset(buff, fill, len);
+
+    struct iovec vec;
+    vec.iov_base = buff;
+    vec.iov_len = len;
+
+    return ring->write(&vec, 1);
+}
+
+static bool read_fill(LogRing* ring, uint8_t fill, size_t len) {
+    size_t rec_len = 0;
+    const uint8_t* rec = ring->peek(&rec_len);
+    if(NULL == rec) {
+        return false;
+    }
+
+    bool ok = (rec_len == len);
+    for(size_t i = 0; ok && i < len; i++) {
+        ok = (rec[i] == fill);
+    }
+
+    ring->pop();
+
+    return ok;
+}
+
+static void test_log_ring() {
+    const size_t slots = 4;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    locked_page = (uint8_t*)mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    memset(locked_page, 'A', page_size);
+    mprotect(locked_page, page_size, PROT_NONE);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = hold_producer;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, NULL);
+
+    LogRing consumer("log_ring_test");
+    if(SUCCESS != consumer.create(slots)) {
+        check(false, "couldn't create ring");
+        return;
+    }
+
+    LogRing producer("log_ring_test");
+    if(SUCCESS != producer.attach()) {
+        check(false, "couldn't attach to ring");
+        consumer.destroy();
+        return;
+    }
+
+    // stall a producer in the first slot
+    pthread_t thread;
+    pthread_create(&thread, NULL, stalled_write, &producer);
+    while(!__atomic_load_n(&stalled, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+
+    // fill the rest of the ring
+    for(size_t i = 1; i < slots; i++) {
+        check(SUCCESS == write_fill(&producer, 'a' + i, 100), "write behind a stall failed");
+    }
+
+    // the consumer skips the stalled slot once it's been stuck long enough
+    size_t len;
+    check(NULL == consumer.peek(&len), "read an unpublished record");
+    usleep((LogRingDecls::STALL_MS + 20) * 1000);
+
+    for(size_t i = 1; i < slots; i++) {
+        check(read_fill(&consumer, 'a' + i, 100), "record behind a stall corrupted");
+    }
+    check(1 == consumer.dropped(), "skipped record not counted as dropped");
+
+    // the next lap reaches the stalled slot while the producer is still
+    // writing into it, a record written there now must come out intact
+    bool wrote = (SUCCESS == write_fill(&producer, 'B', 400));
+
+    __atomic_store_n(&release, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+
+    if(wrote) {
+        check(read_fill(&consumer, 'B', 400), "stalled producer overwrote the next record");
+    } else {
+        // the stalled producer frees the slot once it's done
+        check(SUCCESS == write_fill(&producer, 'C', 400), "stalled slot never freed");
+        check(read_fill(&consumer, 'C', 400), "record after a stall corrupted");
+    }
+
+    check(NULL == consumer.peek(&len), "stalled record was read");
+
+    // a full ring rejects records, only counting them if asked to
+    for(size_t i = 0; i < slots; i++) {
+        check(SUCCESS == write_fill(&producer, 'D', 100), "write to an empty ring failed");
+    }
+
+    uint64_t dropped = consumer.dropped();
+    uint8_t buff[100] = {0};
+    struct iovec vec = {buff, sizeof(buff)};
+    check(FAILURE == producer.write(&vec, 1, false), "write to a full ring succeeded");
+    check(dropped == consumer.dropped(), "uncounted write to a full ring counted as dropped");
+    check(FAILURE == producer.write(&vec, 1), "write to a full ring succeeded");
+    check(dropped + 1 == consumer.dropped(), "write to a full ring not counted as dropped");
+
+    for(size_t i = 0; i < slots; i++) {
+        check(read_fill(&consumer, 'D', 100), "record in a full ring corrupted");
+    }
+
+    producer.detach();
+    consumer.destroy();
+    munmap(locked_page, page_size);
+    signal(SIGSEGV, SIG_DFL);
+}
+
+static void test_crc() {
+    // the check value of CRC32C, from the catalogue of parametrised CRC
+    // algorithms
+    static const char* CHECK = "123456789";
+    static const uint32_t CHECK_CRC = 0xE3069283;
+
+    check(CHECK_CRC == crc::crc32c(CHECK, 9), "crc32c of the check string is wrong");
+    check(CHECK_CRC == crc::crc32c_table(CHECK, 9), "table crc32c of the check string is wrong");
+    check(CHECK_CRC == crc::crc32c(CHECK + 4, 5, crc::crc32c(CHECK, 4)),
+          "crc32c in pieces doesn't match crc32c all at once");
+    check(0 == crc::crc32c(CHECK, 0), "crc32c of nothing isn't 0");
+
+    // every length and alignment around the 8 byte steps of the crc32
+    // instruction
+    uint8_t data[128];
+    for(size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)((i * 131) + 7);
+    }
+
+    bool same = true;
+    for(size_t start = 0; start < 8; start++) {
+        for(size_t len = 0; start + len <= sizeof(data); len++) {
+            same &= (crc::crc32c(data + start, len) == crc::crc32c_table(data + start, len));
+        }
+    }
+    check(same, "crc32c and table crc32c disagree");
+}
+
+/// first timestamp in the test logs
+static const time_util::timestamp_t LOG_START = 1700000000 * time_util::NS_PER_SEC;
+
+/// time between records in the test logs
+static const time_util::timestamp_t LOG_STEP = time_util::NS_PER_MS;
+
+/// @brief get the length of a record's packet in the test logs
+static size_t log_len(size_t record) {
+    return 5 + (record % 13);
+}
+
+/// @brief write a packet log and its index
+/// @param dir      the directory
+/// @param file     the index of the log in the directory
+/// @param first    the number of the first record, which sets its timestamp
+///                 and packet
+/// @param count    the number of records
+/// @param every    records between index entries
+/// @return the offset of each record in the file
+static std::vector<uint64_t> write_log(const std::string& dir, size_t file, size_t first,
+                                       size_t count, size_t every) {
+    using namespace PacketLogDecls;
+
+    std::string base = dir + "/" + PREFIX + std::to_string(file);
+    std::vector<uint8_t> log;
+    std::vector<uint64_t> offsets;
+
+    file_header_t header = {MAGIC, VERSION, sizeof(record_t), 0};
+    log.insert(log.end(), (uint8_t*)&header, (uint8_t*)(&header + 1));
+
+    FILE* idx = fopen((base + INDEX_SUFFIX).c_str(), "w");
+    index_header_t idx_header = {INDEX_MAGIC, VERSION, 0};
+    fwrite(&idx_header, sizeof(idx_header), 1, idx);
+
+    for(size_t i = first; i < first + count; i++) {
+        uint8_t packet[32];
+        size_t len = log_len(i);
+        for(size_t j = 0; j < len; j++) {
+            packet[j] = (uint8_t)(i + j);
+        }
+
+        record_t rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.sync = SYNC;
+        rec.timestamp = LOG_START + (i * LOG_STEP);
+        rec.len = len;
+        rec.port = 8080;
+        rec.crc = record_crc(&rec, packet);
+
+        if(0 == (i - first) % every) {
+            index_entry_t entry = {rec.timestamp, log.size()};
+            fwrite(&entry, sizeof(entry), 1, idx);
+        }
+
+        offsets.push_back(log.size());
+        log.insert(log.end(), (uint8_t*)&rec, (uint8_t*)(&rec + 1));
+        log.insert(log.end(), packet, packet + len);
+        log.resize(offsets.back() + record_size(len), 0);
+    }
+
+    fclose(idx);
+
+    FILE* f = fopen((base + SUFFIX).c_str(), "w");
+    fwrite(log.data(), 1, log.size(), f);
+    fclose(f);
+
+    return offsets;
+}
+
+/// @brief remove the test logs
+static void remove_logs(const std::string& dir, size_t files) {
+    for(size_t i = 0; i < files; i++) {
+        std::string base = dir + "/" + PacketLogDecls::PREFIX + std::to_string(i);
+        unlink((base + PacketLogDecls::SUFFIX).c_str());
+        unlink((base + PacketLogDecls::INDEX_SUFFIX).c_str());
+    }
+
+    rmdir(dir.c_str());
+}
+
+/// @brief get the record number of a packet read from the test logs
+static size_t record_of(const PacketLogReaderDecls::packet_t& pkt) {
+    return (pkt.rec->timestamp - LOG_START) / LOG_STEP;
+}
+
+static void test_packet_log_corrupt() {
+    char dir[] = "/tmp/gsw_packet_log_XXXXXX";
+    if(NULL == mkdtemp(dir)) {
+        check(false, "couldn't make a directory for packet logs");
+        return;
+    }
+
+    // flip a bit in the middle of the packet of a record half way through
+    const size_t count = 20;
+    const size_t bad = 10;
+    std::vector<uint64_t> offsets = write_log(dir, 0, 0, count, 4);
+
+    std::string path = std::string(dir) + "/" + PacketLogDecls::PREFIX + "0" + PacketLogDecls::SUFFIX;
+    int fd = open(path.c_str(), O_RDWR);
+    uint8_t byte = 0;
+    off_t at = offsets[bad] + sizeof(PacketLogDecls::record_t) + (log_len(bad) / 2);
+    check(1 == pread(fd, &byte, 1, at), "couldn't read the packet log");
+    byte ^= 0x10;
+    check(1 == pwrite(fd, &byte, 1, at), "couldn't corrupt the packet log");
+    close(fd);
+
+    PacketLogReader reader;
+    check(SUCCESS == reader.open(dir), "couldn't open the packet log");
+
+    PacketLogReaderDecls::packet_t pkt;
+    size_t expected = 0;
+    bool in_order = true;
+    size_t read = 0;
+    while(SUCCESS == reader.next(&pkt)) {
+        if(bad == expected) {
+            expected++;
+        }
+
+        in_order &= (record_of(pkt) == expected) && (pkt.offset == offsets[expected]) &&
+                    (pkt.rec->len == log_len(expected)) && (pkt.data[0] == (uint8_t)expected);
+        expected++;
+        read++;
+    }
+
+    check(count - 1 == read, "wrong number of records read around a corrupt one");
+    check(in_order, "wrong records read around a corrupt one");
+    check(1 == reader.resyncs(), "a corrupt record wasn't exactly one resync");
+    check(PacketLogDecls::record_size(log_len(bad)) == reader.corrupt(),
+          "corrupt bytes aren't the corrupt record");
+
+    reader.close();
+    remove_logs(dir, 1);
+}
+
+static void test_packet_log_seek() {
+    char dir[] = "/tmp/gsw_packet_log_XXXXXX";
+    if(NULL == mkdtemp(dir)) {
+        check(false, "couldn't make a directory for packet logs");
+        return;
+    }
+
+    // records 0-29 in the first file and 30-59 in the second, an index entry
+    // every 4 records
+    const size_t per_file = 30;
+    const size_t every = 4;
+    std::vector<uint64_t> offsets[2];
+    offsets[0] = write_log(dir, 0, 0, per_file, every);
+    offsets[1] = write_log(dir, 1, per_file, per_file, every);
+
+    PacketLogReader reader;
+    check(SUCCESS == reader.open(dir), "couldn't open the packet logs");
+    check(2 == reader.files().size(), "wrong number of packet logs");
+    check(per_file / every + 1 == reader.files()[0].index.size(), "index not loaded");
+
+    // lands on the last entry at or before the time, for every time, and
+    // reading on from it gets to the record at the time
+    bool landed = true;
+    bool reached = true;
+    for(size_t target = 0; target < 2 * per_file; target++) {
+        time_util::timestamp_t when = LOG_START + (target * LOG_STEP) + (LOG_STEP / 2);
+        check(SUCCESS == reader.seek(when), "seek failed");
+
+        size_t file = target / per_file;
+        size_t entry = target - ((target % per_file) % every);
+
+        PacketLogReaderDecls::packet_t pkt;
+        if(SUCCESS != reader.next(&pkt) || pkt.file != file ||
+           pkt.offset != offsets[file][entry % per_file] || record_of(pkt) != entry) {
+            landed = false;
+            continue;
+        }
+
+        while(record_of(pkt) < target && SUCCESS == reader.next(&pkt)) {}
+        reached &= (record_of(pkt) == target);
+    }
+    check(landed, "seek didn't land on the index entry before the time");
+    check(reached, "reading on from a seek didn't reach the time");
+
+    // before the first record starts at the beginning
+    PacketLogReaderDecls::packet_t pkt;
+    check(SUCCESS == reader.seek(LOG_START - 1) && SUCCESS == reader.next(&pkt) &&
+          0 == record_of(pkt), "seek before the first record didn't start at the beginning");
+
+    // an exact timestamp lands on its own entry
+    check(SUCCESS == reader.seek(LOG_START + (every * LOG_STEP)) && SUCCESS == reader.next(&pkt) &&
+          every == record_of(pkt), "seek to an entry's time didn't land on it");
+
+    reader.close();
+    remove_logs(dir, 2);
+}
+
+int main() {
+    test_log_ring();
+    test_crc();
+    test_packet_log_corrupt();
+    test_packet_log_seek();
+
+    return failures ? 1 : 0;
+}
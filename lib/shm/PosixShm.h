@@ -0,0 +1,114 @@
+/********************************************************************
+*  Name: PosixShm.h
+*
+*  Purpose: Defines PosixShm object to store data in named POSIX
+*           shared memory, with optional huge pages and prefaulting.
+*
+*  Author: Will Merges
+*
+*********************************************************************/
+#ifndef POSIX_SHM_H
+#define POSIX_SHM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <string>
+
+#include "common/types.h"
+
+// unlike Shm (System V), blocks are named so there are no key collisions and
+// leftover blocks are visible (and removable) as files under /dev/shm
+// (or the hugetlbfs mount when using huge pages)
+
+// POSIX shared memory type and data declarations
+namespace PosixShmDecls {
+    /// @brief flags controlling how the block is created and mapped
+    typedef enum {
+        HUGEPAGES = 0x1,                // back with explicit huge pages from a
+                                        // hugetlbfs mount, falls back to normal
+                                        // pages if unavailable
+        TRANSPARENT_HUGEPAGES = 0x2,    // ask for transparent huge pages (only
+                                        // honored if the kernel allows THP for shmem)
+        PREFAULT = 0x4,                 // fault every page in when attaching
+        LOCK = 0x8,                     // lock the pages into RAM when attaching
+        REPLACE = 0x10                  // create replaces an existing block
+                                        // with the same name
+    } flags_t;
+};
+
+// faciliates access to named shared memory
+class PosixShm {
+public:
+    /// @brief constructor
+    /// @param name     the name of the block, should start with '/' and contain
+    ///                 no other slashes (e.g. "/gsw_telemetry")
+    /// @param size     the size of the shared memory block
+    /// @param flags    bitwise OR of PosixShmDecls::flags_t
+    PosixShm(const char* name, size_t size, uint32_t flags = 0);
+
+    /// @brief destructor
+    virtual ~PosixShm();
+
+    /// @brief attach the current process to the shared memory block
+    RetType attach();
+
+    /// @brief detach the current process from the shared memory block
+    RetType detach();
+
+    /// @brief destroy the shared memory block, detaching from it if attached
+    // NOTE: processes still attached keep their mapping until they detach
+    RetType destroy();
+
+    /// @brief create shared memory block
+    // NOTE: does not attach the process to the block
+    RetType create();
+
+    /// @brief get the size of the pages backing the block
+    /// @return the page size in bytes, or 0 if not attached
+    size_t page_size() { return m_pageSize; }
+
+    /// @brief check if the block attached to has since been destroyed, or
+    ///        replaced by a create with REPLACE
+    /// @return true if attaching again wouldn't map the same block, false if
+    ///         not attached
+    // NOTE: doesn't log, so it can be polled
+    bool replaced();
+
+    // pointer to shared memory block
+    // NULL when not attached
+    uint8_t* data;
+
+    // size of shared memory block
+    const size_t size;
+
+private:
+    /// @brief open the file backing the block
+    /// @param oflag    flags to open with
+    /// @return the file descriptor or -1 on failure
+    int open_block(int oflag);
+
+    /// @brief remove the file backing the block
+    /// @return 0 on success, -1 on failure
+    int unlink_block();
+
+    /// @brief stop using huge pages, the block is a normal POSIX shared memory
+    ///        block from now on
+    void normal_pages();
+
+    std::string m_name;
+    uint32_t m_flags;
+
+    // path of the block on a hugetlbfs mount, empty if not using huge pages
+    std::string m_hugePath;
+
+    // size of the mapping (rounded up to a multiple of the page size)
+    size_t m_mapSize;
+    size_t m_pageSize;
+
+    // the file backing the attached block
+    dev_t m_dev;
+    ino_t m_ino;
+};
+
+#endif
@@ -32,8 +32,8 @@ public:
     /// @brief detach the current process from the shared memory block
     RetType detach();
 
-    /// @brief destroy the shared memory block
-    // NOTE: must have called create or attach first
+    /// @brief destroy the shared memory block, detaching from it
+    // NOTE: must be attached first
     RetType destroy();
 
     /// @brief create shared memory block
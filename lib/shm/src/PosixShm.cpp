@@ -0,0 +1,347 @@
+/********************************************************************
+*  Name: PosixShm.cpp
+*
+*  Purpose: Declares PosixShm object to store data in named POSIX
+*           shared memory, with optional huge pages and prefaulting.
+*
+*  Author: Will Merges
+*
+*********************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <fstream>
+
+#include "lib/shm/PosixShm.h"
+#include "lib/logging/MessageLogger.h"
+#include "common/types.h"
+
+using namespace PosixShmDecls;
+
+// NOTE: shared memory can be manually inspected and removed under /dev/shm
+
+/// @brief find where hugetlbfs is mounted
+/// @return the mount point or an empty string if it's not mounted
+static std::string hugetlbfs_mount() {
+    std::ifstream mounts("/proc/mounts");
+
+    std::string dev, dir, type, rest;
+    while(mounts >> dev >> dir >> type) {
+        std::getline(mounts, rest);
+
+        if("hugetlbfs" == type) {
+            return dir;
+        }
+    }
+
+    return "";
+}
+
+/// @brief check if a mapping is backed by transparent huge pages
+/// @param addr     the start of the mapping
+/// @return the huge page size if it is, otherwise 0
+static size_t thp_page_size(void* addr) {
+    char start[32];
+    snprintf(start, sizeof(start), "%lx-", (unsigned long)addr);
+
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool found = false;
+    size_t pmd_kb = 0;
+    while(std::getline(smaps, line)) {
+        if(!found) {
+            found = (0 == line.compare(0, strlen(start), start));
+            continue;
+        }
+
+        // the next mapping starts with an address range, fields start with a name
+        if(line.find(':') == std::string::npos || line.find('-') < line.find(':')) {
+            break;
+        }
+
+        if(0 == line.compare(0, 15, "ShmemPmdMapped:") || 0 == line.compare(0, 14, "FilePmdMapped:")) {
+            pmd_kb += strtoul(line.c_str() + line.find(':') + 1, NULL, 10);
+        }
+    }
+
+    if(0 == pmd_kb) {
+        return 0;
+    }
+
+    std::ifstream meminfo("/proc/meminfo");
+    while(std::getline(meminfo, line)) {
+        if(0 == line.compare(0, 13, "Hugepagesize:")) {
+            return strtoul(line.c_str() + 13, NULL, 10) * 1024;
+        }
+    }
+
+    return 0;
+}
+
+/// @brief constructor
+/// @param name     the name of the block
+/// @param size     the size of the shared memory block
+/// @param flags    bitwise OR of PosixShmDecls::flags_t
+PosixShm::PosixShm(const char* name, size_t size, uint32_t flags) :
+                                data(NULL), size(size), m_name(name),
+                                m_flags(flags), m_mapSize(0), m_pageSize(0),
+                                m_dev(0), m_ino(0) {
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    if(m_flags & HUGEPAGES) {
+        std::string mount = hugetlbfs_mount();
+
+        struct statfs fs;
+        if(mount.length() && 0 == statfs(mount.c_str(), &fs)) {
+            m_hugePath = mount + m_name;
+            page = fs.f_bsize;
+        }
+    }
+
+    // mappings are always a whole number of pages
+    m_mapSize = ((size + page - 1) / page) * page;
+}
+
+/// @brief destructor
+PosixShm::~PosixShm() {
+    // don't detach or destroy, leave that up to the user
+}
+
+/// @brief open the file backing the block
+/// @param oflag    flags to open with
+/// @return the file descriptor or -1 on failure
+int PosixShm::open_block(int oflag) {
+    if(m_hugePath.length()) {
+        return open(m_hugePath.c_str(), oflag, 0666);
+    }
+
+    return shm_open(m_name.c_str(), oflag, 0666);
+}
+
+/// @brief remove the file backing the block
+/// @return 0 on success, -1 on failure
+int PosixShm::unlink_block() {
+    if(m_hugePath.length()) {
+        return unlink(m_hugePath.c_str());
+    }
+
+    return shm_unlink(m_name.c_str());
+}
+
+/// @brief stop using huge pages, the block is a normal POSIX shared memory
+///        block from now on
+void PosixShm::normal_pages() {
+    m_hugePath = "";
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    m_mapSize = ((size + page - 1) / page) * page;
+}
+
+// creates shared memory but does not attach to it
+RetType PosixShm::create() {
+    MessageLogger logger("PosixShm", "create");
+
+    if(m_flags & REPLACE) {
+        // don't check for error since it may not exist
+        unlink_block();
+    }
+
+    int fd = open_block(O_CREAT | O_EXCL | O_RDWR);
+
+    // hugetlbfs reserves the huge pages when the block is first mapped, not
+    // when it's created, so with too few free the file is created fine and
+    // every attach fails with ENOMEM
+    // map it now, before anyone can attach, so the pages are reserved for
+    // the life of the file or the block falls back to normal pages
+    if(-1 != fd && m_hugePath.length()) {
+        void* addr = mmap(NULL, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(MAP_FAILED == addr) {
+            int err = errno;
+            close(fd);
+            unlink_block();
+
+            fd = -1;
+            errno = err;
+        } else {
+            munmap(addr, m_mapSize);
+        }
+    }
+
+    if(-1 == fd && m_hugePath.length() && EEXIST != errno) {
+        logger.log_message("failed to create block on hugetlbfs, falling back to normal pages",
+                           MessageLoggerDecls::WARN);
+
+        normal_pages();
+
+        if(m_flags & REPLACE) {
+            unlink_block();
+        }
+        fd = open_block(O_CREAT | O_EXCL | O_RDWR);
+    }
+
+    if(-1 == fd) {
+        logger.log_message("shm_open failure", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    // let other users attach, regardless of umask
+    fchmod(fd, 0666);
+
+    // hugetlbfs doesn't support ftruncate, the size is set by the first mapping
+    if(m_hugePath.empty() && -1 == ftruncate(fd, m_mapSize)) {
+        logger.log_message("ftruncate failure", MessageLoggerDecls::CRIT);
+        close(fd);
+        unlink_block();
+        return FAILURE;
+    }
+
+    close(fd);
+    return SUCCESS;
+}
+
+RetType PosixShm::attach() {
+    MessageLogger logger("PosixShm", "attach");
+
+    if(NULL != data) {
+        logger.log_message("already attached", MessageLoggerDecls::WARN);
+        return SUCCESS;
+    }
+
+    int fd = open_block(O_RDWR);
+    if(-1 == fd && m_hugePath.length()) {
+        // the creator may have fallen back to normal pages
+        normal_pages();
+        fd = open_block(O_RDWR);
+    }
+
+    if(-1 == fd) {
+        logger.log_message("shm_open failure, cannot attach to shmem", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    struct statfs fs;
+    m_pageSize = sysconf(_SC_PAGESIZE);
+    if(0 == fstatfs(fd, &fs)) {
+        m_pageSize = fs.f_bsize;
+    }
+
+    // remember which file this is, a replacement has the same name
+    struct stat sb;
+    m_dev = 0;
+    m_ino = 0;
+    if(0 == fstat(fd, &sb)) {
+        m_dev = sb.st_dev;
+        m_ino = sb.st_ino;
+    }
+
+    // transparent huge pages have to be requested before the pages are
+    // faulted in, so don't populate the mapping as it's created in that case
+    int flags = MAP_SHARED;
+    bool thp = (m_flags & TRANSPARENT_HUGEPAGES) && m_hugePath.empty();
+    if((m_flags & PREFAULT) && !thp) {
+        flags |= MAP_POPULATE;
+    }
+
+    void* addr = mmap(NULL, m_mapSize, PROT_READ | PROT_WRITE, flags, fd, 0);
+    close(fd);
+
+    if(MAP_FAILED == addr) {
+        logger.log_message("mmap failure, cannot attach to shmem", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+    data = (uint8_t*)addr;
+
+    if(thp) {
+        if(-1 == madvise(data, m_mapSize, MADV_HUGEPAGE)) {
+            logger.log_message("failed to request transparent huge pages", MessageLoggerDecls::WARN);
+            // non-critical, don't fail
+        }
+
+        if(m_flags & PREFAULT) {
+#ifdef MADV_POPULATE_WRITE
+            if(0 == madvise(data, m_mapSize, MADV_POPULATE_WRITE)) {
+                thp = false;
+            }
+#endif
+            if(thp) {
+                // older kernel, touch every page instead
+                for(size_t i = 0; i < m_mapSize; i += m_pageSize) {
+                    (void)*(volatile uint8_t*)(data + i);
+                }
+            }
+        }
+
+        size_t huge = thp_page_size(data);
+        if(huge) {
+            m_pageSize = huge;
+        }
+    }
+
+    // avoids delays from page faults and swapping, pages are automatically
+    // unlocked when the process exits so every attached process should lock
+    if((m_flags & LOCK) && -1 == mlock(data, m_mapSize)) {
+        logger.log_message("failed to lock shared memory pages into RAM", MessageLoggerDecls::WARN);
+        // non-critical, don't fail
+    }
+
+    return SUCCESS;
+}
+
+RetType PosixShm::detach() {
+    MessageLogger logger("PosixShm", "detach");
+
+    if(NULL == data) {
+        logger.log_message("process is not attached, nothing to detach from", MessageLoggerDecls::WARN);
+        return SUCCESS;
+    }
+
+    if(-1 == munmap(data, m_mapSize)) {
+        logger.log_message("munmap failure", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    data = NULL;
+    m_pageSize = 0;
+
+    return SUCCESS;
+}
+
+RetType PosixShm::destroy() {
+    MessageLogger logger("PosixShm", "destroy");
+
+    if(-1 == unlink_block() && ENOENT != errno) {
+        logger.log_message("failed to remove shared memory", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    if(NULL != data) {
+        return detach();
+    }
+
+    return SUCCESS;
+}
+
+bool PosixShm::replaced() {
+    if(NULL == data) {
+        return false;
+    }
+
+    int fd = open_block(O_RDONLY);
+    if(-1 == fd) {
+        // destroyed
+        return true;
+    }
+
+    struct stat sb;
+    bool ret = (0 == fstat(fd, &sb) && (sb.st_dev != m_dev || sb.st_ino != m_ino));
+    close(fd);
+
+    return ret;
+}
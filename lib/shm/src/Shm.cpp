@@ -117,6 +117,11 @@ RetType Shm::destroy() {
         return FAILURE;
     }
 
+    // the block is only freed once everyone detaches, including us
+    if(shmdt(data) != 0) {
+        logger.log_message("shmdt failure", MessageLoggerDecls::WARN);
+    }
+
     m_shmid = -1;
     data = NULL;
 
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <fstream>
+
+#include "lib/shm/PosixShm.h"
+
+using namespace PosixShmDecls;
+
+// a block asking for explicit huge pages is made larger than the huge pages
+// that are free, so even with hugetlbfs mounted it can't be backed by them
+// and has to fall back to normal pages, attaching from another object (as
+// another process would) has to find the same block
+
+static int failures = 0;
+
+static void check(bool cond, const char* msg) {
+    if(!cond) {
+        printf("failed shared memory unit test, %s :(\n", msg);
+        failures++;
+    }
+}
+
+/// @brief read a field from /proc/meminfo
+/// @param name     the name of the field, including the ':'
+/// @return the value of the field or 0 if it's not there
+static size_t meminfo(const char* name) {
+    std::ifstream file("/proc/meminfo");
+    std::string line;
+    while(std::getline(file, line)) {
+        if(0 == line.compare(0, strlen(name), name)) {
+            return strtoul(line.c_str() + strlen(name), NULL, 10);
+        }
+    }
+
+    return 0;
+}
+
+/// @brief find where hugetlbfs is mounted
+/// @return the mount point or an empty string if it's not mounted
+static std::string hugetlbfs_mount() {
+    std::ifstream mounts("/proc/mounts");
+
+    std::string dev, dir, type, rest;
+    while(mounts >> dev >> dir >> type) {
+        std::getline(mounts, rest);
+
+        if("hugetlbfs" == type) {
+            return dir;
+        }
+    }
+
+    return "";
+}
+
+static void test_hugepage_fallback() {
+    static const char* NAME = "/gsw_shm_test_huge";
+
+    std::string mount = hugetlbfs_mount();
+    if(mount.empty()) {
+        printf("hugetlbfs isn't mounted, only testing the fallback when it's missing\n");
+    }
+
+    // one more huge page than is free
+    size_t huge = meminfo("Hugepagesize:") * 1024;
+    if(0 == huge) {
+        huge = 2 * 1024 * 1024;
+    }
+    size_t size = (meminfo("HugePages_Free:") + 1) * huge;
+
+    PosixShm shm(NAME, size, HUGEPAGES | REPLACE);
+    check(SUCCESS == shm.create(), "create with no huge pages free failed");
+    check(SUCCESS == shm.attach(), "attach with no huge pages free failed");
+    check(NULL != shm.data, "not attached");
+    check(shm.page_size() == (size_t)sysconf(_SC_PAGESIZE), "didn't fall back to normal pages");
+
+    if(mount.length()) {
+        check(0 != access((mount + NAME).c_str(), F_OK), "block left on hugetlbfs");
+    }
+
+    if(NULL == shm.data) {
+        return;
+    }
+
+    shm.data[0] = 0x5a;
+    shm.data[size - 1] = 0xa5;
+
+    // another user of the block has to attach to the same fallback block
+    PosixShm other(NAME, size, HUGEPAGES);
+    check(SUCCESS == other.attach(), "second attach failed");
+    check(NULL != other.data && 0x5a == other.data[0] && 0xa5 == other.data[size - 1],
+          "second attach mapped a different block");
+    check(!other.replaced(), "fallback block reported as replaced");
+
+    other.detach();
+    check(SUCCESS == shm.destroy(), "destroy failed");
+}
+
+static void test_replace() {
+    static const char* NAME = "/gsw_shm_test_replace";
+    static const size_t SIZE = 4096;
+
+    PosixShm shm(NAME, SIZE, REPLACE);
+    check(SUCCESS == shm.create() && SUCCESS == shm.attach(), "create and attach failed");
+    check(!shm.replaced(), "block reported as replaced before it was");
+
+    PosixShm other(NAME, SIZE, REPLACE);
+    check(SUCCESS == other.create(), "replacing create failed");
+    check(shm.replaced(), "replaced block not reported as replaced");
+
+    other.destroy();
+    shm.destroy();
+}
+
+int main() {
+    test_hugepage_fallback();
+    test_replace();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,187 @@
+/******************************************************************************
+*  Name: Histogram.h
+*
+*  Purpose: Log bucketed histograms and counters that are cheap enough to
+*           record into on every operation
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// values are bucketed like an HDR histogram, each power of 2 is split into
+// SUB_BUCKETS linear buckets, so a bucket is never wider than 1/SUB_BUCKETS
+// of its value (~6%) and every 64-bit value has a bucket
+//
+// a histogram or counter has a single writer, so recording is a few plain
+// loads and stores with no atomic read-modify-writes, the stores are relaxed
+// atomics so another thread or process can read a slightly stale but never
+// torn copy at any time
+//
+// both are plain data that can be placed in shared memory, zeroed memory is
+// an empty histogram or a counter of 0
+
+// Histogram type and data declarations
+namespace HistogramDecls {
+    /// bits of the value below its leading bit used to pick a sub bucket
+    static const unsigned int SUB_BITS = 4;
+
+    /// linear buckets per power of 2
+    static const size_t SUB_BUCKETS = 1 << SUB_BITS;
+
+    /// values below this each have their own bucket
+    static const uint64_t LINEAR_MAX = 2 * SUB_BUCKETS;
+
+    /// buckets needed to cover every 64-bit value
+    static const size_t NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    /// @brief get the bucket a value falls in
+    /// @param val  the value
+    /// @return the bucket index
+    inline size_t bucket(uint64_t val) {
+        if(val < LINEAR_MAX) {
+            return val;
+        }
+
+        unsigned int exp = 63 - __builtin_clzll(val);
+        return ((exp - SUB_BITS + 1) << SUB_BITS) + ((val >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1));
+    }
+
+    /// @brief get the smallest value in a bucket
+    /// @param index    the bucket index
+    /// @return the value
+    inline uint64_t bucket_low(size_t index) {
+        if(index < LINEAR_MAX) {
+            return index;
+        }
+
+        unsigned int exp = (index >> SUB_BITS) + SUB_BITS - 1;
+        return (SUB_BUCKETS + (index & (SUB_BUCKETS - 1))) << (exp - SUB_BITS);
+    }
+
+    /// @brief get the largest value in a bucket
+    /// @param index    the bucket index
+    /// @return the value
+    inline uint64_t bucket_high(size_t index) {
+        if(index + 1 >= NUM_BUCKETS) {
+            return UINT64_MAX;
+        }
+
+        return bucket_low(index + 1) - 1;
+    }
+};
+
+/// @brief a histogram of values, usually latencies in nanoseconds
+/// NOTE: only one thread may record at a time
+class Histogram {
+public:
+    /// @brief record a value
+    /// @param val  the value
+    void record(uint64_t val) {
+        size_t index = HistogramDecls::bucket(val);
+
+        __atomic_store_n(&buckets[index], buckets[index] + 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&sum, sum + val, __ATOMIC_RELAXED);
+        if(val > max) {
+            __atomic_store_n(&max, val, __ATOMIC_RELAXED);
+        }
+
+        // count last, so a reader that sees the count sees every bucket
+        // (on architectures that don't reorder stores)
+        __atomic_store_n(&count, count + 1, __ATOMIC_RELEASE);
+    }
+
+    /// @brief add every value recorded in another histogram
+    /// @param other    the histogram to add, may be in the middle of being
+    ///                 recorded into
+    void merge(const Histogram& other) {
+        count += __atomic_load_n(&other.count, __ATOMIC_ACQUIRE);
+        sum += __atomic_load_n(&other.sum, __ATOMIC_RELAXED);
+
+        uint64_t other_max = __atomic_load_n(&other.max, __ATOMIC_RELAXED);
+        if(other_max > max) {
+            max = other_max;
+        }
+
+        for(size_t i = 0; i < HistogramDecls::NUM_BUCKETS; i++) {
+            buckets[i] += __atomic_load_n(&other.buckets[i], __ATOMIC_RELAXED);
+        }
+    }
+
+    /// @brief get a percentile
+    /// @param p    the percentile, 0 to 1
+    /// @return the largest value in the bucket holding the percentile, at
+    ///         most the largest value recorded, or 0 if empty
+    uint64_t percentile(double p) const {
+        uint64_t total = 0;
+        for(size_t i = 0; i < HistogramDecls::NUM_BUCKETS; i++) {
+            total += buckets[i];
+        }
+
+        if(0 == total) {
+            return 0;
+        }
+
+        // nearest rank
+        uint64_t rank = (uint64_t)(p * total);
+        if(rank < p * total || 0 == rank) {
+            rank++;
+        }
+
+        uint64_t seen = 0;
+        for(size_t i = 0; i < HistogramDecls::NUM_BUCKETS; i++) {
+            seen += buckets[i];
+            if(seen >= rank) {
+                uint64_t high = HistogramDecls::bucket_high(i);
+                return (max && high > max) ? max : high;
+            }
+        }
+
+        return max;
+    }
+
+    // number of values recorded
+    uint64_t count;
+
+    // sum of the values recorded
+    uint64_t sum;
+
+    // largest value recorded
+    uint64_t max;
+
+    uint64_t unused;
+
+    // values recorded in each bucket
+    uint64_t buckets[HistogramDecls::NUM_BUCKETS];
+};
+
+/// @brief a counter
+/// NOTE: only one thread may add at a time
+class Counter {
+public:
+    /// @brief add to the counter
+    /// @param val  the amount to add
+    void add(uint64_t val = 1) {
+        __atomic_store_n(&value, value + val, __ATOMIC_RELAXED);
+    }
+
+    /// @brief set the counter, for a gauge of current state
+    /// @param val  the value
+    void set(uint64_t val) {
+        __atomic_store_n(&value, val, __ATOMIC_RELAXED);
+    }
+
+    /// @brief get the value of the counter
+    uint64_t get() const {
+        return __atomic_load_n(&value, __ATOMIC_RELAXED);
+    }
+
+    uint64_t value;
+};
+
+#endif
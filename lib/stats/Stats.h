@@ -0,0 +1,165 @@
+/******************************************************************************
+*  Name: Stats.h
+*
+*  Purpose: Table of histograms and counters in shared memory, one per
+*           thread that records them, read live by gsw_stat
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "common/types.h"
+#include "lib/sync/Mutex.h"
+#include "lib/stats/Histogram.h"
+
+// every thread that records a stat gets its own entry, so recording never
+// contends with another thread and readers merge entries with the same name
+//
+// entries are never removed, an entry whose thread has exited is reused by
+// the next stat registered, so the table only holds live threads plus
+// however many have exited since the last registration
+//
+// the table is created by the first process to use it and never removed, if
+// it can't be created stats are recorded into private memory instead
+//
+// NOTE: uses its own mapping instead of PosixShm since PosixShm reports
+//       errors with a MessageLogger, which records stats here
+
+// Stats type and data declarations
+namespace StatsDecls {
+    /// @brief the name of the shared memory block
+    static const char* const SHM_NAME = "/gsw_stats";
+
+    /// the number of entries in the table
+    static const size_t MAX_ENTRIES = 256;
+
+    /// the longest stat name, including the NULL terminator
+    static const size_t MAX_NAME = 48;
+
+    /// written once the table is initialized
+    static const uint32_t MAGIC = 0x47535454;
+
+    /// the table layout version
+    static const uint32_t VERSION = 1;
+
+    /// @brief what an entry holds
+    typedef enum {
+        FREE = 0,
+        HISTOGRAM,
+        COUNTER,
+        GAUGE                       // a counter holding current state, set
+                                    // instead of added to
+    } type_t;
+
+    /// @brief what a histogram's values are
+    typedef enum {
+        NANOSECONDS = 0,
+        COUNT
+    } unit_t;
+
+    /// @brief an entry in the table
+    typedef struct {
+        char name[MAX_NAME];
+        uint32_t type;              // type_t, FREE while being (re)initialized
+        uint32_t unit;              // unit_t
+        int32_t pid;                // process that records it
+        int32_t tid;                // thread that registered it
+        uint32_t generation;        // incremented every time the entry is reused
+        uint32_t unused;
+        union {
+            Histogram hist;
+            Counter counter;
+        };
+    } entry_t;
+
+    /// @brief the shared memory block
+    typedef struct {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t count;             // number of entries in use
+        uint32_t unused;
+        Mutex lock;                 // held while claiming entries
+        entry_t entries[MAX_ENTRIES];
+    } table_t;
+};
+
+class Stats {
+public:
+    /// @brief constructor
+    Stats();
+
+    /// @brief destructor
+    virtual ~Stats();
+
+    /// @brief attach to the table, creating it if it doesn't exist
+    /// @return
+    RetType attach();
+
+    /// @brief detach from the table
+    /// @return
+    RetType detach();
+
+    /// @brief get a histogram for the calling thread to record into
+    /// @param name     the name of the stat, e.g. "Class::func" or
+    ///                 "process.stage"
+    /// @param unit     what the values are
+    /// @return the histogram, never NULL
+    /// NOTE: calling again from the same thread with the same name returns
+    ///       the same histogram
+    Histogram* histogram(const char* name, StatsDecls::unit_t unit = StatsDecls::NANOSECONDS);
+
+    /// @brief get a counter for the calling thread to add to
+    /// @param name     the name of the stat
+    /// @return the counter, never NULL
+    Counter* counter(const char* name);
+
+    /// @brief get a gauge for the calling thread to set
+    /// @param name     the name of the stat
+    /// @return the gauge, never NULL
+    /// NOTE: readers add up gauges with the same name, so a gauge set by
+    ///       several threads reads as their total
+    Counter* gauge(const char* name);
+
+    /// @brief get the number of entries in the table, 0 if not attached
+    size_t count();
+
+    /// @brief get an entry in the table
+    /// @param index    the entry index
+    /// @return the entry or NULL if out of range
+    const StatsDecls::entry_t* entry(size_t index);
+
+    /// @brief check if the thread that records an entry is still running
+    /// @param entry    the entry
+    /// @return true if running
+    static bool alive(const StatsDecls::entry_t* entry);
+
+    /// @brief get the table shared by every stat in the process
+    /// @return the table, attached if possible
+    static Stats* shared();
+
+    /// @brief get the number of times the process has forked into a child,
+    ///        counted in the child
+    /// @return the count
+    /// NOTE: stats a thread got before a fork still belong to the parent, a
+    ///       thread that caches them should get them again when this changes
+    static uint32_t forks();
+
+private:
+    /// @brief claim an entry for the calling thread
+    /// @param name     the name of the stat
+    /// @param type     the type of the entry
+    /// @param unit     the unit of a histogram
+    /// @return the entry or NULL if not attached or the table is full
+    StatsDecls::entry_t* claim(const char* name, StatsDecls::type_t type, StatsDecls::unit_t unit);
+
+    StatsDecls::table_t* m_table;
+};
+
+#endif
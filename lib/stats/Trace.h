@@ -0,0 +1,129 @@
+/******************************************************************************
+*  Name: Trace.h
+*
+*  Purpose: Records when each packet reaches each stage of the system, into a
+*           ring per process that gsw_trace exports as a Chrome trace
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lib/time/time.h"
+
+// a packet is identified by the UDP port it was received on and the sequence
+// number decom gave it, which is logged with it and copied into every
+// measurement extracted from it
+//
+// every process that records gets a ring in shared memory named after its
+// process ID, the oldest records are overwritten when it's full, rings are
+// left behind when the process exits so a run can be exported afterwards
+//
+// recording is compiled out unless GSW_TRACE is defined ('make TRACE=1'),
+// the TRACE_PACKET macros don't evaluate their arguments when it isn't
+
+#ifdef GSW_TRACE
+/// @brief record that a packet reached a stage now
+#define TRACE_PACKET(stage, port, seq) \
+    Trace::record((stage), (port), (seq), time_util::mono_ns())
+
+/// @brief record that a packet reached a stage at a monotonic time
+#define TRACE_PACKET_AT(stage, port, seq, mono) \
+    Trace::record((stage), (port), (seq), (mono))
+#else
+#define TRACE_PACKET(stage, port, seq) ((void)0)
+#define TRACE_PACKET_AT(stage, port, seq, mono) ((void)0)
+#endif
+
+// Trace type and data declarations
+namespace TraceDecls {
+    /// @brief the name prefix of trace rings, followed by the process ID
+    static const char* const SHM_PREFIX = "/gsw_trace_";
+
+    /// records in a ring, a power of 2
+    static const size_t RING_SIZE = 1 << 16;
+
+    /// the longest process name, including the NULL terminator
+    static const size_t MAX_NAME = 16;
+
+    /// written once the ring is initialized
+    static const uint32_t MAGIC = 0x47535452;
+
+    /// the ring layout version
+    static const uint32_t VERSION = 1;
+
+    /// @brief the stages a packet passes through, in order
+    typedef enum {
+        RECEIVE = 0,        // kernel receive timestamp in decom
+        LOG,                // handed to the packet logger
+        PUBLISH,            // measurements written to telemetry shared memory
+        LOGD_WRITE,         // copied into the packet log by gsw_logd
+        BROKER_READ,        // measurements read by the broker
+        BROKER_PUBLISH,     // measurements written to subscribers
+        CONSUMER_READ,      // measurement read by an application
+        NUM_STAGES
+    } stage_t;
+
+    /// @brief names of the stages
+    static const char* const stage_str[NUM_STAGES] = {
+        "receive",
+        "log",
+        "publish",
+        "logd_write",
+        "broker_read",
+        "broker_publish",
+        "consumer_read"
+    };
+
+    /// @brief a packet reaching a stage
+    typedef struct {
+        uint64_t seq;                       // sequence number of the packet
+        time_util::timestamp_t timestamp;   // monotonic time
+        int32_t tid;                        // thread that recorded it
+        uint32_t lap;                       // which pass around the ring
+                                            // wrote it, 0 while writing
+        uint16_t port;                      // UDP port of the packet
+        uint8_t stage;                      // stage_t
+        uint8_t unused[5];
+    } record_t;
+
+    /// @brief a ring in shared memory
+    typedef struct {
+        uint32_t magic;
+        uint32_t version;
+        int32_t pid;                        // process that records into it
+        char name[MAX_NAME];                // name of the process
+        uint32_t unused;
+        uint64_t head;                      // records ever written
+        uint8_t pad[64 - 40];
+        record_t records[RING_SIZE];
+    } ring_t;
+
+    static_assert(32 == sizeof(record_t), "trace records should stay 32 bytes");
+    static_assert(0 == (RING_SIZE & (RING_SIZE - 1)), "trace ring size must be a power of 2");
+};
+
+class Trace {
+public:
+    /// @brief record that a packet reached a stage, use the TRACE_PACKET
+    ///        macros instead so it's compiled out when tracing is disabled
+    /// @param stage        the stage
+    /// @param port         the UDP port of the packet
+    /// @param seq          the sequence number of the packet, 0 isn't traced
+    /// @param timestamp    monotonic time the packet reached the stage
+    static void record(TraceDecls::stage_t stage, uint16_t port, uint64_t seq,
+                       time_util::timestamp_t timestamp);
+
+    /// @brief copy the records of a ring, which may be written while copying
+    /// @param ring     the ring
+    /// @param out      filled with at most RING_SIZE records, oldest first
+    /// @return the number of records copied
+    static size_t copy(const TraceDecls::ring_t* ring, TraceDecls::record_t* out);
+};
+
+#endif
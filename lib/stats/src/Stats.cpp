@@ -0,0 +1,313 @@
+/******************************************************************************
+*  Name: Stats.cpp
+*
+*  Purpose: Table of histograms and counters in shared memory, one per
+*           thread that records them, read live by gsw_stat
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "lib/stats/Stats.h"
+
+using namespace StatsDecls;
+
+// NOTE: errors aren't logged here, loggers record stats
+
+/// value of the magic word while the creator initializes the table
+static const uint32_t INITIALIZING = 1;
+
+/// how long to wait for another process to initialize the table
+static const int INIT_WAIT_MS = 1000;
+
+/// number of times the process has forked into a child
+static uint32_t fork_count = 0;
+
+// where stats go when there's no entry for them (not attached or the table
+// is full), one of each kind shared by every caller since no one reads them,
+// so lost updates from threads recording at once don't matter
+static Histogram sink_hist;
+static Counter sink_counter;
+static Counter sink_gauge;
+
+/// @brief count a fork, run in the child
+static void count_fork() {
+    __atomic_add_fetch(&fork_count, 1, __ATOMIC_RELAXED);
+}
+
+/// @brief constructor
+Stats::Stats() : m_table(NULL) {
+    // nothing else to do
+}
+
+/// @brief destructor
+Stats::~Stats() {
+    detach();
+}
+
+/// @brief attach to the table, creating it if it doesn't exist
+/// @return
+RetType Stats::attach() {
+    if(NULL != m_table) {
+        return SUCCESS;
+    }
+
+    int fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
+    if(-1 == fd) {
+        return FAILURE;
+    }
+
+    // let every process record stats, regardless of umask
+    fchmod(fd, 0666);
+
+    // only ever grows the block, so racing creators all end up the same size
+    struct stat sb;
+    if(-1 == fstat(fd, &sb) ||
+       ((size_t)sb.st_size < sizeof(table_t) && -1 == ftruncate(fd, sizeof(table_t)))) {
+        close(fd);
+        return FAILURE;
+    }
+
+    void* addr = mmap(NULL, sizeof(table_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(MAP_FAILED == addr) {
+        return FAILURE;
+    }
+
+    table_t* table = (table_t*)addr;
+
+    // the first process to get here initializes the table, the block starts
+    // zeroed so every entry is already FREE
+    uint32_t expected = 0;
+    if(__atomic_compare_exchange_n(&table->magic, &expected, INITIALIZING, false,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        new (&table->lock) Mutex;
+        table->version = VERSION;
+        table->count = 0;
+
+        __atomic_store_n(&table->magic, MAGIC, __ATOMIC_RELEASE);
+    } else {
+        for(int i = 0; MAGIC != __atomic_load_n(&table->magic, __ATOMIC_ACQUIRE); i++) {
+            if(i >= INIT_WAIT_MS) {
+                // the creator died part way through or it's not a table
+                munmap(addr, sizeof(table_t));
+                return FAILURE;
+            }
+
+            usleep(1000);
+        }
+
+        if(VERSION != table->version) {
+            munmap(addr, sizeof(table_t));
+            return FAILURE;
+        }
+    }
+
+    m_table = table;
+
+    return SUCCESS;
+}
+
+/// @brief detach from the table
+/// @return
+RetType Stats::detach() {
+    if(NULL == m_table) {
+        return SUCCESS;
+    }
+
+    if(-1 == munmap(m_table, sizeof(table_t))) {
+        return FAILURE;
+    }
+
+    m_table = NULL;
+
+    return SUCCESS;
+}
+
+/// @brief check if the thread that records an entry is still running
+/// @param entry    the entry
+/// @return true if running
+bool Stats::alive(const entry_t* entry) {
+    // signal 0 only checks the thread exists, checking the thread group too
+    // catches a recycled tid in another process
+    if(-1 == syscall(SYS_tgkill, entry->pid, entry->tid, 0)) {
+        return ESRCH != errno;
+    }
+
+    return true;
+}
+
+/// @brief claim an entry for the calling thread
+/// @param name     the name of the stat
+/// @param type     the type of the entry
+/// @param unit     the unit of a histogram
+/// @return the entry or NULL if not attached or the table is full
+entry_t* Stats::claim(const char* name, type_t type, unit_t unit) {
+    if(NULL == m_table) {
+        return NULL;
+    }
+
+    pid_t pid = getpid();
+    pid_t tid = syscall(SYS_gettid);
+
+    m_table->lock.lock();
+
+    entry_t* entry = NULL;
+    entry_t* reuse = NULL;
+
+    uint32_t count = m_table->count;
+    for(uint32_t i = 0; i < count; i++) {
+        entry_t* curr = &m_table->entries[i];
+
+        if(FREE == curr->type) {
+            if(NULL == reuse) {
+                reuse = curr;
+            }
+            continue;
+        }
+
+        if(curr->pid == pid && curr->tid == tid && curr->type == (uint32_t)type &&
+           0 == strncmp(curr->name, name, MAX_NAME - 1)) {
+            entry = curr;
+            break;
+        }
+
+        if(NULL == reuse && !alive(curr)) {
+            reuse = curr;
+        }
+    }
+
+    if(NULL == entry) {
+        if(NULL == reuse && count < MAX_ENTRIES) {
+            reuse = &m_table->entries[count];
+            __atomic_store_n(&m_table->count, count + 1, __ATOMIC_RELEASE);
+        }
+
+        if(NULL != reuse) {
+            // readers check the type and generation around copying an entry,
+            // so they never report a half reset entry
+            uint32_t generation = reuse->generation + 1;
+            __atomic_store_n(&reuse->type, (uint32_t)FREE, __ATOMIC_RELEASE);
+
+            memset(reuse, 0, sizeof(entry_t));
+            strncpy(reuse->name, name, MAX_NAME - 1);
+            reuse->unit = unit;
+            reuse->pid = pid;
+            reuse->tid = tid;
+            reuse->generation = generation;
+
+            __atomic_store_n(&reuse->type, (uint32_t)type, __ATOMIC_RELEASE);
+
+            entry = reuse;
+        }
+    }
+
+    m_table->lock.unlock();
+
+    return entry;
+}
+
+/// @brief get a histogram for the calling thread to record into
+/// @param name     the name of the stat
+/// @param unit     what the values are
+/// @return the histogram, never NULL
+Histogram* Stats::histogram(const char* name, unit_t unit) {
+    entry_t* entry = claim(name, HISTOGRAM, unit);
+    if(NULL != entry) {
+        return &entry->hist;
+    }
+
+    // not attached or table full, record where no one will see it
+    return &sink_hist;
+}
+
+/// @brief get a counter for the calling thread to add to
+/// @param name     the name of the stat
+/// @return the counter, never NULL
+Counter* Stats::counter(const char* name) {
+    entry_t* entry = claim(name, COUNTER, NANOSECONDS);
+    if(NULL != entry) {
+        return &entry->counter;
+    }
+
+    return &sink_counter;
+}
+
+/// @brief get a gauge for the calling thread to set
+/// @param name     the name of the stat
+/// @return the gauge, never NULL
+Counter* Stats::gauge(const char* name) {
+    entry_t* entry = claim(name, GAUGE, COUNT);
+    if(NULL != entry) {
+        return &entry->counter;
+    }
+
+    return &sink_gauge;
+}
+
+/// @brief get the number of entries in the table, 0 if not attached
+size_t Stats::count() {
+    if(NULL == m_table) {
+        return 0;
+    }
+
+    return __atomic_load_n(&m_table->count, __ATOMIC_ACQUIRE);
+}
+
+/// @brief get an entry in the table
+/// @param index    the entry index
+/// @return the entry or NULL if out of range
+const entry_t* Stats::entry(size_t index) {
+    if(index >= count()) {
+        return NULL;
+    }
+
+    return &m_table->entries[index];
+}
+
+/// @brief get the table shared by every stat in the process
+/// @return the table, attached if possible
+Stats* Stats::shared() {
+    // function local so stats can be registered during static
+    // initialization, never destroyed since stats in other static objects
+    // may still point into it
+    static Stats* stats = NULL;
+    static Mutex lock;
+
+    lock.lock();
+
+    if(NULL == stats) {
+        stats = new Stats();
+
+        // don't care if this fails, stats are recorded privately
+        stats->attach();
+    }
+
+    lock.unlock();
+
+    return stats;
+}
+
+/// @brief get the number of times the process has forked into a child,
+///        counted in the child
+/// @return the count
+uint32_t Stats::forks() {
+    // anything cached checked this before the fork, so it's counted
+    static const int registered = pthread_atfork(NULL, NULL, count_fork);
+    (void)registered;
+
+    return __atomic_load_n(&fork_count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,179 @@
+/******************************************************************************
+*  Name: Trace.cpp
+*
+*  Purpose: Records when each packet reaches each stage of the system, into a
+*           ring per process that gsw_trace exports as a Chrome trace
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <string>
+
+#include "lib/stats/Trace.h"
+#include "lib/stats/Stats.h"
+#include "lib/sync/Mutex.h"
+
+using namespace TraceDecls;
+
+// NOTE: errors aren't logged here, packets are traced on the logging path
+
+/// @brief create the ring of the calling process, replacing one left by an
+///        exited process with the same ID
+/// @return the ring or NULL on failure
+static ring_t* create_ring() {
+    pid_t pid = getpid();
+    std::string name = SHM_PREFIX + std::to_string(pid);
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+    if(-1 == fd) {
+        return NULL;
+    }
+
+    // let gsw_trace remove it, regardless of umask
+    fchmod(fd, 0666);
+
+    if(-1 == ftruncate(fd, sizeof(ring_t))) {
+        close(fd);
+        return NULL;
+    }
+
+    void* addr = mmap(NULL, sizeof(ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(MAP_FAILED == addr) {
+        return NULL;
+    }
+
+    ring_t* ring = (ring_t*)addr;
+
+    // readers skip the ring until the magic is written, the records of a
+    // ring left by an exited process are cleared too
+    __atomic_store_n(&ring->magic, 0, __ATOMIC_RELEASE);
+    memset(ring, 0, sizeof(ring_t));
+
+    ring->version = VERSION;
+    ring->pid = pid;
+
+    FILE* comm = fopen("/proc/self/comm", "r");
+    if(NULL != comm) {
+        if(NULL != fgets(ring->name, sizeof(ring->name), comm)) {
+            ring->name[strcspn(ring->name, "\n")] = '\0';
+        }
+        fclose(comm);
+    }
+
+    __atomic_store_n(&ring->magic, MAGIC, __ATOMIC_RELEASE);
+
+    return ring;
+}
+
+/// @brief get the ring of the calling process, creating it the first time
+/// @return the ring or NULL if it couldn't be created
+static ring_t* shared_ring() {
+    // never unmapped, other threads may be recording
+    static ring_t* ring = NULL;
+    static uint32_t forks = 0;
+    static bool failed = false;
+    static Mutex lock;
+
+    // a child of a fork gets its own ring
+    uint32_t curr = Stats::forks();
+    ring_t* ret = __atomic_load_n(&ring, __ATOMIC_ACQUIRE);
+    if(NULL != ret && curr == __atomic_load_n(&forks, __ATOMIC_RELAXED)) {
+        return ret;
+    }
+
+    lock.lock();
+
+    if(curr != forks) {
+        ring = NULL;
+        failed = false;
+    }
+
+    // don't keep retrying if shared memory isn't available
+    if(NULL == ring && !failed) {
+        ring_t* fresh = create_ring();
+        failed = (NULL == fresh);
+        __atomic_store_n(&forks, curr, __ATOMIC_RELAXED);
+        __atomic_store_n(&ring, fresh, __ATOMIC_RELEASE);
+    }
+
+    ret = ring;
+
+    lock.unlock();
+
+    return ret;
+}
+
+/// @brief record that a packet reached a stage
+/// @param stage        the stage
+/// @param port         the UDP port of the packet
+/// @param seq          the sequence number of the packet, 0 isn't traced
+/// @param timestamp    monotonic time the packet reached the stage
+void Trace::record(stage_t stage, uint16_t port, uint64_t seq, time_util::timestamp_t timestamp) {
+    if(0 == seq) {
+        return;
+    }
+
+    ring_t* ring = shared_ring();
+    if(NULL == ring) {
+        return;
+    }
+
+    // every thread in the process shares the ring
+    static thread_local pid_t tid = syscall(SYS_gettid);
+
+    uint64_t index = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+    record_t* rec = &ring->records[index & (RING_SIZE - 1)];
+
+    // readers skip the record while it's being written
+    __atomic_store_n(&rec->lap, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    rec->seq = seq;
+    rec->timestamp = timestamp;
+    rec->tid = tid;
+    rec->port = port;
+    rec->stage = stage;
+
+    __atomic_store_n(&rec->lap, (uint32_t)(index / RING_SIZE) + 1, __ATOMIC_RELEASE);
+}
+
+/// @brief copy the records of a ring, which may be written while copying
+/// @param ring     the ring
+/// @param out      filled with at most RING_SIZE records, oldest first
+/// @return the number of records copied
+size_t Trace::copy(const ring_t* ring, record_t* out) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t start = (head > RING_SIZE) ? head - RING_SIZE : 0;
+
+    size_t count = 0;
+    for(uint64_t index = start; index < head; index++) {
+        const record_t* rec = &ring->records[index & (RING_SIZE - 1)];
+        uint32_t lap = (uint32_t)(index / RING_SIZE) + 1;
+
+        // skip records being written or already overwritten by the next lap
+        if(lap != __atomic_load_n(&rec->lap, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        out[count] = *rec;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(lap != __atomic_load_n(&rec->lap, __ATOMIC_RELAXED)) {
+            continue;
+        }
+
+        count++;
+    }
+
+    return count;
+}
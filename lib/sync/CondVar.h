@@ -0,0 +1,110 @@
+/*******************************************************************************
+*
+*  Name: CondVar.h
+*
+*  Purpose: Provide implementation for a process-shared condition variable
+*           used together with Mutex that spins adaptively before sleeping.
+*
+*  Author: Will Merges
+*
+*******************************************************************************/
+#ifndef CONDVAR_H
+#define CONDVAR_H
+
+#include <stdint.h>
+
+#include "common/types.h"
+#include "lib/sync/Futex.h"
+#include "lib/sync/Mutex.h"
+
+/// @brief condition variable
+/// As with any condition variable, waiters can wake up spuriously and should
+/// re-check their condition in a loop
+/// Can be placed in shared memory, in which case exactly one process should
+/// construct it (e.g. with placement new) and the rest use it in place
+/// NOTE: gcc specific (uses __atomic builtins)
+class CondVar {
+public:
+    /// @brief constructor
+    CondVar() : m_seq(0), m_waiters(0), m_contended(0),
+                m_spin(futex::INITIAL_SPIN) {};
+
+    /// @brief atomically unlock 'mutex' and wait to be signaled
+    /// @param mutex        a mutex locked by the caller, locked again on return
+    /// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+    ///                     block forever
+    /// @return SUCCESS if woken up, FAILURE on timeout
+    /// NOTE: the mutex is re-locked before returning in both cases
+    RetType wait(Mutex& mutex, int timeout_ms = -1) {
+        struct timespec ts;
+        struct timespec* deadline = futex::deadline(timeout_ms, &ts);
+
+        // any signal after this point changes the sequence number, so the
+        // futex wait returns immediately if we are signaled after unlocking
+        uint32_t seq = __atomic_load_n(&m_seq, __ATOMIC_SEQ_CST);
+
+        mutex.unlock();
+
+        uint32_t spin = __atomic_load_n(&m_spin, __ATOMIC_RELAXED);
+        for(uint32_t i = 0; i < spin; i++) {
+            futex::cpu_relax();
+
+            if(__atomic_load_n(&m_seq, __ATOMIC_SEQ_CST) != seq) {
+                futex::adapt(&m_spin, i, false);
+                mutex.lock();
+                return SUCCESS;
+            }
+        }
+
+        // spinning didn't pay off, go to sleep
+        futex::adapt(&m_spin, spin, true);
+        __atomic_add_fetch(&m_contended, 1, __ATOMIC_RELAXED);
+
+        // the waiter count has to be visible before the sequence number is
+        // checked by the futex, otherwise 'signal' may not wake us
+        __atomic_add_fetch(&m_waiters, 1, __ATOMIC_SEQ_CST);
+        long ret = futex::wait(&m_seq, seq, deadline);
+        int err = errno;
+
+        __atomic_sub_fetch(&m_waiters, 1, __ATOMIC_SEQ_CST);
+        mutex.lock();
+
+        if(-1 == ret && ETIMEDOUT == err) {
+            return FAILURE;
+        }
+
+        return SUCCESS;
+    }
+
+    /// @brief wake up one waiter
+    void signal() {
+        __atomic_add_fetch(&m_seq, 1, __ATOMIC_SEQ_CST);
+
+        if(__atomic_load_n(&m_waiters, __ATOMIC_SEQ_CST)) {
+            futex::wake(&m_seq, 1);
+        }
+    }
+
+    /// @brief wake up all waiters
+    void broadcast() {
+        __atomic_add_fetch(&m_seq, 1, __ATOMIC_SEQ_CST);
+
+        if(__atomic_load_n(&m_waiters, __ATOMIC_SEQ_CST)) {
+            futex::wake(&m_seq);
+        }
+    }
+
+    /// @brief get the number of times a waiter had to sleep
+    /// @return the contention count
+    uint32_t contention() {
+        return __atomic_load_n(&m_contended, __ATOMIC_RELAXED);
+    }
+
+private:
+    uint32_t m_seq;         // futex word
+    uint32_t m_waiters;     // number of sleeping waiters
+    uint32_t m_contended;   // number of waits that had to sleep
+    uint32_t m_spin;        // adaptive spin count
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*******************************************************************************
+*
+*  Name: Event.h
+*
+*  Purpose: Provide implementation for a process-shared event that processes
+*           spin on adaptively, then sleep on until it is signaled.
+*
+*  Author: Will Merges
+*
+*******************************************************************************/
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdint.h>
+
+#include "common/types.h"
+#include "lib/sync/Futex.h"
+
+/// @brief event counter
+/// Every call to 'signal' increments a sequence number, waiters pass in the
+/// last sequence number they saw and sleep until it changes. Since waiters
+/// compare against their own sequence number no signals are ever missed.
+/// Can be placed in shared memory, in which case exactly one process should
+/// construct it (e.g. with placement new) and the rest use it in place
+/// NOTE: gcc specific (uses __atomic builtins)
+class Event {
+public:
+    /// @brief constructor
+    Event() : m_seq(0), m_waiters(0), m_contended(0),
+              m_spin(futex::INITIAL_SPIN) {};
+
+    /// @brief signal the event, waking all waiters
+    /// NOTE: never blocks, only makes a system call if someone is sleeping
+    void signal() {
+        __atomic_add_fetch(&m_seq, 1, __ATOMIC_SEQ_CST);
+
+        if(__atomic_load_n(&m_waiters, __ATOMIC_SEQ_CST)) {
+            futex::wake(&m_seq);
+        }
+    }
+
+    /// @brief get the current sequence number
+    /// @return the number of times the event has been signaled
+    uint32_t sequence() {
+        return __atomic_load_n(&m_seq, __ATOMIC_SEQ_CST);
+    }
+
+    /// @brief wait for the event to be signaled
+    /// @param seq          the last sequence number seen, returns as soon as
+    ///                     the sequence number differs from this
+    /// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+    ///                     block forever
+    /// @return SUCCESS if signaled, FAILURE on timeout
+    RetType wait(uint32_t seq, int timeout_ms = -1) {
+        if(sequence() != seq) {
+            return SUCCESS;
+        }
+
+        struct timespec ts;
+        return wait_until(seq, futex::deadline(timeout_ms, &ts));
+    }
+
+    /// @brief wait for the event to be signaled, until a deadline
+    /// @param seq          the last sequence number seen, returns as soon as
+    ///                     the sequence number differs from this
+    /// @param deadline     absolute CLOCK_MONOTONIC deadline (see
+    ///                     futex::deadline) or NULL to block forever
+    /// @return SUCCESS if signaled, FAILURE once the deadline passes
+    RetType wait_until(uint32_t seq, const struct timespec* deadline) {
+        if(sequence() != seq) {
+            return SUCCESS;
+        }
+
+        uint32_t spin = __atomic_load_n(&m_spin, __ATOMIC_RELAXED);
+        for(uint32_t i = 0; i < spin; i++) {
+            futex::cpu_relax();
+
+            if(sequence() != seq) {
+                futex::adapt(&m_spin, i, false);
+                return SUCCESS;
+            }
+        }
+
+        // spinning didn't pay off, go to sleep
+        futex::adapt(&m_spin, spin, true);
+        __atomic_add_fetch(&m_contended, 1, __ATOMIC_RELAXED);
+
+        while(sequence() == seq) {
+            // the waiter count has to be visible before the sequence number is
+            // checked by the futex, otherwise 'signal' may not wake us
+            __atomic_add_fetch(&m_waiters, 1, __ATOMIC_SEQ_CST);
+            long ret = futex::wait(&m_seq, seq, deadline);
+            int err = errno;
+            __atomic_sub_fetch(&m_waiters, 1, __ATOMIC_SEQ_CST);
+
+            if(-1 == ret && ETIMEDOUT == err) {
+                return (sequence() != seq) ? SUCCESS : FAILURE;
+            }
+        }
+
+        return SUCCESS;
+    }
+
+    /// @brief get the number of times a waiter had to sleep
+    /// @return the contention count
+    uint32_t contention() {
+        return __atomic_load_n(&m_contended, __ATOMIC_RELAXED);
+    }
+
+private:
+    uint32_t m_seq;         // futex word
+    uint32_t m_waiters;     // number of sleeping waiters
+    uint32_t m_contended;   // number of waits that had to sleep
+    uint32_t m_spin;        // adaptive spin count
+};
+
+#endif
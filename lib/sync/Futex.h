@@ -0,0 +1,103 @@
+/*******************************************************************************
+*
+*  Name: Futex.h
+*
+*  Purpose: Thin wrappers around the futex system call and spinning helpers
+*           shared by the process-shared synchronization primitives.
+*
+*  Author: Will Merges
+*
+*******************************************************************************/
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// NOTE: none of the primitives use FUTEX_PRIVATE_FLAG so they work when placed
+//       in memory shared between processes (e.g. a Shm block)
+
+namespace futex {
+    /// the most iterations any primitive will spin before sleeping
+    static const uint32_t MAX_SPIN = 4096;
+
+    /// the number of iterations to spin for the first acquire
+    static const uint32_t INITIAL_SPIN = 64;
+
+    /// @brief hint to the processor that we are in a spin loop
+    inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+    /// @brief convert a relative timeout to an absolute CLOCK_MONOTONIC deadline
+    /// @param timeout_ms   timeout in milliseconds, or -1 for no timeout
+    /// @param deadline     filled with the deadline
+    /// @return 'deadline' or NULL if there is no timeout
+    inline struct timespec* deadline(int timeout_ms, struct timespec* deadline) {
+        if(timeout_ms < 0) {
+            return NULL;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, deadline);
+        deadline->tv_sec += timeout_ms / 1000;
+        deadline->tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if(deadline->tv_nsec >= 1000000000L) {
+            deadline->tv_sec++;
+            deadline->tv_nsec -= 1000000000L;
+        }
+
+        return deadline;
+    }
+
+    /// @brief sleep as long as '*addr' equals 'val'
+    /// @param addr         the futex word
+    /// @param val          the expected value of the futex word
+    /// @param deadline     absolute CLOCK_MONOTONIC deadline or NULL to wait forever
+    /// @return 0 if woken up (or spuriously), -1 with errno set otherwise
+    ///         (ETIMEDOUT on timeout, EAGAIN if '*addr' did not equal 'val')
+    inline long wait(uint32_t* addr, uint32_t val, const struct timespec* deadline) {
+        // FUTEX_WAIT_BITSET takes an absolute timeout, unlike FUTEX_WAIT
+        return syscall(SYS_futex, addr, FUTEX_WAIT_BITSET, val, deadline,
+                       NULL, FUTEX_BITSET_MATCH_ANY);
+    }
+
+    /// @brief wake up processes sleeping on a futex word
+    /// @param addr     the futex word
+    /// @param count    the maximum number of waiters to wake
+    /// @return the number of waiters woken up
+    inline long wake(uint32_t* addr, int count = INT_MAX) {
+        return syscall(SYS_futex, addr, FUTEX_WAKE, count, NULL, NULL, 0);
+    }
+
+    /// @brief update an adaptive spin count after an acquire
+    /// @param spin     the spin count to update
+    /// @param used     the number of iterations spun before acquiring
+    /// @param slept    true if spinning failed and the acquire had to sleep
+    inline void adapt(uint32_t* spin, uint32_t used, bool slept) {
+        // move the spin count 1/8th of the way towards a target so spinning
+        // grows while it pays off and backs off when the holder is slow
+        // (e.g. descheduled because we share its core)
+        int32_t curr = __atomic_load_n(spin, __ATOMIC_RELAXED);
+        int32_t target = slept ? (curr / 2) : (int32_t)(used * 2);
+        int32_t next = curr + ((target - curr) / 8);
+
+        if(next > (int32_t)MAX_SPIN) {
+            next = MAX_SPIN;
+        } else if(next < 1) {
+            next = 1;
+        }
+
+        __atomic_store_n(spin, (uint32_t)next, __ATOMIC_RELAXED);
+    }
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*******************************************************************************
+*
+*  Name: Mutex.h
+*
+*  Purpose: Provide implementation for a process-shared mutex that spins
+*           adaptively before sleeping on a futex.
+*
+*  Author: Will Merges
+*
+*******************************************************************************/
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include <stdint.h>
+
+#include "common/types.h"
+#include "lib/sync/Futex.h"
+
+// the mutex state is one of
+// 0 - unlocked
+// 1 - locked, no sleeping waiters
+// 2 - locked, possibly sleeping waiters (unlock must wake one)
+// see "Futexes Are Tricky" by Ulrich Drepper
+
+/// @brief mutual exclusion lock
+/// Can be placed in shared memory, in which case exactly one process should
+/// construct it (e.g. with placement new) and the rest use it in place
+/// NOTE: gcc specific (uses __atomic builtins)
+class Mutex {
+public:
+    /// @brief constructor, mutex starts unlocked
+    Mutex() : m_state(0), m_contended(0), m_spin(futex::INITIAL_SPIN) {};
+
+    /// @brief attempt to lock the mutex without blocking
+    /// @return true if the mutex was locked
+    bool try_lock() {
+        uint32_t expected = 0;
+        return __atomic_compare_exchange_n(&m_state, &expected, 1, false,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+    }
+
+    /// @brief lock the mutex
+    /// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+    ///                     block forever
+    /// @return SUCCESS if locked, FAILURE on timeout
+    RetType lock(int timeout_ms = -1) {
+        uint32_t spin = __atomic_load_n(&m_spin, __ATOMIC_RELAXED);
+        for(uint32_t i = 0; i < spin; i++) {
+            // only attempt the (cache line stealing) CAS if it looks unlocked
+            if(0 == __atomic_load_n(&m_state, __ATOMIC_RELAXED) && try_lock()) {
+                futex::adapt(&m_spin, i, false);
+                return SUCCESS;
+            }
+
+            futex::cpu_relax();
+        }
+
+        futex::adapt(&m_spin, spin, true);
+        __atomic_add_fetch(&m_contended, 1, __ATOMIC_RELAXED);
+
+        struct timespec ts;
+        struct timespec* deadline = futex::deadline(timeout_ms, &ts);
+
+        // mark the mutex as having waiters, if it was unlocked we now own it
+        while(0 != __atomic_exchange_n(&m_state, 2, __ATOMIC_ACQUIRE)) {
+            if(-1 == futex::wait(&m_state, 2, deadline) && ETIMEDOUT == errno) {
+                // one last attempt, leaving the state as 2 is safe since it
+                // only costs the next unlock an unnecessary wake
+                if(0 == __atomic_exchange_n(&m_state, 2, __ATOMIC_ACQUIRE)) {
+                    return SUCCESS;
+                }
+
+                return FAILURE;
+            }
+        }
+
+        return SUCCESS;
+    }
+
+    /// @brief unlock the mutex
+    /// NOTE: only makes a system call if another process may be sleeping
+    void unlock() {
+        if(2 == __atomic_exchange_n(&m_state, 0, __ATOMIC_RELEASE)) {
+            futex::wake(&m_state, 1);
+        }
+    }
+
+    /// @brief get the number of times a lock had to sleep
+    /// @return the contention count
+    uint32_t contention() {
+        return __atomic_load_n(&m_contended, __ATOMIC_RELAXED);
+    }
+
+private:
+    uint32_t m_state;       // futex word
+    uint32_t m_contended;   // number of locks that had to sleep
+    uint32_t m_spin;        // adaptive spin count
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*******************************************************************************
+*
+*  Name: Semaphore.h
+*
+*  Purpose: Provide implementation for a process-shared counting semaphore
+*           that spins adaptively before sleeping on a futex.
+*
+*  Author: Will Merges
+*
+*******************************************************************************/
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include <stdint.h>
+
+#include "common/types.h"
+#include "lib/sync/Futex.h"
+
+/// @brief counting semaphore
+/// Can be placed in shared memory, in which case exactly one process should
+/// construct it (e.g. with placement new) and the rest use it in place
+/// NOTE: gcc specific (uses __atomic builtins)
+class Semaphore {
+public:
+    /// @brief constructor
+    /// @param val  initial value
+    Semaphore(uint32_t val) : m_val(val), m_waiters(0), m_contended(0),
+                              m_spin(futex::INITIAL_SPIN) {};
+
+    /// @brief increment the semaphore, releasing a resource
+    /// NOTE: only makes a system call if another process is sleeping
+    void release() {
+        __atomic_add_fetch(&m_val, 1, __ATOMIC_SEQ_CST);
+
+        if(__atomic_load_n(&m_waiters, __ATOMIC_SEQ_CST)) {
+            futex::wake(&m_val, 1);
+        }
+    }
+
+    /// @brief attempt to decrement the semaphore without blocking
+    /// @return true if a resource was acquired
+    bool try_acquire() {
+        uint32_t expected = __atomic_load_n(&m_val, __ATOMIC_RELAXED);
+
+        while(expected) {
+            if(__atomic_compare_exchange_n(&m_val, &expected, expected - 1, false,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return true;
+            } // otherwise 'expected' was updated to the new value, try again
+        }
+
+        return false;
+    }
+
+    /// @brief decrement the semaphore, acquiring a resource
+    /// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+    ///                     block forever
+    /// @return SUCCESS if acquired, FAILURE on timeout
+    RetType acquire(int timeout_ms = -1) {
+        uint32_t spin = __atomic_load_n(&m_spin, __ATOMIC_RELAXED);
+        for(uint32_t i = 0; i < spin; i++) {
+            if(try_acquire()) {
+                futex::adapt(&m_spin, i, false);
+                return SUCCESS;
+            }
+
+            futex::cpu_relax();
+        }
+
+        // spinning didn't pay off, go to sleep
+        futex::adapt(&m_spin, spin, true);
+        __atomic_add_fetch(&m_contended, 1, __ATOMIC_RELAXED);
+
+        struct timespec ts;
+        struct timespec* deadline = futex::deadline(timeout_ms, &ts);
+
+        while(!try_acquire()) {
+            __atomic_add_fetch(&m_waiters, 1, __ATOMIC_SEQ_CST);
+            long ret = futex::wait(&m_val, 0, deadline);
+            int err = errno;
+            __atomic_sub_fetch(&m_waiters, 1, __ATOMIC_SEQ_CST);
+
+            if(-1 == ret && ETIMEDOUT == err) {
+                return try_acquire() ? SUCCESS : FAILURE;
+            }
+        }
+
+        return SUCCESS;
+    }
+
+    /// @brief get the current value of the semaphore
+    /// @return the number of available resources
+    uint32_t value() {
+        return __atomic_load_n(&m_val, __ATOMIC_RELAXED);
+    }
+
+    /// @brief get the number of times an acquire had to sleep
+    /// @return the contention count
+    uint32_t contention() {
+        return __atomic_load_n(&m_contended, __ATOMIC_RELAXED);
+    }
+
+private:
+    uint32_t m_val;         // futex word
+    uint32_t m_waiters;     // number of sleeping acquirers
+    uint32_t m_contended;   // number of acquires that had to sleep
+    uint32_t m_spin;        // adaptive spin count
+};
+
+#endif
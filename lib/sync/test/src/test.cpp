@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <new>
+
+#include "lib/sync/Mutex.h"
+#include "lib/sync/Semaphore.h"
+#include "lib/sync/Event.h"
+#include "lib/sync/CondVar.h"
+
+// every primitive is used from a shared anonymous mapping, the same way it's
+// used from a Shm block, cross process tests fork a child that shares it
+
+static int failures = 0;
+
+static void check(bool cond, const char* msg) {
+    if(!cond) {
+        printf("failed sync unit test, %s :(\n", msg);
+        failures++;
+    }
+}
+
+static double mono_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e3) + (ts.tv_nsec / 1e6);
+}
+
+/// @brief everything the tests share, placed in a shared mapping
+typedef struct {
+    Mutex mutex;
+    Semaphore sem;
+    Event event;
+    CondVar cond;
+    uint32_t ready;     // protected by mutex
+    uint32_t value;
+} shared_t;
+
+static shared_t* shared = NULL;
+
+static void* hold_mutex(void*) {
+    shared->mutex.lock();
+    usleep(20000);
+    shared->value = 1;
+    shared->mutex.unlock();
+
+    return NULL;
+}
+
+static void test_mutex() {
+    Mutex& mutex = shared->mutex;
+
+    check(mutex.try_lock(), "try_lock on an unlocked mutex failed");
+    check(!mutex.try_lock(), "try_lock on a locked mutex succeeded");
+
+    // timeout while held
+    double start = mono_ms();
+    check(FAILURE == mutex.lock(30), "lock on a held mutex didn't time out");
+    double elapsed = mono_ms() - start;
+    check(elapsed >= 29 && elapsed < 500, "mutex timed out at the wrong time");
+
+    mutex.unlock();
+    check(SUCCESS == mutex.lock(0), "timed lock on an unlocked mutex failed");
+    mutex.unlock();
+
+    // a blocked lock gets the mutex once it's released
+    shared->value = 0;
+    pthread_t thread;
+    pthread_create(&thread, NULL, hold_mutex, NULL);
+    usleep(5000);
+    check(SUCCESS == mutex.lock(1000), "mutex wasn't handed over on unlock");
+    check(1 == shared->value, "mutex locked while held");
+    mutex.unlock();
+    pthread_join(thread, NULL);
+}
+
+static void test_semaphore() {
+    Semaphore& sem = shared->sem;
+
+    check(sem.try_acquire(), "try_acquire with a resource failed");
+    check(!sem.try_acquire(), "try_acquire without a resource succeeded");
+
+    double start = mono_ms();
+    check(FAILURE == sem.acquire(30), "acquire without a resource didn't time out");
+    double elapsed = mono_ms() - start;
+    check(elapsed >= 29 && elapsed < 500, "semaphore timed out at the wrong time");
+
+    sem.release();
+    sem.release();
+    check(2 == sem.value(), "release didn't add a resource");
+    check(SUCCESS == sem.acquire(0) && SUCCESS == sem.acquire(0), "timed acquire with resources failed");
+    check(0 == sem.value(), "acquire didn't take a resource");
+}
+
+static void test_event() {
+    Event& event = shared->event;
+
+    uint32_t seq = event.sequence();
+    double start = mono_ms();
+    check(FAILURE == event.wait(seq, 30), "wait on an unsignaled event didn't time out");
+    double elapsed = mono_ms() - start;
+    check(elapsed >= 29 && elapsed < 500, "event timed out at the wrong time");
+
+    // a signal before the wait isn't missed
+    event.signal();
+    check(SUCCESS == event.wait(seq, 0), "signal before the wait was missed");
+
+    struct timespec ts;
+    seq = event.sequence();
+    check(FAILURE == event.wait_until(seq, futex::deadline(10, &ts)), "wait_until didn't time out");
+}
+
+static void test_condvar() {
+    shared->mutex.lock();
+
+    double start = mono_ms();
+    check(FAILURE == shared->cond.wait(shared->mutex, 30), "wait on an unsignaled condvar didn't time out");
+    double elapsed = mono_ms() - start;
+    check(elapsed >= 29 && elapsed < 500, "condvar timed out at the wrong time");
+    check(!shared->mutex.try_lock(), "condvar timeout didn't relock the mutex");
+
+    shared->mutex.unlock();
+}
+
+// the child waits on each primitive in turn while the parent wakes it, its
+// exit status is the number of failures it saw
+static void test_cross_process() {
+    shared->value = 0;
+    shared->ready = 0;
+    uint32_t seq = shared->event.sequence();
+    uint32_t slept = shared->event.contention();
+
+    pid_t pid = fork();
+    if(0 == pid) {
+        int fails = 0;
+
+        // every wait has to end well before its timeout, a wait that times
+        // out after the parent signaled can still return SUCCESS
+        double start = mono_ms();
+
+        // woken by the event
+        if(SUCCESS != shared->event.wait(seq, 5000) ||
+           1 != __atomic_load_n(&shared->value, __ATOMIC_ACQUIRE) ||
+           mono_ms() - start > 1000) {
+            fails++;
+        }
+
+        // woken by the semaphore
+        start = mono_ms();
+        if(SUCCESS != shared->sem.acquire(5000) || mono_ms() - start > 1000) {
+            fails++;
+        }
+
+        // woken by the condition variable
+        shared->mutex.lock();
+        shared->ready = 1;
+        start = mono_ms();
+        while(2 != shared->value) {
+            if(SUCCESS != shared->cond.wait(shared->mutex, 5000)) {
+                fails++;
+                break;
+            }
+        }
+        if(mono_ms() - start > 1000) {
+            fails++;
+        }
+        shared->mutex.unlock();
+
+        _exit(fails);
+    }
+
+    // long enough for the child to be asleep, not spinning
+    usleep(50000);
+    __atomic_store_n(&shared->value, 1, __ATOMIC_RELEASE);
+    shared->event.signal();
+
+    usleep(50000);
+    shared->sem.release();
+
+    // wait for the child to be waiting on the condition variable
+    while(true) {
+        shared->mutex.lock();
+        bool ready = shared->ready;
+        shared->mutex.unlock();
+
+        if(ready) {
+            break;
+        }
+
+        usleep(1000);
+    }
+
+    usleep(50000);
+    shared->mutex.lock();
+    shared->value = 2;
+    shared->cond.signal();
+    shared->mutex.unlock();
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    check(WIFEXITED(status) && 0 == WEXITSTATUS(status), "child process wasn't woken");
+    check(shared->event.contention() > slept, "cross process event wait never slept");
+}
+
+int main() {
+    shared = (shared_t*)mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(MAP_FAILED == shared) {
+        printf("failed sync unit test, couldn't map shared memory :(\n");
+        return 1;
+    }
+
+    new (&shared->mutex) Mutex();
+    new (&shared->sem) Semaphore(1);
+    new (&shared->event) Event();
+    new (&shared->cond) CondVar();
+
+    test_mutex();
+    test_semaphore();
+    test_event();
+    test_condvar();
+    test_cross_process();
+
+    munmap(shared, sizeof(shared_t));
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+/******************************************************************************
+*  Name: BatchDecoder.h
+*
+*  Purpose: Decodes every measurement in a packet at once, using SIMD
+*           instructions to byte swap and convert groups of same-typed fields
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef BATCH_DECODER_H
+#define BATCH_DECODER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "lib/telemetry/TelemetryConfig.h"
+
+// measurements are sorted into groups of fields that share a size, byte order
+// and type (e.g. every big endian 32 bit signed integer), each group is decoded
+// several fields at a time with gather, shuffle, convert, multiply and add
+// instructions, every instruction set gives the same results as field::value
+// bit for bit
+// fields that don't fit a group (bit fields, 8 bit fields, ...) are decoded
+// one at a time after the groups
+//
+// output is a structure of arrays, one array of raw values and one array of
+// values in engineering units, both in "slot" order so each group is written
+// contiguously, use 'slot' to find where a measurement ended up
+//
+// each measurement has its own triple buffer, so the arrays are scratch space
+// that Extractor copies out of, lib/telemetry/test checks every instruction
+// set against field::raw / field::value and 'gsw_bench decoder' times them
+
+// Batch decoder type and data declarations
+namespace BatchDecoderDecls {
+    /// @brief instruction sets the decoder can use
+    typedef enum {
+        SCALAR = 0,
+        SSE4,       // SSE4.1
+        AVX2
+    } isa_t;
+
+    /// maps instruction sets to strings
+    extern const char* isa_str[AVX2 + 1];
+};
+
+class BatchDecoder {
+public:
+    /// @brief constructor
+    /// @param packet   the packet layout to decode
+    /// @param max_isa  the best instruction set to use, the best one the
+    ///                 processor supports up to this is used
+    BatchDecoder(const TelemetryConfigDecls::packet_info_t& packet,
+                 BatchDecoderDecls::isa_t max_isa = BatchDecoderDecls::AVX2);
+
+    /// @brief decode every measurement in a packet
+    /// @param pkt      the packet data, must be at least 'min_size' bytes
+    /// @param raw      array of raw values, one per measurement in slot order
+    /// @param value    array of engineering values, one per measurement in slot order
+    void decode(const uint8_t* pkt, uint64_t* raw, double* value);
+
+    /// @brief get the output slot of a measurement
+    /// @param measurement  index of the measurement in the packet
+    /// @return index into the 'raw' and 'value' arrays
+    size_t slot(size_t measurement) { return m_slots[measurement]; }
+
+    /// @brief get the smallest packet that holds every measurement
+    /// @return the size in bytes
+    size_t min_size() { return m_minSize; }
+
+    /// @brief get the instruction set in use
+    /// @return the instruction set
+    BatchDecoderDecls::isa_t isa() { return m_isa; }
+
+private:
+    /// @brief fields of the same size, byte order and type
+    typedef struct {
+        size_t bits;                        // 16, 32 or 64
+        TelemetryConfigDecls::endian_t endian;
+        TelemetryConfigDecls::type_t type;
+        size_t first;                       // first output slot
+        std::vector<int32_t> offsets;       // load offset of each field
+        std::vector<double> scale;
+        std::vector<double> bias;
+    } group_t;
+
+    void decode_group_scalar(const group_t& group, const uint8_t* pkt, uint64_t* raw, double* value);
+    void decode_group_sse4(const group_t& group, const uint8_t* pkt, uint64_t* raw, double* value);
+    void decode_group_avx2(const group_t& group, const uint8_t* pkt, uint64_t* raw, double* value);
+
+    const TelemetryConfigDecls::packet_info_t& m_packet;
+    std::vector<group_t> m_groups;
+    std::vector<size_t> m_scalar;           // measurements decoded one at a time
+    size_t m_scalarFirst;                   // first output slot of 'm_scalar'
+    std::vector<size_t> m_slots;            // maps measurement index to slot
+    size_t m_minSize;
+    BatchDecoderDecls::isa_t m_isa;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/******************************************************************************
+*  Name: Extractor.h
+*
+*  Purpose: Extracts measurements from packets according to the telemetry
+*           configuration
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef EXTRACTOR_H
+#define EXTRACTOR_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "common/types.h"
+#include "lib/telemetry/TelemetryConfig.h"
+#include "lib/telemetry/TelemetryShm.h"
+#include "lib/telemetry/BatchDecoder.h"
+
+// by default measurements are extracted by interpreting the configuration
+// with a BatchDecoder, which decodes groups of same-typed fields with SIMD
+// instructions
+// gsw_schemac generates a straight-line extraction kernel for each packet in a
+// configuration that an Extractor can use instead
+
+// Extractor type and data declarations
+namespace ExtractorDecls {
+    /// @brief an extraction kernel for one packet
+    /// @param pkt  the packet data
+    /// @param len  the length of the packet in bytes
+    /// @param out  array of measurements to fill in
+    /// @return FAILURE if the packet is too short
+    typedef RetType (*kernel_t)(const uint8_t* pkt, size_t len,
+                                TelemetryShmDecls::measurement_t** out);
+
+    /// @brief a generated kernel and the packet layout it was generated from
+    typedef struct {
+        const char* packet;     // packet name
+        uint64_t fingerprint;   // TelemetryConfig::fingerprint of the packet
+        kernel_t kernel;
+    } kernel_entry_t;
+};
+
+class Extractor {
+public:
+    /// @brief constructor
+    /// @param packet   the packet layout to extract measurements from
+    Extractor(const TelemetryConfigDecls::packet_info_t& packet);
+
+    /// @brief use a generated kernel instead of interpreting the configuration
+    /// @param kernels  table of generated kernels, terminated by an entry with
+    ///                 a NULL packet name
+    /// @return FAILURE if there is no kernel generated from the same layout
+    RetType use_kernel(const ExtractorDecls::kernel_entry_t* kernels);
+
+    /// @brief extract every measurement from a packet
+    /// @param pkt  the packet data
+    /// @param len  the length of the packet in bytes
+    /// @param out  array of measurements to fill in, one for each measurement
+    ///             in the packet layout (only 'raw' and 'value' are set)
+    /// @return FAILURE if the packet is too short to hold every measurement,
+    ///         in which case nothing is extracted
+    RetType extract(const uint8_t* pkt, size_t len, TelemetryShmDecls::measurement_t** out) {
+        if(NULL != m_kernel) {
+            return m_kernel(pkt, len, out);
+        }
+
+        return interpret(pkt, len, out);
+    }
+
+    /// @brief get the smallest packet that holds every measurement
+    /// @return the size in bytes
+    size_t min_size() { return m_decoder.min_size(); }
+
+    /// @brief get the batch decoder used when not using a generated kernel
+    /// @return the decoder
+    BatchDecoder& decoder() { return m_decoder; }
+
+private:
+    /// @brief extract by interpreting the configuration
+    RetType interpret(const uint8_t* pkt, size_t len, TelemetryShmDecls::measurement_t** out);
+
+    const TelemetryConfigDecls::packet_info_t& m_packet;
+    ExtractorDecls::kernel_t m_kernel;
+
+    BatchDecoder m_decoder;
+
+    // decoded values in slot order, copied into 'out'
+    std::vector<uint64_t> m_raw;
+    std::vector<double> m_value;
+};
+
+#endif
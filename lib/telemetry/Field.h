@@ -0,0 +1,189 @@
+/******************************************************************************
+*  Name: Field.h
+*
+*  Purpose: Functions for extracting a single measurement from a packet, in
+*           both a runtime form (for interpreting a configuration) and a
+*           compile time form (for code generated from a configuration)
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef FIELD_H
+#define FIELD_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/telemetry/TelemetryConfig.h"
+
+namespace field {
+    /// @brief load up to 8 bytes as a big endian unsigned integer
+    /// @param data     the bytes to load
+    /// @param n        the number of bytes
+    /// @return the integer
+    inline uint64_t load_be(const uint8_t* data, size_t n) {
+        uint64_t val = 0;
+        for(size_t i = 0; i < n; i++) {
+            val = (val << 8) | data[i];
+        }
+
+        return val;
+    }
+
+    /// @brief load up to 8 bytes as a little endian unsigned integer
+    /// @param data     the bytes to load
+    /// @param n        the number of bytes
+    /// @return the integer
+    inline uint64_t load_le(const uint8_t* data, size_t n) {
+        uint64_t val = 0;
+        for(size_t i = n; i > 0; i--) {
+            val = (val << 8) | data[i - 1];
+        }
+
+        return val;
+    }
+
+    /// @brief get a mask of the lowest 'bits' bits
+    inline uint64_t mask(size_t bits) {
+        return (bits >= 64) ? ~0ULL : ((1ULL << bits) - 1);
+    }
+
+    /// @brief extract the raw bits of a measurement
+    /// @param pkt  the packet, must be long enough to hold the measurement
+    /// @param meas the measurement
+    /// @return the raw bits, right aligned
+    inline uint64_t raw(const uint8_t* pkt, const TelemetryConfigDecls::measurement_info_t& meas) {
+        const uint8_t* data = pkt + meas.offset;
+
+        if(0 == meas.bit && 0 == meas.bits % 8) {
+            if(TelemetryConfigDecls::BIG == meas.endian) {
+                return load_be(data, meas.bits / 8);
+            }
+
+            return load_le(data, meas.bits / 8);
+        }
+
+        // bit field, load every byte it touches and shift it down
+        size_t nbytes = (meas.bit + meas.bits + 7) / 8;
+        uint64_t val = load_be(data, nbytes);
+
+        return (val >> ((nbytes * 8) - meas.bit - meas.bits)) & mask(meas.bits);
+    }
+
+    /// @brief convert raw bits to a value in engineering units
+    /// @param raw  the raw bits, right aligned
+    /// @param meas the measurement
+    /// @return the value
+    inline double value(uint64_t raw, const TelemetryConfigDecls::measurement_info_t& meas) {
+        double val;
+
+        switch(meas.type) {
+            case TelemetryConfigDecls::INT:
+                // sign extend from the top bit of the field
+                val = (double)((int64_t)(raw << (64 - meas.bits)) >> (64 - meas.bits));
+                break;
+            case TelemetryConfigDecls::FLOAT:
+                if(32 == meas.bits) {
+                    uint32_t bits32 = raw;
+                    float f;
+                    memcpy(&f, &bits32, sizeof(f));
+                    val = f;
+                } else {
+                    double d;
+                    memcpy(&d, &raw, sizeof(d));
+                    val = d;
+                }
+                break;
+            default:
+                val = (double)raw;
+                break;
+        }
+
+        return (val * meas.scale) + meas.bias;
+    }
+
+    /// @brief extract the raw bits of a measurement with a layout known at
+    ///        compile time, which compiles to a single load, swap, and mask
+    /// @tparam OFFSET  byte offset into the packet
+    /// @tparam BIT     bit offset into the first byte (0 = MSB)
+    /// @tparam BITS    size in bits
+    /// @tparam ENDIAN  byte order
+    /// @param pkt      the packet, must be long enough to hold the measurement
+    /// @return the raw bits, right aligned
+    template <size_t OFFSET, size_t BIT, size_t BITS, TelemetryConfigDecls::endian_t ENDIAN>
+    inline uint64_t raw(const uint8_t* pkt) {
+        static_assert(BITS > 0 && BIT + BITS <= 64, "field too large");
+
+        const uint8_t* data = pkt + OFFSET;
+
+        if constexpr(0 == BIT && 8 == BITS) {
+            return data[0];
+        } else if constexpr(0 == BIT && (16 == BITS || 32 == BITS || 64 == BITS)) {
+            // native load and byte swap if needed
+            uint64_t val;
+            if constexpr(16 == BITS) {
+                uint16_t v;
+                memcpy(&v, data, sizeof(v));
+                if constexpr((TelemetryConfigDecls::BIG == ENDIAN) == (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)) {
+                    v = __builtin_bswap16(v);
+                }
+                val = v;
+            } else if constexpr(32 == BITS) {
+                uint32_t v;
+                memcpy(&v, data, sizeof(v));
+                if constexpr((TelemetryConfigDecls::BIG == ENDIAN) == (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)) {
+                    v = __builtin_bswap32(v);
+                }
+                val = v;
+            } else {
+                uint64_t v;
+                memcpy(&v, data, sizeof(v));
+                if constexpr((TelemetryConfigDecls::BIG == ENDIAN) == (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)) {
+                    v = __builtin_bswap64(v);
+                }
+                val = v;
+            }
+
+            return val;
+        } else if constexpr(0 == BIT && 0 == BITS % 8) {
+            // odd sized byte aligned field, loop is unrolled with a constant count
+            if constexpr(TelemetryConfigDecls::BIG == ENDIAN) {
+                return load_be(data, BITS / 8);
+            } else {
+                return load_le(data, BITS / 8);
+            }
+        } else {
+            constexpr size_t NBYTES = (BIT + BITS + 7) / 8;
+            constexpr uint64_t MASK = (BITS >= 64) ? ~0ULL : ((1ULL << BITS) - 1);
+
+            return (load_be(data, NBYTES) >> ((NBYTES * 8) - BIT - BITS)) & MASK;
+        }
+    }
+
+    /// @brief convert raw bits to a value with a type known at compile time
+    /// @tparam BITS    size in bits
+    /// @tparam TYPE    how the bits are interpreted
+    /// @param raw      the raw bits, right aligned
+    /// @return the value before scaling
+    template <size_t BITS, TelemetryConfigDecls::type_t TYPE>
+    inline double value(uint64_t raw) {
+        if constexpr(TelemetryConfigDecls::INT == TYPE) {
+            return (double)((int64_t)(raw << (64 - BITS)) >> (64 - BITS));
+        } else if constexpr(TelemetryConfigDecls::FLOAT == TYPE && 32 == BITS) {
+            uint32_t bits32 = raw;
+            float f;
+            memcpy(&f, &bits32, sizeof(f));
+            return f;
+        } else if constexpr(TelemetryConfigDecls::FLOAT == TYPE) {
+            double d;
+            memcpy(&d, &raw, sizeof(d));
+            return d;
+        } else {
+            return (double)raw;
+        }
+    }
+};
+
+#endif
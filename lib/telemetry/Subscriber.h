@@ -0,0 +1,124 @@
+/******************************************************************************
+*  Name: Subscriber.h
+*
+*  Purpose: Subscribes to measurement updates from a broker
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef SUBSCRIBER_H
+#define SUBSCRIBER_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "common/types.h"
+#include "lib/shm/PosixShm.h"
+#include "lib/telemetry/TelemetryShm.h"
+#include "lib/triple_buffer/ShmTripleBuffer.h"
+
+// applications send requests to the broker for a packet over a UNIX datagram
+// socket, the broker replies with the name of a shared memory block holding a
+// triple buffer that only that application reads from and only the broker
+// writes to, one per (application, measurement) pair
+
+// Subscriber type and data declarations
+namespace SubscriberDecls {
+    /// @brief the file path prefix of broker sockets (relative to GSW_HOME),
+    ///        followed by the packet name
+    static const char* const ADDRESS_PREFIX = "broker_socket_";
+
+    /// @brief the name prefix of subscription shared memory blocks, followed
+    ///        by the packet name, application process ID, and subscription ID
+    static const char* const SHM_PREFIX = "/gsw_broker_";
+
+    /// flags subscription blocks are mapped with, each is a single page
+    /// that's written on every update so keep it resident
+    static const uint32_t SHM_FLAGS = PosixShmDecls::PREFAULT | PosixShmDecls::LOCK;
+
+    /// maximum length of a measurement name, including the NULL terminator
+    static const size_t MAX_NAME = 64;
+
+    /// maximum length of a shared memory block name, including the NULL terminator
+    static const size_t MAX_SHM_NAME = 128;
+
+    /// @brief kinds of requests
+    typedef enum {
+        SUBSCRIBE = 0,
+        UNSUBSCRIBE
+    } request_type_t;
+
+    /// @brief request sent to the broker
+    typedef struct {
+        request_type_t type;
+        pid_t pid;                  // process ID of the application
+        uint32_t id;                // subscription ID (unsubscribe only)
+        char measurement[MAX_NAME]; // measurement name (subscribe only)
+        double rate;                // maximum updates per second, 0 for no limit
+        int32_t priority;           // higher priority subscribers are updated first
+    } request_t;
+
+    /// @brief response from the broker
+    typedef struct {
+        RetType status;
+        uint32_t id;                // subscription ID
+        char shm_name[MAX_SHM_NAME]; // shared memory block name
+        uint16_t port;              // UDP port of the packet, identifies it
+                                    // in packet traces
+    } response_t;
+};
+
+class Subscriber {
+public:
+    /// @brief constructor
+    /// @param packet   the name of the packet the measurement is in
+    Subscriber(const char* packet);
+
+    /// @brief destructor, unsubscribes if subscribed
+    virtual ~Subscriber();
+
+    /// @brief subscribe to a measurement
+    /// @param measurement  the name of the measurement
+    /// @param rate         maximum updates per second, 0 for no limit
+    /// @param priority     higher priority subscribers are updated first
+    /// @param timeout_ms   how long to wait for the broker to respond
+    /// @return
+    RetType subscribe(const char* measurement, double rate = 0,
+                      int32_t priority = 0, int timeout_ms = 1000);
+
+    /// @brief unsubscribe from the measurement
+    /// @return
+    RetType unsubscribe();
+
+    /// @brief get the latest value of the measurement
+    /// @return the value or NULL if there's been no update since the last read
+    TelemetryShmDecls::measurement_t* read();
+
+    /// @brief get the latest value of the measurement, blocking until an update
+    /// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+    ///                     block forever
+    /// @return the value or NULL if the timeout expired
+    TelemetryShmDecls::measurement_t* read_blocking(int timeout_ms = -1);
+
+private:
+    /// @brief send a request to the broker and wait for a response
+    /// @param req          the request
+    /// @param resp         filled with the response
+    /// @param timeout_ms   how long to wait for the response
+    /// @return
+    RetType request(SubscriberDecls::request_t* req,
+                    SubscriberDecls::response_t* resp, int timeout_ms);
+
+    const char* m_packet;
+    uint32_t m_id;
+
+    // UDP port of the packet, for tracing
+    uint16_t m_port;
+
+    PosixShm* m_shm;
+    ShmTripleBuffer<TelemetryShmDecls::measurement_t>* m_buff;
+};
+
+#endif
@@ -0,0 +1,94 @@
+/******************************************************************************
+*  Name: TelemetryConfig.h
+*
+*  Purpose: Parses the telemetry configuration describing packet layouts
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef TELEMETRY_CONFIG_H
+#define TELEMETRY_CONFIG_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+
+// the configuration file is line based, '#' starts a comment
+// each packet is started by a 'packet' line followed by its measurements
+//
+// packet <packet name> <UDP port>
+//     <measurement name> <offset> <size> [big|little] [uint|int|float] [scale [bias]]
+//
+// offset is '<byte>' or '<byte>.<bit>', where bit 0 is the most significant
+// bit of the byte
+// size is '<bytes>' or '<bits>b', at most 64 bits including the bit offset
+// measurements are big endian unsigned integers by default, fields that don't
+// start and end on a byte boundary must be big endian
+// floats must be 32 or 64 bits and byte aligned
+// the value in engineering units is (raw value * scale) + bias
+
+// Telemetry configuration type and data declarations
+namespace TelemetryConfigDecls {
+    /// @brief byte order of a measurement
+    typedef enum {
+        BIG = 0,
+        LITTLE
+    } endian_t;
+
+    /// @brief how the raw bits of a measurement are interpreted
+    typedef enum {
+        UINT = 0,
+        INT,
+        FLOAT
+    } type_t;
+
+    /// @brief location and conversion of a measurement within a packet
+    typedef struct {
+        std::string name;
+        size_t offset;      // offset into the packet in bytes
+        size_t bit;         // offset into the first byte in bits (0 = MSB)
+        size_t bits;        // size of the measurement in bits
+        endian_t endian;
+        type_t type;
+        double scale;
+        double bias;
+    } measurement_info_t;
+
+    /// @brief a packet and the measurements it contains
+    typedef struct {
+        std::string name;
+        uint16_t port;      // UDP port the packet is received on
+        std::vector<measurement_info_t> measurements;
+    } packet_info_t;
+
+    /// @brief the default configuration file (relative to GSW_HOME)
+    static const char* const DEFAULT_FILE = "config/telemetry.conf";
+};
+
+class TelemetryConfig {
+public:
+    /// @brief parse a configuration file
+    /// @param filename     the file to parse
+    /// @return
+    RetType parse(const char* filename);
+
+    /// @brief find a packet by name
+    /// @param name     the name of the packet
+    /// @return the index of the packet in 'packets' or -1 if it doesn't exist
+    int find(const char* name);
+
+    /// @brief hash the layout of a packet, used to check that code generated
+    ///        from one configuration matches the configuration in use
+    /// @param packet   the packet
+    /// @return the fingerprint
+    static uint64_t fingerprint(const TelemetryConfigDecls::packet_info_t& packet);
+
+    /// the parsed packets
+    std::vector<TelemetryConfigDecls::packet_info_t> packets;
+};
+
+#endif
@@ -0,0 +1,119 @@
+/******************************************************************************
+*  Name: TelemetryShm.h
+*
+*  Purpose: Shared memory block holding the latest value of each measurement
+*           in a packet, written by decom and read by the broker
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef TELEMETRY_SHM_H
+#define TELEMETRY_SHM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "common/types.h"
+#include "lib/shm/PosixShm.h"
+#include "lib/sync/Event.h"
+#include "lib/triple_buffer/ShmTripleBuffer.h"
+
+// the shared memory block is layed out as follows
+// | header_t (padded to HEADER_SIZE) | triple buffer 0 | ... | triple buffer N-1 |
+//
+// there is one triple buffer per measurement, in the order the measurements
+// are listed in the configuration for the packet
+// the header holds an event that is signaled after a batch of packets has
+// been extracted, so a reader can wait on every measurement in the packet at once
+
+// Telemetry shared memory type and data declarations
+namespace TelemetryShmDecls {
+    /// @brief the value of a measurement
+    typedef struct {
+        double timestamp;   // receive time of the packet (milliseconds since the epoch)
+        uint64_t seq;       // sequence number of the packet the value was extracted from
+        uint64_t raw;       // raw value extracted from the packet
+        double value;       // value in engineering units
+    } measurement_t;
+
+    /// @brief header placed at the start of the shared memory block
+    typedef struct {
+        Event update;       // signaled whenever any measurement is written
+        uint32_t count;     // number of measurements in the block
+    } header_t;
+
+    /// offset of the first triple buffer from the start of the block
+    static const size_t HEADER_SIZE = 64;
+
+    /// prefix of the shared memory block name, followed by the packet name
+    static const char* const NAME_PREFIX = "/gsw_telemetry_";
+
+    /// flags the block is mapped with, the block is small and read on every
+    /// packet so keep it resident and avoid page faults in the receive loop
+    static const uint32_t SHM_FLAGS = PosixShmDecls::PREFAULT |
+                                      PosixShmDecls::TRANSPARENT_HUGEPAGES |
+                                      PosixShmDecls::LOCK;
+
+    static_assert(sizeof(header_t) <= HEADER_SIZE, "telemetry header too large");
+};
+
+class TelemetryShm {
+public:
+    /// @brief constructor
+    /// @param packet       the name of the packet in the configuration
+    /// @param count        the number of measurements in the packet
+    TelemetryShm(const char* packet, size_t count);
+
+    /// @brief destructor
+    virtual ~TelemetryShm();
+
+    /// @brief create, attach to, and initialize the shared memory block
+    ///        replaces any block left behind by a decom that didn't exit
+    ///        cleanly, so only call this while holding the packet's port
+    /// @return
+    RetType create();
+
+    /// @brief attach to a block created by another process
+    /// @return
+    RetType attach();
+
+    /// @brief detach from the block
+    /// @return
+    RetType detach();
+
+    /// @brief destroy the block
+    /// @return
+    RetType destroy();
+
+    /// @brief get the triple buffer for a measurement
+    /// @param index    index of the measurement in the packet
+    /// @return the triple buffer or NULL if not attached / out of range
+    ShmTripleBuffer<TelemetryShmDecls::measurement_t>* buffer(size_t index);
+
+    /// @brief get the event signaled whenever any measurement is written
+    /// @return the event or NULL if not attached
+    Event* update();
+
+    /// @brief get the size of the pages backing the block
+    /// @return the page size in bytes, or 0 if not attached
+    size_t page_size() { return m_shm.page_size(); }
+
+    /// @brief check if the block attached to was destroyed or replaced by a
+    ///        new decom since attaching, in which case detach and attach again
+    /// @return true if the block is no longer the packet's block
+    bool replaced() { return m_shm.replaced(); }
+
+    /// the number of measurements in the block
+    const size_t count;
+
+private:
+    /// @brief construct the triple buffer objects over the attached block
+    /// @param create   true if the triple buffers should be initialized
+    void setup(bool create);
+
+    PosixShm m_shm;
+    ShmTripleBuffer<TelemetryShmDecls::measurement_t>* m_buffs;
+};
+
+#endif
@@ -0,0 +1,384 @@
+/******************************************************************************
+*  Name: BatchDecoder.cpp
+*
+*  Purpose: Decodes every measurement in a packet at once, using SIMD
+*           instructions to byte swap and convert groups of same-typed fields
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+
+#include "lib/telemetry/BatchDecoder.h"
+#include "lib/telemetry/Field.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_DECODER_X86
+#endif
+
+using namespace TelemetryConfigDecls;
+using namespace BatchDecoderDecls;
+
+/// maps instruction sets to strings
+const char* BatchDecoderDecls::isa_str[AVX2 + 1] = \
+{
+    "scalar",
+    "SSE4.1",
+    "AVX2"
+};
+
+/// @brief constructor
+/// @param packet   the packet layout to decode
+/// @param max_isa  the best instruction set to use, the best one the
+///                 processor supports up to this is used
+BatchDecoder::BatchDecoder(const packet_info_t& packet, isa_t max_isa) :
+                                        m_packet(packet), m_scalarFirst(0),
+                                        m_minSize(0), m_isa(SCALAR) {
+#ifdef BATCH_DECODER_X86
+    __builtin_cpu_init();
+    if(max_isa >= AVX2 && __builtin_cpu_supports("avx2")) {
+        m_isa = AVX2;
+    } else if(max_isa >= SSE4 && __builtin_cpu_supports("sse4.1")) {
+        m_isa = SSE4;
+    }
+#else
+    (void)max_isa;
+#endif
+
+    size_t num = packet.measurements.size();
+    m_slots.resize(num);
+
+    for(size_t i = 0; i < num; i++) {
+        const measurement_info_t& meas = packet.measurements[i];
+
+        size_t end = meas.offset + ((meas.bit + meas.bits + 7) / 8);
+        if(end > m_minSize) {
+            m_minSize = end;
+        }
+
+        // 16 bit fields are gathered with 32 bit loads ending at the field so
+        // the load never runs past the end of the packet, that needs 2 bytes
+        // before the field
+        bool groupable = (0 == meas.bit) &&
+                         (32 == meas.bits || 64 == meas.bits ||
+                          (16 == meas.bits && meas.offset >= 2));
+        if(!groupable) {
+            m_scalar.push_back(i);
+            continue;
+        }
+
+        group_t* group = NULL;
+        for(group_t& g : m_groups) {
+            if(g.bits == meas.bits && g.endian == meas.endian && g.type == meas.type) {
+                group = &g;
+                break;
+            }
+        }
+
+        if(NULL == group) {
+            group_t g;
+            g.bits = meas.bits;
+            g.endian = meas.endian;
+            g.type = meas.type;
+            g.first = 0;
+            m_groups.push_back(g);
+            group = &m_groups.back();
+        }
+
+        group->offsets.push_back(meas.offset);
+        group->scale.push_back(meas.scale);
+        group->bias.push_back(meas.bias);
+    }
+
+    // assign slots, each group gets a contiguous run
+    size_t slot = 0;
+    for(group_t& g : m_groups) {
+        g.first = slot;
+        slot += g.offsets.size();
+    }
+    m_scalarFirst = slot;
+
+    std::vector<size_t> next(m_groups.size());
+    for(size_t i = 0; i < m_groups.size(); i++) {
+        next[i] = m_groups[i].first;
+    }
+
+    size_t scalar = 0;
+    for(size_t i = 0; i < num; i++) {
+        if(scalar < m_scalar.size() && m_scalar[scalar] == i) {
+            m_slots[i] = m_scalarFirst + scalar;
+            scalar++;
+            continue;
+        }
+
+        const measurement_info_t& meas = packet.measurements[i];
+        for(size_t j = 0; j < m_groups.size(); j++) {
+            if(m_groups[j].bits == meas.bits && m_groups[j].endian == meas.endian &&
+               m_groups[j].type == meas.type) {
+                m_slots[i] = next[j]++;
+                break;
+            }
+        }
+    }
+}
+
+/// @brief decode every measurement in a packet
+/// @param pkt      the packet data, must be at least 'min_size' bytes
+/// @param raw      array of raw values, one per measurement in slot order
+/// @param value    array of engineering values, one per measurement in slot order
+void BatchDecoder::decode(const uint8_t* pkt, uint64_t* raw, double* value) {
+    for(const group_t& group : m_groups) {
+        switch(m_isa) {
+            case AVX2:
+                decode_group_avx2(group, pkt, raw + group.first, value + group.first);
+                break;
+            case SSE4:
+                decode_group_sse4(group, pkt, raw + group.first, value + group.first);
+                break;
+            default:
+                decode_group_scalar(group, pkt, raw + group.first, value + group.first);
+                break;
+        }
+    }
+
+    for(size_t i = 0; i < m_scalar.size(); i++) {
+        const measurement_info_t& meas = m_packet.measurements[m_scalar[i]];
+
+        uint64_t r = field::raw(pkt, meas);
+        raw[m_scalarFirst + i] = r;
+        value[m_scalarFirst + i] = field::value(r, meas);
+    }
+}
+
+/// @brief convert the raw bits of a grouped field
+/// @param r        the raw bits, right aligned
+/// @param bits     the size of the field
+/// @param type     the type of the field
+/// @return the value before scaling
+static inline double convert(uint64_t r, size_t bits, type_t type) {
+    if(INT == type) {
+        return (double)((int64_t)(r << (64 - bits)) >> (64 - bits));
+    } else if(FLOAT == type) {
+        if(32 == bits) {
+            uint32_t bits32 = r;
+            float f;
+            memcpy(&f, &bits32, sizeof(f));
+            return f;
+        }
+
+        double d;
+        memcpy(&d, &r, sizeof(d));
+        return d;
+    }
+
+    return (double)r;
+}
+
+/// @brief decode fields [start, end) of a group one at a time
+static inline void decode_range(size_t bits, endian_t endian, type_t type,
+                                const int32_t* offsets, const double* scale,
+                                const double* bias, size_t start, size_t end,
+                                const uint8_t* pkt, uint64_t* raw, double* value) {
+    for(size_t i = start; i < end; i++) {
+        const uint8_t* data = pkt + offsets[i];
+        uint64_t r = (BIG == endian) ? field::load_be(data, bits / 8)
+                                     : field::load_le(data, bits / 8);
+
+        raw[i] = r;
+        value[i] = (convert(r, bits, type) * scale[i]) + bias[i];
+    }
+}
+
+void BatchDecoder::decode_group_scalar(const group_t& group, const uint8_t* pkt,
+                                       uint64_t* raw, double* value) {
+    decode_range(group.bits, group.endian, group.type, group.offsets.data(),
+                 group.scale.data(), group.bias.data(), 0, group.offsets.size(),
+                 pkt, raw, value);
+}
+
+#ifdef BATCH_DECODER_X86
+
+__attribute__((target("sse4.1")))
+void BatchDecoder::decode_group_sse4(const group_t& group, const uint8_t* pkt,
+                                     uint64_t* raw, double* value) {
+    size_t n = group.offsets.size();
+    const int32_t* offsets = group.offsets.data();
+    const double* scale = group.scale.data();
+    const double* bias = group.bias.data();
+
+    size_t i = 0;
+    if(16 == group.bits || 32 == group.bits) {
+        // shuffles that byte swap 32 bit lanes, or pull a 16 bit field out of
+        // the top half of a 32 bit load (swapping it if big endian)
+        __m128i shuffle;
+        if(32 == group.bits) {
+            shuffle = (BIG == group.endian) ?
+                      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12) :
+                      _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        } else {
+            shuffle = (BIG == group.endian) ?
+                      _mm_setr_epi8(3, 2, -1, -1, 7, 6, -1, -1, 11, 10, -1, -1, 15, 14, -1, -1) :
+                      _mm_setr_epi8(2, 3, -1, -1, 6, 7, -1, -1, 10, 11, -1, -1, 14, 15, -1, -1);
+        }
+        int back = (16 == group.bits) ? 2 : 0;
+
+        for(; i + 4 <= n; i += 4) {
+            // no gather in SSE, load each lane on its own
+            uint32_t lanes[4];
+            memcpy(&lanes[0], pkt + offsets[i] - back, 4);
+            memcpy(&lanes[1], pkt + offsets[i + 1] - back, 4);
+            memcpy(&lanes[2], pkt + offsets[i + 2] - back, 4);
+            memcpy(&lanes[3], pkt + offsets[i + 3] - back, 4);
+
+            __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*)lanes), shuffle);
+
+            _mm_storeu_si128((__m128i*)&raw[i], _mm_cvtepu32_epi64(v));
+            _mm_storeu_si128((__m128i*)&raw[i + 2], _mm_cvtepu32_epi64(_mm_srli_si128(v, 8)));
+
+            __m128d lo, hi;
+            if(FLOAT == group.type) {
+                lo = _mm_cvtps_pd(_mm_castsi128_ps(v));
+                hi = _mm_cvtps_pd(_mm_castsi128_ps(_mm_srli_si128(v, 8)));
+            } else {
+                if(INT == group.type && 16 == group.bits) {
+                    v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+                } else if(UINT == group.type && 32 == group.bits) {
+                    // no unsigned conversion, bias into signed range and back
+                    v = _mm_xor_si128(v, _mm_set1_epi32(0x80000000));
+                }
+
+                lo = _mm_cvtepi32_pd(v);
+                hi = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+
+                if(UINT == group.type && 32 == group.bits) {
+                    lo = _mm_add_pd(lo, _mm_set1_pd(2147483648.0));
+                    hi = _mm_add_pd(hi, _mm_set1_pd(2147483648.0));
+                }
+            }
+
+            lo = _mm_add_pd(_mm_mul_pd(lo, _mm_loadu_pd(&scale[i])), _mm_loadu_pd(&bias[i]));
+            hi = _mm_add_pd(_mm_mul_pd(hi, _mm_loadu_pd(&scale[i + 2])), _mm_loadu_pd(&bias[i + 2]));
+            _mm_storeu_pd(&value[i], lo);
+            _mm_storeu_pd(&value[i + 2], hi);
+        }
+    }
+
+    // 64 bit fields and leftovers
+    decode_range(group.bits, group.endian, group.type, offsets, scale, bias,
+                 i, n, pkt, raw, value);
+}
+
+// NOTE: not built with "fma", a fused multiply-add rounds once instead of
+//       twice and wouldn't match field::value bit for bit
+__attribute__((target("avx2")))
+void BatchDecoder::decode_group_avx2(const group_t& group, const uint8_t* pkt,
+                                     uint64_t* raw, double* value) {
+    size_t n = group.offsets.size();
+    const int32_t* offsets = group.offsets.data();
+    const double* scale = group.scale.data();
+    const double* bias = group.bias.data();
+
+    size_t i = 0;
+    if(16 == group.bits || 32 == group.bits) {
+        __m256i shuffle;
+        if(32 == group.bits) {
+            shuffle = (BIG == group.endian) ?
+                      _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                       3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12) :
+                      _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                       0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        } else {
+            shuffle = (BIG == group.endian) ?
+                      _mm256_setr_epi8(3, 2, -1, -1, 7, 6, -1, -1, 11, 10, -1, -1, 15, 14, -1, -1,
+                                       3, 2, -1, -1, 7, 6, -1, -1, 11, 10, -1, -1, 15, 14, -1, -1) :
+                      _mm256_setr_epi8(2, 3, -1, -1, 6, 7, -1, -1, 10, 11, -1, -1, 14, 15, -1, -1,
+                                       2, 3, -1, -1, 6, 7, -1, -1, 10, 11, -1, -1, 14, 15, -1, -1);
+        }
+        __m256i back = _mm256_set1_epi32((16 == group.bits) ? 2 : 0);
+
+        for(; i + 8 <= n; i += 8) {
+            __m256i offs = _mm256_sub_epi32(_mm256_loadu_si256((__m256i*)&offsets[i]), back);
+            __m256i v = _mm256_i32gather_epi32((const int*)pkt, offs, 1);
+            v = _mm256_shuffle_epi8(v, shuffle);
+
+            __m128i v_lo = _mm256_castsi256_si128(v);
+            __m128i v_hi = _mm256_extracti128_si256(v, 1);
+            _mm256_storeu_si256((__m256i*)&raw[i], _mm256_cvtepu32_epi64(v_lo));
+            _mm256_storeu_si256((__m256i*)&raw[i + 4], _mm256_cvtepu32_epi64(v_hi));
+
+            __m256d lo, hi;
+            if(FLOAT == group.type) {
+                lo = _mm256_cvtps_pd(_mm_castsi128_ps(v_lo));
+                hi = _mm256_cvtps_pd(_mm_castsi128_ps(v_hi));
+            } else {
+                if(INT == group.type && 16 == group.bits) {
+                    v = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+                } else if(UINT == group.type && 32 == group.bits) {
+                    // no unsigned conversion, bias into signed range and back
+                    v = _mm256_xor_si256(v, _mm256_set1_epi32(0x80000000));
+                }
+
+                lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+                hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1));
+
+                if(UINT == group.type && 32 == group.bits) {
+                    lo = _mm256_add_pd(lo, _mm256_set1_pd(2147483648.0));
+                    hi = _mm256_add_pd(hi, _mm256_set1_pd(2147483648.0));
+                }
+            }
+
+            lo = _mm256_add_pd(_mm256_mul_pd(lo, _mm256_loadu_pd(&scale[i])), _mm256_loadu_pd(&bias[i]));
+            hi = _mm256_add_pd(_mm256_mul_pd(hi, _mm256_loadu_pd(&scale[i + 4])), _mm256_loadu_pd(&bias[i + 4]));
+            _mm256_storeu_pd(&value[i], lo);
+            _mm256_storeu_pd(&value[i + 4], hi);
+        }
+    } else {
+        // 64 bit fields, gather and swap four at a time
+        __m256i shuffle = (BIG == group.endian) ?
+                          _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                           7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8) :
+                          _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                           0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+        for(; i + 4 <= n; i += 4) {
+            __m128i offs = _mm_loadu_si128((__m128i*)&offsets[i]);
+            __m256i v = _mm256_i32gather_epi64((const long long*)pkt, offs, 1);
+            v = _mm256_shuffle_epi8(v, shuffle);
+            _mm256_storeu_si256((__m256i*)&raw[i], v);
+
+            __m256d d;
+            if(FLOAT == group.type) {
+                d = _mm256_castsi256_pd(v);
+            } else {
+                // no 64 bit integer conversion in AVX2
+                d = _mm256_setr_pd(convert(raw[i], 64, group.type),
+                                   convert(raw[i + 1], 64, group.type),
+                                   convert(raw[i + 2], 64, group.type),
+                                   convert(raw[i + 3], 64, group.type));
+            }
+
+            d = _mm256_add_pd(_mm256_mul_pd(d, _mm256_loadu_pd(&scale[i])), _mm256_loadu_pd(&bias[i]));
+            _mm256_storeu_pd(&value[i], d);
+        }
+    }
+
+    // leftovers
+    decode_range(group.bits, group.endian, group.type, offsets, scale, bias,
+                 i, n, pkt, raw, value);
+}
+
+#else
+
+void BatchDecoder::decode_group_sse4(const group_t& group, const uint8_t* pkt,
+                                     uint64_t* raw, double* value) {
+    decode_group_scalar(group, pkt, raw, value);
+}
+
+void BatchDecoder::decode_group_avx2(const group_t& group, const uint8_t* pkt,
+                                     uint64_t* raw, double* value) {
+    decode_group_scalar(group, pkt, raw, value);
+}
+
+#endif
@@ -0,0 +1,58 @@
+/******************************************************************************
+*  Name: Extractor.cpp
+*
+*  Purpose: Extracts measurements from packets according to the telemetry
+*           configuration
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include "lib/telemetry/Extractor.h"
+
+using namespace TelemetryConfigDecls;
+using namespace TelemetryShmDecls;
+using namespace ExtractorDecls;
+
+/// @brief constructor
+/// @param packet   the packet layout to extract measurements from
+Extractor::Extractor(const packet_info_t& packet) : m_packet(packet), m_kernel(NULL),
+                                                    m_decoder(packet),
+                                                    m_raw(packet.measurements.size()),
+                                                    m_value(packet.measurements.size()) {}
+
+/// @brief use a generated kernel instead of interpreting the configuration
+/// @param kernels  table of generated kernels, terminated by an entry with
+///                 a NULL packet name
+/// @return FAILURE if there is no kernel generated from the same layout
+RetType Extractor::use_kernel(const kernel_entry_t* kernels) {
+    uint64_t fingerprint = TelemetryConfig::fingerprint(m_packet);
+
+    for(size_t i = 0; NULL != kernels[i].packet; i++) {
+        if(m_packet.name == kernels[i].packet && fingerprint == kernels[i].fingerprint) {
+            m_kernel = kernels[i].kernel;
+            return SUCCESS;
+        }
+    }
+
+    return FAILURE;
+}
+
+/// @brief extract by interpreting the configuration
+RetType Extractor::interpret(const uint8_t* pkt, size_t len, measurement_t** out) {
+    // checking the length once per packet saves checking it for every measurement
+    if(len < m_decoder.min_size()) {
+        return FAILURE;
+    }
+
+    m_decoder.decode(pkt, m_raw.data(), m_value.data());
+
+    size_t num = m_packet.measurements.size();
+    for(size_t i = 0; i < num; i++) {
+        size_t slot = m_decoder.slot(i);
+        out[i]->raw = m_raw[slot];
+        out[i]->value = m_value[slot];
+    }
+
+    return SUCCESS;
+}
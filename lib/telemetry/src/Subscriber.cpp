@@ -0,0 +1,216 @@
+/******************************************************************************
+*  Name: Subscriber.cpp
+*
+*  Purpose: Subscribes to measurement updates from a broker
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <string>
+
+#include "lib/telemetry/Subscriber.h"
+#include "lib/logging/MessageLogger.h"
+#include "lib/stats/Stats.h"
+#include "lib/stats/Trace.h"
+
+using namespace SubscriberDecls;
+using namespace TelemetryShmDecls;
+
+/// @brief constructor
+/// @param packet   the name of the packet the measurement is in
+Subscriber::Subscriber(const char* packet) : m_packet(packet), m_id(0), m_port(0),
+                                             m_shm(NULL), m_buff(NULL) {}
+
+/// @brief destructor, unsubscribes if subscribed
+Subscriber::~Subscriber() {
+    if(NULL != m_shm) {
+        unsubscribe();
+    }
+}
+
+/// @brief send a request to the broker and wait for a response
+/// @param req          the request
+/// @param resp         filled with the response
+/// @param timeout_ms   how long to wait for the response
+/// @return
+RetType Subscriber::request(request_t* req, response_t* resp, int timeout_ms) {
+    MessageLogger logger("Subscriber", "request");
+
+    char* gsw_home = getenv("GSW_HOME");
+    if(NULL == gsw_home) {
+        logger.log_message("GSW_HOME not set", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    std::string file = gsw_home;
+    file += "/";
+    file += ADDRESS_PREFIX;
+    file += m_packet;
+
+    struct sockaddr_un addr;
+    addr.sun_family = AF_UNIX;
+    if(file.length() >= sizeof(addr.sun_path)) {
+        logger.log_message("broker socket path too long", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+    strcpy(addr.sun_path, file.c_str());
+
+    int sd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if(-1 == sd) {
+        logger.log_message("failed to open socket", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    // bind to an autogenerated abstract address so the broker can reply
+    struct sockaddr_un local;
+    local.sun_family = AF_UNIX;
+    if(-1 == bind(sd, (struct sockaddr*)&local, sizeof(sa_family_t))) {
+        logger.log_message("failed to bind socket", MessageLoggerDecls::CRIT);
+        close(sd);
+        return FAILURE;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    if(-1 == sendto(sd, req, sizeof(*req), 0, (struct sockaddr*)&addr, sizeof(addr))) {
+        logger.log_message("failed to send request to broker, is it running?", MessageLoggerDecls::CRIT);
+        close(sd);
+        return FAILURE;
+    }
+
+    ssize_t len = recv(sd, resp, sizeof(*resp), 0);
+    close(sd);
+
+    if(len != sizeof(*resp)) {
+        logger.log_message("no response from broker", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/// @brief subscribe to a measurement
+/// @param measurement  the name of the measurement
+/// @param rate         maximum updates per second, 0 for no limit
+/// @param priority     higher priority subscribers are updated first
+/// @param timeout_ms   how long to wait for the broker to respond
+/// @return
+RetType Subscriber::subscribe(const char* measurement, double rate,
+                              int32_t priority, int timeout_ms) {
+    MessageLogger logger("Subscriber", "subscribe");
+
+    if(NULL != m_shm) {
+        logger.log_message("already subscribed", MessageLoggerDecls::WARN);
+        return FAILURE;
+    }
+
+    if(strlen(measurement) >= MAX_NAME) {
+        logger.log_message("measurement name too long", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    request_t req;
+    memset(&req, 0, sizeof(req));
+    req.type = SUBSCRIBE;
+    req.pid = getpid();
+    strcpy(req.measurement, measurement);
+    req.rate = rate;
+    req.priority = priority;
+
+    response_t resp;
+    if(SUCCESS != request(&req, &resp, timeout_ms)) {
+        return FAILURE;
+    }
+
+    if(SUCCESS != resp.status) {
+        logger.log_message("broker rejected subscription", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    m_id = resp.id;
+    m_port = resp.port;
+    resp.shm_name[MAX_SHM_NAME - 1] = '\0';
+
+    m_shm = new PosixShm(resp.shm_name, ShmTripleBuffer<measurement_t>::SHM_SIZE, SubscriberDecls::SHM_FLAGS);
+    if(SUCCESS != m_shm->attach()) {
+        delete m_shm;
+        m_shm = NULL;
+        return FAILURE;
+    }
+
+    m_buff = new ShmTripleBuffer<measurement_t>(m_shm->data, false);
+
+    // time reads that get an update, recorded as the thread that subscribed
+    m_buff->instrument(NULL, Stats::shared()->histogram("Subscriber::read"));
+
+    return SUCCESS;
+}
+
+/// @brief unsubscribe from the measurement
+/// @return
+RetType Subscriber::unsubscribe() {
+    if(NULL == m_shm) {
+        return SUCCESS;
+    }
+
+    delete m_buff;
+    m_buff = NULL;
+
+    m_shm->detach();
+    delete m_shm;
+    m_shm = NULL;
+
+    request_t req;
+    memset(&req, 0, sizeof(req));
+    req.type = UNSUBSCRIBE;
+    req.pid = getpid();
+    req.id = m_id;
+
+    response_t resp;
+    if(SUCCESS != request(&req, &resp, 1000)) {
+        return FAILURE;
+    }
+
+    return resp.status;
+}
+
+/// @brief get the latest value of the measurement
+/// @return the value or NULL if there's been no update since the last read
+measurement_t* Subscriber::read() {
+    if(NULL == m_buff) {
+        return NULL;
+    }
+
+    measurement_t* val = m_buff->read();
+    if(NULL != val) {
+        TRACE_PACKET(TraceDecls::CONSUMER_READ, m_port, val->seq);
+    }
+
+    return val;
+}
+
+/// @brief get the latest value of the measurement, blocking until an update
+/// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+///                     block forever
+/// @return the value or NULL if the timeout expired
+measurement_t* Subscriber::read_blocking(int timeout_ms) {
+    if(NULL == m_buff) {
+        return NULL;
+    }
+
+    measurement_t* val = m_buff->read_blocking(timeout_ms);
+    if(NULL != val) {
+        TRACE_PACKET(TraceDecls::CONSUMER_READ, m_port, val->seq);
+    }
+
+    return val;
+}
@@ -0,0 +1,204 @@
+/******************************************************************************
+*  Name: TelemetryConfig.cpp
+*
+*  Purpose: Parses the telemetry configuration describing packet layouts
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+#include "lib/telemetry/TelemetryConfig.h"
+#include "lib/logging/MessageLogger.h"
+
+using namespace TelemetryConfigDecls;
+
+/// @brief parse a configuration file
+/// @param filename     the file to parse
+/// @return
+RetType TelemetryConfig::parse(const char* filename) {
+    MessageLogger logger("TelemetryConfig", "parse");
+
+    std::ifstream f(filename);
+    if(!f.is_open()) {
+        logger.log_message("failed to open telemetry configuration file", MessageLoggerDecls::CRIT);
+        return FAILURE;
+    }
+
+    packets.clear();
+
+    std::string line;
+    size_t line_num = 0;
+    while(std::getline(f, line)) {
+        line_num++;
+
+        // strip comments
+        size_t comment = line.find('#');
+        if(std::string::npos != comment) {
+            line.erase(comment);
+        }
+
+        std::istringstream tokens(line);
+        std::vector<std::string> words;
+        std::string word;
+        while(tokens >> word) {
+            words.push_back(word);
+        }
+
+        if(0 == words.size()) {
+            // blank line
+            continue;
+        }
+
+        if("packet" == words[0]) {
+            if(words.size() != 3) {
+                logger.log(MessageLoggerDecls::CRIT, "line %lu: expected 'packet <name> <port>'", line_num);
+                return FAILURE;
+            }
+
+            char* end;
+            unsigned long port = strtoul(words[2].c_str(), &end, 0);
+            if(*end != '\0' || port == 0 || port > UINT16_MAX) {
+                logger.log(MessageLoggerDecls::CRIT, "line %lu: invalid port", line_num);
+                return FAILURE;
+            }
+
+            packet_info_t packet;
+            packet.name = words[1];
+            packet.port = port;
+            packets.push_back(packet);
+
+            continue;
+        }
+
+        // otherwise it's a measurement
+        if(0 == packets.size()) {
+            logger.log(MessageLoggerDecls::CRIT, "line %lu: measurement listed before any packet", line_num);
+            return FAILURE;
+        }
+
+        if(words.size() < 3 || words.size() > 7) {
+            logger.log(MessageLoggerDecls::CRIT,
+                       "line %lu: expected '<name> <offset> <size> [big|little] [uint|int|float] [scale [bias]]'",
+                       line_num);
+            return FAILURE;
+        }
+
+        measurement_info_t meas;
+        meas.name = words[0];
+        meas.bit = 0;
+        meas.endian = BIG;
+        meas.type = UINT;
+        meas.scale = 1;
+        meas.bias = 0;
+
+        // offset is '<byte>' or '<byte>.<bit>'
+        char* end;
+        meas.offset = strtoul(words[1].c_str(), &end, 0);
+        if(*end == '.') {
+            meas.bit = strtoul(end + 1, &end, 0);
+        }
+        if(*end != '\0' || meas.bit > 7) {
+            logger.log(MessageLoggerDecls::CRIT, "line %lu: invalid offset", line_num);
+            return FAILURE;
+        }
+
+        // size is '<bytes>' or '<bits>b'
+        meas.bits = strtoul(words[2].c_str(), &end, 0);
+        if(*end == 'b') {
+            end++;
+        } else {
+            meas.bits *= 8;
+        }
+        if(*end != '\0' || meas.bits == 0 || meas.bit + meas.bits > 64) {
+            logger.log(MessageLoggerDecls::CRIT,
+                       "line %lu: invalid size, must be at most 64 bits including the bit offset", line_num);
+            return FAILURE;
+        }
+
+        // the rest are keywords or scale and bias (in that order)
+        size_t nums = 0;
+        for(size_t i = 3; i < words.size(); i++) {
+            if("big" == words[i]) {
+                meas.endian = BIG;
+            } else if("little" == words[i]) {
+                meas.endian = LITTLE;
+            } else if("uint" == words[i]) {
+                meas.type = UINT;
+            } else if("int" == words[i]) {
+                meas.type = INT;
+            } else if("float" == words[i]) {
+                meas.type = FLOAT;
+            } else {
+                double num = strtod(words[i].c_str(), &end);
+                if(*end != '\0' || nums >= 2) {
+                    logger.log(MessageLoggerDecls::CRIT, "line %lu: unexpected '%s'", line_num, words[i].c_str());
+                    return FAILURE;
+                }
+
+                if(0 == nums) {
+                    meas.scale = num;
+                } else {
+                    meas.bias = num;
+                }
+                nums++;
+            }
+        }
+
+        bool aligned = (0 == meas.bit) && (0 == meas.bits % 8);
+        if(!aligned && LITTLE == meas.endian) {
+            logger.log(MessageLoggerDecls::CRIT, "line %lu: fields not on byte boundaries must be big endian", line_num);
+            return FAILURE;
+        }
+
+        if(FLOAT == meas.type && (!aligned || (meas.bits != 32 && meas.bits != 64))) {
+            logger.log(MessageLoggerDecls::CRIT, "line %lu: floats must be byte aligned and 32 or 64 bits", line_num);
+            return FAILURE;
+        }
+
+        packets.back().measurements.push_back(meas);
+    }
+
+    return SUCCESS;
+}
+
+/// @brief find a packet by name
+/// @param name     the name of the packet
+/// @return the index of the packet in 'packets' or -1 if it doesn't exist
+int TelemetryConfig::find(const char* name) {
+    for(size_t i = 0; i < packets.size(); i++) {
+        if(packets[i].name == name) {
+            return (int)i;
+        }
+    }
+
+    return -1;
+}
+
+/// @brief hash the layout of a packet, used to check that code generated
+///        from one configuration matches the configuration in use
+/// @param packet   the packet
+/// @return the fingerprint
+uint64_t TelemetryConfig::fingerprint(const packet_info_t& packet) {
+    // FNV-1a over a canonical text form of the layout
+    std::string text = packet.name + ":" + std::to_string(packet.port);
+    for(const measurement_info_t& meas : packet.measurements) {
+        char buff[128];
+        snprintf(buff, sizeof(buff), ";%lu.%lu:%lu:%d:%d:%a:%a",
+                 meas.offset, meas.bit, meas.bits, meas.endian, meas.type,
+                 meas.scale, meas.bias);
+        text += meas.name + buff;
+    }
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(char c : text) {
+        hash ^= (uint8_t)c;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,130 @@
+/******************************************************************************
+*  Name: TelemetryShm.cpp
+*
+*  Purpose: Shared memory block holding the latest value of each measurement
+*           in a packet, written by decom and read by the broker
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#include <new>
+#include <string>
+
+#include "lib/telemetry/TelemetryShm.h"
+#include "lib/logging/MessageLogger.h"
+
+using namespace TelemetryShmDecls;
+
+typedef ShmTripleBuffer<measurement_t> buffer_t;
+
+/// @brief constructor
+/// @param packet       the name of the packet in the configuration
+/// @param count        the number of measurements in the packet
+TelemetryShm::TelemetryShm(const char* packet, size_t count) :
+                                count(count),
+                                m_shm((std::string(NAME_PREFIX) + packet).c_str(),
+                                      HEADER_SIZE + (count * buffer_t::SHM_SIZE),
+                                      SHM_FLAGS | PosixShmDecls::REPLACE),
+                                m_buffs(NULL) {}
+
+/// @brief destructor
+TelemetryShm::~TelemetryShm() {
+    // don't detach, leave that up to the user
+    // just free the triple buffer objects
+    free(m_buffs);
+}
+
+/// @brief construct the triple buffer objects over the attached block
+/// @param create   true if the triple buffers should be initialized
+void TelemetryShm::setup(bool create) {
+    // triple buffers have no default constructor, so allocate raw memory and
+    // construct each in place
+    free(m_buffs);
+    m_buffs = (buffer_t*)malloc(count * sizeof(buffer_t));
+
+    for(size_t i = 0; i < count; i++) {
+        new (&m_buffs[i]) buffer_t(m_shm.data + HEADER_SIZE + (i * buffer_t::SHM_SIZE), create);
+    }
+}
+
+/// @brief create, attach to, and initialize the shared memory block
+/// @return
+RetType TelemetryShm::create() {
+    if(SUCCESS != m_shm.create()) {
+        return FAILURE;
+    }
+
+    if(SUCCESS != m_shm.attach()) {
+        return FAILURE;
+    }
+
+    header_t* hdr = (header_t*)m_shm.data;
+    new (&hdr->update) Event();
+
+    setup(true);
+
+    // a reader that attaches before this fails the count check and retries
+    __atomic_store_n(&hdr->count, count, __ATOMIC_RELEASE);
+
+    return SUCCESS;
+}
+
+/// @brief attach to a block created by another process
+/// @return
+RetType TelemetryShm::attach() {
+    MessageLogger logger("TelemetryShm", "attach");
+
+    if(SUCCESS != m_shm.attach()) {
+        return FAILURE;
+    }
+
+    if(__atomic_load_n(&((header_t*)m_shm.data)->count, __ATOMIC_ACQUIRE) != count) {
+        logger.log_message("measurement count does not match telemetry block", MessageLoggerDecls::CRIT);
+        m_shm.detach();
+        return FAILURE;
+    }
+
+    setup(false);
+
+    return SUCCESS;
+}
+
+/// @brief detach from the block
+/// @return
+RetType TelemetryShm::detach() {
+    free(m_buffs);
+    m_buffs = NULL;
+
+    return m_shm.detach();
+}
+
+/// @brief destroy the block
+/// @return
+RetType TelemetryShm::destroy() {
+    free(m_buffs);
+    m_buffs = NULL;
+
+    return m_shm.destroy();
+}
+
+/// @brief get the triple buffer for a measurement
+/// @param index    index of the measurement in the packet
+/// @return the triple buffer or NULL if not attached / out of range
+ShmTripleBuffer<measurement_t>* TelemetryShm::buffer(size_t index) {
+    if(NULL == m_buffs || index >= count) {
+        return NULL;
+    }
+
+    return &m_buffs[index];
+}
+
+/// @brief get the event signaled whenever any measurement is written
+/// @return the event or NULL if not attached
+Event* TelemetryShm::update() {
+    if(NULL == m_shm.data) {
+        return NULL;
+    }
+
+    return &((header_t*)m_shm.data)->update;
+}
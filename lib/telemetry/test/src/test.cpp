@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "lib/telemetry/BatchDecoder.h"
+#include "lib/telemetry/Field.h"
+
+using namespace TelemetryConfigDecls;
+using namespace BatchDecoderDecls;
+
+// every instruction set the processor supports decodes random packets, each
+// field has to match field::raw and field::value exactly, bit for bit, so
+// a value doesn't change depending on which machine decom runs on
+// random bytes include NaNs, infinities and denormals for the float fields
+
+/// number of measurements in the packet layout
+#define NUM_FIELDS 500
+
+/// number of random packets each instruction set is checked against
+#define NUM_CHECKS 200
+
+static int failures = 0;
+
+static void check(bool cond, const char* msg) {
+    if(!cond) {
+        printf("failed telemetry unit test, %s :(\n", msg);
+        failures++;
+    }
+}
+
+/// @brief xorshift64, the layout and packets are the same every run
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/// @brief build a packet layout with a mix of every kind of field
+/// @return the size of the packet in bytes
+static size_t make_layout(packet_info_t* packet) {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    packet->name = "test";
+    packet->port = 0;
+
+    // leave room before the first field for 16 bit loads
+    size_t offset = 2;
+
+    for(size_t i = 0; i < NUM_FIELDS; i++) {
+        measurement_info_t meas;
+        meas.name = "m" + std::to_string(i);
+        meas.offset = offset;
+        meas.bit = 0;
+        meas.endian = (next_random(&state) & 1) ? BIG : LITTLE;
+        meas.type = UINT;
+
+        // scales and biases that don't round nicely, so a fused multiply-add
+        // would round differently than a multiply then an add
+        meas.scale = ((double)(next_random(&state) % 2000001) - 1000000.0) / 7919.0;
+        meas.bias = ((double)(next_random(&state) % 2000001) - 1000000.0) / 104729.0;
+
+        uint64_t kind = next_random(&state) % 16;
+        if(kind < 4) {
+            meas.bits = 16;
+            meas.type = (kind & 1) ? INT : UINT;
+        } else if(kind < 10) {
+            meas.bits = 32;
+            meas.type = (type_t)(kind % 3);
+        } else if(kind < 13) {
+            meas.bits = 64;
+            meas.type = (type_t)(kind % 3);
+        } else if(kind < 15) {
+            meas.bits = 8;
+            meas.type = (kind & 1) ? INT : UINT;
+        } else {
+            // bit field, always big endian
+            meas.bit = next_random(&state) % 8;
+            meas.bits = 1 + next_random(&state) % 12;
+            meas.endian = BIG;
+        }
+
+        packet->measurements.push_back(meas);
+        offset += (meas.bit + meas.bits + 7) / 8;
+    }
+
+    return offset;
+}
+
+/// @brief check a decoder against field::raw and field::value
+/// @return the number of fields that didn't match exactly
+static uint64_t mismatches(BatchDecoder& decoder, const packet_info_t& packet, size_t size) {
+    std::vector<uint8_t> pkt(size);
+    std::vector<uint64_t> raw(NUM_FIELDS);
+    std::vector<double> value(NUM_FIELDS);
+    uint64_t state = 0xD1B54A32D192ED03ULL;
+    uint64_t count = 0;
+
+    for(size_t n = 0; n < NUM_CHECKS; n++) {
+        for(uint8_t& byte : pkt) {
+            byte = next_random(&state);
+        }
+
+        decoder.decode(pkt.data(), raw.data(), value.data());
+
+        for(size_t i = 0; i < NUM_FIELDS; i++) {
+            const measurement_info_t& meas = packet.measurements[i];
+            size_t slot = decoder.slot(i);
+
+            uint64_t r = field::raw(pkt.data(), meas);
+            double v = field::value(r, meas);
+
+            // compare the bits, NaN never equals itself
+            if(raw[slot] == r && 0 == memcmp(&value[slot], &v, sizeof(v))) {
+                continue;
+            }
+
+            if(0 == count) {
+                printf("BatchDecoder (%s) mismatch: measurement %lu, %lu bits at %lu.%lu, "
+                       "raw 0x%lx expected 0x%lx, value %.17g expected %.17g\n",
+                       isa_str[decoder.isa()], i, meas.bits, meas.offset, meas.bit,
+                       raw[slot], r, value[slot], v);
+            }
+
+            count++;
+        }
+    }
+
+    return count;
+}
+
+int main() {
+    packet_info_t packet;
+    size_t size = make_layout(&packet);
+
+    for(int isa = SCALAR; isa <= AVX2; isa++) {
+        BatchDecoder decoder(packet, (isa_t)isa);
+        if(decoder.isa() != isa) {
+            printf("skipping %s telemetry unit test, not supported by this processor\n",
+                   isa_str[isa]);
+            continue;
+        }
+
+        check(decoder.min_size() == size, "minimum packet size doesn't cover every field");
+        check(0 == mismatches(decoder, packet, size), "decoded value doesn't match field::value");
+    }
+
+    return failures ? 1 : 0;
+}
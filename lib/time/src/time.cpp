@@ -9,53 +9,492 @@
 
 #include <time.h>
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
 
 #include "lib/time/time.h"
 
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#define HAVE_TSC
+#endif
+
+using namespace time_util;
+
+// intermediate for fixed point math, products of cycles and rates overflow
+// 64 bits
+__extension__ typedef unsigned __int128 uint128_t;
+
+/// the file naming the clocksource the kernel uses
+#define CLOCKSOURCE_FILE "/sys/devices/system/clocksource/clocksource0/current_clocksource"
+
+/// how often the TSC is recalibrated
+static const timestamp_t RECAL_NS = NS_PER_SEC;
+
+/// how long the first calibration measures the TSC for
+static const timestamp_t INITIAL_CAL_NS = 2 * NS_PER_MS;
+
+/// how many times to read the clocks when taking an anchor
+static const int ANCHOR_TRIES = 5;
+
+/// the most the clock is slewed by in one calibration period, if it falls
+/// further behind than this it's stepped forward instead
+static const int64_t MAX_SLEW_NS = NS_PER_MS;
+
+/// @brief converts TSC readings to nanoseconds
+typedef struct {
+    uint64_t tsc;           // TSC at the anchor
+    timestamp_t mono;       // monotonic time at the anchor, continuous with
+                            // the previous calibration
+    timestamp_t clock;      // CLOCK_MONOTONIC at the anchor
+    uint64_t mult;          // nanoseconds per cycle, 32.32 fixed point
+    int64_t offset;         // CLOCK_REALTIME - CLOCK_MONOTONIC
+    uint64_t next;          // TSC to recalibrate at
+} calibration_t;
+
+/// @brief a calibration and its generation, odd while it's being written
+typedef struct {
+    uint32_t gen;
+    calibration_t cal;
+} cal_slot_t;
+
+// readers copy 'cals[cal_index]', a recalibration fills in the other one and
+// then switches the index, readers never wait
+// a reader that's held up for a whole period can still be copying a slot when
+// the next recalibration starts rewriting it, so each slot is a seqlock and
+// the reader takes another copy if the generation changed under it
+static cal_slot_t cals[2];
+static uint32_t cal_index = 0;
+
+/// number of 64 bit words in a calibration
+static const size_t CAL_WORDS = sizeof(calibration_t) / sizeof(uint64_t);
+static_assert(0 == sizeof(calibration_t) % sizeof(uint64_t), "calibration isn't whole words");
+
+// set while a thread is recalibrating
+static uint32_t cal_busy = 0;
+
+/// @brief read a clock
+/// @param id   the clock
+/// @return the time in nanoseconds
+static timestamp_t clock_ns(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+
+    return ((timestamp_t)ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
+}
+
+#ifdef HAVE_TSC
+/// @brief take a consistent copy of the current calibration
+/// @param cal  filled with the calibration
+static inline void load_cal(calibration_t* cal) {
+    uint64_t* dst = (uint64_t*)cal;
+
+    while(true) {
+        const cal_slot_t* slot = &cals[__atomic_load_n(&cal_index, __ATOMIC_ACQUIRE)];
+
+        uint32_t gen = __atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE);
+        if(gen & 1) {
+            // being rewritten, the index has moved on since we loaded it
+            continue;
+        }
+
+        const uint64_t* src = (const uint64_t*)&slot->cal;
+        for(size_t i = 0; i < CAL_WORDS; i++) {
+            dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+
+        // the copy has to be done before the generation is checked again
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&slot->gen, __ATOMIC_RELAXED) == gen) {
+            return;
+        }
+    }
+}
+
+/// @brief write a calibration into a slot and make it the current one
+///        must only be called by one thread at a time
+/// @param index    the slot
+/// @param cal      the calibration
+static void store_cal(uint32_t index, const calibration_t* cal) {
+    cal_slot_t* slot = &cals[index];
+    const uint64_t* src = (const uint64_t*)cal;
+    uint64_t* dst = (uint64_t*)&slot->cal;
+
+    uint32_t gen = __atomic_load_n(&slot->gen, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->gen, gen + 1, __ATOMIC_RELAXED);
+
+    // readers have to see the odd generation before any of the new words
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for(size_t i = 0; i < CAL_WORDS; i++) {
+        __atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&slot->gen, gen + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&cal_index, index, __ATOMIC_RELEASE);
+}
+
+/// @brief read the TSC and the clocks at (nearly) the same instant
+/// @param tsc      filled with the TSC
+/// @param clock    filled with CLOCK_MONOTONIC
+/// @param real     filled with CLOCK_REALTIME, or NULL
+static void read_anchor(uint64_t* tsc, timestamp_t* clock, timestamp_t* real) {
+    uint64_t best = UINT64_MAX;
+
+    // an interrupt between the reads throws the anchor off, keep the
+    // tightest of a few tries
+    for(int i = 0; i < ANCHOR_TRIES; i++) {
+        uint64_t before = __rdtsc();
+        timestamp_t c = clock_ns(CLOCK_MONOTONIC);
+        timestamp_t r = (NULL != real) ? clock_ns(CLOCK_REALTIME) : 0;
+        uint64_t after = __rdtsc();
+
+        if(after - before < best) {
+            best = after - before;
+
+            // take the TSC halfway between the clock reads
+            *tsc = before + ((after - before) / 2);
+            *clock = c;
+            if(NULL != real) {
+                *real = r;
+            }
+        }
+    }
+}
+
+/// @brief convert a TSC reading to monotonic time
+/// @param cal  the calibration
+/// @param tsc  the TSC
+/// @return the monotonic time
+static inline timestamp_t scale(const calibration_t* cal, uint64_t tsc) {
+    // cores can disagree by a few cycles, don't go back past the anchor
+    uint64_t delta = (tsc > cal->tsc) ? tsc - cal->tsc : 0;
+
+    return cal->mono + (timestamp_t)(((uint128_t)delta * cal->mult) >> 32);
+}
+
+/// @brief calibrate the TSC for the first time
+/// @return true if the TSC can be used
+static bool init_tsc() {
+    // only trust the TSC if the kernel does, it checks that it's invariant
+    // and synchronized across cores
+    FILE* f = fopen(CLOCKSOURCE_FILE, "r");
+    if(NULL == f) {
+        return false;
+    }
+
+    char source[32] = {0};
+    bool tsc = (NULL != fgets(source, sizeof(source), f)) && (0 == strcmp(source, "tsc\n"));
+    fclose(f);
+
+    if(!tsc) {
+        return false;
+    }
+
+    uint64_t tsc0, tsc1;
+    timestamp_t clock0, clock1, real;
+    read_anchor(&tsc0, &clock0, NULL);
+    do {
+        read_anchor(&tsc1, &clock1, &real);
+    } while(clock1 - clock0 < INITIAL_CAL_NS);
+
+    calibration_t cal;
+    cal.tsc = tsc1;
+    cal.mono = clock1;
+    cal.clock = clock1;
+    cal.mult = (uint64_t)((((uint128_t)(clock1 - clock0)) << 32) / (tsc1 - tsc0));
+    cal.offset = (int64_t)(real - clock1);
+    cal.next = tsc1 + (uint64_t)((((uint128_t)RECAL_NS) << 32) / cal.mult);
+
+    store_cal(0, &cal);
+
+    return true;
+}
+
+/// @brief recalibrate the TSC against the clocks
+///        the rate is adjusted so the error is made up over the next period,
+///        so the scale stays continuous
+static void recalibrate() {
+    uint32_t expected = 0;
+    if(!__atomic_compare_exchange_n(&cal_busy, &expected, 1, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        // another thread is already on it
+        return;
+    }
+
+    // only the recalibrating thread writes the slots, so the current one
+    // can't change under us
+    uint32_t index = __atomic_load_n(&cal_index, __ATOMIC_RELAXED);
+    const calibration_t* curr = &cals[index].cal;
+
+    uint64_t tsc;
+    timestamp_t clock, real;
+    read_anchor(&tsc, &clock, &real);
+
+    if(tsc <= curr->tsc || clock <= curr->clock) {
+        __atomic_store_n(&cal_busy, 0, __ATOMIC_RELEASE);
+        return;
+    }
+
+    // the rate over the last period, measured by the clock
+    uint64_t rate = (uint64_t)((((uint128_t)(clock - curr->clock)) << 32) / (tsc - curr->tsc));
+    uint64_t period = (uint64_t)((((uint128_t)RECAL_NS) << 32) / rate);
+
+    timestamp_t ours = scale(curr, tsc);
+    int64_t err = (int64_t)(clock - ours);
+
+    calibration_t next;
+    next.tsc = tsc;
+    next.clock = clock;
+    next.offset = (int64_t)(real - clock);
+    next.next = tsc + period;
+
+    if(err > MAX_SLEW_NS) {
+        // too far behind (e.g. suspended), step forward
+        next.mono = clock;
+        next.mult = rate;
+    } else {
+        // never step backwards, slow down instead
+        if(err < -MAX_SLEW_NS) {
+            err = -MAX_SLEW_NS;
+        }
+
+        next.mono = ours;
+        next.mult = (uint64_t)((((uint128_t)(RECAL_NS + err)) << 32) / period);
+    }
+
+    store_cal(index ^ 1, &next);
+    __atomic_store_n(&cal_busy, 0, __ATOMIC_RELEASE);
+}
+
+/// @brief read the monotonic time from the TSC
+/// @param offset   filled with CLOCK_REALTIME - CLOCK_MONOTONIC
+/// @return the monotonic time
+static inline timestamp_t tsc_mono(int64_t* offset) {
+    uint64_t tsc = __rdtsc();
+
+    calibration_t cal;
+    load_cal(&cal);
+    if(tsc >= cal.next) {
+        recalibrate();
+        load_cal(&cal);
+    }
+
+    *offset = cal.offset;
+    return scale(&cal, tsc);
+}
+#endif
+
+/// @brief check if the clock is read from the TSC
+/// @return true if the TSC is used, false if clock_gettime is
+bool time_util::tsc_enabled() {
+#ifdef HAVE_TSC
+    // calibrated the first time it's needed
+    static const bool enabled = init_tsc();
+
+    return enabled;
+#else
+    return false;
+#endif
+}
+
+/// @brief get the number of nanoseconds since the epoch in UTC
+/// @return the wall clock time
+timestamp_t time_util::now_ns() {
+#ifdef HAVE_TSC
+    if(tsc_enabled()) {
+        int64_t offset;
+        timestamp_t mono = tsc_mono(&offset);
+
+        return mono + offset;
+    }
+#endif
+
+    return clock_ns(CLOCK_REALTIME);
+}
+
+/// @brief get the number of nanoseconds on the monotonic clock
+/// @return the monotonic time
+timestamp_t time_util::mono_ns() {
+#ifdef HAVE_TSC
+    if(tsc_enabled()) {
+        int64_t offset;
+        return tsc_mono(&offset);
+    }
+#endif
+
+    return clock_ns(CLOCK_MONOTONIC);
+}
+
+/// @brief get CLOCK_REALTIME - CLOCK_MONOTONIC
+/// @return the offset in nanoseconds
+static int64_t real_offset() {
+#ifdef HAVE_TSC
+    if(tsc_enabled()) {
+        calibration_t cal;
+        load_cal(&cal);
+
+        return cal.offset;
+    }
+#endif
+
+    timestamp_t mono = clock_ns(CLOCK_MONOTONIC);
+    timestamp_t real = clock_ns(CLOCK_REALTIME);
+
+    return (int64_t)(real - mono);
+}
+
+/// @brief convert a monotonic time to wall clock time
+/// @param mono     the monotonic time
+/// @return the wall clock time
+timestamp_t time_util::mono_to_real(timestamp_t mono) {
+    return mono + real_offset();
+}
+
+/// @brief convert a wall clock time to monotonic time
+/// @param real     the wall clock time
+/// @return the monotonic time
+timestamp_t time_util::real_to_mono(timestamp_t real) {
+    return real - real_offset();
+}
 
 /// @brief get the number of milliseconds since the epoch in UTC
 /// @return the time in milliseconds
 double time_util::now() {
-    double ms;
+    return (double)now_ns() / NS_PER_MS;
+}
 
-    struct timespec time;
-    clock_gettime(CLOCK_REALTIME, &time);
+/// the length of "YYYY-MM-DDTHH:mm:ss"
+static const size_t DATE_TIME_LEN = 19;
 
-    ms = (double)time.tv_sec * 1000;
-    ms += ((double)time.tv_nsec / 1000000);
+/// @brief the date and time of the last second formatted by a thread
+typedef struct {
+    timestamp_t second;             // seconds since the epoch
+    char str[DATE_TIME_LEN];        // not NULL terminated
+} date_cache_t;
 
-    return ms;
+// start with a second that can't be formatted so the first call misses
+static thread_local date_cache_t date_cache = {UINT64_MAX, {0}};
+
+/// @brief write a number with a fixed number of digits, zero padded
+/// @param buff     the buffer to write to
+/// @param value    the number
+/// @param digits   the number of digits
+static inline void write_digits(char* buff, uint64_t value, unsigned int digits) {
+    for(unsigned int i = digits; i > 0; i--) {
+        buff[i - 1] = '0' + (value % 10);
+        value /= 10;
+    }
 }
 
-/// @brief convert a timestamp to a string in YYYY-MM-DDTHH:mm:ssZ format
-/// @param timestamp    the time in milliseconds since the epoch
-/// @param subsecond    whether additional subsecond precision should be included,
-///                     making the timestamp in YYYY-MM-DDTHH:mm:ss.fffZ format.
-const char* time_util::to_string(double timestamp, bool subsecond) {
-    static char buff[4096];
+/// @brief render the date and time of a second into the cache
+///        uses the days to civil date conversion from Howard Hinnant's
+///        "chrono-Compatible Low-Level Date Algorithms" instead of gmtime,
+///        which takes a lock and checks the time zone
+/// @param cache    the cache
+/// @param second   seconds since the epoch
+static void render_date_time(date_cache_t* cache, timestamp_t second) {
+    uint64_t days = second / 86400;
+    uint64_t secs = second % 86400;
+
+    // shift the epoch to 0000-03-01 so leap days fall at the end of a year
+    uint64_t z = days + 719468;
+    uint64_t era = z / 146097;
+    uint64_t doe = z - (era * 146097);                                      // [0, 146096]
+    uint64_t yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365; // [0, 399]
+    uint64_t doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));           // [0, 365]
+    uint64_t mp = ((5 * doy) + 2) / 153;                                    // [0, 11]
+    uint64_t day = doy - (((153 * mp) + 2) / 5) + 1;                        // [1, 31]
+    uint64_t month = (mp < 10) ? mp + 3 : mp - 9;                           // [1, 12]
+    uint64_t year = yoe + (era * 400) + (month <= 2);
+
+    char* str = cache->str;
+    write_digits(str, year, 4);
+    str[4] = '-';
+    write_digits(str + 5, month, 2);
+    str[7] = '-';
+    write_digits(str + 8, day, 2);
+    str[10] = 'T';
+    write_digits(str + 11, secs / 3600, 2);
+    str[13] = ':';
+    write_digits(str + 14, (secs / 60) % 60, 2);
+    str[16] = ':';
+    write_digits(str + 17, secs % 60, 2);
+
+    cache->second = second;
+}
+
+/// @brief format a timestamp in YYYY-MM-DDTHH:mm:ss[.f...] format
+/// @param timestamp    nanoseconds since the epoch
+/// @param buff         the buffer to write to, NULL terminated
+/// @param len          the size of buff
+/// @param digits       subsecond digits, at most MAX_DIGITS
+/// @return the length of the string, or 0 if it didn't fit
+size_t time_util::format(timestamp_t timestamp, char* buff, size_t len, unsigned int digits) {
+    if(digits > MAX_DIGITS) {
+        digits = MAX_DIGITS;
+    }
+
+    size_t str_len = DATE_TIME_LEN + (digits ? digits + 1 : 0);
+    if(NULL == buff || len <= str_len) {
+        return 0;
+    }
 
-    time_t seconds = timestamp / 1000;
+    timestamp_t second = timestamp / NS_PER_SEC;
 
-    // get the decimal seconds in 3 digits
-    // also checks if seconds should be rounded up
-    double remain = timestamp - floor(timestamp);
-    remain = round(remain * 1000);
-    if(remain == 1000) {
-        seconds++;
-        remain = 0;
+    date_cache_t* cache = &date_cache;
+    if(cache->second != second) {
+        render_date_time(cache, second);
     }
 
-    struct tm* tm = gmtime(&seconds);
+    memcpy(buff, cache->str, DATE_TIME_LEN);
 
-    int len = snprintf(buff, 4095, "%04d-%02d-%02dT%02d:%02d:%02d",
-                        tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
-                        tm->tm_hour, tm->tm_min, tm->tm_sec);
+    if(digits) {
+        // drop the digits past the precision
+        uint64_t fraction = timestamp % NS_PER_SEC;
+        for(unsigned int i = digits; i < MAX_DIGITS; i++) {
+            fraction /= 10;
+        }
 
-    if(subsecond) {
-        snprintf(&(buff[len]), 4095 - len, ".%03d", (int)remain);
+        buff[DATE_TIME_LEN] = '.';
+        write_digits(buff + DATE_TIME_LEN + 1, fraction, digits);
     }
 
-    // make sure always NULL terminated
-    buff[4096] = '\0';
+    buff[str_len] = '\0';
+
+    return str_len;
+}
+
+/// @brief format an array of timestamps
+/// @param timestamps   nanoseconds since the epoch
+/// @param count        the number of timestamps
+/// @param buff         filled with 'count' strings, 'stride' bytes apart
+/// @param stride       bytes between strings
+/// @param digits       subsecond digits, at most MAX_DIGITS
+/// @return FAILURE if the strings don't fit in 'stride'
+RetType time_util::format(const timestamp_t* timestamps, size_t count, char* buff, size_t stride,
+                          unsigned int digits) {
+    for(size_t i = 0; i < count; i++) {
+        if(0 == format(timestamps[i], buff + (i * stride), stride, digits)) {
+            return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+}
+
+/// @brief convert a timestamp to a string in YYYY-MM-DDTHH:mm:ss format
+/// @param timestamp    the time in milliseconds since the epoch
+/// @param subsecond    whether additional subsecond precision should be included,
+///                     making the timestamp in YYYY-MM-DDTHH:mm:ss.fff format.
+const char* time_util::to_string(double timestamp, bool subsecond) {
+    static thread_local char buff[TIME_STR_LEN];
+
+    if(timestamp < 0) {
+        timestamp = 0;
+    }
+
+    format((timestamp_t)llround(timestamp * NS_PER_MS), buff, sizeof(buff), subsecond ? 3 : 0);
+
     return buff;
 }
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "lib/time/time.h"
+
+using namespace time_util;
+
+// several threads read the clock for long enough to see a few
+// recalibrations (one a second), every reading has to be at least the last
+// one the thread saw and the latest one any thread published before it, and
+// stay close to CLOCK_MONOTONIC
+
+/// number of threads reading the clock
+#define NUM_THREADS 4
+
+/// how long the threads read the clock for
+static const timestamp_t RUN_NS = 2500 * NS_PER_MS;
+
+/// how far the clock can be from CLOCK_MONOTONIC, a recalibration slews
+/// away at most a millisecond of error per second
+static const int64_t MAX_DRIFT_NS = 2 * NS_PER_MS;
+
+/// readings between comparisons against CLOCK_MONOTONIC
+#define DRIFT_EVERY 1000
+
+static int failures = 0;
+
+static void check(bool cond, const char* msg) {
+    if(!cond) {
+        printf("failed time unit test, %s :(\n", msg);
+        __atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static timestamp_t clock_mono() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((timestamp_t)ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
+}
+
+// latest reading published by any thread
+static timestamp_t latest = 0;
+
+/// @brief per thread results
+typedef struct {
+    uint64_t readings;
+    uint64_t backwards;         // readings before the thread's last one
+    uint64_t behind;            // readings before another thread's published one
+    int64_t max_drift;          // furthest from CLOCK_MONOTONIC
+} result_t;
+
+static void* read_clock(void* arg) {
+    result_t* res = (result_t*)arg;
+    memset(res, 0, sizeof(*res));
+
+    timestamp_t last = 0;
+    timestamp_t end = clock_mono() + RUN_NS;
+    while(true) {
+        timestamp_t published = __atomic_load_n(&latest, __ATOMIC_ACQUIRE);
+        timestamp_t now = mono_ns();
+
+        if(now < last) {
+            res->backwards++;
+        }
+        if(now < published) {
+            res->behind++;
+        }
+        last = now;
+
+        // publish, unless someone published a later one
+        while(published < now &&
+              !__atomic_compare_exchange_n(&latest, &published, now, false,
+                                           __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {}
+
+        if(0 == (++res->readings % DRIFT_EVERY)) {
+            // bracket the reading so preemption only ever loosens the check
+            timestamp_t before = clock_mono();
+            timestamp_t ours = mono_ns();
+            timestamp_t after = clock_mono();
+
+            int64_t drift = 0;
+            if(ours < before) {
+                drift = (int64_t)(before - ours);
+            } else if(ours > after) {
+                drift = (int64_t)(ours - after);
+            }
+
+            if(drift > res->max_drift) {
+                res->max_drift = drift;
+            }
+
+            if(after > end) {
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int main() {
+    pthread_t threads[NUM_THREADS];
+    result_t results[NUM_THREADS];
+
+    for(int i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, read_clock, &results[i]);
+    }
+
+    for(int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+
+        check(results[i].readings > 0, "thread never read the clock");
+        check(0 == results[i].backwards, "clock went backwards in a thread");
+        check(0 == results[i].behind, "clock went backwards across threads");
+        check(results[i].max_drift <= MAX_DRIFT_NS, "clock drifted from CLOCK_MONOTONIC");
+
+        if(results[i].backwards || results[i].behind || results[i].max_drift > MAX_DRIFT_NS) {
+            printf("thread %d: %lu readings, %lu backwards, %lu behind, %ld ns max drift\n",
+                   i, results[i].readings, results[i].backwards, results[i].behind,
+                   results[i].max_drift);
+        }
+    }
+
+    // wall clock time follows CLOCK_REALTIME
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    timestamp_t real = ((timestamp_t)ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
+    timestamp_t ours = now_ns();
+    int64_t diff = (ours > real) ? (int64_t)(ours - real) : (int64_t)(real - ours);
+    check(diff <= MAX_DRIFT_NS, "wall clock time drifted from CLOCK_REALTIME");
+
+    check(mono_to_real(real_to_mono(real)) == real, "real_to_mono and mono_to_real don't round trip");
+
+    return failures ? 1 : 0;
+}
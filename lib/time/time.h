@@ -13,16 +13,92 @@
 #include <stdint.h>
 #include <string>
 
+#include "common/types.h"
+
+// now_ns and mono_ns read the TSC when the kernel trusts it (it's the
+// system clocksource), scaled to nanoseconds by a calibration against
+// CLOCK_MONOTONIC that's refreshed every second, otherwise they fall back to
+// clock_gettime (served by the vDSO, no system call)
+//
+// recalibrating only slews the rate, so mono_ns never steps, and wall clock
+// time is monotonic time plus the CLOCK_REALTIME offset from the last
+// calibration, so it follows NTP a second late
+
 namespace time_util {
 
-    /// @brief get the number of seconds since the epoch in UTC
-    /// @return the time in seconds
+    /// @brief integer nanoseconds, either since the epoch in UTC (wall clock)
+    ///        or since boot (monotonic)
+    typedef uint64_t timestamp_t;
+
+    /// nanoseconds in a millisecond
+    static const timestamp_t NS_PER_MS = 1000000;
+
+    /// nanoseconds in a second
+    static const timestamp_t NS_PER_SEC = 1000000000;
+
+    /// @brief get the number of milliseconds since the epoch in UTC
+    /// @return the time in milliseconds
     double now();
 
-    /// @brief convert a timestamp to a string in YYYY-MM-DDTHH:mm:ssZ format
-    /// @param timestamp    the time in seconds since the epoch
+    /// @brief get the number of nanoseconds since the epoch in UTC
+    /// @return the wall clock time
+    timestamp_t now_ns();
+
+    /// @brief get the number of nanoseconds on the monotonic clock, for
+    ///        measuring intervals
+    /// @return the monotonic time
+    timestamp_t mono_ns();
+
+    /// @brief convert a monotonic time to wall clock time
+    /// @param mono     the monotonic time
+    /// @return the wall clock time
+    timestamp_t mono_to_real(timestamp_t mono);
+
+    /// @brief convert a wall clock time to monotonic time
+    /// @param real     the wall clock time
+    /// @return the monotonic time
+    timestamp_t real_to_mono(timestamp_t real);
+
+    /// @brief check if the clock is read from the TSC
+    /// @return true if the TSC is used, false if clock_gettime is
+    bool tsc_enabled();
+
+    /// the longest formatted timestamp, including the NULL terminator
+    /// "YYYY-MM-DDTHH:mm:ss.fffffffff"
+    static const size_t TIME_STR_LEN = 32;
+
+    /// the most subsecond digits a timestamp can be formatted with
+    static const unsigned int MAX_DIGITS = 9;
+
+    /// @brief format a timestamp in YYYY-MM-DDTHH:mm:ss format, followed by
+    ///        a decimal point and 'digits' subsecond digits if 'digits' isn't 0
+    ///        the date and time of the last second formatted is cached per
+    ///        thread, so timestamps in the same second only render the
+    ///        subsecond digits
+    /// @param timestamp    nanoseconds since the epoch
+    /// @param buff         the buffer to write to, NULL terminated
+    /// @param len          the size of buff, TIME_STR_LEN always fits
+    /// @param digits       subsecond digits (truncated, not rounded), at most
+    ///                     MAX_DIGITS
+    /// @return the length of the string, or 0 if it didn't fit
+    size_t format(timestamp_t timestamp, char* buff, size_t len, unsigned int digits=0);
+
+    /// @brief format an array of timestamps, see 'format'
+    /// @param timestamps   nanoseconds since the epoch
+    /// @param count        the number of timestamps
+    /// @param buff         filled with 'count' strings, the i'th starting at
+    ///                     buff + (i * stride)
+    /// @param stride       bytes between strings, TIME_STR_LEN always fits
+    /// @param digits       subsecond digits, at most MAX_DIGITS
+    /// @return FAILURE if the strings don't fit in 'stride'
+    RetType format(const timestamp_t* timestamps, size_t count, char* buff, size_t stride,
+                   unsigned int digits=0);
+
+    /// @brief convert a timestamp to a string in YYYY-MM-DDTHH:mm:ss format
+    /// NOTE: the string is only valid until the next call from the same thread
+    /// @param timestamp    the time in milliseconds since the epoch
     /// @param subsecond    whether additional subsecond precision should be included,
-    ///                     making the timestamp in YYYY-MM-DDTHH:mm:ss.fZ format.
+    ///                     making the timestamp in YYYY-MM-DDTHH:mm:ss.fff format.
     const char* to_string(double timestamp, bool subsecond=false);
 }
 
@@ -10,6 +10,8 @@
 #ifndef LOCAL_TRIPLE_BUFFER_H
 #define LOCAL_TRIPLE_BUFFER_H
 
+#include "lib/triple_buffer/TripleBuffer.h"
+
 /// @brief triple buffer allocated to local memory (e.g. non-shared)
 /// @tparam TYPE    the type of each buffer
 template <typename TYPE>
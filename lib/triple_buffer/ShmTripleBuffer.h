@@ -0,0 +1,176 @@
+/******************************************************************************
+*  Name: ShmTripleBuffer.h
+*
+*  Purpose: triple buffer allocated in shared memory
+*
+*  Author: Will Merges
+*
+******************************************************************************/
+
+#ifndef SHM_TRIPLE_BUFFER_H
+#define SHM_TRIPLE_BUFFER_H
+
+#include <stdint.h>
+#include <new>
+
+#include "lib/triple_buffer/TripleBuffer.h"
+#include "lib/sync/Event.h"
+#include "lib/time/time.h"
+#include "lib/stats/Histogram.h"
+
+// the shared memory block is layed out as follows
+// | header_t (padded to BUFF_OFFSET) | buffer 0 | buffer 1 | buffer 2 |
+//
+// the header holds the control field used by the triple buffer and an event
+// that is signaled on every write, readers that want to block until a new
+// write is made sleep on the event
+// the writer only makes a system call to wake readers if one is sleeping
+
+// Shared memory triple buffer type and data declarations
+namespace ShmTripleBufferDecls {
+    /// @brief header placed at the start of the shared memory block
+    typedef struct {
+        volatile uint_fast8_t ctl;  // triple buffer control field
+        Event event;                // signaled on every write
+    } header_t;
+
+    /// offset of the first buffer from the start of the block
+    /// the buffers start on their own cache line
+    static const size_t BUFF_OFFSET = 64;
+
+    static_assert(sizeof(header_t) <= BUFF_OFFSET, "triple buffer header too large");
+};
+
+/// @brief triple buffer allocated to shared memory
+/// @tparam TYPE    the type of each buffer, must be trivially copyable
+/// The memory can be anywhere that is shared between the processes, usually
+/// a Shm block of at least SHM_SIZE bytes, e.g.
+///     Shm shm{file, id, ShmTripleBuffer<TYPE>::SHM_SIZE};
+///     shm.create(); shm.attach();
+///     ShmTripleBuffer<TYPE> buff{shm.data, true};
+/// Exactly one process should construct with 'create' set, all others attach
+/// Use 'write' from one process and 'read' or 'read_blocking' from another
+/// Use 'instrument' to record how long each swap takes
+/// NOTE: 'read' and 'write' hide TripleBuffer::read and TripleBuffer::write,
+///       calling them through a pointer to the base class will not wake
+///       blocked readers or record swap times
+template <typename TYPE>
+class ShmTripleBuffer : public TripleBuffer<TYPE> {
+public:
+    /// the number of bytes of shared memory needed to hold the triple buffer
+    static const size_t SHM_SIZE = ShmTripleBufferDecls::BUFF_OFFSET + (3 * sizeof(TYPE));
+
+    /// @brief constructor
+    /// @param mem      shared memory block of at least SHM_SIZE bytes
+    /// @param create   true if the triple buffer should be initialized, false
+    ///                 if attaching to a triple buffer someone else created
+    ShmTripleBuffer(uint8_t* mem, bool create) :
+                    TripleBuffer<TYPE>(((ShmTripleBufferDecls::header_t*)mem)->ctl,
+                                       (TYPE*)(mem + ShmTripleBufferDecls::BUFF_OFFSET),
+                                       create),
+                    m_hdr((ShmTripleBufferDecls::header_t*)mem),
+                    m_writeHist(NULL), m_readHist(NULL) {
+        if(create) {
+            new (&m_hdr->event) Event();
+        }
+    }
+
+    /// @brief obtain a buffer for writing, flushing the last write buffer
+    ///        and waking any readers blocked in 'read_blocking'
+    /// @return a pointer to a buffer to be written to
+    /// NOTE: never blocks, only makes a system call if a reader is sleeping
+    TYPE* write() {
+        TYPE* buff;
+        if(NULL == m_writeHist) {
+            buff = TripleBuffer<TYPE>::write();
+        } else {
+            time_util::timestamp_t start = time_util::mono_ns();
+            buff = TripleBuffer<TYPE>::write();
+            m_writeHist->record(time_util::mono_ns() - start);
+        }
+
+        m_hdr->event.signal();
+
+        return buff;
+    }
+
+    /// @brief obtain a buffer for reading
+    /// @return a pointer to a buffer to be read from or NULL if no new writes
+    ///         were made since the last call to 'read'
+    TYPE* read() {
+        if(NULL == m_readHist) {
+            return TripleBuffer<TYPE>::read();
+        }
+
+        if(!NEW_WRITE(m_hdr->ctl)) {
+            // reads with nothing new aren't timed, a polling reader would
+            // bury the swaps in them
+            return NULL;
+        }
+
+        time_util::timestamp_t start = time_util::mono_ns();
+        TYPE* buff = TripleBuffer<TYPE>::read();
+        m_readHist->record(time_util::mono_ns() - start);
+
+        return buff;
+    }
+
+    /// @brief obtain a buffer for reading, blocking until a new write is made
+    /// @param timeout_ms   maximum time to block in milliseconds, or -1 to
+    ///                     block forever
+    /// @return a pointer to a buffer to be read from or NULL if the timeout
+    ///         expired before a new write was made
+    TYPE* read_blocking(int timeout_ms = -1) {
+        // the event is signaled after the control field is updated, so if
+        // the sequence number is cached before checking for a write, any write
+        // that lands after the check causes the wait to return immediately
+        uint32_t seq = m_hdr->event.sequence();
+
+        TYPE* buff = this->read();
+        if(NULL != buff) {
+            return buff;
+        }
+
+        // one deadline for every wait, so wakeups that find nothing new
+        // (another reader got there first) don't restart the timeout
+        struct timespec ts;
+        struct timespec* deadline = futex::deadline(timeout_ms, &ts);
+
+        while(NULL == buff) {
+            if(SUCCESS != m_hdr->event.wait_until(seq, deadline)) {
+                // timed out
+                return NULL;
+            }
+
+            seq = m_hdr->event.sequence();
+            buff = this->read();
+        }
+
+        return buff;
+    }
+
+    /// @brief get the number of writes made to the triple buffer
+    /// @return the current write sequence number
+    uint32_t sequence() {
+        return m_hdr->event.sequence();
+    }
+
+    /// @brief record how long each swap takes
+    /// @param write    histogram to record writes in, or NULL to not record
+    /// @param read     histogram to record reads that return a buffer in, or
+    ///                 NULL to not record
+    /// NOTE: histograms have a single writer, the writer and reader of this
+    ///       buffer must be the threads that got the histograms
+    void instrument(Histogram* write, Histogram* read) {
+        m_writeHist = write;
+        m_readHist = read;
+    }
+
+private:
+    ShmTripleBufferDecls::header_t* m_hdr;
+
+    Histogram* m_writeHist;
+    Histogram* m_readHist;
+};
+
+#endif
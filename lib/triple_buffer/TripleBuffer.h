@@ -30,8 +30,8 @@
 // implementation heavily influenced from https://github.com/remis-thoughts/blog/blob/master/triple-buffering/src/main/md/triple-buffering.md
 
 #define NEW_WRITE(ctl)   (ctl & 0b01000000)
-#define DIRTY_INDEX(ctl) ((ctl & 0b00110000) > 4)
-#define CLEAN_INDEX(ctl) ((ctl & 0b00001100) > 2)
+#define DIRTY_INDEX(ctl) ((ctl & 0b00110000) >> 4)
+#define CLEAN_INDEX(ctl) ((ctl & 0b00001100) >> 2)
 #define SNAP_INDEX(ctl)  (ctl & 0b00000011)
 
 /// @brief a triple buffer
@@ -92,7 +92,10 @@ protected:
     /// @brief protected constructor
     /// @param ctl      reference to an integer to use for control fields
     /// @param buffs    array of 3 TYPE objects to use as buffers
-    TripleBuffer(volatile uint_fast8_t& ctl, TYPE buffs[3]) : m_ctl(ctl),
+    /// @param init     whether to initialize the control field, should be false
+    ///                 if the control field is shared and already initialized
+    TripleBuffer(volatile uint_fast8_t& ctl, TYPE buffs[3], bool init = true)
+                                                            : m_ctl(ctl),
                                                               m_buffs(buffs) {
         // initial setup is
         // new_write = 0
@@ -100,7 +103,9 @@ protected:
         // clean = 1
         // snap = 2
 
-        ctl = 0b0000110;
+        if(init) {
+            ctl = 0b0000110;
+        }
     }
 
 private:
@@ -1,6 +1,33 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "lib/triple_buffer/LocalTripleBuffer.h"
+#include "lib/triple_buffer/ShmTripleBuffer.h"
+
+static bool stop_signaling = false;
+
+// wakes blocked readers without writing, like a second reader taking the
+// write first would
+static void* signal_event(void* arg) {
+    ShmTripleBufferDecls::header_t* hdr = (ShmTripleBufferDecls::header_t*)arg;
+
+    while(!__atomic_load_n(&stop_signaling, __ATOMIC_RELAXED)) {
+        hdr->event.signal();
+        usleep(1000);
+    }
+
+    return NULL;
+}
+
+static double mono_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ts.tv_sec * 1e3) + (ts.tv_nsec / 1e6);
+}
 
 int main() {
     LocalTripleBuffer<int> buff{};
@@ -16,4 +43,37 @@ int main() {
     if(*r != 5) {
         printf("failed unit test :(\n");
     }
+
+    // the memory is normally a Shm block, but any memory works
+    static uint8_t mem[ShmTripleBuffer<int>::SHM_SIZE];
+    ShmTripleBuffer<int> sbuff{mem, true};
+    ShmTripleBuffer<int> sreader{mem, false};
+
+    if(sreader.read_blocking(10) != NULL) {
+        printf("failed shared memory unit test, read with no write :(\n");
+    }
+
+    w = sbuff.write();
+    *w = 7;
+    w = sbuff.write();
+
+    r = sreader.read_blocking(10);
+    if(NULL == r || *r != 7) {
+        printf("failed shared memory unit test :(\n");
+    }
+
+    // wakeups that find nothing new don't restart the timeout
+    pthread_t thread;
+    pthread_create(&thread, NULL, signal_event, mem);
+
+    double start = mono_ms();
+    r = sreader.read_blocking(50);
+    double elapsed = mono_ms() - start;
+
+    __atomic_store_n(&stop_signaling, true, __ATOMIC_RELAXED);
+    pthread_join(thread, NULL);
+
+    if(NULL != r || elapsed > 500) {
+        printf("failed shared memory unit test, timeout restarted by wakeups :(\n");
+    }
 }
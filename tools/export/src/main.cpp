@@ -0,0 +1,681 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Decodes the packet logs of a run into one CSV file per
+*           measurement, using every core
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_export [-c config] [-o dir] [-j threads] [path]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/types.h"
+#include "lib/logging/PacketLogReader.h"
+#include "lib/telemetry/TelemetryConfig.h"
+#include "lib/telemetry/BatchDecoder.h"
+#include "lib/time/time.h"
+#include "lib/sync/Mutex.h"
+
+using namespace TelemetryConfigDecls;
+using namespace PacketLogReaderDecls;
+
+// decoding runs in two phases on the same pool of threads
+//
+// 1. the logs are split into chunks of about CHUNK_BYTES at packet index
+//    entries, each chunk is decoded into rows of (timestamp, values) per
+//    packet, sorted by timestamp, and written to a temporary file
+// 2. each packet's chunk files are merged in timestamp order into one CSV
+//    file per measurement, the measurements of a packet are split into groups
+//    that are merged separately so packets with many measurements use more
+//    than one thread
+//
+// records are logged in receive order, so chunks are nearly in timestamp order
+// already, a chunk file is only opened for the merge once the merge reaches
+// its earliest timestamp, so only a few are open at a time
+//
+// every thread has its own queue of tasks and takes from the front of it,
+// when it runs out it steals from the back of another thread's queue
+
+/// target size of a chunk of log
+#define CHUNK_BYTES (8 * 1024 * 1024)
+
+/// stdio buffer size of each output file
+#define OUTPUT_BUFFER (256 * 1024)
+
+/// @brief a range of a packet log file
+typedef struct {
+    size_t file;
+    uint64_t start;     // offset of the first record
+    uint64_t end;       // offset past the last record
+} chunk_t;
+
+/// @brief the rows a chunk decoded for one packet
+typedef struct {
+    uint64_t rows;
+    time_util::timestamp_t min;     // earliest timestamp
+} chunk_rows_t;
+
+/// @brief a group of measurements of a packet to merge
+typedef struct {
+    size_t packet;
+    size_t first;       // first measurement
+    size_t last;        // past the last measurement
+} merge_t;
+
+/// @brief shared export state
+typedef struct {
+    std::string log_dir;
+    std::string tmp_dir;
+    std::string out_dir;
+
+    TelemetryConfig config;
+    std::unordered_map<uint16_t, size_t> ports;     // port to packet index
+
+    std::vector<chunk_t> chunks;
+
+    // rows of chunk c for packet p are at [(c * packets) + p]
+    std::vector<chunk_rows_t> rows;
+
+    std::vector<merge_t> merges;
+
+    // counters, updated with atomics
+    uint64_t packets;
+    uint64_t unknown;       // packets on ports not in the configuration
+    uint64_t short_packets;
+    uint64_t corrupt;       // corrupt bytes skipped
+    bool failed;
+} export_t;
+
+/// @brief a thread's task queue
+typedef struct {
+    Mutex lock;
+    std::deque<size_t> tasks;
+} task_queue_t;
+
+/// @brief a pool of threads running a set of tasks
+typedef struct {
+    std::vector<task_queue_t> queues;
+    void (*run)(size_t task, size_t worker, void* arg);
+    void* arg;
+} pool_t;
+
+/// @brief arguments of a pool thread
+typedef struct {
+    pool_t* pool;
+    size_t worker;
+} worker_arg_t;
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_export [-c config] [-o dir] [-j threads] [path]\n");
+    printf("    -c config   telemetry configuration file (default $GSW_HOME/%s)\n",
+           DEFAULT_FILE);
+    printf("    -o dir      directory to write '<packet>/<measurement>.csv' files to\n");
+    printf("                (default export)\n");
+    printf("    -j threads  number of threads (default one per core)\n");
+    printf("    path        a packet log directory (default $GSW_HOME/logs/latest/packets)\n");
+    exit(FAILURE);
+}
+
+/// @brief take the next task for a worker, stealing one if it has none left
+/// @param pool     the pool
+/// @param worker   the worker
+/// @param task     filled with the task
+/// @return false if every queue is empty
+bool take_task(pool_t* pool, size_t worker, size_t* task) {
+    size_t n = pool->queues.size();
+
+    for(size_t i = 0; i < n; i++) {
+        task_queue_t* queue = &pool->queues[(worker + i) % n];
+        bool found = false;
+
+        queue->lock.lock();
+        if(!queue->tasks.empty()) {
+            if(0 == i) {
+                *task = queue->tasks.front();
+                queue->tasks.pop_front();
+            } else {
+                // steal from the other end, the owner's next tasks are
+                // likely next to each other in the log
+                *task = queue->tasks.back();
+                queue->tasks.pop_back();
+            }
+
+            found = true;
+        }
+        queue->lock.unlock();
+
+        if(found) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// @brief pool thread entry point
+/// @param arg  the worker_arg_t
+void* pool_thread(void* arg) {
+    worker_arg_t* w = (worker_arg_t*)arg;
+
+    size_t task;
+    while(take_task(w->pool, w->worker, &task)) {
+        w->pool->run(task, w->worker, w->pool->arg);
+    }
+
+    return NULL;
+}
+
+/// @brief run tasks on a pool of threads and wait for them to finish
+/// @param tasks    the number of tasks, numbered from 0
+/// @param threads  the number of threads
+/// @param run      runs a task
+/// @param arg      passed to 'run'
+/// @return
+RetType run_pool(size_t tasks, size_t threads, void (*run)(size_t, size_t, void*), void* arg) {
+    pool_t pool;
+    pool.queues = std::vector<task_queue_t>(threads);
+    pool.run = run;
+    pool.arg = arg;
+
+    // deal out runs of neighboring tasks
+    for(size_t i = 0; i < tasks; i++) {
+        pool.queues[(i * threads) / tasks].tasks.push_back(i);
+    }
+
+    std::vector<pthread_t> ids(threads);
+    std::vector<worker_arg_t> args(threads);
+
+    for(size_t i = 0; i < threads; i++) {
+        args[i].pool = &pool;
+        args[i].worker = i;
+
+        if(0 != pthread_create(&ids[i], NULL, pool_thread, &args[i])) {
+            printf("Failed to start thread\n");
+
+            // the threads that did start take the rest
+            threads = i;
+            break;
+        }
+    }
+
+    if(0 == threads) {
+        return FAILURE;
+    }
+
+    for(size_t i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    return SUCCESS;
+}
+
+/// @brief get the path of a chunk's temporary file for a packet
+/// @param ex       export state
+/// @param chunk    the chunk index
+/// @param packet   the packet index
+/// @return the path
+std::string chunk_path(export_t* ex, size_t chunk, size_t packet) {
+    return ex->tmp_dir + "/" + std::to_string(chunk) + "-" + std::to_string(packet) + ".bin";
+}
+
+/// @brief per thread decode state
+typedef struct {
+    PacketLogReader reader;
+    std::vector<BatchDecoder*> decoders;    // by packet index
+    std::vector<uint64_t> raw;
+    std::vector<double> value;
+} decode_state_t;
+
+// decode state of each worker, indexed by worker
+std::vector<decode_state_t*> decode_states;
+
+/// @brief decode a chunk
+/// @param task     the chunk index
+/// @param worker   the worker
+/// @param arg      the export_t
+void decode_chunk(size_t task, size_t worker, void* arg) {
+    export_t* ex = (export_t*)arg;
+    decode_state_t* state = decode_states[worker];
+    const chunk_t& chunk = ex->chunks[task];
+    size_t num_packets = ex->config.packets.size();
+
+    // lazily opened, so workers that never run a chunk don't map anything
+    if(state->decoders.empty()) {
+        if(SUCCESS != state->reader.open(ex->log_dir.c_str())) {
+            __atomic_store_n(&ex->failed, true, __ATOMIC_RELAXED);
+            return;
+        }
+
+        size_t max_meas = 0;
+        for(size_t p = 0; p < num_packets; p++) {
+            state->decoders.push_back(new BatchDecoder(ex->config.packets[p]));
+            max_meas = std::max(max_meas, ex->config.packets[p].measurements.size());
+        }
+
+        state->raw.resize(max_meas);
+        state->value.resize(max_meas);
+    }
+
+    // rows of each packet, a timestamp followed by a value per measurement
+    std::vector<std::vector<double>> rows(num_packets);
+    std::vector<std::vector<time_util::timestamp_t>> times(num_packets);
+
+    uint64_t count = 0;
+    uint64_t unknown = 0;
+    uint64_t short_packets = 0;
+    uint64_t corrupt = state->reader.corrupt();
+
+    state->reader.seek(chunk.file, chunk.start);
+
+    packet_t pkt;
+    while(SUCCESS == state->reader.next(&pkt) && pkt.file == chunk.file && pkt.offset < chunk.end) {
+        count++;
+
+        std::unordered_map<uint16_t, size_t>::const_iterator it = ex->ports.find(pkt.rec->port);
+        if(ex->ports.end() == it) {
+            unknown++;
+            continue;
+        }
+
+        size_t p = it->second;
+        BatchDecoder* decoder = state->decoders[p];
+        if(pkt.rec->len < decoder->min_size()) {
+            short_packets++;
+            continue;
+        }
+
+        decoder->decode(pkt.data, state->raw.data(), state->value.data());
+
+        // put values back in measurement order
+        size_t num_meas = ex->config.packets[p].measurements.size();
+        times[p].push_back(pkt.rec->timestamp);
+        for(size_t m = 0; m < num_meas; m++) {
+            rows[p].push_back(state->value[decoder->slot(m)]);
+        }
+    }
+
+    __atomic_fetch_add(&ex->packets, count, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ex->unknown, unknown, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ex->short_packets, short_packets, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ex->corrupt, state->reader.corrupt() - corrupt, __ATOMIC_RELAXED);
+
+    for(size_t p = 0; p < num_packets; p++) {
+        size_t n = times[p].size();
+        chunk_rows_t* out = &ex->rows[(task * num_packets) + p];
+        out->rows = n;
+
+        if(0 == n) {
+            continue;
+        }
+
+        size_t num_meas = ex->config.packets[p].measurements.size();
+
+        // sort rows by timestamp, keeping receive order for equal timestamps
+        std::vector<uint32_t> order(n);
+        for(size_t i = 0; i < n; i++) {
+            order[i] = i;
+        }
+
+        const std::vector<time_util::timestamp_t>& t = times[p];
+        std::stable_sort(order.begin(), order.end(),
+                         [&t](uint32_t a, uint32_t b) { return t[a] < t[b]; });
+
+        out->min = t[order[0]];
+
+        FILE* f = fopen(chunk_path(ex, task, p).c_str(), "w");
+        if(NULL == f) {
+            perror("Failed to create temporary file");
+            __atomic_store_n(&ex->failed, true, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        bool ok = true;
+        for(size_t i = 0; i < n && ok; i++) {
+            ok = (1 == fwrite(&t[order[i]], sizeof(time_util::timestamp_t), 1, f)) &&
+                 (num_meas == fwrite(&rows[p][order[i] * num_meas], sizeof(double), num_meas, f));
+        }
+
+        if(0 != fclose(f) || !ok) {
+            printf("Failed to write temporary file\n");
+            __atomic_store_n(&ex->failed, true, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/// @brief a chunk file being merged
+typedef struct {
+    FILE* file;
+    time_util::timestamp_t timestamp;   // of the current row
+    std::vector<double> values;         // of the current row
+} cursor_t;
+
+/// @brief read the next row of a chunk file
+/// @param cursor   the chunk file
+/// @return false if there are no more rows
+bool advance(cursor_t* cursor) {
+    return 1 == fread(&cursor->timestamp, sizeof(cursor->timestamp), 1, cursor->file) &&
+           cursor->values.size() == fread(cursor->values.data(), sizeof(double),
+                                          cursor->values.size(), cursor->file);
+}
+
+/// @brief merge a packet's chunk files into the files of a group of its
+///        measurements
+/// @param index    the merge_t index
+/// @param worker   the worker
+/// @param arg      the export_t
+void merge_group(size_t index, size_t, void* arg) {
+    export_t* ex = (export_t*)arg;
+    const merge_t& merge = ex->merges[index];
+    size_t p = merge.packet;
+    const packet_info_t& packet = ex->config.packets[p];
+    size_t num_packets = ex->config.packets.size();
+    size_t num_meas = packet.measurements.size();
+
+    // chunks with rows, by earliest timestamp
+    std::vector<size_t> chunks;
+    for(size_t c = 0; c < ex->chunks.size(); c++) {
+        if(ex->rows[(c * num_packets) + p].rows) {
+            chunks.push_back(c);
+        }
+    }
+
+    if(chunks.empty()) {
+        return;
+    }
+
+    std::stable_sort(chunks.begin(), chunks.end(), [ex, num_packets, p](size_t a, size_t b) {
+        return ex->rows[(a * num_packets) + p].min < ex->rows[(b * num_packets) + p].min;
+    });
+
+    std::string dir = ex->out_dir + "/" + packet.name;
+    if(-1 == mkdir(dir.c_str(), 0755) && EEXIST != errno) {
+        printf("Failed to create '%s'\n", dir.c_str());
+        __atomic_store_n(&ex->failed, true, __ATOMIC_RELAXED);
+        return;
+    }
+
+    std::vector<FILE*> outputs(num_meas, NULL);
+    for(size_t m = merge.first; m < merge.last; m++) {
+        std::string path = dir + "/" + packet.measurements[m].name + ".csv";
+        outputs[m] = fopen(path.c_str(), "w");
+        if(NULL == outputs[m]) {
+            printf("Failed to create '%s'\n", path.c_str());
+            __atomic_store_n(&ex->failed, true, __ATOMIC_RELAXED);
+            break;
+        }
+
+        setvbuf(outputs[m], NULL, _IOFBF, OUTPUT_BUFFER);
+        fprintf(outputs[m], "time,%s\n", packet.measurements[m].name.c_str());
+    }
+
+    std::vector<cursor_t> cursors(chunks.size());
+
+    // min heap of cursors by current timestamp
+    typedef std::pair<time_util::timestamp_t, size_t> entry_t;
+    std::priority_queue<entry_t, std::vector<entry_t>, std::greater<entry_t>> heap;
+
+    size_t next = 0;
+    char timestamp[time_util::TIME_STR_LEN];
+
+    while(!__atomic_load_n(&ex->failed, __ATOMIC_RELAXED)) {
+        // open every chunk that could have the next row
+        while(next < chunks.size() &&
+              (heap.empty() || ex->rows[(chunks[next] * num_packets) + p].min <= heap.top().first)) {
+            cursor_t* cursor = &cursors[next];
+            cursor->values.resize(num_meas);
+            cursor->file = fopen(chunk_path(ex, chunks[next], p).c_str(), "r");
+
+            if(NULL != cursor->file && advance(cursor)) {
+                heap.push(entry_t(cursor->timestamp, next));
+            } else {
+                printf("Failed to read temporary file\n");
+                __atomic_store_n(&ex->failed, true, __ATOMIC_RELAXED);
+            }
+
+            next++;
+        }
+
+        if(heap.empty()) {
+            break;
+        }
+
+        cursor_t* cursor = &cursors[heap.top().second];
+        size_t index = heap.top().second;
+        heap.pop();
+
+        time_util::format(cursor->timestamp, timestamp, sizeof(timestamp), time_util::MAX_DIGITS);
+        for(size_t m = merge.first; m < merge.last; m++) {
+            if(NULL != outputs[m]) {
+                fprintf(outputs[m], "%s,%.15g\n", timestamp, cursor->values[m]);
+            }
+        }
+
+        if(advance(cursor)) {
+            heap.push(entry_t(cursor->timestamp, index));
+        } else {
+            fclose(cursor->file);
+            cursor->file = NULL;
+        }
+    }
+
+    for(cursor_t& cursor : cursors) {
+        if(NULL != cursor.file) {
+            fclose(cursor.file);
+        }
+    }
+
+    for(size_t m = merge.first; m < merge.last; m++) {
+        if(NULL != outputs[m] && 0 != fclose(outputs[m])) {
+            printf("Failed to write '%s'\n", packet.measurements[m].name.c_str());
+            __atomic_store_n(&ex->failed, true, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/// @brief split the measurements of every packet into groups to merge, so
+///        there's at least one group per thread
+/// @param ex       export state
+/// @param threads  the number of threads
+void make_merges(export_t* ex, size_t threads) {
+    size_t num_packets = ex->config.packets.size();
+    size_t per_packet = (threads + num_packets - 1) / num_packets;
+
+    for(size_t p = 0; p < num_packets; p++) {
+        size_t num_meas = ex->config.packets[p].measurements.size();
+        size_t groups = std::min(per_packet, num_meas);
+
+        for(size_t g = 0; g < groups; g++) {
+            merge_t merge = {p, (g * num_meas) / groups, ((g + 1) * num_meas) / groups};
+            ex->merges.push_back(merge);
+        }
+    }
+}
+
+/// @brief remove the temporary files
+/// @param ex       export state
+void remove_chunks(export_t* ex) {
+    size_t num_packets = ex->config.packets.size();
+
+    for(size_t c = 0; c < ex->chunks.size(); c++) {
+        for(size_t p = 0; p < num_packets; p++) {
+            if(ex->rows[(c * num_packets) + p].rows) {
+                unlink(chunk_path(ex, c, p).c_str());
+            }
+        }
+    }
+
+    rmdir(ex->tmp_dir.c_str());
+}
+
+/// @brief split the logs into chunks at index entries
+/// @param ex       export state
+/// @param reader   the open logs
+void make_chunks(export_t* ex, PacketLogReader& reader) {
+    const std::vector<file_t>& files = reader.files();
+
+    for(size_t f = 0; f < files.size(); f++) {
+        chunk_t chunk = {f, sizeof(PacketLogDecls::file_header_t), UINT64_MAX};
+
+        for(const PacketLogDecls::index_entry_t& entry : files[f].index) {
+            if(entry.offset >= chunk.start + CHUNK_BYTES) {
+                chunk.end = entry.offset;
+                ex->chunks.push_back(chunk);
+
+                chunk.start = entry.offset;
+                chunk.end = UINT64_MAX;
+            }
+        }
+
+        ex->chunks.push_back(chunk);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    char* gsw_home = getenv("GSW_HOME");
+
+    std::string config_file;
+    if(NULL != gsw_home) {
+        config_file = std::string(gsw_home) + "/" + DEFAULT_FILE;
+    }
+
+    export_t ex;
+    ex.out_dir = "export";
+    ex.packets = 0;
+    ex.unknown = 0;
+    ex.short_packets = 0;
+    ex.corrupt = 0;
+    ex.failed = false;
+
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "c:o:j:h"))) {
+        switch(opt) {
+            case 'c':
+                config_file = optarg;
+                break;
+            case 'o':
+                ex.out_dir = optarg;
+                break;
+            case 'j':
+                threads = atol(optarg);
+                if(threads <= 0) {
+                    usage();
+                }
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if(threads <= 0) {
+        threads = 1;
+    }
+
+    if(optind < argc) {
+        ex.log_dir = argv[optind];
+    } else if(NULL != gsw_home) {
+        ex.log_dir = std::string(gsw_home) + "/logs/latest/packets";
+    }
+
+    if(config_file.empty() || ex.log_dir.empty()) {
+        printf("GSW_HOME environment variable not set, did you run '. setenv'?\n");
+        exit(FAILURE);
+    }
+
+    if(SUCCESS != ex.config.parse(config_file.c_str())) {
+        printf("Failed to parse telemetry configuration '%s'\n", config_file.c_str());
+        exit(FAILURE);
+    }
+
+    for(size_t p = 0; p < ex.config.packets.size(); p++) {
+        ex.ports[ex.config.packets[p].port] = p;
+    }
+
+    PacketLogReader reader;
+    if(SUCCESS != reader.open(ex.log_dir.c_str())) {
+        printf("No packet logs in '%s'\n", ex.log_dir.c_str());
+        exit(FAILURE);
+    }
+
+    make_chunks(&ex, reader);
+    reader.close();
+
+    ex.rows.resize(ex.chunks.size() * ex.config.packets.size());
+
+    ex.tmp_dir = ex.out_dir + "/.tmp";
+    if((-1 == mkdir(ex.out_dir.c_str(), 0755) && EEXIST != errno) ||
+       (-1 == mkdir(ex.tmp_dir.c_str(), 0755) && EEXIST != errno)) {
+        printf("Failed to create output directory '%s'\n", ex.out_dir.c_str());
+        exit(FAILURE);
+    }
+
+    time_util::timestamp_t start = time_util::mono_ns();
+
+    for(long i = 0; i < threads; i++) {
+        decode_states.push_back(new decode_state_t);
+    }
+
+    RetType ret = run_pool(ex.chunks.size(), threads, decode_chunk, &ex);
+
+    for(decode_state_t* state : decode_states) {
+        for(BatchDecoder* decoder : state->decoders) {
+            delete decoder;
+        }
+
+        delete state;
+    }
+    decode_states.clear();
+
+    time_util::timestamp_t decoded = time_util::mono_ns();
+
+    if(SUCCESS == ret && !ex.failed) {
+        make_merges(&ex, threads);
+        ret = run_pool(ex.merges.size(), threads, merge_group, &ex);
+    }
+
+    remove_chunks(&ex);
+
+    time_util::timestamp_t merged = time_util::mono_ns();
+
+    printf("Decoded %lu packets in %lu chunks with %ld threads in %.3f s, merged in %.3f s\n",
+           ex.packets, ex.chunks.size(), threads,
+           (double)(decoded - start) / time_util::NS_PER_SEC,
+           (double)(merged - decoded) / time_util::NS_PER_SEC);
+
+    if(ex.unknown) {
+        printf("%lu packets on ports not in the configuration\n", ex.unknown);
+    }
+
+    if(ex.short_packets) {
+        printf("%lu packets too short to decode\n", ex.short_packets);
+    }
+
+    if(ex.corrupt) {
+        printf("Skipped %lu corrupt bytes\n", ex.corrupt);
+    }
+
+    if(SUCCESS != ret || ex.failed) {
+        printf("Export failed\n");
+        exit(FAILURE);
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,386 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Formats binary system message logs written by the logging daemon
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_logcat [-f] [-c] [-l INFO|WARN|CRIT] [path ...]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "common/types.h"
+#include "lib/logging/MessageLogger.h"
+#include "lib/logging/MessageLog.h"
+#include "lib/time/time.h"
+
+using namespace MessageLogDecls;
+
+/// how often to check for more records when following a log
+#define FOLLOW_INTERVAL_US 100000
+
+// ANSI control escape codes for settings colors
+#define ANSI_RESET          "\033[0m"
+#define ANSI_GREEN_BOLD     "\033[1;32m"
+#define ANSI_YELLOW_BOLD    "\033[1;33m"
+#define ANSI_RED_BOLD       "\033[1;31m"
+#define ANSI_WHITE_BOLD     "\033[1;37m"
+
+// maps message type to escape code color settings
+const char* message_color[MessageLoggerDecls::NUM_MESSAGE_T + 1] = \
+{
+    ANSI_GREEN_BOLD,
+    ANSI_YELLOW_BOLD,
+    ANSI_RED_BOLD,
+    ANSI_WHITE_BOLD
+};
+
+/// @brief output options
+typedef struct {
+    bool csv;           // same format the daemon used to write
+    bool color;         // color the message type
+    uint8_t level;      // lowest severity printed
+} output_t;
+
+/// @brief an open message log file
+typedef struct {
+    FILE* file;
+    std::vector<std::string> sources;   // source names by id
+    std::string payload;                // payload of the last record read
+} log_file_t;
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_logcat [-f] [-c] [-l INFO|WARN|CRIT] [path ...]\n");
+    printf("    -f          follow the log, waiting for new messages and files\n");
+    printf("    -c          print CSV (time,type,message)\n");
+    printf("    -l level    only print messages at least this severe\n");
+    printf("    path        a message log file or a directory of them\n");
+    printf("                (default $GSW_HOME/logs/current/messages)\n");
+    exit(FAILURE);
+}
+
+/// @brief get the path of a file in a message log directory
+/// @param dir      the directory
+/// @param index    the file index
+/// @return the path
+std::string log_path(const std::string& dir, size_t index) {
+    return dir + "/messages-" + std::to_string(index) + SUFFIX;
+}
+
+/// @brief check if a path exists
+/// @param path     the path
+/// @return true if it exists
+bool exists(const std::string& path) {
+    struct stat sb;
+    return 0 == stat(path.c_str(), &sb);
+}
+
+/// @brief open a message log file and check its header
+/// @param path     the file to open
+/// @param log      filled with the open file
+/// @param wait     if the header hasn't been written yet, wait for it
+/// @return
+RetType open_log(const std::string& path, log_file_t* log, bool wait) {
+    log->file = fopen(path.c_str(), "r");
+    if(NULL == log->file) {
+        printf("Failed to open '%s'\n", path.c_str());
+        return FAILURE;
+    }
+
+    log->sources.clear();
+    log->sources.push_back("");
+
+    file_header_t header;
+    while(1 != fread(&header, sizeof(header), 1, log->file)) {
+        if(!wait) {
+            printf("'%s' is not a message log\n", path.c_str());
+            fclose(log->file);
+            return FAILURE;
+        }
+
+        // the daemon just created it
+        clearerr(log->file);
+        rewind(log->file);
+        usleep(FOLLOW_INTERVAL_US);
+    }
+
+    if(MAGIC != header.magic || VERSION != header.version) {
+        printf("'%s' is not a version %u message log\n", path.c_str(), VERSION);
+        fclose(log->file);
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/// @brief read the next record from a message log file
+/// @param log      the file
+/// @param rec      filled with the record, its payload is put in log->payload
+/// @return 1 if a record was read, 0 if there isn't a whole record left
+///         (the file is left at the start of the record), -1 if the file
+///         is corrupt
+int read_record(log_file_t* log, record_t* rec) {
+    long start = ftell(log->file);
+
+    if(1 != fread(rec, sizeof(*rec), 1, log->file)) {
+        clearerr(log->file);
+        fseek(log->file, start, SEEK_SET);
+        return 0;
+    }
+
+    if(rec->len > Logger::MAX_LOG_SIZE) {
+        return -1;
+    }
+
+    log->payload.resize(rec->len);
+    if(rec->len && 1 != fread(&log->payload[0], rec->len, 1, log->file)) {
+        // the rest of the record hasn't been written yet
+        clearerr(log->file);
+        fseek(log->file, start, SEEK_SET);
+        return 0;
+    }
+
+    return 1;
+}
+
+/// @brief print a message
+/// @param log      the file the message is from, holding its payload
+/// @param rec      the message record
+/// @param out      output options
+void print_message(log_file_t* log, const record_t* rec, const output_t* out) {
+    uint8_t type = rec->severity;
+    if(type > MessageLoggerDecls::NUM_MESSAGE_T) {
+        type = MessageLoggerDecls::NUM_MESSAGE_T;
+    }
+
+    if(type < out->level) {
+        return;
+    }
+
+    char timestamp[time_util::TIME_STR_LEN];
+    time_util::format(rec->timestamp, timestamp, sizeof(timestamp), 3);
+    const char* type_str = MessageLoggerDecls::message_str[type];
+
+    std::string source;
+    if(NO_SOURCE != rec->source && rec->source < log->sources.size()) {
+        source = "(" + log->sources[rec->source] + ") ";
+    }
+
+    if(out->csv) {
+        printf("%s,%s,%s%s\n", timestamp, type_str, source.c_str(), log->payload.c_str());
+    } else if(out->color) {
+        printf("%s [%s%s%s] %s%s%s%s\n", timestamp, message_color[type], type_str, ANSI_RESET,
+                                         ANSI_WHITE_BOLD, source.c_str(), log->payload.c_str(),
+                                         ANSI_RESET);
+    } else {
+        printf("%s [%s] %s%s\n", timestamp, type_str, source.c_str(), log->payload.c_str());
+    }
+}
+
+/// @brief print every whole record left in a message log file
+/// @param log      the file
+/// @param out      output options
+/// @return FAILURE if the file is corrupt
+RetType print_records(log_file_t* log, const output_t* out) {
+    record_t rec;
+    int ret;
+
+    while(1 == (ret = read_record(log, &rec))) {
+        if(SOURCE == rec.type) {
+            if(rec.source >= log->sources.size()) {
+                log->sources.resize(rec.source + 1);
+            }
+
+            log->sources[rec.source] = log->payload;
+        } else if(MESSAGE == rec.type) {
+            print_message(log, &rec, out);
+        }
+    }
+
+    if(-1 == ret) {
+        printf("Corrupt record in message log\n");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/// @brief print a message log file
+/// @param path     the file
+/// @param out      output options
+/// @return
+RetType print_file(const std::string& path, const output_t* out) {
+    log_file_t log;
+    if(SUCCESS != open_log(path, &log, false)) {
+        return FAILURE;
+    }
+
+    RetType ret = print_records(&log, out);
+    fclose(log.file);
+
+    return ret;
+}
+
+/// @brief print a message log file, then keep printing records as they're
+///        written until the next file in the directory shows up
+/// @param dir      the directory
+/// @param index    the index of the file in the directory
+/// @param out      output options
+/// @return
+RetType follow_file(const std::string& dir, size_t index, const output_t* out) {
+    log_file_t log;
+    if(SUCCESS != open_log(log_path(dir, index), &log, true)) {
+        return FAILURE;
+    }
+
+    RetType ret = SUCCESS;
+    while(1) {
+        // check for the next file first so nothing written before it was
+        // created gets missed
+        bool rotated = exists(log_path(dir, index + 1));
+
+        if(SUCCESS != print_records(&log, out)) {
+            ret = FAILURE;
+            break;
+        }
+
+        fflush(stdout);
+
+        if(rotated) {
+            break;
+        }
+
+        usleep(FOLLOW_INTERVAL_US);
+    }
+
+    fclose(log.file);
+
+    return ret;
+}
+
+/// @brief print every message log file in a directory
+/// @param dir      the directory
+/// @param follow   keep following the last file
+/// @param out      output options
+/// @return
+RetType print_dir(const std::string& dir, bool follow, const output_t* out) {
+    size_t index = 0;
+
+    if(follow) {
+        while(1) {
+            if(SUCCESS != follow_file(dir, index, out)) {
+                return FAILURE;
+            }
+
+            index++;
+        }
+    }
+
+    while(exists(log_path(dir, index))) {
+        if(SUCCESS != print_file(log_path(dir, index), out)) {
+            return FAILURE;
+        }
+
+        index++;
+    }
+
+    if(0 == index) {
+        printf("No message logs in '%s'\n", dir.c_str());
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    output_t out;
+    out.csv = false;
+    out.color = isatty(STDOUT_FILENO);
+    out.level = MessageLoggerDecls::INFO;
+
+    bool follow = false;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "fcl:h"))) {
+        switch(opt) {
+            case 'f':
+                follow = true;
+                break;
+            case 'c':
+                out.csv = true;
+                break;
+            case 'l':
+                out.level = MessageLoggerDecls::NUM_MESSAGE_T;
+                for(uint8_t i = 0; i < MessageLoggerDecls::NUM_MESSAGE_T; i++) {
+                    if(0 == strcasecmp(optarg, MessageLoggerDecls::message_str[i])) {
+                        out.level = i;
+                    }
+                }
+
+                if(MessageLoggerDecls::NUM_MESSAGE_T == out.level) {
+                    usage();
+                }
+                break;
+            default:
+                usage();
+        }
+    }
+
+    std::vector<std::string> paths;
+    for(int i = optind; i < argc; i++) {
+        paths.push_back(argv[i]);
+    }
+
+    if(paths.empty()) {
+        char* gsw_home = getenv("GSW_HOME");
+        if(NULL == gsw_home) {
+            printf("GSW_HOME environment variable not set, did you run '. setenv'?\n");
+            exit(FAILURE);
+        }
+
+        paths.push_back(std::string(gsw_home) + "/logs/current/messages");
+    }
+
+    if(follow && paths.size() != 1) {
+        printf("Can only follow one directory\n");
+        exit(FAILURE);
+    }
+
+    if(out.csv) {
+        printf("time,type,message\n");
+    }
+
+    for(const std::string& path : paths) {
+        struct stat sb;
+        if(0 != stat(path.c_str(), &sb)) {
+            printf("'%s' does not exist\n", path.c_str());
+            exit(FAILURE);
+        }
+
+        RetType ret;
+        if(S_ISDIR(sb.st_mode)) {
+            ret = print_dir(path, follow, &out);
+        } else if(follow) {
+            printf("Can only follow a directory\n");
+            exit(FAILURE);
+        } else {
+            ret = print_file(path, &out);
+        }
+
+        if(SUCCESS != ret) {
+            exit(FAILURE);
+        }
+    }
+
+    return SUCCESS;
+}
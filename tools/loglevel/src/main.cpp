@@ -0,0 +1,86 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Shows and changes the levels of system message loggers while
+*           processes are running
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_loglevel [tag INFO|WARN|CRIT|OFF]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common/types.h"
+#include "lib/logging/MessageLogger.h"
+#include "lib/logging/LogLevels.h"
+
+/// @brief get the name of a level
+/// @param level    the level
+/// @return the name
+const char* level_str(uint32_t level) {
+    if(level >= MessageLoggerDecls::NUM_MESSAGE_T) {
+        return "OFF";
+    }
+
+    return MessageLoggerDecls::message_str[level];
+}
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_loglevel [tag INFO|WARN|CRIT|OFF]\n");
+    printf("    with no arguments, list the level of every logger\n");
+    printf("    tag     'class::func' for one logger, 'class' for every logger in a\n");
+    printf("            class (including ones that start later), or '%s' for all\n",
+           LogLevelDecls::ALL_TAGS);
+    printf("    level   send messages of at least this type, OFF for none\n");
+    exit(FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    if(1 != argc && 3 != argc) {
+        usage();
+    }
+
+    LogLevels levels;
+    if(SUCCESS != levels.attach()) {
+        printf("Failed to attach to log level table\n");
+        exit(FAILURE);
+    }
+
+    if(3 == argc) {
+        if(strlen(argv[1]) >= LogLevelDecls::MAX_TAG) {
+            printf("Tag can be at most %lu characters\n", LogLevelDecls::MAX_TAG - 1);
+            exit(FAILURE);
+        }
+
+        uint32_t level = MessageLoggerDecls::NUM_MESSAGE_T + 1;
+        for(uint32_t i = 0; i <= MessageLoggerDecls::NUM_MESSAGE_T; i++) {
+            if(0 == strcasecmp(argv[2], level_str(i))) {
+                level = i;
+            }
+        }
+
+        if(level > MessageLoggerDecls::NUM_MESSAGE_T) {
+            usage();
+        }
+
+        if(SUCCESS != levels.set(argv[1], level)) {
+            printf("Log level table is full\n");
+            exit(FAILURE);
+        }
+
+        return SUCCESS;
+    }
+
+    printf("%-*s %s\n", (int)LogLevelDecls::MAX_TAG, "(default)", level_str(levels.default_level()));
+    for(size_t i = 0; i < levels.count(); i++) {
+        const LogLevelDecls::entry_t* entry = levels.entry(i);
+        printf("%-*s %s\n", (int)LogLevelDecls::MAX_TAG, entry->tag, level_str(entry->level));
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,327 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Replays packet logs written by the logging daemon as UDP packets
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_replay [-r rate | -f] [-a address] [-p port] [-s start]
+*                      [-t duration] [path]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string>
+
+#include "common/types.h"
+#include "lib/logging/PacketLogReader.h"
+#include "lib/time/time.h"
+
+using namespace PacketLogReaderDecls;
+
+/// most packets sent per system call
+#define SEND_BATCH 64
+
+/// packets due this soon are sent with the packets already due instead of
+/// sleeping for them, about what a sleep and wake up costs anyway
+#define PACE_SLACK_NS 50000
+
+/// @brief replay options
+typedef struct {
+    double rate;                        // playback speed, 0 for as fast as possible
+    struct sockaddr_in addr;            // where to send packets
+    uint16_t port;                      // port to send every packet to, 0 for
+                                        // the port it was logged with
+    time_util::timestamp_t start;       // log time to start at
+    time_util::timestamp_t end;         // log time to stop at
+} replay_t;
+
+/// @brief a batch of packets to send
+typedef struct {
+    struct mmsghdr msgs[SEND_BATCH];
+    struct iovec vecs[SEND_BATCH];
+    struct sockaddr_in addrs[SEND_BATCH];
+    int len;
+} send_batch_t;
+
+volatile sig_atomic_t should_exit = 0;
+
+/// @brief signal handler that sets 'should_exit'
+void sig_exit(int) {
+    should_exit = 1;
+}
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_replay [-r rate | -f] [-a address] [-p port] [-s start] [-t duration] [path]\n");
+    printf("    -r rate     playback speed relative to real time (default 1)\n");
+    printf("    -f          send packets as fast as possible\n");
+    printf("    -a address  IPv4 address to send packets to (default 127.0.0.1)\n");
+    printf("    -p port     send every packet to this port instead of the port it was logged with\n");
+    printf("    -s start    start this many seconds into the log\n");
+    printf("    -t duration stop after this many seconds of log\n");
+    printf("    path        a packet log directory (default $GSW_HOME/logs/latest/packets)\n");
+    exit(FAILURE);
+}
+
+/// @brief parse a non-negative number of seconds
+/// @param arg  the argument
+/// @return the number of nanoseconds
+time_util::timestamp_t parse_seconds(const char* arg) {
+    char* end;
+    double seconds = strtod(arg, &end);
+    if(end == arg || '\0' != *end || seconds < 0) {
+        usage();
+    }
+
+    return (time_util::timestamp_t)(seconds * time_util::NS_PER_SEC);
+}
+
+/// @brief sleep until a monotonic time
+/// @param mono     the time to wake up at, same clock as time_util::mono_ns
+void sleep_until(time_util::timestamp_t mono) {
+    struct timespec ts;
+    ts.tv_sec = mono / time_util::NS_PER_SEC;
+    ts.tv_nsec = mono % time_util::NS_PER_SEC;
+
+    // restarts if interrupted by anything other than a signal we handle
+    while(EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) && !should_exit) {}
+}
+
+/// @brief send every packet in a batch
+/// @param sd       the socket
+/// @param batch    the batch, emptied
+/// @return the number of packets that couldn't be sent
+size_t send_batch(int sd, send_batch_t* batch) {
+    int sent = 0;
+
+    while(sent < batch->len) {
+        int n = sendmmsg(sd, batch->msgs + sent, batch->len - sent, 0);
+        if(-1 == n) {
+            if(EINTR == errno && !should_exit) {
+                continue;
+            }
+
+            perror("sendmmsg failed");
+            break;
+        }
+
+        sent += n;
+    }
+
+    size_t failed = batch->len - sent;
+    batch->len = 0;
+
+    return failed;
+}
+
+/// @brief replay packets
+/// @param reader   the open packet logs
+/// @param opts     replay options
+/// @return
+RetType replay(PacketLogReader& reader, const replay_t* opts) {
+    int sd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(-1 == sd) {
+        perror("Failed to open socket");
+        return FAILURE;
+    }
+
+    static send_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    for(int i = 0; i < SEND_BATCH; i++) {
+        batch.msgs[i].msg_hdr.msg_iov = &batch.vecs[i];
+        batch.msgs[i].msg_hdr.msg_iovlen = 1;
+        batch.msgs[i].msg_hdr.msg_name = &batch.addrs[i];
+        batch.msgs[i].msg_hdr.msg_namelen = sizeof(batch.addrs[i]);
+    }
+
+    reader.seek(opts->start);
+
+    packet_t pkt;
+    bool have = (SUCCESS == reader.next(&pkt));
+
+    // records are in receive order, skip the ones before the start that the
+    // index entry we seeked to covers
+    while(have && pkt.rec->timestamp < opts->start) {
+        have = (SUCCESS == reader.next(&pkt));
+    }
+
+    // log time and monotonic time playback started at
+    time_util::timestamp_t log_base = have ? pkt.rec->timestamp : 0;
+    time_util::timestamp_t mono_base = time_util::mono_ns();
+
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    uint64_t failed = 0;
+    uint64_t late = 0;
+
+    while(have && !should_exit) {
+        time_util::timestamp_t now = time_util::mono_ns();
+
+        // gather every packet that's due, sleeping for the first one
+        while(have && batch.len < SEND_BATCH) {
+            if(pkt.rec->timestamp > opts->end) {
+                have = false;
+                break;
+            }
+
+            if(opts->rate > 0) {
+                // packets received out of order are sent right away
+                time_util::timestamp_t elapsed = 0;
+                if(pkt.rec->timestamp > log_base) {
+                    elapsed = (time_util::timestamp_t)((pkt.rec->timestamp - log_base) / opts->rate);
+                }
+
+                time_util::timestamp_t due = mono_base + elapsed;
+                if(due > now + PACE_SLACK_NS) {
+                    if(batch.len > 0) {
+                        // send what's due before waiting
+                        break;
+                    }
+
+                    sleep_until(due);
+                    if(should_exit) {
+                        break;
+                    }
+
+                    now = time_util::mono_ns();
+                } else if(now > due + time_util::NS_PER_MS) {
+                    late++;
+                }
+            }
+
+            int i = batch.len++;
+            batch.vecs[i].iov_base = (void*)pkt.data;
+            batch.vecs[i].iov_len = pkt.rec->len;
+            batch.addrs[i] = opts->addr;
+            batch.addrs[i].sin_port = htons(opts->port ? opts->port : pkt.rec->port);
+
+            count++;
+            bytes += pkt.rec->len;
+
+            have = (SUCCESS == reader.next(&pkt));
+        }
+
+        failed += send_batch(sd, &batch);
+    }
+
+    failed += send_batch(sd, &batch);
+
+    double seconds = (double)(time_util::mono_ns() - mono_base) / time_util::NS_PER_SEC;
+    printf("Sent %lu packets (%lu bytes) in %.3f s, %.0f packets/s\n", count - failed, bytes,
+           seconds, seconds > 0 ? (count - failed) / seconds : 0);
+
+    if(late) {
+        printf("%lu packets sent more than 1 ms late\n", late);
+    }
+
+    if(failed) {
+        printf("Failed to send %lu packets\n", failed);
+    }
+
+    if(reader.corrupt()) {
+        printf("Skipped %lu corrupt bytes in %lu places\n", reader.corrupt(), reader.resyncs());
+    }
+
+    close(sd);
+
+    return failed ? FAILURE : SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    replay_t opts;
+    opts.rate = 1;
+    opts.port = 0;
+    opts.start = 0;
+    opts.end = UINT64_MAX;
+
+    memset(&opts.addr, 0, sizeof(opts.addr));
+    opts.addr.sin_family = AF_INET;
+    opts.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    time_util::timestamp_t start = 0;
+    time_util::timestamp_t duration = UINT64_MAX;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "r:fa:p:s:t:h"))) {
+        switch(opt) {
+            case 'r':
+                opts.rate = strtod(optarg, NULL);
+                if(opts.rate <= 0) {
+                    usage();
+                }
+                break;
+            case 'f':
+                opts.rate = 0;
+                break;
+            case 'a':
+                if(1 != inet_pton(AF_INET, optarg, &opts.addr.sin_addr)) {
+                    printf("Invalid address '%s'\n", optarg);
+                    exit(FAILURE);
+                }
+                break;
+            case 'p':
+                opts.port = atoi(optarg);
+                if(0 == opts.port) {
+                    usage();
+                }
+                break;
+            case 's':
+                start = parse_seconds(optarg);
+                break;
+            case 't':
+                duration = parse_seconds(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+
+    std::string path;
+    if(optind < argc) {
+        path = argv[optind];
+    } else {
+        char* gsw_home = getenv("GSW_HOME");
+        if(NULL == gsw_home) {
+            printf("GSW_HOME environment variable not set, did you run '. setenv'?\n");
+            exit(FAILURE);
+        }
+
+        path = std::string(gsw_home) + "/logs/latest/packets";
+    }
+
+    PacketLogReader reader;
+    if(SUCCESS != reader.open(path.c_str())) {
+        printf("No packet logs in '%s'\n", path.c_str());
+        exit(FAILURE);
+    }
+
+    // times are relative to the first packet
+    packet_t first;
+    if(SUCCESS != reader.next(&first)) {
+        printf("No packets in '%s'\n", path.c_str());
+        exit(FAILURE);
+    }
+
+    opts.start = first.rec->timestamp + start;
+    opts.end = (UINT64_MAX - opts.start < duration) ? UINT64_MAX : opts.start + duration;
+
+    signal(SIGINT, sig_exit);
+    signal(SIGTERM, sig_exit);
+
+    if(SUCCESS != replay(reader, &opts)) {
+        exit(FAILURE);
+    }
+
+    return SUCCESS;
+}
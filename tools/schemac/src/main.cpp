@@ -0,0 +1,147 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Telemetry schema compiler, generates a straight-line extraction
+*           kernel for every packet in a telemetry configuration
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_schemac config [output]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string>
+
+#include "common/types.h"
+#include "lib/telemetry/TelemetryConfig.h"
+
+using namespace TelemetryConfigDecls;
+
+// the generated source defines 'generated_kernels', a table of
+// ExtractorDecls::kernel_entry_t that Extractor::use_kernel searches
+// every measurement is extracted with the field::raw and field::value
+// templates, so offsets, widths, byte swaps and conversions are all constants
+
+/// @brief escape a string for use in a C string literal
+/// @param str  the string
+/// @return the escaped string
+std::string escape(const std::string& str) {
+    std::string out;
+    for(char c : str) {
+        if('"' == c || '\\' == c) {
+            out += '\\';
+        }
+        out += c;
+    }
+
+    return out;
+}
+
+/// @brief write the extraction kernel for a packet
+/// @param f        the output file
+/// @param packet   the packet
+/// @param index    index of the packet in the configuration
+void write_kernel(FILE* f, const packet_info_t& packet, size_t index) {
+    size_t min_size = 0;
+    for(const measurement_info_t& meas : packet.measurements) {
+        size_t end = meas.offset + ((meas.bit + meas.bits + 7) / 8);
+        if(end > min_size) {
+            min_size = end;
+        }
+    }
+
+    fprintf(f, "// packet '%s'\n", packet.name.c_str());
+    fprintf(f, "static RetType kernel_%lu(const uint8_t* pkt, size_t len, measurement_t** out) {\n", index);
+    fprintf(f, "    if(len < %lu) {\n", min_size);
+    fprintf(f, "        return FAILURE;\n");
+    fprintf(f, "    }\n\n");
+
+    if(packet.measurements.size()) {
+        fprintf(f, "    uint64_t raw;\n\n");
+    } else {
+        fprintf(f, "    (void)pkt;\n");
+        fprintf(f, "    (void)out;\n\n");
+    }
+
+    for(size_t i = 0; i < packet.measurements.size(); i++) {
+        const measurement_info_t& meas = packet.measurements[i];
+
+        const char* endian = (BIG == meas.endian) ? "BIG" : "LITTLE";
+        const char* type = "UINT";
+        if(INT == meas.type) {
+            type = "INT";
+        } else if(FLOAT == meas.type) {
+            type = "FLOAT";
+        }
+
+        fprintf(f, "    // %s\n", meas.name.c_str());
+        fprintf(f, "    raw = field::raw<%lu, %lu, %lu, %s>(pkt);\n",
+                meas.offset, meas.bit, meas.bits, endian);
+        fprintf(f, "    out[%lu]->raw = raw;\n", i);
+        fprintf(f, "    out[%lu]->value = field::value<%lu, %s>(raw)", i, meas.bits, type);
+
+        // skip the conversion entirely for the common case of no scaling
+        if(1 != meas.scale) {
+            fprintf(f, " * %.17g", meas.scale);
+        }
+        if(0 != meas.bias) {
+            fprintf(f, " + %.17g", meas.bias);
+        }
+        fprintf(f, ";\n\n");
+    }
+
+    fprintf(f, "    return SUCCESS;\n");
+    fprintf(f, "}\n\n");
+}
+
+int main(int argc, char* argv[]) {
+    if(argc < 2 || argc > 3) {
+        printf("usage: gsw_schemac config [output]\n");
+        exit(FAILURE);
+    }
+
+    TelemetryConfig config;
+    if(SUCCESS != config.parse(argv[1])) {
+        printf("Failed to parse telemetry configuration '%s'\n", argv[1]);
+        exit(FAILURE);
+    }
+
+    FILE* f = stdout;
+    if(3 == argc) {
+        f = fopen(argv[2], "w");
+        if(NULL == f) {
+            perror("Failed to open output file");
+            exit(FAILURE);
+        }
+    }
+
+    fprintf(f, "// generated by gsw_schemac from '%s', do not edit\n\n", argv[1]);
+    fprintf(f, "#include <stdint.h>\n");
+    fprintf(f, "#include <stdlib.h>\n\n");
+    fprintf(f, "#include \"common/types.h\"\n");
+    fprintf(f, "#include \"lib/telemetry/Extractor.h\"\n");
+    fprintf(f, "#include \"lib/telemetry/Field.h\"\n\n");
+    fprintf(f, "using namespace TelemetryConfigDecls;\n");
+    fprintf(f, "using namespace TelemetryShmDecls;\n\n");
+
+    for(size_t i = 0; i < config.packets.size(); i++) {
+        write_kernel(f, config.packets[i], i);
+    }
+
+    fprintf(f, "extern const ExtractorDecls::kernel_entry_t generated_kernels[] = {\n");
+    for(size_t i = 0; i < config.packets.size(); i++) {
+        const packet_info_t& packet = config.packets[i];
+        fprintf(f, "    {\"%s\", 0x%016lxULL, kernel_%lu},\n",
+                escape(packet.name).c_str(), TelemetryConfig::fingerprint(packet), i);
+    }
+    fprintf(f, "    {NULL, 0, NULL}\n");
+    fprintf(f, "};\n");
+
+    if(stdout != f) {
+        fclose(f);
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,354 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Shows live percentiles of the histograms, the rates of the
+*           counters and the values of the gauges every process records in
+*           the stats table
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_stat [-i interval_ms] [-n reports] [-c] [-p] [filter ...]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "common/types.h"
+#include "lib/stats/Stats.h"
+#include "lib/time/time.h"
+
+using namespace StatsDecls;
+
+/// @brief a copy of an entry in the table
+typedef struct {
+    bool valid;                 // false if the entry was free or being reused
+    std::string name;
+    uint32_t type;
+    uint32_t unit;
+    int32_t pid;
+    uint32_t generation;
+    Histogram hist;
+    uint64_t value;             // counter or gauge value
+} snapshot_t;
+
+/// @brief a stat combined from every entry with the same name
+typedef struct {
+    uint32_t type;
+    uint32_t unit;
+    Histogram hist;
+    uint64_t value;
+    uint64_t total;             // counter value since the entries were
+                                // created, or gauge value
+} stat_t;
+
+/// @brief copy an entry, which may be recorded into or reused while copying
+/// @param entry    the entry
+/// @param snap     filled with the copy
+void snapshot(const entry_t* entry, snapshot_t* snap) {
+    memset(&snap->hist, 0, sizeof(snap->hist));
+    snap->value = 0;
+    snap->valid = false;
+
+    snap->type = __atomic_load_n(&entry->type, __ATOMIC_ACQUIRE);
+    if(FREE == snap->type) {
+        return;
+    }
+
+    snap->generation = __atomic_load_n(&entry->generation, __ATOMIC_ACQUIRE);
+    snap->name.assign(entry->name, strnlen(entry->name, MAX_NAME));
+    snap->unit = entry->unit;
+    snap->pid = entry->pid;
+
+    if(HISTOGRAM == snap->type) {
+        snap->hist.merge(entry->hist);
+    } else {
+        snap->value = entry->counter.get();
+    }
+
+    // reusing an entry frees it and bumps its generation before resetting it
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    snap->valid = (snap->type == __atomic_load_n(&entry->type, __ATOMIC_ACQUIRE) &&
+                   snap->generation == __atomic_load_n(&entry->generation, __ATOMIC_ACQUIRE));
+}
+
+/// @brief get what was recorded into a histogram between two copies of it
+/// @param curr     the later copy, replaced with the difference
+/// @param prev     the earlier copy
+void subtract(Histogram* curr, const Histogram& prev) {
+    if(curr->count < prev.count) {
+        // can't happen for the same generation, but never report garbage
+        return;
+    }
+
+    curr->count -= prev.count;
+    curr->sum -= prev.sum;
+
+    size_t highest = 0;
+    for(size_t i = 0; i < HistogramDecls::NUM_BUCKETS; i++) {
+        curr->buckets[i] -= prev.buckets[i];
+        if(curr->buckets[i]) {
+            highest = i;
+        }
+    }
+
+    // the largest value in the window isn't kept, the bucket it fell in is
+    // the best bound there is
+    uint64_t high = HistogramDecls::bucket_high(highest);
+    if(curr->count && high < curr->max) {
+        curr->max = high;
+    }
+}
+
+/// @brief format a value of a histogram
+/// @param buff     the buffer to format into
+/// @param len      the size of 'buff'
+/// @param val      the value
+/// @param unit     the unit of the histogram
+void format_value(char* buff, size_t len, double val, uint32_t unit) {
+    if(COUNT == unit) {
+        snprintf(buff, len, "%.0f", val);
+    } else if(val < 1e3) {
+        snprintf(buff, len, "%.0fns", val);
+    } else if(val < 1e6) {
+        snprintf(buff, len, "%.1fus", val / 1e3);
+    } else if(val < 1e9) {
+        snprintf(buff, len, "%.1fms", val / 1e6);
+    } else {
+        snprintf(buff, len, "%.2fs", val / 1e9);
+    }
+}
+
+/// @brief print a report
+/// @param stats    the stats to print, by name
+/// @param secs     length of the window the stats cover in seconds
+/// @param window   true if the stats are of a window, false if cumulative
+void report(std::map<std::string, stat_t>& stats, double secs, bool window) {
+    char p50[32];
+    char p99[32];
+    char p999[32];
+    char max[32];
+    char mean[32];
+
+    printf("%-48s %12s %10s %10s %10s %10s %10s\n", "HISTOGRAM", window ? "COUNT/S" : "COUNT",
+           "MEAN", "P50", "P99", "P99.9", "MAX");
+
+    for(std::pair<const std::string, stat_t>& p : stats) {
+        stat_t& stat = p.second;
+        if(HISTOGRAM != stat.type) {
+            continue;
+        }
+
+        Histogram& hist = stat.hist;
+        double count = window ? (secs > 0 ? hist.count / secs : 0) : hist.count;
+
+        if(0 == hist.count) {
+            printf("%-48s %12.0f %10s %10s %10s %10s %10s\n", p.first.c_str(), count,
+                   "-", "-", "-", "-", "-");
+            continue;
+        }
+
+        format_value(mean, sizeof(mean), (double)hist.sum / hist.count, stat.unit);
+        format_value(p50, sizeof(p50), hist.percentile(0.5), stat.unit);
+        format_value(p99, sizeof(p99), hist.percentile(0.99), stat.unit);
+        format_value(p999, sizeof(p999), hist.percentile(0.999), stat.unit);
+        format_value(max, sizeof(max), hist.max, stat.unit);
+
+        printf("%-48s %12.0f %10s %10s %10s %10s %10s\n", p.first.c_str(), count,
+               mean, p50, p99, p999, max);
+    }
+
+    printf("\n%-48s %12s %10s\n", "COUNTER", "TOTAL", window ? "PER SEC" : "");
+
+    for(std::pair<const std::string, stat_t>& p : stats) {
+        stat_t& stat = p.second;
+        if(COUNTER != stat.type) {
+            continue;
+        }
+
+        if(window) {
+            printf("%-48s %12lu %10.1f\n", p.first.c_str(), stat.total,
+                   secs > 0 ? stat.value / secs : 0);
+        } else {
+            printf("%-48s %12lu\n", p.first.c_str(), stat.total);
+        }
+    }
+
+    printf("\n%-48s %12s\n", "GAUGE", "VALUE");
+
+    for(std::pair<const std::string, stat_t>& p : stats) {
+        stat_t& stat = p.second;
+        if(GAUGE != stat.type) {
+            continue;
+        }
+
+        printf("%-48s %12lu\n", p.first.c_str(), stat.total);
+    }
+}
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_stat [-i interval_ms] [-n reports] [-c] [-p] [filter ...]\n");
+    printf("    -i interval_ms  time between reports (default 1000)\n");
+    printf("    -n reports      exit after this many reports (default never)\n");
+    printf("    -c              report everything recorded since each stat was\n");
+    printf("                    created instead of only the last interval\n");
+    printf("    -p              report each process separately\n");
+    printf("    filter          only report stats with a name containing one of these\n");
+    exit(FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned long interval_ms = 1000;
+    unsigned long reports = 0;
+    bool cumulative = false;
+    bool per_process = false;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "i:n:cph"))) {
+        switch(opt) {
+            case 'i': {
+                char* end;
+                interval_ms = strtoul(optarg, &end, 0);
+                if(end == optarg || '\0' != *end || 0 == interval_ms) {
+                    usage();
+                }
+                break;
+            }
+            case 'n': {
+                char* end;
+                reports = strtoul(optarg, &end, 0);
+                if(end == optarg || '\0' != *end) {
+                    usage();
+                }
+                break;
+            }
+            case 'c':
+                cumulative = true;
+                break;
+            case 'p':
+                per_process = true;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    Stats table;
+    if(SUCCESS != table.attach()) {
+        printf("Failed to attach to stats table\n");
+        exit(FAILURE);
+    }
+
+    // only clear the screen for a person watching
+    bool clear = isatty(STDOUT_FILENO);
+
+    std::vector<snapshot_t> prev(MAX_ENTRIES);
+    std::vector<snapshot_t> curr(MAX_ENTRIES);
+    for(size_t i = 0; i < MAX_ENTRIES; i++) {
+        prev[i].valid = false;
+        curr[i].valid = false;
+    }
+
+    time_util::timestamp_t last = time_util::mono_ns();
+    if(!cumulative) {
+        // a window needs somewhere to start
+        for(size_t i = 0; i < table.count(); i++) {
+            snapshot(table.entry(i), &prev[i]);
+        }
+
+        usleep(interval_ms * 1000);
+    }
+
+    for(unsigned long n = 0; 0 == reports || n < reports; n++) {
+        time_util::timestamp_t now = time_util::mono_ns();
+        double secs = (double)(now - last) / time_util::NS_PER_SEC;
+        last = now;
+
+        std::map<std::string, stat_t> stats;
+
+        size_t count = table.count();
+        for(size_t i = 0; i < count; i++) {
+            snapshot_t& snap = curr[i];
+            snapshot(table.entry(i), &snap);
+
+            if(!snap.valid) {
+                prev[i].valid = false;
+                continue;
+            }
+
+            if(optind < argc) {
+                bool match = false;
+                for(int j = optind; j < argc; j++) {
+                    match |= (NULL != strstr(snap.name.c_str(), argv[j]));
+                }
+
+                if(!match) {
+                    continue;
+                }
+            }
+
+            std::string key = snap.name;
+            if(per_process) {
+                key += " [" + std::to_string(snap.pid) + "]";
+            }
+
+            // zero initialized the first time, which is empty
+            stat_t& stat = stats[key];
+            stat.type = snap.type;
+            stat.unit = snap.unit;
+            stat.total += snap.value;
+
+            // an entry that was reused since the last copy starts over
+            bool same = prev[i].valid && prev[i].generation == snap.generation &&
+                        prev[i].type == snap.type;
+
+            if(HISTOGRAM == snap.type) {
+                if(cumulative) {
+                    stat.hist.merge(snap.hist);
+                } else {
+                    Histogram delta = snap.hist;
+                    if(same) {
+                        subtract(&delta, prev[i].hist);
+                    }
+                    stat.hist.merge(delta);
+                }
+            } else if(COUNTER == snap.type) {
+                uint64_t delta = snap.value;
+                if(!cumulative && same && snap.value >= prev[i].value) {
+                    delta -= prev[i].value;
+                }
+                stat.value += delta;
+            }
+        }
+
+        if(clear) {
+            printf("\033[H\033[2J");
+        }
+
+        char timestamp[time_util::TIME_STR_LEN];
+        time_util::format(time_util::now_ns(), timestamp, sizeof(timestamp), 0);
+        if(cumulative) {
+            printf("%s, since each stat was created\n\n", timestamp);
+        } else {
+            printf("%s, last %.1f seconds\n\n", timestamp, secs);
+        }
+
+        report(stats, secs, !cumulative);
+        fflush(stdout);
+
+        std::swap(prev, curr);
+
+        if(0 == reports || n + 1 < reports) {
+            usleep(interval_ms * 1000);
+        }
+    }
+
+    return SUCCESS;
+}
@@ -0,0 +1,388 @@
+/******************************************************************************
+*  Name: main.cpp
+*
+*  Purpose: Exports the packet trace rings of every process as a Chrome trace
+*           (also loaded by Perfetto) and prints how long packets take to
+*           reach each stage
+*
+*  Author: Will Merges
+*
+*  Usage: ./gsw_trace [-o file] [-r]
+*
+******************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "common/types.h"
+#include "lib/stats/Trace.h"
+#include "lib/stats/Histogram.h"
+
+using namespace TraceDecls;
+
+/// the directory POSIX shared memory blocks appear in
+#define SHM_DIR "/dev/shm"
+
+/// @brief the stage each stage follows, the latency of a stage is measured
+///        from it
+static const int PREVIOUS[NUM_STAGES] = {
+    -1,                 // RECEIVE
+    RECEIVE,            // LOG
+    LOG,                // PUBLISH, extracted after being queued to log
+    LOG,                // LOGD_WRITE
+    PUBLISH,            // BROKER_READ
+    BROKER_READ,        // BROKER_PUBLISH
+    BROKER_PUBLISH      // CONSUMER_READ
+};
+
+/// @brief a record and the process it came from
+typedef struct {
+    record_t rec;
+    int32_t pid;
+} event_t;
+
+/// @brief a packet, identified by its port and sequence number
+typedef std::pair<uint16_t, uint64_t> packet_key_t;
+
+/// @brief latencies of a stage
+typedef struct {
+    Histogram step;         // since the stage before it
+    Histogram total;        // since the packet was received
+} stage_stats_t;
+
+/// @brief read the records of every trace ring
+/// @param events   filled with the records
+/// @param names    filled with the name of each process
+/// @param rings    filled with the shared memory name of each ring by pid
+/// @return the number of rings read
+size_t read_rings(std::vector<event_t>& events, std::map<int32_t, std::string>& names,
+                  std::map<int32_t, std::string>& rings) {
+    DIR* dir = opendir(SHM_DIR);
+    if(NULL == dir) {
+        perror("Failed to open " SHM_DIR);
+        exit(FAILURE);
+    }
+
+    // the prefix without the leading '/'
+    const char* prefix = SHM_PREFIX + 1;
+    size_t prefix_len = strlen(prefix);
+
+    record_t* records = new record_t[RING_SIZE];
+    size_t count = 0;
+
+    struct dirent* ent;
+    while(NULL != (ent = readdir(dir))) {
+        if(0 != strncmp(ent->d_name, prefix, prefix_len)) {
+            continue;
+        }
+
+        std::string name = std::string("/") + ent->d_name;
+
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if(-1 == fd) {
+            continue;
+        }
+
+        struct stat sb;
+        if(-1 == fstat(fd, &sb) || (size_t)sb.st_size < sizeof(ring_t)) {
+            close(fd);
+            continue;
+        }
+
+        void* addr = mmap(NULL, sizeof(ring_t), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+
+        if(MAP_FAILED == addr) {
+            continue;
+        }
+
+        const ring_t* ring = (const ring_t*)addr;
+        if(MAGIC != __atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) || VERSION != ring->version) {
+            munmap(addr, sizeof(ring_t));
+            continue;
+        }
+
+        size_t n = Trace::copy(ring, records);
+        for(size_t i = 0; i < n; i++) {
+            if(records[i].stage < NUM_STAGES) {
+                events.push_back({records[i], ring->pid});
+            }
+        }
+
+        names[ring->pid] = std::string(ring->name, strnlen(ring->name, MAX_NAME));
+        rings[ring->pid] = name;
+        count++;
+
+        munmap(addr, sizeof(ring_t));
+    }
+
+    delete[] records;
+    closedir(dir);
+
+    return count;
+}
+
+/// @brief write a string as a JSON string
+/// @param out  the file to write to
+/// @param str  the string
+void json_string(FILE* out, const char* str) {
+    fputc('"', out);
+
+    for(; *str; str++) {
+        if('"' == *str || '\\' == *str) {
+            fputc('\\', out);
+            fputc(*str, out);
+        } else if((unsigned char)*str < 0x20) {
+            fprintf(out, "\\u%04x", *str);
+        } else {
+            fputc(*str, out);
+        }
+    }
+
+    fputc('"', out);
+}
+
+/// @brief write an event as JSON
+/// @param out      the file to write to
+/// @param first    true if this is the first event written
+/// @param ph       the event phase
+/// @param name     the event name
+/// @param ts       monotonic time of the event in nanoseconds
+/// @param pid      the process
+/// @param tid      the thread
+/// @param key      the packet the event is for
+/// @param extra    more JSON fields, starting with a comma, or ""
+void json_event(FILE* out, bool* first, const char* ph, const char* name,
+                time_util::timestamp_t ts, int32_t pid, int32_t tid,
+                const packet_key_t& key, const char* extra) {
+    fprintf(out, "%s\n  {\"ph\": \"%s\", \"cat\": \"packet\", \"name\": ", *first ? "" : ",", ph);
+    json_string(out, name);
+
+    // trace times are in microseconds
+    fprintf(out, ", \"ts\": %lu.%03lu, \"pid\": %d, \"tid\": %d, \"id\": \"%u:%lu\"%s}",
+            ts / 1000, ts % 1000, pid, tid, key.first, key.second, extra);
+
+    *first = false;
+}
+
+/// @brief format a latency
+/// @param buff     the buffer to format into
+/// @param len      the size of 'buff'
+/// @param ns       the latency in nanoseconds
+void format_ns(char* buff, size_t len, uint64_t ns) {
+    if(ns < 1000) {
+        snprintf(buff, len, "%luns", ns);
+    } else if(ns < 1000000) {
+        snprintf(buff, len, "%.1fus", ns / 1e3);
+    } else if(ns < 1000000000) {
+        snprintf(buff, len, "%.1fms", ns / 1e6);
+    } else {
+        snprintf(buff, len, "%.2fs", ns / 1e9);
+    }
+}
+
+/// @brief print the latency of every stage
+/// @param stats    latencies by stage
+void report(stage_stats_t* stats) {
+    printf("%-16s %10s %-16s %9s %9s %9s   %9s %9s %9s\n", "STAGE", "PACKETS", "FROM",
+           "P50", "P99", "MAX", "RECV P50", "RECV P99", "RECV MAX");
+
+    for(int s = 0; s < NUM_STAGES; s++) {
+        Histogram& step = stats[s].step;
+        Histogram& total = stats[s].total;
+
+        char cols[6][32];
+        format_ns(cols[0], sizeof(cols[0]), step.percentile(0.5));
+        format_ns(cols[1], sizeof(cols[1]), step.percentile(0.99));
+        format_ns(cols[2], sizeof(cols[2]), step.max);
+        format_ns(cols[3], sizeof(cols[3]), total.percentile(0.5));
+        format_ns(cols[4], sizeof(cols[4]), total.percentile(0.99));
+        format_ns(cols[5], sizeof(cols[5]), total.max);
+
+        uint64_t count = std::max(step.count, total.count);
+        if(0 == count) {
+            printf("%-16s %10d\n", stage_str[s], 0);
+            continue;
+        }
+
+        printf("%-16s %10lu %-16s %9s %9s %9s   %9s %9s %9s\n", stage_str[s], count,
+               PREVIOUS[s] < 0 ? "-" : stage_str[PREVIOUS[s]],
+               step.count ? cols[0] : "-", step.count ? cols[1] : "-", step.count ? cols[2] : "-",
+               total.count ? cols[3] : "-", total.count ? cols[4] : "-", total.count ? cols[5] : "-");
+    }
+}
+
+/// @brief print usage and exit
+void usage() {
+    printf("usage: gsw_trace [-o file] [-r]\n");
+    printf("    -o file     write the trace to this file (default trace.json), open it\n");
+    printf("                in Perfetto (ui.perfetto.dev) or chrome://tracing\n");
+    printf("    -r          remove the rings of processes that have exited afterwards\n");
+    printf("processes only record packets when built with 'make TRACE=1'\n");
+    exit(FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    const char* file = "trace.json";
+    bool remove = false;
+
+    int opt;
+    while(-1 != (opt = getopt(argc, argv, "o:rh"))) {
+        switch(opt) {
+            case 'o':
+                file = optarg;
+                break;
+            case 'r':
+                remove = true;
+                break;
+            default:
+                usage();
+        }
+    }
+
+    if(optind != argc) {
+        usage();
+    }
+
+    std::vector<event_t> events;
+    std::map<int32_t, std::string> names;
+    std::map<int32_t, std::string> rings;
+
+    size_t num_rings = read_rings(events, names, rings);
+    if(0 == num_rings) {
+        printf("No trace rings found, were the processes built with 'make TRACE=1'?\n");
+        exit(FAILURE);
+    }
+
+    // every stage a packet reached, in the order it reached them
+    std::map<packet_key_t, std::vector<const event_t*>> packets;
+    for(const event_t& ev : events) {
+        packets[packet_key_t(ev.rec.port, ev.rec.seq)].push_back(&ev);
+    }
+
+    FILE* out = fopen(file, "w");
+    if(NULL == out) {
+        printf("Failed to open '%s'\n", file);
+        exit(FAILURE);
+    }
+
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    bool first = true;
+
+    for(std::pair<const int32_t, std::string>& p : names) {
+        fprintf(out, "%s\n  {\"ph\": \"M\", \"name\": \"process_name\", \"pid\": %d, \"args\": {\"name\": ",
+                first ? "" : ",", p.first);
+        json_string(out, p.second.c_str());
+        fprintf(out, "}}");
+        first = false;
+    }
+
+    // zeroed is empty
+    stage_stats_t* stats = (stage_stats_t*)calloc(NUM_STAGES, sizeof(stage_stats_t));
+
+    char extra[128];
+    for(std::pair<const packet_key_t, std::vector<const event_t*>>& p : packets) {
+        const packet_key_t& key = p.first;
+        std::vector<const event_t*>& stages = p.second;
+
+        std::stable_sort(stages.begin(), stages.end(), [](const event_t* a, const event_t* b) {
+            return a->rec.timestamp < b->rec.timestamp;
+        });
+
+        // when the packet first reached each stage
+        time_util::timestamp_t reached[NUM_STAGES];
+        bool have[NUM_STAGES] = {false};
+        for(const event_t* ev : stages) {
+            if(!have[ev->rec.stage]) {
+                have[ev->rec.stage] = true;
+                reached[ev->rec.stage] = ev->rec.timestamp;
+            }
+        }
+
+        // the packet gets its own track in the process that saw it first,
+        // each stage is a slice from the stage before it in time, so they
+        // nest under the packet no matter which process reached them
+        const event_t* head = stages.front();
+        std::string label = "packet " + std::to_string(key.first) + ":" + std::to_string(key.second);
+
+        snprintf(extra, sizeof(extra), ", \"args\": {\"port\": %u, \"seq\": %lu}", key.first, key.second);
+        json_event(out, &first, "b", label.c_str(), head->rec.timestamp, head->pid, head->rec.tid,
+                   key, extra);
+
+        for(size_t i = 1; i < stages.size(); i++) {
+            const event_t* ev = stages[i];
+            const char* name = stage_str[ev->rec.stage];
+
+            json_event(out, &first, "b", name, stages[i - 1]->rec.timestamp, head->pid,
+                       head->rec.tid, key, "");
+            json_event(out, &first, "e", name, ev->rec.timestamp, head->pid, head->rec.tid, key, "");
+        }
+
+        json_event(out, &first, "e", label.c_str(), stages.back()->rec.timestamp, head->pid,
+                   head->rec.tid, key, "");
+
+        // and a mark on the thread that reached each stage
+        for(const event_t* ev : stages) {
+            if(have[RECEIVE]) {
+                snprintf(extra, sizeof(extra), ", \"s\": \"t\", \"args\": {\"since_receive_us\": %.3f}",
+                         ((double)ev->rec.timestamp - reached[RECEIVE]) / 1000);
+            } else {
+                snprintf(extra, sizeof(extra), ", \"s\": \"t\"");
+            }
+
+            json_event(out, &first, "i", stage_str[ev->rec.stage], ev->rec.timestamp,
+                       ev->pid, ev->rec.tid, key, extra);
+        }
+
+        for(int s = 0; s < NUM_STAGES; s++) {
+            if(!have[s]) {
+                continue;
+            }
+
+            int prev = PREVIOUS[s];
+            if(prev >= 0 && have[prev] && reached[s] >= reached[prev]) {
+                stats[s].step.record(reached[s] - reached[prev]);
+            }
+
+            if(have[RECEIVE] && reached[s] >= reached[RECEIVE]) {
+                stats[s].total.record(reached[s] - reached[RECEIVE]);
+            }
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+
+    if(0 != fclose(out)) {
+        printf("Failed to write '%s'\n", file);
+        exit(FAILURE);
+    }
+
+    printf("Wrote %lu records of %lu packets from %lu processes to '%s'\n\n",
+           events.size(), packets.size(), num_rings, file);
+
+    report(stats);
+    free(stats);
+
+    if(remove) {
+        for(std::pair<const int32_t, std::string>& p : rings) {
+            if(-1 == kill(p.first, 0) && ESRCH == errno) {
+                shm_unlink(p.second.c_str());
+            }
+        }
+    }
+
+    return SUCCESS;
+}